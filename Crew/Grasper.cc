@@ -5,6 +5,7 @@
 #include "DualCoding/ShapeCross.h"
 #include "DualCoding/ShapeNaught.h"
 #include "DualCoding/VRmixin.h"
+#include "Motion/IKBatch.h"
 #include "Motion/IKSolver.h"
 #include "Planners/Navigation/ShapeSpacePlannerXYTheta.h"
 #include "Shared/mathutils.h"
@@ -20,6 +21,7 @@ float closedRightGripperVal = 0.25f;
 
 GrasperRequest* Grasper::curReq = NULL;
 Grasper::GrasperVerbosity_t Grasper::verbosity = -1U;
+ReachabilityMap Grasper::reachabilityMap;
 
 GenericRRTBase::PlannerResult2D
 Grasper::planBodyPath(const Point &targetPt, AngTwoPi approachOrientation,
@@ -1197,8 +1199,8 @@ void Grasper::computeGoalStates(IKSolver::Point &toPt,
 				std::vector<std::pair<float, float> > &rangesZ,
                                 float resolution, std::vector<NodeValue_t>& goals, const IKSolver::Point &offset) {
   // std::cout << "computGoalStates " << toPt << " resolution=" << resolution << std::endl;
-  KinematicJoint* effector = kine->getKinematicJoint(curReq->effectorOffset)->cloneBranch();
   goals.clear();
+  std::vector<IKSolver::Rotation> candidates;
   if (resolution == 0)
     resolution = M_PI/2;
   
@@ -1237,15 +1239,15 @@ void Grasper::computeGoalStates(IKSolver::Point &toPt,
           fmat::Quaternion oriPlus = fmat::Quaternion::fromMatrix(fmat::rotationZ(midZ + thetaZ) * 
 								  fmat::rotationY(midY + thetaY) *
 								  fmat::rotationX(midX + thetaX));
-	  checkGoalCandidate(offset, IKSolver::Rotation(oriPlus), effector, toPt, goals);
+	  candidates.push_back(IKSolver::Rotation(oriPlus));
 	  if ( factorX > 0 ||  factorY > 0 || factorZ > 0 ) {
 	    fmat::Quaternion oriMinus = fmat::Quaternion::fromMatrix(fmat::rotationZ(midZ - thetaZ) *
 								     fmat::rotationY(midY - thetaY) * 
 								     fmat::rotationX(midX - thetaX));
-	    checkGoalCandidate(offset, IKSolver::Rotation(oriMinus), effector, toPt, goals);
+	    candidates.push_back(IKSolver::Rotation(oriMinus));
 	  }
 
-          if ( goals.size() >= curReq->maxNumberOfAngles )
+          if ( candidates.size() >= curReq->maxNumberOfAngles )
             keepGoing = false;
           factorZ++;
         } // Z
@@ -1254,27 +1256,45 @@ void Grasper::computeGoalStates(IKSolver::Point &toPt,
       factorX++;
     } // X
   } while (keepGoing);
+
+  // Solve all the candidates at once, in parallel.  If a reachability
+  // map has been loaded for this effector and effector point, candidates
+  // it rules out are skipped without running IK, and the rest start from
+  // its seeds.  A map of some other point on the effector would wrongly
+  // skip reachable candidates, so it isn't used.
+  float const positionMostImportant = 1.0f;
+  float const orientationLeastImportant = 0.5f;
+  const IKSolver::Parallel vertical(0,0,1);
+  const IKSolver::Rotation oriEff(fmat::Quaternion::aboutX(-M_PI/2));
+  std::vector<IKBatch::Target> targets;
+  for (unsigned int i = 0; i < candidates.size(); i++)
+    targets.push_back(IKBatch::Target(offset, oriEff, toPt, positionMostImportant,
+				      vertical/*candidates[i]*/, orientationLeastImportant));
+  const KinematicJoint* effector = kine->getKinematicJoint(curReq->effectorOffset);
+  IKBatch batch(*effector);
+  const float effectorPointTolerance = 1; // mm
+  if ( reachabilityMap.isValid() && reachabilityMap.getEffectorName() == effector->outputOffset.get() &&
+       (reachabilityMap.getEffectorPoint() - offset).norm() < effectorPointTolerance )
+    batch.setReachabilityMap(&reachabilityMap);
+  std::vector<IKBatch::Solution> solutions;
+  batch.solve(targets, solutions);
+  for (unsigned int i = 0; i < solutions.size(); i++)
+    checkGoalCandidate(solutions[i], goals);
   if ( curReq->verbosity & GVcomputeGoals )
     std::cout << "Grasper found " << goals.size() << " potential goal states." << std::endl;
 }
 
-void Grasper::checkGoalCandidate(const IKSolver::Point &offset, const IKSolver::Rotation &ori, 
-				 KinematicJoint *effector, const IKSolver::Point &position, std::vector<NodeValue_t>& goals) {
-  IKSolver& solver = effector->getIK();
-  float const positionMostImportant = 1.0f;
-  float const orientationLeastImportant = 0.5f;
-  bool reached = solver.solve(offset, IKSolver::Rotation(fmat::Quaternion::aboutX(-M_PI/2)), *effector,
-			      position, positionMostImportant, IKSolver::Parallel(0,0,1)/*ori*/, orientationLeastImportant);
-  std::cout << "checkGoalCandidate: reached = " << reached << std::endl;
-  if (true||reached) {
+void Grasper::checkGoalCandidate(const IKBatch::Solution &solution, std::vector<NodeValue_t>& goals) {
+  if ( curReq->verbosity & GVcomputeGoals )
+    std::cout << "checkGoalCandidate: reached = " << solution.success << (solution.skipped ? " (unreachable)" : "") << std::endl;
+  // Candidates the reachability map ruled out have no solution to
+  // offer; otherwise keep the candidate even if IK didn't converge.
+  if (!solution.skipped) {
+    // The planner joints are the last mobile joints leading up to the effector
     NodeValue_t endSt;
-    KinematicJoint *joint = effector;
-    for (int j = numPlannerJoints-1; j >= 0; j--) {
-      while (joint->isMobile() == false)
-	joint = joint->getParent();
-      endSt[j] = joint->getQ();
-      joint = joint->getParent();
-    }
+    const size_t firstJoint = solution.q.size() - numPlannerJoints;
+    for (unsigned int j = 0; j < numPlannerJoints; j++)
+      endSt[j] = solution.q[firstJoint + j];
     switch ( curReq->graspStrategy ) {
     case GrasperRequest::unconstrainedGrasp:
       break;
@@ -923,6 +923,7 @@ void Pilot::LocalizationUtility::PrepareForNextGazePoint::prepareForNext(std::de
 				 << float(((ShapeBasedParticleFilter*)VRmixin::particleFilter)->getVariance().theta) * 180 / M_PI << " deg."
 				 << "  wtvar " << ((ShapeBasedParticleFilter*)VRmixin::particleFilter)->getVariance().y
 				 << "  bestWeight=" << estimate.weight
+				 << "  particles=" << VRmixin::particleFilter->getNumParticles()
 				 << endl;
 #if defined(TGT_IS_CREATE) || defined(TGT_IS_CREATE2)
 		// cout << "GPS = [ " << state->sensors[GPSXOffset] << " , " << state->sensors[GPSYOffset] << " ]" << endl;
@@ -0,0 +1,154 @@
+#ifndef PLATFORM_APERIOS
+#include "DeadlineMonitor.h"
+#include "Shared/MarkScope.h"
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+using namespace std;
+
+const float DeadlineMonitor::binLimits[DeadlineMonitor::NUM_BINS-1] = { .01f, .02f, .05f, .1f, .25f, .5f, 1 };
+
+/*! @cond INTERNAL */
+//! lock for monitors(), function static to be safe from static initialization order
+static Thread::Lock& monitorsLock() {
+	static Thread::Lock lock;
+	return lock;
+}
+//! all of the monitors in the process, for DeadlineMonitor::dumpStats()
+static std::vector<DeadlineMonitor*>& monitors() {
+	static std::vector<DeadlineMonitor*> m;
+	return m;
+}
+//! displays one line of a histogram with DeadlineMonitor::binLimits
+static void dumpHistogram(std::ostream& os, const char* label, const unsigned int hist[DeadlineMonitor::NUM_BINS]) {
+	os << '\t' << setw(16) << "" << ' ' << label << " histogram:";
+	for(unsigned int i=0; i<DeadlineMonitor::NUM_BINS; ++i) {
+		if(i<DeadlineMonitor::NUM_BINS-1)
+			os << " <" << setprecision(0) << DeadlineMonitor::binLimits[i]*100 << "%:" << hist[i];
+		else
+			os << " >=" << setprecision(0) << DeadlineMonitor::binLimits[i-1]*100 << "%:" << hist[i];
+	}
+	os << endl;
+}
+/*! @endcond */
+
+DeadlineMonitor::DeadlineMonitor(const std::string& monitorName)
+	: name(monitorName), last(), haveLast(false), stats(), intervals(0), lock()
+{
+	MarkScope l(monitorsLock());
+	monitors().push_back(this);
+}
+
+DeadlineMonitor::~DeadlineMonitor() {
+	MarkScope l(monitorsLock());
+	std::vector<DeadlineMonitor*>& m=monitors();
+	m.erase(std::remove(m.begin(),m.end(),this),m.end());
+}
+
+void DeadlineMonitor::activated(const TimeET& period) {
+	TimeET now;
+	MarkScope l(lock);
+	++stats.activations;
+	stats.period=period.Value();
+	if(haveLast && stats.period>0) {
+		const double interval=(now-last).Value();
+		const double jitter=std::fabs(interval-stats.period);
+		++intervals;
+		stats.meanJitter+=jitter;
+		stats.rmsJitter+=jitter*jitter;
+		if(jitter>stats.maxJitter)
+			stats.maxJitter=jitter;
+		const double frac=jitter/stats.period;
+		unsigned int bin=0;
+		while(bin<NUM_BINS-1 && frac>=binLimits[bin])
+			++bin;
+		++stats.histogram[bin];
+		if(interval>=stats.period*1.5)
+			stats.misses+=static_cast<unsigned int>(interval/stats.period+.5)-1;
+	}
+	last=now;
+	haveLast=true;
+}
+
+void DeadlineMonitor::completed(const TimeET& start) {
+	TimeET now;
+	MarkScope l(lock);
+	const double latency=(now-start).Value();
+	++stats.completions;
+	stats.meanLatency+=latency;
+	if(latency>stats.maxLatency)
+		stats.maxLatency=latency;
+	if(stats.period>0) {
+		const double frac=latency/stats.period;
+		unsigned int bin=0;
+		while(bin<NUM_BINS-1 && frac>=binLimits[bin])
+			++bin;
+		++stats.latencyHistogram[bin];
+	}
+}
+
+void DeadlineMonitor::setPeriod(const TimeET& period) {
+	MarkScope l(lock);
+	stats.period=period.Value();
+}
+
+void DeadlineMonitor::restart() {
+	MarkScope l(lock);
+	haveLast=false;
+}
+
+DeadlineMonitor::Stats DeadlineMonitor::getStats() const {
+	MarkScope l(lock);
+	Stats s=stats;
+	if(intervals>0) {
+		s.meanJitter/=intervals;
+		s.rmsJitter=std::sqrt(s.rmsJitter/intervals);
+	}
+	if(s.completions>0)
+		s.meanLatency/=s.completions;
+	return s;
+}
+
+void DeadlineMonitor::resetStats() {
+	MarkScope l(lock);
+	stats=Stats();
+	intervals=0;
+	haveLast=false;
+}
+
+void DeadlineMonitor::dumpStats(std::ostream& os) {
+	MarkScope l(monitorsLock());
+	const std::vector<DeadlineMonitor*>& m=monitors();
+	for(std::vector<DeadlineMonitor*>::const_iterator it=m.begin(); it!=m.end(); ++it)
+		dumpStats(os,(*it)->getName(),(*it)->getStats());
+}
+
+void DeadlineMonitor::dumpStats(std::ostream& os, const std::string& label, const Stats& s) {
+	ios::fmtflags flags=os.flags();
+	streamsize prec=os.precision();
+	os << fixed << setprecision(2);
+	os << '\t' << setw(16) << left << label << right << setw(8) << s.period*1000 << " ms period";
+	if(s.activations>0 || s.completions==0) {
+		os << ", " << s.activations << " cycles, " << s.misses << " missed, jitter mean " << s.meanJitter*1000
+			<< " rms " << s.rmsJitter*1000 << " max " << s.maxJitter*1000 << " ms" << endl;
+		dumpHistogram(os,"jitter",s.histogram);
+	} else {
+		os << endl; // only records latency, see setPeriod()
+	}
+	if(s.completions>0) {
+		os << '\t' << setw(16) << "" << ' ' << s.completions << " completed, latency mean " << setprecision(2)
+			<< s.meanLatency*1000 << " max " << s.maxLatency*1000 << " ms" << endl;
+		dumpHistogram(os,"latency",s.latencyHistogram);
+	}
+	os.flags(flags);
+	os.precision(prec);
+}
+
+/*! @file
+ * @brief Implements DeadlineMonitor, which records missed deadlines and jitter for periodic threads
+ */
+
+#endif //PLATFORM_APERIOS check
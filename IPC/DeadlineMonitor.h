@@ -0,0 +1,101 @@
+//-*-c++-*-
+#ifndef INCLUDED_DeadlineMonitor_h_
+#define INCLUDED_DeadlineMonitor_h_
+
+#ifdef PLATFORM_APERIOS
+#  warning DeadlineMonitor is not Aperios compatable
+#else
+
+#include "Thread.h"
+#include "Shared/TimeET.h"
+#include <iosfwd>
+#include <string>
+
+//! Records timing statistics for a periodic thread: missed deadlines, and jitter in the interval between activations
+/*! The thread calls activated() at the start of each cycle, passing the nominal period.
+ *  The interval since the previous activation is compared to the period: the absolute
+ *  difference is the jitter, which is accumulated into mean/RMS/max statistics and a
+ *  histogram (binned as a fraction of the period).  If the interval reaches 1.5 periods,
+ *  the intervening cycles are counted as missed deadlines.
+ *
+ *  If the cycle's work is delivered later, possibly by another thread (e.g. motion outputs
+ *  written to a serial port by a device driver), completed() records the latency from when
+ *  the work was produced, in a second histogram with the same bins.
+ *
+ *  When the period is changed or the thread is paused, call restart() so the gap isn't
+ *  counted against it.
+ *
+ *  All monitors in a process can be displayed with dumpStats(). */
+class DeadlineMonitor {
+public:
+	static const unsigned int NUM_BINS=8; //!< number of bins in the jitter histogram
+	static const float binLimits[NUM_BINS-1]; //!< upper bounds of all but the last histogram bin, as a fraction of the period
+
+	//! a snapshot of the statistics, see getStats()
+	struct Stats {
+		//! constructor
+		Stats() : activations(0), misses(0), period(0), meanJitter(0), rmsJitter(0), maxJitter(0), completions(0), meanLatency(0), maxLatency(0) {
+			for(unsigned int i=0; i<NUM_BINS; ++i)
+				histogram[i]=latencyHistogram[i]=0;
+		}
+		unsigned int activations; //!< number of calls to activated() (including those following restart(), which have no interval)
+		unsigned int misses; //!< number of cycles which were skipped entirely
+		double period; //!< the most recent nominal period, in seconds
+		double meanJitter; //!< average absolute difference between the measured interval and the period, in seconds
+		double rmsJitter; //!< root mean square jitter, in seconds
+		double maxJitter; //!< largest absolute jitter, in seconds
+		unsigned int histogram[NUM_BINS]; //!< number of intervals with jitter in each bin, see #binLimits
+		unsigned int completions; //!< number of calls to completed()
+		double meanLatency; //!< average time from the start passed to completed() until the call, in seconds
+		double maxLatency; //!< largest latency, in seconds
+		unsigned int latencyHistogram[NUM_BINS]; //!< number of completions with latency in each bin (as a fraction of the period), see #binLimits
+	};
+
+	//! constructor, @a monitorName is used by dumpStats()
+	explicit DeadlineMonitor(const std::string& monitorName);
+	//! destructor
+	~DeadlineMonitor();
+
+	//! call at the start of each cycle, @a period is the nominal time between cycles
+	void activated(const TimeET& period);
+	//! call when work produced at @a start has been delivered, records the latency since then
+	/*! May be called from any thread.  The latency is only binned in the histogram once activated() or setPeriod() has provided a period. */
+	void completed(const TimeET& start);
+	//! sets the nominal period used to bin latencies, for a monitor which only records completed() and not the cycle jitter
+	void setPeriod(const TimeET& period);
+	//! forget the previous activation, so the next activated() doesn't measure an interval
+	void restart();
+
+	//! returns a copy of the current statistics
+	Stats getStats() const;
+	//! clears the statistics (implies restart())
+	void resetStats();
+
+	//! returns #name
+	const std::string& getName() const { return name; }
+
+	//! displays a summary line for each monitor in the process
+	static void dumpStats(std::ostream& os);
+	//! displays a summary line for @a s, labeled as @a label
+	static void dumpStats(std::ostream& os, const std::string& label, const Stats& s);
+
+protected:
+	std::string name; //!< identifies the monitor in dumpStats()
+	TimeET last; //!< the time of the previous activation
+	bool haveLast; //!< false until activated() is called, or following restart()
+	Stats stats; //!< the accumulated statistics, #Stats::meanJitter, #Stats::rmsJitter, and #Stats::meanLatency hold sums until getStats() is called
+	unsigned int intervals; //!< number of intervals measured, the divisor for the sums in #stats
+	mutable Thread::Lock lock; //!< protects #stats, since getStats() is generally called from another thread
+
+private:
+	DeadlineMonitor(const DeadlineMonitor&); //!< don't call
+	DeadlineMonitor& operator=(const DeadlineMonitor&); //!< don't call
+};
+
+/*! @file
+ * @brief Describes DeadlineMonitor, which records missed deadlines and jitter for periodic threads
+ */
+
+#endif //Aperios check
+
+#endif
@@ -0,0 +1,87 @@
+#ifndef PLATFORM_APERIOS
+#include "Futex.h"
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#  include <linux/futex.h>
+#  include <sys/syscall.h>
+#endif
+
+namespace futex {
+
+#ifdef __linux__
+
+	bool wait(std::atomic<int>& word, int expected, unsigned int timeout/*=-1U*/) {
+		// std::atomic<int> is required to be layout-compatible with int on all platforms with futexes
+		int* addr=reinterpret_cast<int*>(&word);
+		timespec ts, *tsp=NULL;
+		if(timeout!=-1U) {
+			ts.tv_sec=timeout/1000000;
+			ts.tv_nsec=(timeout%1000000)*1000;
+			tsp=&ts;
+		}
+		if(syscall(SYS_futex,addr,FUTEX_WAIT_PRIVATE,expected,tsp,NULL,0)==0)
+			return true;
+		// EAGAIN: value already changed, EINTR: signal (e.g. Thread::interrupt()) -- either way caller re-tests
+		return errno!=ETIMEDOUT;
+	}
+
+	void wake(std::atomic<int>& word, int n/*=1*/) {
+		syscall(SYS_futex,reinterpret_cast<int*>(&word),FUTEX_WAKE_PRIVATE,n,NULL,NULL,0);
+	}
+
+#else
+
+	//! polling interval (in microseconds) for platforms without futexes
+	static const unsigned int FALLBACK_POLL=500;
+
+	bool wait(std::atomic<int>& word, int expected, unsigned int timeout/*=-1U*/) {
+		if(word.load()!=expected)
+			return true;
+		if(timeout<FALLBACK_POLL) {
+			usleep(timeout);
+			return word.load()!=expected;
+		}
+		usleep(FALLBACK_POLL);
+		return true;
+	}
+
+	void wake(std::atomic<int>& /*word*/, int /*n=1*/) {}
+
+#endif
+
+}
+
+bool FutexSemaphore::lower(unsigned int x, bool block/*=true*/) {
+	const int dx=static_cast<int>(x);
+	int v=value.load();
+	for(;;) {
+		while(v>=dx) {
+			if(value.compare_exchange_weak(v,v-dx))
+				return true;
+		}
+		if(!block)
+			return false;
+		// register as a waiter *before* the final test so raise() can't miss us
+		++waiters;
+		v=value.load();
+		if(v<dx)
+			futex::wait(value,v);
+		--waiters;
+		v=value.load();
+	}
+}
+
+void FutexSemaphore::raise(unsigned int x) {
+	value.fetch_add(static_cast<int>(x));
+	if(waiters.load()>0)
+		futex::wakeAll(value);
+}
+
+/*! @file
+ * @brief Implements futex::wait() and futex::wake(), and FutexSemaphore, a counting semaphore built on them
+ */
+
+#endif //PLATFORM_APERIOS check
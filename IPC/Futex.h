@@ -0,0 +1,67 @@
+//-*-c++-*-
+#ifndef INCLUDED_Futex_h_
+#define INCLUDED_Futex_h_
+
+#ifdef PLATFORM_APERIOS
+#  warning Futex is not Aperios compatable
+#else
+
+#include <atomic>
+#include <climits>
+
+//! Thin wrappers around the Linux futex ("fast userspace mutex") system call, for blocking on the value of a 32-bit word
+/*! The kernel is only involved when a thread actually needs to sleep or be
+ *  woken, so the uncontended path of anything built on these is a single
+ *  atomic operation on the word itself.
+ *
+ *  These are process-private futexes: the word must only be shared between
+ *  threads, not between processes (e.g. TEKKOTSU_SHM_STYLE==NO_SHM, or
+ *  SimConfig::multiprocess is false).
+ *
+ *  On platforms without futexes (e.g. Mac OS X), wait() falls back to a short
+ *  sleep, so callers must always re-test their condition after wait() returns
+ *  (which they need to do anyway to handle spurious wakeups). */
+namespace futex {
+	//! blocks while @a word holds @a expected, for at most @a timeout microseconds (-1U for no timeout); returns false on timeout
+	/*! May also return true spuriously, or if interrupted by a signal */
+	bool wait(std::atomic<int>& word, int expected, unsigned int timeout=-1U);
+
+	//! wakes up to @a n threads blocked in wait() on @a word
+	void wake(std::atomic<int>& word, int n=1);
+
+	//! wakes all threads blocked in wait() on @a word
+	inline void wakeAll(std::atomic<int>& word) { wake(word,INT_MAX); }
+}
+
+//! A counting semaphore built on a futex, a thread-only alternative to the SysV semaphores handed out by SemaphoreManager
+/*! raise() only makes a system call if some thread is actually blocked in lower() */
+class FutexSemaphore {
+public:
+	//! constructor, initial value is 0
+	FutexSemaphore() : value(0), waiters(0) {}
+
+	//! Lowers the semaphore's value by @a x, optionally blocking if the value would go negative until it is raised enough to succeed.
+	/*! Returns true if the semaphore was successfully lowered. */
+	bool lower(unsigned int x, bool block=true);
+	//! raises the semaphore's value by @a x, waking any blocked threads
+	void raise(unsigned int x);
+
+	int getValue() const { return value.load(); } //!< returns the semaphore's value
+	void setValue(int x) { value.store(x); if(waiters.load()>0) futex::wakeAll(value); } //!< sets the semaphore's value
+
+protected:
+	std::atomic<int> value; //!< the current value of the semaphore, and the futex word threads block on
+	std::atomic<int> waiters; //!< number of threads currently (or about to be) blocked in lower(), so raise() can skip the wake call
+
+private:
+	FutexSemaphore(const FutexSemaphore&); //!< don't call
+	FutexSemaphore& operator=(const FutexSemaphore&); //!< don't call
+};
+
+/*! @file
+ * @brief Describes futex::wait() and futex::wake(), and FutexSemaphore, a counting semaphore built on them
+ */
+
+#endif //Aperios check
+
+#endif //INCLUDED
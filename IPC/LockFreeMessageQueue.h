@@ -0,0 +1,503 @@
+//-*-c++-*-
+#ifndef INCLUDED_LockFreeMessageQueue_h_
+#define INCLUDED_LockFreeMessageQueue_h_
+
+#ifdef PLATFORM_APERIOS
+#  warning LockFreeMessageQueue is not Aperios compatable
+#else
+
+#include "MessageQueue.h"
+#include "Futex.h"
+#include <atomic>
+#include <sched.h>
+
+//! A lock-free implementation of MessageQueueBase for use when all "processes" are threads within a single process
+/*! Messages are stored in a bounded ring of MAX_UNREAD slots.  Each message
+ *  is assigned a 64-bit ticket by atomically advancing the tail, and each slot
+ *  carries a sequence word which encodes both the ticket it currently holds
+ *  and its state: <tt>4*t</tt> is free for ticket @e t, <tt>4*t+1</tt> is
+ *  published, <tt>4*t+3</tt> is retired (read by all receivers, or dropped,
+ *  but not yet released), and <tt>4*t+2</tt> is being released.  Senders
+ *  claim a ticket, fill the slot, and publish it; traversal (oldest(),
+ *  newer(), ...) stops at the first slot which isn't published or retired, so
+ *  messages are always seen in ticket order.
+ *
+ *  Receivers mark messages read by setting a bit in a per-slot mask, and the
+ *  receiver which completes a message retires it.  A sender dropping the
+ *  oldest message under DROP_OLDEST retires it the same way: retiring is a
+ *  compare-and-swap of the slot from published to retired, so when a reader
+ *  and a dropper race, exactly one of them wins.  The head then advances over
+ *  retired slots, each step claimed by a compare-and-swap of the slot from
+ *  retired to releasing, so only one thread releases each slot.  None of
+ *  these operations take #lock; it is only used when adding or removing
+ *  receivers and status listeners.
+ *
+ *  Notifications use FutexSemaphore instead of SysV semaphores from the
+ *  SemaphoreManager, so the notification ids returned by addReceiver() and
+ *  addReadStatusListener() are only meaningful to this queue's
+ *  lowerNotification(), raiseNotification(), etc.
+ *
+ *  Since neither the atomics nor the futexes are shared between processes,
+ *  this queue can only be used when TEKKOTSU_SHM_STYLE is NO_SHM (or
+ *  SimConfig::multiprocess is otherwise guaranteed to be false).
+ *
+ *  MAX_RECEIVERS is limited to 32 by the width of the read mask.
+ *
+ *  @see MessageQueue, MessageReceiver, MessageQueueStatusThread */
+template<unsigned int MAX_UNREAD, unsigned int MAX_RECEIVERS=10, unsigned int MAX_SENDERS=10>
+class LockFreeMessageQueue : public MessageQueueBase {
+public:
+	//! total number of messages which can be backed up in the queue
+	static const unsigned int CAPACITY=MAX_UNREAD;
+	//! total number of receivers which can be registered
+	static const unsigned int RECEIVER_CAPACITY=MAX_RECEIVERS;
+	//! total number of senders which can be registered (see MessageQueue::SENDER_CAPACITY)
+	static const unsigned int SENDER_CAPACITY=MAX_SENDERS;
+
+	//! constructor
+	LockFreeMessageQueue() : MessageQueueBase(), head(0), tail(0), sent(0), read(0), dropped(0), spaceWaiters(0), activeReceivers(0), rcvrMask(0), sndrMask(0) {
+		for(unsigned int i=0; i<MAX_UNREAD; ++i)
+			mq[i].seq.store(4ULL*i);
+	}
+
+	//! destructor
+	virtual ~LockFreeMessageQueue();
+
+	virtual SemaphoreManager::semid_t addReadStatusListener() ATTR_must_check;
+	virtual void removeReadStatusListener(SemaphoreManager::semid_t sem);
+
+	virtual SemaphoreManager::semid_t addReceiver() ATTR_must_check;
+	virtual void removeReceiver(SemaphoreManager::semid_t rcvr);
+
+	virtual void sendMessage(RCRegion * rcr, bool autoDereference=false);
+	virtual RCRegion * readMessage(index_t msg, SemaphoreManager::semid_t rcvr);
+	virtual RCRegion * peekMessage(index_t msg);
+	virtual void markRead(index_t msg, SemaphoreManager::semid_t rcvr);
+	virtual void markReadSN(index_t msg, unsigned int sn, SemaphoreManager::semid_t rcvr);
+
+	virtual unsigned int getMessageSN(index_t msg) { return static_cast<unsigned int>(mq[msg].seq.load()>>2); }
+	virtual unsigned int getMessagesRead() { return static_cast<unsigned int>(read.load()); }
+	virtual unsigned int getMessagesSent() { return sent.load(); }
+	//! returns the number of messages the DROP_OLDEST policy has retired before all receivers read them
+	unsigned int getMessagesDropped() const { return dropped.load(); }
+	virtual unsigned int getNumReceivers() const { return activeReceivers.load(); }
+
+	virtual index_t oldest() const;
+	virtual index_t newer(index_t it) const;
+	virtual index_t older(index_t it) const;
+	virtual index_t newest() const;
+	virtual bool isEnd(index_t it) const { return it>=MAX_UNREAD; }
+
+	virtual Resource& getIterationLock() const { return emptyResource; }
+
+	virtual bool lowerNotification(SemaphoreManager::semid_t sem, unsigned int x, bool block=true) { return lookupNotification(sem).lower(x,block); }
+	virtual void raiseNotification(SemaphoreManager::semid_t sem, unsigned int x) { lookupNotification(sem).raise(x); }
+	virtual int getNotificationValue(SemaphoreManager::semid_t sem) const { return const_cast<LockFreeMessageQueue*>(this)->lookupNotification(sem).getValue(); }
+	virtual SemaphoreManager::semid_t invalidNotification() const { return INVALID_NOTIFICATION; }
+
+protected:
+	//! value returned by invalidNotification()
+	static const SemaphoreManager::semid_t INVALID_NOTIFICATION=static_cast<SemaphoreManager::semid_t>(-1);
+
+	//! data storage needed for each message slot
+	struct entry {
+		entry() : seq(0), id(), readFlags(0), numRead(0), pins(0) {} //!< constructor
+		std::atomic<unsigned long long> seq; //!< ticket and state of the slot, see class notes
+		RCRegion::Identifier id; //!< the identifier for the shared memory region so that other regions can attach it (only written while the slot is free)
+		std::atomic<unsigned int> readFlags; //!< a bit for each receiver to indicate if they have read it
+		std::atomic<unsigned int> numRead; //!< a count of the number of receivers which have read this message (should always equal popcount(readFlags))
+		std::atomic<unsigned int> pins; //!< number of readers currently copying #id, the release waits for this to clear before releasing the region
+	};
+
+	//! returns true if slot @a e holds ticket @a t and is published or retired, i.e. its message has not been released yet
+	static bool isPublished(const entry& e, unsigned long long t) { return (e.seq.load()|2)==4*t+3; }
+
+	//! attaches the region held by slot @a msg and stores the slot's sequence value into @a seq, or returns NULL if the slot is not published (or retired)
+	RCRegion * attachEntry(index_t msg, unsigned long long& seq);
+	//! pins slot @a msg and returns true if it still holds sequence value @a seq, otherwise leaves it unpinned and returns false
+	/*! While pinned, a published slot can't be released, so its read flags still belong to the message with sequence value @a seq */
+	bool pinEntry(index_t msg, unsigned long long seq) {
+		entry& e=mq[msg];
+		++e.pins;
+		if(e.seq.load()==seq)
+			return true;
+		--e.pins;
+		return false;
+	}
+	//! marks slot @a msg as read by @a rcvr, retiring it if all receivers have read it; does nothing if the slot no longer holds sequence value @a seq
+	void markEntryRead(index_t msg, unsigned long long seq, SemaphoreManager::semid_t rcvr);
+	//! marks slot @a msg as retired and advances the head past any retired slots; returns false (doing nothing) if the slot no longer holds the published sequence value @a seq
+	bool retire(index_t msg, unsigned long long seq);
+	//! releases retired slots at the head of the queue, notifying read status listeners
+	void advanceHead();
+
+	//! returns the semaphore for notification id @a sem -- receivers are numbered from 0, status listeners from RECEIVER_CAPACITY
+	FutexSemaphore& lookupNotification(SemaphoreManager::semid_t sem) { return sem<MAX_RECEIVERS ? rcvrSems[sem] : sndrSems[sem-MAX_RECEIVERS]; }
+
+	//! the message slots
+	entry mq[MAX_UNREAD];
+	//! ticket of the oldest unreleased message
+	std::atomic<unsigned long long> head;
+	//! ticket which will be assigned to the next message
+	std::atomic<unsigned long long> tail;
+	//! number of messages sent, returned by getMessagesSent() (replaces MessageQueueBase::numMessages)
+	std::atomic<unsigned int> sent;
+	//! number of messages released, returned by getMessagesRead() (replaces MessageQueueBase::messagesRead); senders using the WAIT policy block on this word
+	std::atomic<int> read;
+	//! number of messages retired by the DROP_OLDEST policy, returned by getMessagesDropped()
+	std::atomic<unsigned int> dropped;
+	//! number of senders blocked on #read waiting for space, so advanceHead() can skip the wake call
+	std::atomic<int> spaceWaiters;
+	//! number of registered receivers (replaces MessageQueueBase::numReceivers)
+	std::atomic<unsigned int> activeReceivers;
+
+	//! bitmask of receiver slots currently in use
+	std::atomic<unsigned int> rcvrMask;
+	//! receiver notification semaphores
+	FutexSemaphore rcvrSems[MAX_RECEIVERS];
+	//! bitmask of status listener slots currently in use
+	std::atomic<unsigned long long> sndrMask;
+	//! status listener notification semaphores
+	FutexSemaphore sndrSems[MAX_SENDERS];
+
+	static_assert(MAX_RECEIVERS<=32,"LockFreeMessageQueue read flags only support up to 32 receivers");
+	static_assert(MAX_SENDERS<=64,"LockFreeMessageQueue only supports up to 64 status listeners");
+	static_assert(MAX_UNREAD+0ULL<static_cast<index_t>(-1),"LockFreeMessageQueue capacity exceeds index_t");
+};
+
+template<unsigned int MAX_UNREAD, unsigned int MAX_RECEIVERS, unsigned int MAX_SENDERS>
+LockFreeMessageQueue<MAX_UNREAD,MAX_RECEIVERS,MAX_SENDERS>::~LockFreeMessageQueue() {
+	// as with MessageQueue, no one else should have access by now
+	for(unsigned long long t=head.load(), end=tail.load(); t!=end; ++t) {
+		entry& e=mq[t%MAX_UNREAD];
+		if(!isPublished(e,t))
+			continue;
+		RCRegion * rcr = RCRegion::attach(e.id);
+		rcr->RemoveSharedReference();
+		rcr->RemoveReference();
+	}
+}
+
+template<unsigned int MAX_UNREAD, unsigned int MAX_RECEIVERS, unsigned int MAX_SENDERS>
+SemaphoreManager::semid_t LockFreeMessageQueue<MAX_UNREAD,MAX_RECEIVERS,MAX_SENDERS>::addReadStatusListener() {
+	AutoLock autolock(lock);
+	for(unsigned int i=0; i<MAX_SENDERS; ++i) {
+		if(sndrMask.load() & (1ULL<<i))
+			continue;
+		sndrSems[i].setValue(0);
+		sndrMask.fetch_or(1ULL<<i);
+		return MAX_RECEIVERS+i;
+	}
+	std::cerr << "ERROR: unable to add read status listener to message queue because message queue can't register any more senders (MAX_SENDERS)" << std::endl;
+	return INVALID_NOTIFICATION;
+}
+
+template<unsigned int MAX_UNREAD, unsigned int MAX_RECEIVERS, unsigned int MAX_SENDERS>
+void LockFreeMessageQueue<MAX_UNREAD,MAX_RECEIVERS,MAX_SENDERS>::removeReadStatusListener(SemaphoreManager::semid_t sem) {
+	if(sem<MAX_RECEIVERS || sem>=MAX_RECEIVERS+MAX_SENDERS)
+		return;
+	AutoLock autolock(lock);
+	sndrMask.fetch_and(~(1ULL<<(sem-MAX_RECEIVERS)));
+}
+
+template<unsigned int MAX_UNREAD, unsigned int MAX_RECEIVERS, unsigned int MAX_SENDERS>
+SemaphoreManager::semid_t LockFreeMessageQueue<MAX_UNREAD,MAX_RECEIVERS,MAX_SENDERS>::addReceiver() {
+	AutoLock autolock(lock);
+	for(unsigned int i=0; i<MAX_RECEIVERS; ++i) {
+		if(rcvrMask.load() & (1U<<i))
+			continue;
+		rcvrSems[i].setValue(0);
+		rcvrMask.fetch_or(1U<<i);
+		++activeReceivers;
+		numReceivers=activeReceivers.load();
+		return i;
+	}
+	std::cerr << "ERROR: unable to add receiver to message queue because message queue can't register any more receivers (MAX_RECEIVERS)" << std::endl;
+	return INVALID_NOTIFICATION;
+}
+
+template<unsigned int MAX_UNREAD, unsigned int MAX_RECEIVERS, unsigned int MAX_SENDERS>
+void LockFreeMessageQueue<MAX_UNREAD,MAX_RECEIVERS,MAX_SENDERS>::removeReceiver(SemaphoreManager::semid_t rcvr) {
+	AutoLock autolock(lock);
+	if(rcvr>=MAX_RECEIVERS || !(rcvrMask.load() & (1U<<rcvr))) {
+		std::cerr << "WARNING: tried to remove message queue receiver " << rcvr << ", which is not registered as a receiver for this queue" << std::endl;
+		return;
+	}
+	const unsigned int bit=1U<<rcvr;
+	rcvrMask.fetch_and(~bit);
+	--activeReceivers;
+	numReceivers=activeReceivers.load();
+	for(unsigned long long t=head.load(), end=tail.load(); t!=end; ++t) {
+		entry& e=mq[t%MAX_UNREAD];
+		if(!pinEntry(t%MAX_UNREAD,4*t+1))
+			continue;
+		bool complete=false;
+		if(e.readFlags.fetch_and(~bit) & bit) {
+			// the removed receiver had read this message, decrement the read count
+			--e.numRead;
+		} else {
+			//all *remaining* receivers may have gotten a look
+			complete = (e.numRead.load()>=activeReceivers.load());
+		}
+		--e.pins;
+		if(complete)
+			retire(t%MAX_UNREAD,4*t+1);
+	}
+}
+
+template<unsigned int MAX_UNREAD, unsigned int MAX_RECEIVERS, unsigned int MAX_SENDERS>
+void LockFreeMessageQueue<MAX_UNREAD,MAX_RECEIVERS,MAX_SENDERS>::sendMessage(RCRegion * rcr, bool autoDereference/*=false*/) {
+	if(rcr==NULL) {
+		rcr=new RCRegion(0);
+		autoDereference=true;
+	}
+	if(filters[ProcessID::getID()]!=NULL && !filters[ProcessID::getID()]->filterSendRequest(rcr)) {
+		if(autoDereference)
+			rcr->RemoveReference();
+		return;
+	}
+	if(activeReceivers.load()==0) {
+		++read; // counts as a read message (read by all 0 readers is still read by all readers!)
+		for(unsigned int i=0; i<MAX_SENDERS; ++i)
+			if(sndrMask.load() & (1ULL<<i))
+				sndrSems[i].raise(1);
+		if(autoDereference)
+			rcr->RemoveReference();
+		return;
+	}
+	if(isClosed) {
+		if(reportDroppings)
+			std::cerr << "Warning: LockFreeMessageQueue dropping " << rcr->ID().key << " because queue is closed" << std::endl;
+		if(autoDereference)
+			rcr->RemoveReference();
+		return;
+	}
+
+	// claim a ticket
+	unsigned long long t=tail.load();
+	for(;;) {
+		unsigned long long h=head.load();
+		if(t-h<MAX_UNREAD) {
+			if(mq[t%MAX_UNREAD].seq.load()!=4*t) {
+				// slot is still being released by a retiring reader, or someone claimed t already
+				sched_yield();
+				t=tail.load();
+				continue;
+			}
+			if(tail.compare_exchange_weak(t,t+1))
+				break;
+			continue; // t was reloaded by the failed exchange
+		}
+		switch(overflowPolicy) {
+			case DROP_OLDEST: {
+				entry& e=mq[h%MAX_UNREAD];
+				if(retire(h%MAX_UNREAD,4*h+1)) {
+					++dropped;
+					if(reportDroppings)
+						std::cerr << "WARNING: LockFreeMessageQueue full, dropping oldest unread message (#" << static_cast<unsigned int>(h) << ")" << std::endl;
+				} else if(e.seq.load()==4*h+3)
+					advanceHead(); // a reader retired it first, help release it
+				else
+					sched_yield(); // oldest is still being published, or is being released
+			} break;
+			case DROP_NEWEST:
+				if(reportDroppings)
+					std::cerr << "WARNING: LockFreeMessageQueue full, dropping newest unread message (" << rcr->ID().key << ")" << std::endl;
+				if(autoDereference)
+					rcr->RemoveReference();
+				return;
+			case WAIT: {
+				if(reportDroppings)
+					std::cerr << "WARNING: LockFreeMessageQueue full, waiting for readers to catch up" << std::endl;
+				int r=read.load();
+				++spaceWaiters;
+				if(tail.load()-head.load()>=MAX_UNREAD)
+					futex::wait(read,r,MutexLockBase::usleep_granularity*15); // timeout in case overflowPolicy is changed
+				--spaceWaiters;
+			} break;
+			case THROW_BAD_ALLOC:
+				if(reportDroppings)
+					std::cerr << "WARNING: LockFreeMessageQueue full, throwing bad_alloc exception" << std::endl;
+				throw std::bad_alloc();
+		}
+		t=tail.load();
+	}
+
+	// fill and publish the slot
+	entry& e=mq[t%MAX_UNREAD];
+	rcr->AddSharedReference();
+	e.id=rcr->ID();
+	e.readFlags.store(0);
+	e.numRead.store(0);
+	e.seq.store(4*t+1);
+	++sent;
+
+	//notify receivers
+	unsigned int rm=rcvrMask.load();
+	for(unsigned int i=0; i<MAX_RECEIVERS; ++i)
+		if(rm & (1U<<i))
+			rcvrSems[i].raise(1);
+
+	if(autoDereference)
+		rcr->RemoveReference();
+}
+
+template<unsigned int MAX_UNREAD, unsigned int MAX_RECEIVERS, unsigned int MAX_SENDERS>
+RCRegion * LockFreeMessageQueue<MAX_UNREAD,MAX_RECEIVERS,MAX_SENDERS>::readMessage(index_t msg, SemaphoreManager::semid_t rcvr) {
+	unsigned long long seq;
+	RCRegion * rcr=attachEntry(msg,seq);
+	if(rcr!=NULL)
+		markEntryRead(msg,seq,rcvr); // only if the slot still holds the message we attached
+	return rcr;
+}
+
+template<unsigned int MAX_UNREAD, unsigned int MAX_RECEIVERS, unsigned int MAX_SENDERS>
+RCRegion * LockFreeMessageQueue<MAX_UNREAD,MAX_RECEIVERS,MAX_SENDERS>::peekMessage(index_t msg) {
+	unsigned long long seq;
+	return attachEntry(msg,seq);
+}
+
+template<unsigned int MAX_UNREAD, unsigned int MAX_RECEIVERS, unsigned int MAX_SENDERS>
+void LockFreeMessageQueue<MAX_UNREAD,MAX_RECEIVERS,MAX_SENDERS>::markRead(index_t msg, SemaphoreManager::semid_t rcvr) {
+	// the caller only gives us the slot, so mark whichever message it holds now
+	unsigned long long seq=mq[msg].seq.load();
+	if((seq&3)!=1)
+		return;
+	markEntryRead(msg,seq,rcvr);
+}
+
+template<unsigned int MAX_UNREAD, unsigned int MAX_RECEIVERS, unsigned int MAX_SENDERS>
+void LockFreeMessageQueue<MAX_UNREAD,MAX_RECEIVERS,MAX_SENDERS>::markReadSN(index_t msg, unsigned int sn, SemaphoreManager::semid_t rcvr) {
+	// if the message was dropped and the slot reused, leave the new message for the receiver to find
+	unsigned long long seq=mq[msg].seq.load();
+	if((seq&3)!=1 || static_cast<unsigned int>(seq>>2)!=sn)
+		return;
+	markEntryRead(msg,seq,rcvr);
+}
+
+template<unsigned int MAX_UNREAD, unsigned int MAX_RECEIVERS, unsigned int MAX_SENDERS>
+RCRegion * LockFreeMessageQueue<MAX_UNREAD,MAX_RECEIVERS,MAX_SENDERS>::attachEntry(index_t msg, unsigned long long& seq) {
+	entry& e=mq[msg];
+	// pin *before* testing the state, so a retirement which starts after the test will wait for us
+	++e.pins;
+	RCRegion * rcr=NULL;
+	seq=e.seq.load();
+	if((seq&1)==1) // published or retired, not yet released
+		rcr=RCRegion::attach(e.id);
+	--e.pins;
+	return rcr;
+}
+
+template<unsigned int MAX_UNREAD, unsigned int MAX_RECEIVERS, unsigned int MAX_SENDERS>
+void LockFreeMessageQueue<MAX_UNREAD,MAX_RECEIVERS,MAX_SENDERS>::markEntryRead(index_t msg, unsigned long long seq, SemaphoreManager::semid_t rcvr) {
+	if(rcvr>=MAX_RECEIVERS) {
+		std::cerr << "WARNING: tried to look up queue receiver " << rcvr << ", which is not registered as a receiver for this queue" << std::endl;
+		return;
+	}
+	// if the message was dropped and its slot reused since the caller looked, the flags belong to someone else
+	if(!pinEntry(msg,seq))
+		return;
+	entry& e=mq[msg];
+	const unsigned int bit=1U<<rcvr;
+	if(e.readFlags.fetch_or(bit) & bit) {
+		--e.pins;
+		std::cerr << "WARNING: LockFreeMessageQueue::markRead(): Receiver re-reading message, could be recycled/invalidated any time" << std::endl;
+		return;
+	}
+	const bool complete = (++e.numRead>=activeReceivers.load());
+	--e.pins; // before retiring, the release waits for pins to clear
+	if(complete)
+		retire(msg,seq);
+}
+
+template<unsigned int MAX_UNREAD, unsigned int MAX_RECEIVERS, unsigned int MAX_SENDERS>
+bool LockFreeMessageQueue<MAX_UNREAD,MAX_RECEIVERS,MAX_SENDERS>::retire(index_t msg, unsigned long long seq) {
+	// readers completing a message and senders dropping it both come through here, only one exchange can succeed
+	if(!mq[msg].seq.compare_exchange_strong(seq,seq+2))
+		return false; // someone else already retired it, or it has been released
+	advanceHead();
+	return true;
+}
+
+template<unsigned int MAX_UNREAD, unsigned int MAX_RECEIVERS, unsigned int MAX_SENDERS>
+void LockFreeMessageQueue<MAX_UNREAD,MAX_RECEIVERS,MAX_SENDERS>::advanceHead() {
+	for(;;) {
+		unsigned long long h=head.load();
+		if(h==tail.load())
+			return;
+		entry& e=mq[h%MAX_UNREAD];
+		// whoever moves the slot from retired to releasing is responsible for releasing it and moving the head
+		unsigned long long s=4*h+3;
+		if(!e.seq.compare_exchange_strong(s,4*h+2)) {
+			if(s==4*h+2 || head.load()!=h)
+				continue; // someone else claimed it, see if the slot after it is ready too
+			return; // head isn't retired yet
+		}
+		head.store(h+1);
+		while(e.pins.load()!=0)
+			sched_yield();
+		RCRegion * rcr = RCRegion::attach(e.id);
+		rcr->RemoveSharedReference();
+		rcr->RemoveReference();
+		e.seq.store(4*(h+MAX_UNREAD));
+		++read;
+		if(spaceWaiters.load()>0)
+			futex::wakeAll(read);
+		unsigned long long sm=sndrMask.load();
+		for(unsigned int i=0; i<MAX_SENDERS; ++i)
+			if(sm & (1ULL<<i))
+				sndrSems[i].raise(1);
+	}
+}
+
+template<unsigned int MAX_UNREAD, unsigned int MAX_RECEIVERS, unsigned int MAX_SENDERS>
+MessageQueueBase::index_t LockFreeMessageQueue<MAX_UNREAD,MAX_RECEIVERS,MAX_SENDERS>::oldest() const {
+	unsigned long long h=head.load();
+	if(h==tail.load() || !isPublished(mq[h%MAX_UNREAD],h))
+		return MAX_UNREAD;
+	return h%MAX_UNREAD;
+}
+
+template<unsigned int MAX_UNREAD, unsigned int MAX_RECEIVERS, unsigned int MAX_SENDERS>
+MessageQueueBase::index_t LockFreeMessageQueue<MAX_UNREAD,MAX_RECEIVERS,MAX_SENDERS>::newer(index_t it) const {
+	if(it>=MAX_UNREAD)
+		return oldest(); // as with ListMemBuf, the list wraps around through the end marker
+	unsigned long long s=mq[it].seq.load();
+	if((s&1)!=1)
+		return MAX_UNREAD; // slot has been recycled out from under the caller
+	unsigned long long t=(s>>2)+1;
+	if(!isPublished(mq[t%MAX_UNREAD],t))
+		return MAX_UNREAD; // end of queue, or next message is still being filled in
+	return t%MAX_UNREAD;
+}
+
+template<unsigned int MAX_UNREAD, unsigned int MAX_RECEIVERS, unsigned int MAX_SENDERS>
+MessageQueueBase::index_t LockFreeMessageQueue<MAX_UNREAD,MAX_RECEIVERS,MAX_SENDERS>::older(index_t it) const {
+	if(it>=MAX_UNREAD)
+		return newest(); // as with ListMemBuf, the list wraps around through the end marker
+	unsigned long long s=mq[it].seq.load();
+	if((s&1)!=1 || (s>>2)==0)
+		return MAX_UNREAD;
+	unsigned long long t=(s>>2)-1;
+	if(t<head.load() || !isPublished(mq[t%MAX_UNREAD],t))
+		return MAX_UNREAD;
+	return t%MAX_UNREAD;
+}
+
+template<unsigned int MAX_UNREAD, unsigned int MAX_RECEIVERS, unsigned int MAX_SENDERS>
+MessageQueueBase::index_t LockFreeMessageQueue<MAX_UNREAD,MAX_RECEIVERS,MAX_SENDERS>::newest() const {
+	// the most recent ticket may still be in the process of being published, scan back to the last one which is ready
+	unsigned long long h=head.load();
+	for(unsigned long long t=tail.load(); t>h; --t)
+		if(isPublished(mq[(t-1)%MAX_UNREAD],t-1))
+			return (t-1)%MAX_UNREAD;
+	return MAX_UNREAD;
+}
+
+/*! @file
+ * @brief Defines LockFreeMessageQueue, a lock-free MessageQueueBase for use when all processes are threads within a single process
+ */
+
+#endif //APERIOS check
+
+#endif //INCLUDED
@@ -12,6 +12,7 @@
 #include "MutexLock.h"
 #include "Shared/MarkScope.h"
 #include "Shared/attributes.h"
+#include <cstring>
 #include <exception>
 #include <stdlib.h>
 #include <unistd.h> // for usleep
@@ -48,6 +49,7 @@ public:
 	{
 		for(unsigned int i=0; i<ProcessID::NumProcesses; ++i)
 			filters[i]=NULL;
+		lock.setName("MessageQueue");
 	}
 	//!destructor
 	virtual ~MessageQueueBase() {}
@@ -103,6 +105,8 @@ public:
 	virtual RCRegion * peekMessage(index_t msg)=0;
 	//! increments read counter -- do not call more than once per receiver per message!
 	virtual void markRead(index_t msg, SemaphoreManager::semid_t rcvr)=0;
+	//! as markRead(), but only if the message in @a msg still has serial number @a sn (see getMessageSN()); a message which was dropped meanwhile is left alone, and so is whatever took its place
+	virtual void markReadSN(index_t msg, unsigned int sn, SemaphoreManager::semid_t rcvr) { AutoLock autolock(lock); if(getMessageSN(msg)==sn) markRead(msg,rcvr); }
 	//! do not allow any new messages to be posted
 	virtual void close() { AutoLock autolock(lock); isClosed=true; }
 
@@ -128,6 +132,18 @@ public:
 	typedef MarkScope AutoLock;
 	//! returns a reference to the queue's inter-process lock
 	MutexLock<ProcessID::NumProcesses>& getLock() const { return lock; }
+	//! returns the resource a receiver should hold while scanning the queue (oldest(), newer(), etc.) and reading a message, by default getLock()
+	/*! Implementations which are safe to traverse concurrently (LockFreeMessageQueue) can return ::emptyResource */
+	virtual Resource& getIterationLock() const { return lock; }
+	
+	//! lowers a notification semaphore (as returned by addReceiver() or addReadStatusListener()) by @a x, optionally blocking until it can; returns false if it was not lowered
+	virtual bool lowerNotification(SemaphoreManager::semid_t sem, unsigned int x, bool block=true) { return semgr->lower(sem,x,block); }
+	//! raises a notification semaphore (as returned by addReceiver() or addReadStatusListener()) by @a x
+	virtual void raiseNotification(SemaphoreManager::semid_t sem, unsigned int x) { semgr->raise(sem,x); }
+	//! returns the current value of a notification semaphore (as returned by addReceiver() or addReadStatusListener())
+	virtual int getNotificationValue(SemaphoreManager::semid_t sem) const { return semgr->getValue(sem); }
+	//! returns the value returned by addReceiver() or addReadStatusListener() on failure
+	virtual SemaphoreManager::semid_t invalidNotification() const { return semgr->invalid(); }
 
 	
 	virtual index_t oldest() const=0;          //!< return oldest message still in the queue (may or may not have been read by this process)
@@ -23,7 +23,7 @@ void MessageQueueStatusThread::addStatusListener(StatusListener* l) {
 			if(queue==NULL)
 				return;
 			semid=queue->addReadStatusListener();
-			if(semid==queue->getSemaphoreManager()->invalid()) {
+			if(semid==queue->invalidNotification()) {
 				std::cerr << "ERROR: could not start MessageQueueStatusThread -- out of semaphore IDs" << std::endl;
 				return;
 			}
@@ -57,7 +57,7 @@ void MessageQueueStatusThread::setMessageQueue(MessageQueueBase& mq) {
 	SemaphoreManager::semid_t oldsem=semid;
 	queue=&mq;
 	semid=queue->addReadStatusListener();
-	if(semid==queue->getSemaphoreManager()->invalid()) {
+	if(semid==queue->invalidNotification()) {
 		std::cerr << "ERROR: could not switch MessageQueue -- new queue out of semaphores, stopping thread" << std::endl;
 		queue=oldqueue;
 		semid=oldsem;
@@ -66,9 +66,9 @@ void MessageQueueStatusThread::setMessageQueue(MessageQueueBase& mq) {
 		return;
 	}
 	numRead=queue->getMessagesRead();
-	if(oldqueue!=NULL && oldsem!=queue->getSemaphoreManager()->invalid()) {
+	if(oldqueue!=NULL && oldsem!=queue->invalidNotification()) {
 		if(running)
-			oldqueue->getSemaphoreManager()->raise(oldsem,1); //so run will notice the switchover
+			oldqueue->raiseNotification(oldsem,1); //so run will notice the switchover
 		oldqueue->removeReadStatusListener(oldsem);
 	}*/
 }
@@ -83,11 +83,11 @@ bool MessageQueueStatusThread::launched() {
 
 void * MessageQueueStatusThread::run() {
 	for(;;) {
-		queue->getSemaphoreManager()->lower(semid,1,true);
+		queue->lowerNotification(semid,1,true);
 		//there might be a few reads, handle them as a group
-		unsigned int more=queue->getSemaphoreManager()->getValue(semid);
+		unsigned int more=queue->getNotificationValue(semid);
 		if(more>0)
-			if(!queue->getSemaphoreManager()->lower(semid,more,false))
+			if(!queue->lowerNotification(semid,more,false))
 				std::cerr << "WARNING: MessageQueueStatusThread had a message notification disappear (is someone else using the semaphore?  Get your own!)" << std::endl;
 		testCancel();
 #ifdef DEBUG
@@ -105,8 +105,8 @@ void * MessageQueueStatusThread::run() {
 
 Thread& MessageQueueStatusThread::stop() {
 	Thread::stop();
-	if(semid!=queue->getSemaphoreManager()->invalid()) //if semid is still invalid, probably canceling before the launch got off
-		queue->getSemaphoreManager()->raise(semid,1); //so run will notice the stop request
+	if(semid!=queue->invalidNotification()) //if semid is still invalid, probably canceling before the launch got off
+		queue->raiseNotification(semid,1); //so run will notice the stop request
 	return *this;
 }
 
@@ -115,7 +115,7 @@ void MessageQueueStatusThread::cancelled() {
 		return;
 	//cout << "MessageQueueStatusThread removing MessageQueue read listener" << endl;
 	queue->removeReadStatusListener(semid);
-	semid=queue->getSemaphoreManager()->invalid();
+	semid=queue->invalidNotification();
 }
 
 void MessageQueueStatusThread::fireMessagesRead(unsigned int howmany) {
@@ -7,15 +7,15 @@
 //using namespace std;
 
 MessageReceiver::MessageReceiver(MessageQueueBase& mq, bool (*callback) (RCRegion*)/*=NULL*/, bool startThread/*=true*/, bool subscribe/*=true*/)
-: Thread(), queue(mq), semid(mq.getSemaphoreManager()->invalid()),
-nextMessage(0), lastProcessedMessage(-1U), process(callback), curit((index_t)-1)
+: Thread(), queue(mq), semid(mq.invalidNotification()),
+nextMessage(0), lastProcessedMessage(-1U), peekedMessage(-1U), process(callback), curit((index_t)-1)
 {
 	if(startThread)
 		start();
 	else if(subscribe) {
-		ASSERTRET(semid==queue.getSemaphoreManager()->invalid(),"semid is already set?");
+		ASSERTRET(semid==queue.invalidNotification(),"semid is already set?");
 		semid=queue.addReceiver();
-		if(semid==queue.getSemaphoreManager()->invalid())
+		if(semid==queue.invalidNotification())
 			std::cerr << "ERROR: could not start MessageReceiver -- out of semaphore IDs" << std::endl;
 	}
 }
@@ -26,19 +26,20 @@ MessageReceiver::~MessageReceiver() {
 	stop();
 	join();
 	queue.removeReceiver(semid);
-	semid=queue.getSemaphoreManager()->invalid();
+	semid=queue.invalidNotification();
 }
 
 RCRegion * MessageReceiver::peekNextMessage() {
-	MessageQueueBase::AutoLock autolock(queue.getLock());
+	MessageQueueBase::AutoLock autolock(queue.getIterationLock());
 	findCurrentMessage();
 	if(queue.isEnd(curit))
 		return NULL;
+	peekedMessage=queue.getMessageSN(curit);
 	return queue.peekMessage(curit);
 }
 
 RCRegion * MessageReceiver::getNextMessage() {
-	MessageQueueBase::AutoLock autolock(queue.getLock());
+	MessageQueueBase::AutoLock autolock(queue.getIterationLock());
 	findCurrentMessage();
 	if(queue.isEnd(curit))
 		return NULL;
@@ -49,7 +50,7 @@ RCRegion * MessageReceiver::getNextMessage() {
 
 Thread& MessageReceiver::stop() {
 	Thread::stop();
-	queue.getSemaphoreManager()->raise(semid,1); //trigger a check so the thread will notice the stop
+	queue.raiseNotification(semid,1); //trigger a check so the thread will notice the stop
 	return *this;
 }
 
@@ -70,18 +71,18 @@ void MessageReceiver::finish() {
 		stop();
 		join();
 	}
-	if(semid!=queue.getSemaphoreManager()->invalid()) {
+	if(semid!=queue.invalidNotification()) {
 		//cout << Process::getName() << " finish" << endl;
 		while(processNextMessage()) {}
 		queue.removeReceiver(semid);
-		semid=queue.getSemaphoreManager()->invalid();
+		semid=queue.invalidNotification();
 	}
 }
 
 bool MessageReceiver::launched() {
-	if(semid==queue.getSemaphoreManager()->invalid())
+	if(semid==queue.invalidNotification())
 		semid=queue.addReceiver();
-	if(semid==queue.getSemaphoreManager()->invalid()) {
+	if(semid==queue.invalidNotification()) {
 		std::cerr << "ERROR: could not start MessageReceiver -- out of semaphore IDs" << std::endl;
 		return false;
 	}
@@ -93,14 +94,14 @@ unsigned int MessageReceiver::runloop() {
 	pushNoCancel();
 	waitNextMessage();
 	while(processNextMessage()) { //get everything else in the queue
-		queue.getSemaphoreManager()->lower(semid,1,false);
+		queue.lowerNotification(semid,1,false);
 	}
 	popNoCancel();
 	return 0;
 }
 
 bool MessageReceiver::waitNextMessage() {
-	return queue.getSemaphoreManager()->lower(semid,1,true);
+	return queue.lowerNotification(semid,1,true);
 }
 
 bool MessageReceiver::processNextMessage() {
@@ -128,11 +129,17 @@ void MessageReceiver::markRead(bool checkNext) {
 	findCurrentMessage();
 	if(queue.isEnd(curit))
 		return;
-	nextMessage=queue.getMessageSN(curit)+1;
-	queue.markRead(curit,semid);
-	curit=queue.newer(curit); //next time, start on (or peek at) the one after this
+	const unsigned int sn=queue.getMessageSN(curit);
+	if(peekedMessage!=-1U && sn!=peekedMessage) {
+		// the peeked message was dropped (DROP_OLDEST) before we got here, don't mark the newer one in its place
+		nextMessage=peekedMessage+1;
+	} else {
+		nextMessage=sn+1;
+		queue.markReadSN(curit,sn,semid); // does nothing if it is dropped meanwhile
+		curit=queue.newer(curit); //next time, start on (or peek at) the one after this
+	}
 	if(checkNext && !queue.isEnd(curit))
-		queue.getSemaphoreManager()->raise(semid,1); //trigger a check if there are more waiting in the queue
+		queue.raiseNotification(semid,1); //trigger a check if there are more waiting in the queue
 }
 
 
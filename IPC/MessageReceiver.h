@@ -57,6 +57,7 @@ protected:
 	SemaphoreManager::semid_t semid; //!< the semaphore raised when the queue should be checked for new messages
 	unsigned int nextMessage; //!< the expected serial number of the next message to be sent
 	unsigned int lastProcessedMessage; //!< the serial number of the last received message
+	unsigned int peekedMessage; //!< the serial number of the message last returned by peekNextMessage(), which markRead() marks
 	bool (*process) (RCRegion*); //!< the client callback function
 	index_t curit; //!< the message id of the last received message (currently being processed)
 	
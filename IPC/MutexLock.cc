@@ -4,6 +4,115 @@ unsigned int MutexLockBase::usleep_granularity=5000;
 
 #if !defined(PLATFORM_APERIOS) && !defined(MUTEX_LOCK_ET_USE_SOFTWARE_ONLY)
 #  if !defined(TEKKOTSU_SHM_STYLE) || TEKKOTSU_SHM_STYLE==NO_SHM
+#    include "Shared/MarkScope.h"
+#    include "Shared/TimeET.h"
+#    include <algorithm>
+#    include <iomanip>
+#    include <vector>
+
+unsigned int MutexLockBase::max_spin=100;
+std::atomic<bool> MutexLockBase::profiling(false);
+
+//! tells the processor we're in a spin loop (saves power, and lets a hyperthreaded sibling, possibly the lock holder, run faster)
+static inline void cpuRelax() {
+#if defined(__i386__) || defined(__x86_64__)
+	__builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+	__asm__ __volatile__("yield");
+#endif
+}
+
+//! protects contentionProfiles() and the contents of each profile
+static Thread::Lock& profileLock() {
+	static Thread::Lock l;
+	return l;
+}
+//! all profiles created so far, they are never deleted since a lock may still point to its own
+static std::vector<MutexLockBase::ContentionProfile*>& contentionProfiles() {
+	static std::vector<MutexLockBase::ContentionProfile*> profiles;
+	return profiles;
+}
+
+void MutexLockBase::lockContended(std::atomic<int>& word, std::atomic<int>& spinEstimate, int holder) {
+	const bool prof=profiling.load(std::memory_order_relaxed);
+	TimeET start(0L);
+	if(prof)
+		start.Set();
+	// spin for a bit, locks like MotionManager's are usually held for only a few microseconds,
+	// the limit follows the recent history of this lock (same heuristic as glibc's adaptive mutexes)
+	const int estimate=spinEstimate.load(std::memory_order_relaxed);
+	const int maxCnt=std::min(static_cast<int>(max_spin),estimate*2+10);
+	int cnt=0;
+	for(; cnt<maxCnt; ++cnt) {
+		cpuRelax();
+		int c=word.load(std::memory_order_relaxed);
+		if(c==0 && word.compare_exchange_weak(c,1,std::memory_order_acquire))
+			break;
+	}
+	const bool slept=(cnt>=maxCnt);
+	if(slept) {
+		// mark the lock as contended so the holder will wake us, and sleep until we're the one who changes it from unlocked
+		while(word.exchange(2,std::memory_order_acquire)!=0)
+			futex::wait(word,2);
+	}
+	// we hold the lock now, so no one else is updating the estimate
+	const int prev=spinEstimate.load(std::memory_order_relaxed);
+	spinEstimate.store(prev+(cnt-prev)/8,std::memory_order_relaxed);
+	
+	if(prof) {
+		double waited=start.Age().Value();
+		MarkScope l(profileLock());
+		if(profile==NULL) {
+			profile=new ContentionProfile(this,name);
+			contentionProfiles().push_back(profile);
+		}
+		++profile->contended;
+		if(slept)
+			++profile->slept;
+		profile->totalWait+=waited;
+		if(waited>profile->maxWait)
+			profile->maxWait=waited;
+		++profile->holders[holder];
+	}
+}
+
+//! sorts profiles by decreasing total wait time
+static bool greaterWait(const MutexLockBase::ContentionProfile* a, const MutexLockBase::ContentionProfile* b) {
+	return a->totalWait>b->totalWait;
+}
+
+void MutexLockBase::dumpContentionProfile(std::ostream& os) {
+	MarkScope l(profileLock());
+	std::vector<ContentionProfile*> sorted(contentionProfiles());
+	std::sort(sorted.begin(),sorted.end(),greaterWait);
+	os << std::setw(24) << std::left << "Lock" << std::right << std::setw(10) << "contended" << std::setw(8) << "slept"
+		<< std::setw(12) << "total(ms)" << std::setw(10) << "mean(us)" << std::setw(10) << "max(us)" << "  holders" << std::endl;
+	for(std::vector<ContentionProfile*>::const_iterator it=sorted.begin(); it!=sorted.end(); ++it) {
+		const ContentionProfile& p=**it;
+		if(p.contended==0)
+			continue;
+		if(p.name!=NULL)
+			os << std::setw(24) << std::left << p.name;
+		else
+			os << std::setw(24) << std::left << p.lock;
+		os << std::right << std::setw(10) << p.contended << std::setw(8) << p.slept
+			<< std::setw(12) << p.totalWait*1e3 << std::setw(10) << p.totalWait/p.contended*1e6 << std::setw(10) << p.maxWait*1e6 << " ";
+		for(std::map<int,unsigned int>::const_iterator hit=p.holders.begin(); hit!=p.holders.end(); ++hit)
+			os << ' ' << hit->first << ':' << hit->second;
+		os << std::endl;
+	}
+}
+
+void MutexLockBase::resetContentionProfile() {
+	MarkScope l(profileLock());
+	std::vector<ContentionProfile*>& profiles=contentionProfiles();
+	for(std::vector<ContentionProfile*>::const_iterator it=profiles.begin(); it!=profiles.end(); ++it) {
+		(*it)->contended=(*it)->slept=0;
+		(*it)->totalWait=(*it)->maxWait=0;
+		(*it)->holders.clear();
+	}
+}
+
 #  else
 void MutexLockBase::setSemaphoreManager(SemaphoreManager* mgr) {
 	if(mgr==NULL) {
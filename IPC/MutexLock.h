@@ -10,6 +10,11 @@
 #include <iostream>
 #include <exception>
 #include <typeinfo>
+#if !defined(PLATFORM_APERIOS) && !defined(MUTEX_LOCK_ET_USE_SOFTWARE_ONLY) && (!defined(TEKKOTSU_SHM_STYLE) || TEKKOTSU_SHM_STYLE==NO_SHM)
+#  include "IPC/Futex.h"
+#  include <thread>
+#  include <map>
+#endif
 
 // If you want to use the same software-only lock on both
 // PLATFORM_LOCAL and Aperios, then uncomment this next line:
@@ -37,6 +42,56 @@ public:
 #if !defined(PLATFORM_APERIOS) && !defined(MUTEX_LOCK_ET_USE_SOFTWARE_ONLY)
 #  if !defined(TEKKOTSU_SHM_STYLE) || TEKKOTSU_SHM_STYLE==NO_SHM
 	static void aboutToFork() {}
+	
+	//! maximum number of times a contended lock() will poll the lock before blocking in the kernel (0 to always block right away)
+	/*! The actual number of iterations adapts per lock, see MutexLock::spinEstimate */
+	static unsigned int max_spin;
+	
+	//! contention statistics for a single lock, see setContentionProfiling()
+	struct ContentionProfile {
+		//! constructor
+		ContentionProfile(const void* l, const char* n) : lock(l), name(n), contended(0), slept(0), totalWait(0), maxWait(0), holders() {}
+		const void* lock; //!< address of the lock (may have been destructed since)
+		const char* name; //!< name assigned by setName(), or NULL
+		unsigned int contended; //!< number of lock() calls which found the lock already held by another thread
+		unsigned int slept; //!< number of those which had to block in the kernel (the others acquired the lock while spinning)
+		double totalWait; //!< total time spent waiting for the lock, in seconds
+		double maxWait; //!< longest single wait for the lock, in seconds
+		std::map<int,unsigned int> holders; //!< number of contentions, indexed by the id which was holding the lock at the time (a ProcessID, or MotionManager accessor, etc.)
+	};
+	
+	//! if @a enable, each lock will record wait times and holders whenever lock() finds it held (the uncontended path is never affected)
+	/*! The simulator sets this from its LockProfiling setting, and the 'status' command displays the profile. */
+	static void setContentionProfiling(bool enable) { profiling.store(enable,std::memory_order_relaxed); }
+	//! returns true if contention is being profiled
+	static bool getContentionProfiling() { return profiling.load(std::memory_order_relaxed); }
+	//! displays the contention profile of each lock which has been contended, in order of total wait time
+	static void dumpContentionProfile(std::ostream& os);
+	//! clears all contention profiles
+	static void resetContentionProfile();
+	
+	//! assigns a name to identify the lock in dumpContentionProfile(), @a n should be a string literal (it is not copied)
+	void setName(const char* n) { name=n; if(profile!=NULL) profile->name=n; }
+	
+protected:
+	//! constructor
+	MutexLockBase() : Resource(), name(NULL), profile(NULL) {}
+	
+	//! called by MutexLock::lock() when @a word was found to be non-zero, spins and then blocks until @a word can be set
+	/*! Uses the three-state scheme from Drepper's "Futexes Are Tricky": 0 is unlocked, 1 is locked,
+	 *  and 2 is locked with (possible) waiters, in which case unlock needs to wake someone up.
+	 *  @a spinEstimate is the lock's running average of how many polls were needed to get the lock by spinning,
+	 *  @a holder is the id of the owner when the lock was found held (for the profile, it may have changed since). */
+	void lockContended(std::atomic<int>& word, std::atomic<int>& spinEstimate, int holder);
+	
+	const char* name; //!< name for the contention profile, see setName()
+	ContentionProfile* profile; //!< this lock's entry in the contention profile, created on first contention while profiling is enabled
+	
+	static std::atomic<bool> profiling; //!< if true, contended locks will record their statistics in #profile
+	
+private:
+	MutexLockBase(const MutexLockBase&); //!< don't call
+	MutexLockBase& operator=(const MutexLockBase&); //!< don't call
 #  else
 	//! exception if a lock is created but there aren't any more semaphores available
 	class no_more_semaphores : public std::exception {
@@ -77,6 +132,11 @@ protected:
 	static SemaphoreManager preallocated;
 #  endif
 #endif
+#if defined(PLATFORM_APERIOS) || defined(MUTEX_LOCK_ET_USE_SOFTWARE_ONLY) || (defined(TEKKOTSU_SHM_STYLE) && TEKKOTSU_SHM_STYLE!=NO_SHM)
+public:
+	//! only the thread-only (futex) lock keeps a contention profile, so the name is ignored here
+	void setName(const char* /*n*/) {}
+#endif
 };
 
 
@@ -85,7 +145,7 @@ protected:
 #  if !defined(TEKKOTSU_SHM_STYLE) || TEKKOTSU_SHM_STYLE==NO_SHM
 #    include "Thread.h"
 
-//! Implements a mutual exclusion lock using pthread mutex
+//! Implements a mutual exclusion lock using a futex (see futex::wait())
 /*! Use this to prevent more than one thread from accessing a data structure
 *  at the same time (which often leads to unpredictable and unexpected results)
 *
@@ -99,72 +159,103 @@ protected:
 *
 *  Just remember, unlock() releases one level.  But releaseAll() completely unlocks.
 *
+*  Acquiring an unheld lock, recursive re-locking, and releasing a lock nobody
+*  is waiting for are each a few atomic operations, without any system call.
+*  When the lock is held by another thread, lock() first spins for a while, adapting
+*  the duration to how long the lock has recently been held for (see #max_spin),
+*  before blocking in the kernel.  Waits can be profiled, see setContentionProfiling().
+*
 *  Note that there is no check that the thread doing the unlocking is the one
 *  that actually has the lock.  Be careful about this.
 */
 template<unsigned int num_doors>
 class MutexLock : public MutexLockBase {
 public:
-	//! constructor, gets a new semaphore from the semaphore manager
-	MutexLock() : owner_index(NO_OWNER), thdLock() {}
+	//! constructor
+	MutexLock() : MutexLockBase(), state(0), spinEstimate(0), owner_index(NO_OWNER), owner_thread(), lockcount(0) {}
 	
-	//! destructor, releases semaphore back to semaphore manager
+	//! destructor, releases the lock if it is still held
 	~MutexLock() {
-		if(owner_index!=NO_OWNER) {
-			owner_index=NO_OWNER;
-			while(thdLock.getLockLevel()>0)
-				thdLock.unlock();
-		}
+		if(lockcount>0)
+			releaseAll();
 	}
 	
-	//! blocks until lock is achieved.  This is done efficiently using a SysV style semaphore
+	//! blocks until lock is achieved, spinning briefly before sleeping on the futex
 	/*! You should pass some process-specific ID number as the input - just
 	 *  make sure no other process will be using the same value. */
 	void lock(int id) {
-		thdLock.lock();
-		if(owner_index!=static_cast<unsigned>(id))
-			owner_index=id;
+		Thread::pushNoCancel();
+		const std::thread::id self=std::this_thread::get_id();
+		if(owner_thread.load(std::memory_order_relaxed)!=self) {
+			int c=0;
+			if(!state.compare_exchange_strong(c,1,std::memory_order_acquire))
+				lockContended(state,spinEstimate,owner_index.load(std::memory_order_relaxed));
+			owner_thread.store(self,std::memory_order_relaxed);
+		}
+		owner_index.store(id,std::memory_order_relaxed);
+		++lockcount;
 	}
 	
 	//! attempts to get a lock, returns true if it succeeds
 	/*! You should pass some process-specific ID number as the input - just
 	 *  make sure no other process will be using the same value.*/
 	bool try_lock(int id) {
-		if(!thdLock.trylock())
-			return false;
-		owner_index=id;
+		Thread::pushNoCancel();
+		const std::thread::id self=std::this_thread::get_id();
+		if(owner_thread.load(std::memory_order_relaxed)!=self) {
+			int c=0;
+			if(!state.compare_exchange_strong(c,1,std::memory_order_acquire)) {
+				Thread::popNoCancel();
+				return false;
+			}
+			owner_thread.store(self,std::memory_order_relaxed);
+		}
+		owner_index.store(id,std::memory_order_relaxed);
+		++lockcount;
 		return true;
 	}
 	
 	//! releases one recursive lock-level from whoever has the current lock
 	inline void unlock() {
-		if(thdLock.getLockLevel()<=0)
+		if(lockcount==0) {
 			std::cerr << "Warning: MutexLock::unlock caused underflow" << std::endl;
-		if(thdLock.getLockLevel()<=1)
-			owner_index=NO_OWNER;
-		thdLock.unlock();
+			return;
+		}
+		if(--lockcount==0) {
+			owner_index.store(NO_OWNER,std::memory_order_relaxed);
+			owner_thread.store(std::thread::id(),std::memory_order_relaxed);
+			if(state.exchange(0,std::memory_order_release)==2)
+				futex::wake(state);
+		}
+		Thread::popNoCancel();
 	}
 	
 	//! completely unlocks, regardless of how many times a recursive lock has been obtained
 	void releaseAll() {
-		owner_index=NO_OWNER;
-		while(thdLock.getLockLevel()>0)
-			thdLock.unlock();
+		while(lockcount>0)
+			unlock();
 	}
 	
 	//! returns the lockcount
-	unsigned int get_lock_level() const { return thdLock.getLockLevel(); }
+	unsigned int get_lock_level() const { return lockcount; }
 	
 	//! returns the current owner's id
-	inline int owner() const { return owner_index; }
+	inline int owner() const { return owner_index.load(std::memory_order_relaxed); }
 	
 protected:
 	friend class MarkScope;
 	virtual void useResource(Resource::Data&) { lock(ProcessID::getID()); }
 	virtual void releaseResource(Resource::Data&) { unlock(); }
 	
-	unsigned int owner_index; //!< holds the tekkotsu process id of the current lock owner
-	Thread::Lock thdLock; //!< all the actual implementation is handed off to the thread lock
+	std::atomic<int> state; //!< the futex word: 0 when unlocked, 1 when locked, 2 when locked and another thread may be blocked waiting
+	std::atomic<int> spinEstimate; //!< running average of the number of polls needed to acquire the lock by spinning, only modified by the thread which just acquired it (but read by threads waiting for it)
+	std::atomic<unsigned int> owner_index; //!< holds the tekkotsu process id of the current lock owner, read without holding the lock by owner() and contending threads
+	std::atomic<std::thread::id> owner_thread; //!< the thread holding the lock, or a default-constructed id if unlocked; only the owner ever stores its own id, so testing for it is safe without holding the lock
+	unsigned int lockcount; //!< the depth of the lock, 0 when unlocked, only modified by the owner
+	
+private:
+	MutexLock(const MutexLock& ml); //!< copy constructor, do not call
+	MutexLock& operator=(const MutexLock& ml); //!< assignment, do not call
 };
 
 #  else /* IPC Lock using Semaphores*/
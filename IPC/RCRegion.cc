@@ -8,6 +8,7 @@
 #include <sstream>
 #include <sys/stat.h>
 #include <errno.h>
+#include <vector>
 
 #if TEKKOTSU_SHM_STYLE!=SYSV_SHM && TEKKOTSU_SHM_STYLE!=POSIX_SHM && TEKKOTSU_SHM_STYLE!=NO_SHM
 #  error Unknown TEKKOTSU_SHM_STYLE setting
@@ -40,6 +41,9 @@ RCRegion::attachedRegions_t RCRegion::attachedRegions;
 bool RCRegion::isFaultShutdown=false;
 bool RCRegion::multiprocess=true;
 Thread::Lock* RCRegion::staticLock=NULL;
+RCRegion::pool_t RCRegion::pool;
+size_t RCRegion::poolCapacity=16*1024*1024;
+RCRegion::PoolStats RCRegion::poolStats;
 
 
 #if TEKKOTSU_SHM_STYLE==SYSV_SHM
@@ -114,47 +118,10 @@ void RCRegion::RemoveReference() {
 		}*/
 		if(wasLastProcRef) {
 			//cout << " detach";
-#if TEKKOTSU_SHM_STYLE==SYSV_SHM
-			if(shmdt(base)<0)
-				perror("Warning: Region detach");
-			base=NULL;
-			references=NULL;
-			if(wasLastAnyRef) {
-				//cout << " delete" << endl;
-				if(shmctl(id.shmid,IPC_RMID,NULL)<0)
-					perror("Warning: Region delete");
-			}
-#elif TEKKOTSU_SHM_STYLE==POSIX_SHM
-			if(munmap(base,calcRealSize(id.size))<0) {
-				perror("Warning: Shared memory unmap (munmap)");
-			}
+			if(!wasLastAnyRef || isFaultShutdown || !addToPool())
+				releaseMapping(id,base,wasLastAnyRef);
 			base=NULL;
 			references=NULL;
-			if(wasLastAnyRef) {
-				//cout << " delete" << endl;
-				if(!unlinkRegion()) {
-					int err=errno;
-					if(isFaultShutdown && (err==EINVAL || err==ENOENT))
-						//On a fault shutdown, we initially try to unlink everything right away,
-						// so an error now is just confirmation that it worked
-						cerr << "Region " << id.key << " appears to have been successfully unlinked" << endl;
-					else {
-						cerr << "Warning: Shared memory unlink of region " << id.key << " returned " << strerror(err);
-						if(err==EINVAL || err==ENOENT)
-							cerr << "\n         May have already been unlinked by a dying process.";
-						cerr << endl;
-					}
-				} else if(isFaultShutdown)
-					//That shouldn't have succeeded on a faultShutdown...
-					cerr << "Region " << id.key << " appears to have been successfully unlinked (nonstandard)" << endl;
-			}
-#elif TEKKOTSU_SHM_STYLE==NO_SHM
-			delete base;
-			base=NULL;
-			references=NULL;
-#else
-#  error "Unknown TEKKOTSU_SHM_STYLE setting"
-#endif
 			delete this;
 			if(attachedRegions.size()==0 && !isFaultShutdown) {
 				//was last attached region, clean up lock for good measure
@@ -201,6 +168,8 @@ void RCRegion::aboutToFork(ProcessID::ProcessID_t newID) {
 	Thread::Lock* old;
 	{
 		MarkScope l(getStaticLock());
+		//the child gets copies of our pooled mappings, don't let both of us recycle them
+		releasePool();
 		attachedRegions_t::const_iterator it=attachedRegions.begin();
 		for(; it!=attachedRegions.end(); ++it) {
 			//cout << "Duplicating attachments for " << (*it).first;
@@ -224,6 +193,7 @@ void RCRegion::faultShutdown() {
 		return;
 	}
 	isFaultShutdown=true;
+	releasePool();
 	if(attachedRegions.size()==0) {
 		cerr << "WARNING: RCRegion::faultShutdown() called without any attached regions (may be a good thing?)" << endl;
 		return;
@@ -287,8 +257,150 @@ unsigned int RCRegion::calcRealSize(unsigned int size) {
 	size=((size+align-1)/align)*align; //round up for field alignment
 	size+=extra; //add room for the reference count
 	unsigned int pagesize=::getpagesize();
-	unsigned int pages=(size+pagesize-1)/pagesize;
-	return pages*pagesize; //round up to the nearest page
+	unsigned int pages=(size+pagesize-1)/pagesize; //round up to the nearest page
+	if(pages>4) {
+		//round up to a size class so released regions can be recycled for similar sizes:
+		//four classes per power of two, so at most 25% is wasted
+		unsigned int step=1;
+		for(unsigned int p=pages; p>=8; p>>=1)
+			step<<=1;
+		pages=((pages+step-1)/step)*step;
+	}
+	return pages*pagesize;
+}
+
+RCRegion::PoolStats RCRegion::getPoolStats() {
+	MarkScope l(getStaticLock());
+	return poolStats;
+}
+
+void RCRegion::setPoolCapacity(size_t bytes) {
+	MarkScope l(getStaticLock());
+	poolCapacity=bytes;
+	trimPool(bytes);
+}
+
+void RCRegion::preallocatePool(size_t sz, unsigned int n) {
+	MarkScope l(getStaticLock());
+	//create them all first, otherwise each would just recycle the previous one
+	std::vector<RCRegion*> regions;
+	regions.reserve(n);
+	for(unsigned int i=0; i<n; i++)
+		regions.push_back(new RCRegion(sz));
+	for(unsigned int i=0; i<n; i++)
+		regions[i]->RemoveReference();
+}
+
+void RCRegion::releasePool() {
+	trimPool(0);
+}
+
+bool RCRegion::recycle(size_t sz, const char* name) {
+	MarkScope l(getStaticLock());
+	unsigned int realSize=calcRealSize(sz);
+	std::pair<pool_t::iterator,pool_t::iterator> range=pool.equal_range(realSize);
+	pool_t::iterator it=range.first;
+#if TEKKOTSU_SHM_STYLE==POSIX_SHM
+	//other processes will attach by name, so a named region can only be recycled under the same name
+	if(name!=NULL)
+		for(; it!=range.second && strncmp(it->second.id.key,name,MAX_NAME_LEN)!=0; ++it) {}
+#elif TEKKOTSU_SHM_STYLE==NO_SHM
+	//names are only entries in attachedRegions, so any region can be renamed, but leave conflicts and clipping to init()
+	if(name!=NULL && (strlen(name)>=MAX_NAME_LEN || attachedRegions.find(name)!=attachedRegions.end()))
+		it=range.second;
+#endif
+	if(it==range.second) {
+		++poolStats.misses;
+		return false;
+	}
+	id=it->second.id;
+	id.size=sz;
+#if TEKKOTSU_SHM_STYLE==NO_SHM
+	if(name!=NULL)
+		strncpy(id.key,name,MAX_NAME_LEN);
+#endif
+	base=it->second.base;
+	pool.erase(it);
+	poolStats.pooledBytes-=realSize;
+	--poolStats.pooledRegions;
+	++poolStats.hits;
+	references=reinterpret_cast<unsigned int*>(base+realSize-extra);
+	for(unsigned int i=0; i<ProcessID::NumProcesses+1; i++)
+		references[i]=0;
+	AddReference();
+	attachedRegions[id.key]=this;
+	return true;
+}
+
+bool RCRegion::addToPool() {
+	unsigned int realSize=calcRealSize(id.size);
+	if(poolStats.pooledBytes+realSize>poolCapacity) {
+		if(poolCapacity>0)
+			++poolStats.evictions;
+		return false;
+	}
+	PooledRegion pr;
+	pr.id=id;
+	pr.base=base;
+	pool.insert(pool_t::value_type(realSize,pr));
+	poolStats.pooledBytes+=realSize;
+	++poolStats.pooledRegions;
+	return true;
+}
+
+void RCRegion::trimPool(size_t bytes) {
+	MarkScope l(getStaticLock());
+	//release the largest regions first, they're the most expensive to hold
+	while(poolStats.pooledBytes>bytes && !pool.empty()) {
+		pool_t::iterator it=pool.end();
+		--it;
+		poolStats.pooledBytes-=it->first;
+		--poolStats.pooledRegions;
+		releaseMapping(it->second.id,it->second.base,true);
+		pool.erase(it);
+	}
+}
+
+void RCRegion::releaseMapping(const Identifier& rid, char * rbase, bool destroy) {
+#if TEKKOTSU_SHM_STYLE==SYSV_SHM
+	if(shmdt(rbase)<0)
+		perror("Warning: Region detach");
+	poolStats.mappedBytes-=calcRealSize(rid.size);
+	if(destroy) {
+		//cout << " delete" << endl;
+		if(shmctl(rid.shmid,IPC_RMID,NULL)<0)
+			perror("Warning: Region delete");
+	}
+#elif TEKKOTSU_SHM_STYLE==POSIX_SHM
+	if(munmap(rbase,calcRealSize(rid.size))<0) {
+		perror("Warning: Shared memory unmap (munmap)");
+	}
+	poolStats.mappedBytes-=calcRealSize(rid.size);
+	if(destroy) {
+		//cout << " delete" << endl;
+		if(!unlinkRegion(rid.key)) {
+			int err=errno;
+			if(isFaultShutdown && (err==EINVAL || err==ENOENT))
+				//On a fault shutdown, we initially try to unlink everything right away,
+				// so an error now is just confirmation that it worked
+				cerr << "Region " << rid.key << " appears to have been successfully unlinked" << endl;
+			else {
+				cerr << "Warning: Shared memory unlink of region " << rid.key << " returned " << strerror(err);
+				if(err==EINVAL || err==ENOENT)
+					cerr << "\n         May have already been unlinked by a dying process.";
+				cerr << endl;
+			}
+		} else if(isFaultShutdown)
+			//That shouldn't have succeeded on a faultShutdown...
+			cerr << "Region " << rid.key << " appears to have been successfully unlinked (nonstandard)" << endl;
+	}
+#elif TEKKOTSU_SHM_STYLE==NO_SHM
+	(void)destroy; //without shared memory, the last process reference is always the last reference
+	delete [] rbase;
+	poolStats.mappedBytes-=calcRealSize(rid.size);
+#else
+#  error "Unknown TEKKOTSU_SHM_STYLE setting"
+#endif
 }
 
 
@@ -369,6 +481,7 @@ void RCRegion::init(size_t sz, key_t sug_key, bool create) {
 			perror("Region delete");
 		exit(EXIT_FAILURE);
 	}
+	poolStats.mappedBytes+=sz;
 	references=reinterpret_cast<unsigned int*>(base+sz-extra);
 	if(create) {
 		for(unsigned int i=0; i<ProcessID::NumProcesses+1; i++)
@@ -401,11 +514,11 @@ int RCRegion::openRegion(int mode) const {
 	return open(getQualifiedName().c_str(),mode,0666);
 #endif
 }
-bool RCRegion::unlinkRegion() const {
+bool RCRegion::unlinkRegion(const std::string& key) {
 #ifdef USE_UNBACKED_SHM
-	return shm_unlink(getQualifiedName().c_str())==0;
+	return shm_unlink(getQualifiedName(key).c_str())==0;
 #else
-	return unlink(getQualifiedName().c_str())==0;
+	return unlink(getQualifiedName(key).c_str())==0;
 #endif
 }
 void RCRegion::init(size_t sz, const std::string& name, bool create) {
@@ -524,6 +637,7 @@ void RCRegion::init(size_t sz, const std::string& name, bool create) {
 	if(close(fd)<0) {
 		perror("Warning: Closing temporary file descriptor from shm_open");
 	}
+	poolStats.mappedBytes+=sz;
 	references=reinterpret_cast<unsigned int*>(base+sz-extra);
 	if(create) {
 		for(unsigned int i=0; i<ProcessID::NumProcesses+1; i++)
@@ -586,11 +700,13 @@ void RCRegion::init(size_t sz, const std::string& name, bool create) {
 			}
 		}
 		base=new char[sz];
+		poolStats.mappedBytes+=sz;
 	} else {
 		attachedRegions_t::const_iterator it=attachedRegions.find(id.key);
 		ASSERT(it==attachedRegions.end(),"attachment not found with disabled shared mem (TEKKOTSU_SHM_STYLE==NO_SHM)");
 		if(it==attachedRegions.end()) {
 			base=new char[sz];
+			poolStats.mappedBytes+=sz;
 		} else {
 			base=it->second->base;
 		}
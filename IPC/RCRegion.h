@@ -101,18 +101,20 @@ public:
 	//! constructor (OPEN-R compatability)
 	explicit RCRegion(size_t sz)
 		: id(), base(NULL), references(NULL)
-	{ init(sz,nextKey,true); }
+	{ if(!recycle(sz,NULL)) init(sz,nextKey,true); }
 	//! constructor, name isn't used for sysv-style shared memory (not OPEN-R compatable)
 	/*! could hash the name to generate key...? */
 	RCRegion(const std::string&, size_t sz)
 		: id(), base(NULL), references(NULL)
-	{ init(sz,nextKey,true); }
+	{ if(!recycle(sz,NULL)) init(sz,nextKey,true); }
 
 #elif TEKKOTSU_SHM_STYLE==POSIX_SHM || TEKKOTSU_SHM_STYLE==NO_SHM
 	//! constructor (OPEN-R compatability, name is autogenerated)
 	explicit RCRegion(size_t sz)
 		: id(), base(NULL), references(NULL)
 	{
+		if(recycle(sz,NULL))
+			return;
 		char name[RCRegion::MAX_NAME_LEN];
 		snprintf(name,RCRegion::MAX_NAME_LEN,"Rgn.%d.%u",ProcessID::getID(),static_cast<unsigned int>(++nextKey));
 		name[RCRegion::MAX_NAME_LEN-1]='\0';
@@ -121,7 +123,7 @@ public:
 	//! constructor, specify your own name for better debugging accountability (not OPEN-R compatable)
 	RCRegion(const std::string& name, size_t sz)
 		: id(), base(NULL), references(NULL)
-	{ init(sz,name,true); }
+	{ if(!recycle(sz,name.c_str())) init(sz,name,true); }
 #endif
 
 	//! requests that a specified RCRegion be loaded into the current process's memory space
@@ -180,6 +182,27 @@ public:
 	static void setMultiprocess(bool mp) { multiprocess=mp; } //!< sets #multiprocess
 	static bool getMultiprocess() { return multiprocess; } //!< returns #multiprocess
 
+	//! statistics regarding the region pool, see getPoolStats()
+	struct PoolStats {
+		PoolStats() : hits(0), misses(0), evictions(0), pooledRegions(0), pooledBytes(0), mappedBytes(0) {} //!< constructor
+		unsigned int hits; //!< number of regions constructed by recycling a pooled region
+		unsigned int misses; //!< number of regions which had to be created from scratch
+		unsigned int evictions; //!< number of released regions which were destroyed instead of pooled because the pool was full
+		unsigned int pooledRegions; //!< number of regions currently held in the pool
+		size_t pooledBytes; //!< bytes currently held in the pool (included in #mappedBytes)
+		size_t mappedBytes; //!< bytes currently mapped (or allocated) by this process, including housekeeping and page rounding
+	};
+	//! returns a snapshot of the current process's pool statistics
+	static PoolStats getPoolStats();
+	//! sets #poolCapacity, releasing pooled regions as needed to fit (0 disables pooling)
+	static void setPoolCapacity(size_t bytes);
+	//! returns #poolCapacity
+	static size_t getPoolCapacity() { return poolCapacity; }
+	//! creates @a n regions sized to hold @a sz bytes and places them directly in the pool, so the first messages of that size don't pay for creation either
+	static void preallocatePool(size_t sz, unsigned int n);
+	//! destroys all pooled regions (unlinking their backing), this should be called before exit so they don't leak
+	static void releasePool();
+	
 	
 protected:
 	//! this protected constructor is used for attaching regions previously created by another process (see attach())
@@ -194,8 +217,29 @@ protected:
 	//! the amount of space to leave at the end of the region for housekeeping (reference counts)
 	static const unsigned int extra=sizeof(unsigned int)*(ProcessID::NumProcesses+1);
 	//! returns the size of the region to be allocated, given the size requested by the client
+	/*! This is rounded up to a size class (whole pages, with at most four classes per power of two)
+	 *  so that released regions can be recycled for similar requests, see recycle() */
 	static unsigned int calcRealSize(unsigned int size);
 
+	//! information retained about a region in the pool
+	struct PooledRegion {
+		PooledRegion() : id(), base(NULL) {} //!< constructor
+		Identifier id; //!< system identifier of the pooled region (Identifier::size is the previous client's size)
+		char * base; //!< the region's (still mapped) memory
+	};
+	//! pooled regions, indexed by calcRealSize() of their size
+	typedef std::multimap<unsigned int,PooledRegion> pool_t;
+	
+	//! if a pooled region of the right size class (and, if it matters for this TEKKOTSU_SHM_STYLE, the right @a name) is available, takes it over and returns true
+	/*! @a name is NULL for anonymous regions, which can take any pooled region of the right size */
+	bool recycle(size_t sz, const char* name);
+	//! called when the last reference to the region has been removed, returns true if the mapping was placed in the pool instead of being released
+	bool addToPool();
+	//! removes the mapping of region @a rid at @a rbase from the current process, and if @a destroy, removes it from the system as well
+	static void releaseMapping(const Identifier& rid, char * rbase, bool destroy);
+	//! releases pooled regions (largest size classes first) until #poolStats shows at most @a bytes pooled
+	static void trimPool(size_t bytes);
+
 	//! intializes and returns #staticLock
 	static Thread::Lock& getStaticLock();
 
@@ -210,7 +254,9 @@ protected:
 	//! opens a region either in "pure" shared memory, or in file-backed shared memory, based on whether USE_UNBACKED_SHM is defined
 	int openRegion(int mode) const;
 	//! unlinks a region either in "pure" shared memory, or in file-backed shared memory, based on whether USE_UNBACKED_SHM is defined
-	bool unlinkRegion() const;
+	bool unlinkRegion() const { return unlinkRegion(id.key); }
+	//! unlinks the region named @a key either in "pure" shared memory, or in file-backed shared memory, based on whether USE_UNBACKED_SHM is defined
+	static bool unlinkRegion(const std::string& key);
 	//! initializes the region's information, either creating a new shared memory region or attempting to connect to a pre-existing one
 	void init(size_t sz, const std::string& name, bool create);
 #elif TEKKOTSU_SHM_STYLE==NO_SHM
@@ -230,6 +276,12 @@ protected:
 	static key_t nextKey; //!< serial number of next key -- starts at 1024 for TEKKOTSU_SHM_STYLE==SYSV_SHM, 0 for POSIX_SHM
 	static attachedRegions_t attachedRegions; //!< a mapping of key values to RCRegion pointers of the attached region
 	
+	//! regions whose last reference (across all processes) was removed by this process, retained for reuse instead of being unmapped and unlinked
+	/*! The pool is process-local, and is emptied by aboutToFork() so that a parent and child can't both recycle the same region */
+	static pool_t pool;
+	static size_t poolCapacity; //!< maximum number of bytes to hold in #pool
+	static PoolStats poolStats; //!< statistics regarding #pool and mapped memory, see getPoolStats()
+	
 	Identifier id; //!< key values for the region, namely the system key type (either an integer or string depending on TEKKOTSU_SHM_STYLE) and the size of the region
 	char * base; //!< pointer to the region's user data
 	unsigned int * references; //!< pointer to the per-process reference counts (stored within the shared region!)
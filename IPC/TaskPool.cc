@@ -0,0 +1,273 @@
+#ifndef PLATFORM_APERIOS
+#include "TaskPool.h"
+#include "Futex.h"
+#include "Shared/MarkScope.h"
+#include <sched.h>
+#include <cstdio>
+#include <thread>
+
+using namespace std;
+
+std::atomic<TaskPool*> TaskPool::defaultPool(NULL);
+unsigned int TaskPool::defaultWorkers=-1U;
+
+//! number of times an idle worker re-checks the queues (yielding in between) before blocking
+static const unsigned int IDLE_SPINS=64;
+//! a thread blocked in TaskGroup::wait() re-checks the queues at this interval (in microseconds), in case stealable tasks appear
+static const unsigned int HELP_POLL=1000;
+
+//! protects creation and release of the default pool
+static Thread::Lock& defaultLock() {
+	static Thread::Lock l;
+	return l;
+}
+
+//! A worker thread of a TaskPool, with its own deque of tasks
+class TaskPool::Worker : public Thread {
+public:
+	//! constructor
+	Worker(TaskPool& p, unsigned int i) : Thread(), pool(p), index(i), tasks(), lock(), seed(i*2654435761U+1) {}
+	//! destructor
+	~Worker() { if(isStarted()) stop().join(); }
+	
+	//! returns a pseudo-random starting point for stealing, so thieves don't all converge on the same victim
+	unsigned int nextVictim() { seed^=seed<<13; seed^=seed>>17; seed^=seed<<5; return seed; }
+	
+	TaskPool& pool; //!< the pool this worker belongs to
+	unsigned int index; //!< the index of this worker within TaskPool::workers
+	std::deque<Task*> tasks; //!< tasks submitted by this worker: it takes from the back, thieves take from the front
+	Thread::Lock lock; //!< protects #tasks
+	unsigned int seed; //!< state for nextVictim()
+	
+protected:
+	virtual bool launched() {
+#ifdef __linux__
+		char name[16];
+		snprintf(name,sizeof(name),"TaskPool-%u",index);
+		pthread_setname_np(pthread_self(),name);
+#endif
+		return Thread::launched();
+	}
+	virtual void* run() {
+		unsigned int idle=0;
+		while(!pool.shuttingDown.load() || pool.queued.load()>0) {
+			int e=pool.epoch.load();
+			if(Task* t=pool.findTask(this)) {
+				execute(t);
+				idle=0;
+			} else if(++idle<IDLE_SPINS) {
+				sched_yield();
+			} else {
+				// enqueue() increments epoch before checking sleepers, so either we'll see the new epoch here or it will see us
+				++pool.sleepers;
+				if(pool.epoch.load()==e && !pool.shuttingDown.load())
+					futex::wait(pool.epoch,e);
+				--pool.sleepers;
+				idle=0;
+			}
+		}
+		return NULL;
+	}
+	
+private:
+	Worker(const Worker&); //!< don't call
+	Worker& operator=(const Worker&); //!< don't call
+};
+
+
+TaskPool::TaskPool(unsigned int numWorkers)
+	: workers(), injected(), injectedLock(), queued(0), epoch(0), sleepers(0), shuttingDown(false)
+{
+	workers.reserve(numWorkers);
+	for(unsigned int i=0; i<numWorkers; i++)
+		workers.push_back(new Worker(*this,i));
+	// start only after the vector is complete, since workers steal from each other
+	for(unsigned int i=0; i<numWorkers; i++)
+		workers[i]->start();
+}
+
+TaskPool::~TaskPool() {
+	shuttingDown.store(true);
+	++epoch;
+	futex::wakeAll(epoch);
+	for(std::vector<Worker*>::const_iterator it=workers.begin(); it!=workers.end(); ++it)
+		(*it)->join();
+	// the workers are all stopped before any is deleted, since they may be stealing from each other until then
+	for(std::vector<Worker*>::const_iterator it=workers.begin(); it!=workers.end(); ++it)
+		delete *it;
+	workers.clear();
+	// only possible if there were no workers
+	while(Task* t=findTask(NULL))
+		execute(t);
+}
+
+TaskPool& TaskPool::getDefault() {
+	TaskPool* p=defaultPool.load();
+	if(p!=NULL)
+		return *p;
+	MarkScope l(defaultLock());
+	if(defaultPool.load()==NULL)
+		defaultPool.store(new TaskPool(getDefaultWorkers()));
+	return *defaultPool.load();
+}
+
+void TaskPool::releaseDefault() {
+	MarkScope l(defaultLock());
+	delete defaultPool.exchange(NULL);
+}
+
+unsigned int TaskPool::getDefaultWorkers() {
+	if(defaultWorkers!=-1U)
+		return defaultWorkers;
+	unsigned int n=std::thread::hardware_concurrency();
+	return n>1 ? n-1 : 0;
+}
+
+void TaskPool::enqueue(Task* const* ts, size_t n) {
+	if(n==0)
+		return;
+	// count first, so a thread which takes one of these can't underflow the count
+	queued.fetch_add(static_cast<unsigned int>(n));
+	if(Worker* w=currentWorker()) {
+		MarkScope l(w->lock);
+		w->tasks.insert(w->tasks.end(),ts,ts+n);
+	} else {
+		MarkScope l(injectedLock);
+		injected.insert(injected.end(),ts,ts+n);
+	}
+	++epoch;
+	if(sleepers.load()>0) {
+		if(n==1)
+			futex::wake(epoch);
+		else
+			futex::wakeAll(epoch);
+	}
+}
+
+TaskPool::Task* TaskPool::findTask(Worker* w) {
+	if(queued.load()==0)
+		return NULL;
+	Task* t=NULL;
+	if(w!=NULL) {
+		MarkScope l(w->lock);
+		if(!w->tasks.empty()) {
+			t=w->tasks.back();
+			w->tasks.pop_back();
+		}
+	}
+	if(t==NULL) {
+		MarkScope l(injectedLock);
+		if(!injected.empty()) {
+			t=injected.front();
+			injected.pop_front();
+		}
+	}
+	if(t==NULL && !workers.empty()) {
+		static std::atomic<unsigned int> outsideVictim(0); // for threads other than workers
+		const size_t n=workers.size();
+		size_t start=(w!=NULL) ? w->nextVictim() : outsideVictim++;
+		for(size_t i=0; i<n && t==NULL; i++) {
+			Worker* v=workers[(start+i)%n];
+			if(v==w)
+				continue;
+			MarkScope l(v->lock);
+			if(!v->tasks.empty()) {
+				t=v->tasks.front();
+				v->tasks.pop_front();
+			}
+		}
+	}
+	if(t!=NULL)
+		--queued;
+	return t;
+}
+
+void TaskPool::execute(Task* t) {
+	TaskGroup* g=t->group;
+	if(!g->isCancelled()) {
+		Thread::pushNoCancel();
+		try {
+			t->run();
+		} catch(...) {
+			g->setError(std::current_exception());
+		}
+		Thread::popNoCancel(false);
+	}
+	// notify before deleting: for async(), deleting the task may release the Future's state, whose group must already be done
+	g->finished();
+	delete t;
+}
+
+TaskPool::Worker* TaskPool::currentWorker() const {
+	if(workers.empty())
+		return NULL;
+	Worker* w=dynamic_cast<Worker*>(Thread::getCurrent());
+	return (w!=NULL && &w->pool==this) ? w : NULL;
+}
+
+
+TaskPool::TaskGroup::~TaskGroup() {
+	Thread::pushNoCancel();
+	help();
+	Thread::popNoCancel(false); // no testCancel, we may already be unwinding
+}
+
+void TaskPool::TaskGroup::submit(Task* t) {
+	t->group=this;
+	++pending;
+	pool.enqueue(&t,1);
+}
+
+void TaskPool::TaskGroup::submit(const std::vector<Task*>& ts) {
+	if(ts.empty())
+		return;
+	for(std::vector<Task*>::const_iterator it=ts.begin(); it!=ts.end(); ++it)
+		(*it)->group=this;
+	pending+=static_cast<int>(ts.size());
+	pool.enqueue(&ts[0],ts.size());
+}
+
+void TaskPool::TaskGroup::wait() {
+	// tasks may refer to the caller's stack, so it can't be cancelled until they're done
+	Thread::pushNoCancel();
+	help();
+	Thread::popNoCancel();
+	if(failed.load()) {
+		std::exception_ptr e=error;
+		error=std::exception_ptr();
+		failed.store(false);
+		cancelled.store(false);
+		std::rethrow_exception(e);
+	}
+}
+
+void TaskPool::TaskGroup::help() {
+	Worker* w=pool.currentWorker();
+	for(int p=pending.load(); p!=0; p=pending.load()) {
+		if(Task* t=pool.findTask(w))
+			execute(t);
+		else
+			futex::wait(pending,p,HELP_POLL);
+	}
+}
+
+void TaskPool::TaskGroup::finished() {
+	// Once pending reaches zero, the waiter may return and destroy the group, so the
+	// wake may be on a dead address.  This is harmless: FUTEX_WAKE only uses the
+	// address as a key, it doesn't access the memory (glibc's semaphores rely on the same)
+	if(pending.fetch_sub(1)==1)
+		futex::wakeAll(pending);
+}
+
+void TaskPool::TaskGroup::setError(const std::exception_ptr& e) {
+	bool expected=false;
+	if(failed.compare_exchange_strong(expected,true))
+		error=e;
+	cancelled.store(true);
+}
+
+/*! @file
+ * @brief Implements TaskPool, a shared pool of worker threads with work stealing, parallel_for, task groups, and futures
+ */
+
+#endif //PLATFORM_APERIOS check
@@ -0,0 +1,294 @@
+//-*-c++-*-
+#ifndef INCLUDED_TaskPool_h_
+#define INCLUDED_TaskPool_h_
+
+#ifdef PLATFORM_APERIOS
+#  warning TaskPool is not Aperios compatable
+#else
+
+#include "Thread.h"
+#include <atomic>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <utility>
+#include <vector>
+
+//! A shared pool of worker threads for running short tasks in parallel, balanced by work stealing
+/*! Rather than each subsystem starting its own threads for data parallel loops
+ *  (vision, planners, particle filters...), they can all share the default pool,
+ *  which is sized from the hardware (one worker per core, less one for the thread which is waiting on the results).
+ *
+ *  The easiest interface is parallel_for(), which splits an index range into chunks:
+ *  @code
+ *  TaskPool::getDefault().parallel_for(0,particles.size(),EvaluateParticle(particles,sensors));
+ *  @endcode
+ *  where EvaluateParticle::operator()(size_t i) const handles a single index.  (Or use
+ *  parallel_for_range() to receive each chunk as a (begin,end) pair.)
+ *
+ *  For heterogeneous work, submit functors to a TaskGroup and wait() on it, or use async() to get a Future.
+ *
+ *  Each worker has its own deque of tasks: tasks submitted by a worker (i.e. nested
+ *  parallelism) go to the back of its own deque and are taken back in LIFO order, while
+ *  idle workers steal from the front of others' deques.  Tasks submitted from other threads
+ *  go into a shared queue.  A thread waiting on a TaskGroup or Future doesn't block while
+ *  there is work available, it helps run tasks until its own have completed, so nested
+ *  waits can't deadlock, and a pool with no workers (or one inherited across a fork())
+ *  still makes progress.
+ *
+ *  Thread cancellation (Thread::stop()) is deferred while a task is running, and while a
+ *  thread is waiting on a TaskGroup, since the tasks may refer to data on the waiter's stack. */
+class TaskPool {
+public:
+	class TaskGroup;
+	template<typename R> class Future;
+
+	//! base class for work items, subclasses override run()
+	class Task {
+	public:
+		//! constructor
+		Task() : group(NULL) {}
+		//! destructor
+		virtual ~Task() {}
+		//! does the actual work
+		virtual void run()=0;
+	protected:
+		friend class TaskPool;
+		friend class TaskGroup;
+		TaskGroup* group; //!< the group to notify when the task completes
+	private:
+		Task(const Task&); //!< don't call
+		Task& operator=(const Task&); //!< don't call
+	};
+
+	//! constructor, starts @a numWorkers worker threads
+	explicit TaskPool(unsigned int numWorkers);
+	//! destructor, stops and joins the workers once their queues are empty
+	~TaskPool();
+
+	//! returns the process-wide shared pool, creating it on first call with getDefaultWorkers() threads
+	static TaskPool& getDefault();
+	//! destroys the default pool (if it has been created), a later getDefault() will create a new one
+	static void releaseDefault();
+	//! sets the number of workers the default pool will be created with, takes effect the next time the default pool is created
+	static void setDefaultWorkers(unsigned int n) { defaultWorkers=n; }
+	//! returns the number of workers the default pool will be created with, by default one less than the number of hardware threads
+	static unsigned int getDefaultWorkers();
+
+	//! returns the number of worker threads
+	unsigned int getNumWorkers() const { return static_cast<unsigned int>(workers.size()); }
+	//! returns the number of threads which can run tasks at once: the workers plus a waiting thread
+	unsigned int getConcurrency() const { return getNumWorkers()+1; }
+
+	//! calls @a f(i) for each @a i in [@a begin,@a end), in parallel, returning when all have completed
+	/*! Indices are processed in chunks of @a grain; 0 selects a grain which gives each thread
+	 *  a few chunks to balance load.  If any call throws, remaining chunks are skipped
+	 *  and the first exception is rethrown. */
+	template<class F> void parallel_for(size_t begin, size_t end, const F& f, size_t grain=0) {
+		parallel_for_range(begin,end,IndexLoop<F>(f),grain);
+	}
+
+	//! calls @a f(b,e) for consecutive subranges [@a b,@a e) covering [@a begin,@a end), in parallel, returning when all have completed
+	/*! See parallel_for() regarding @a grain and exceptions. */
+	template<class F> void parallel_for_range(size_t begin, size_t end, const F& f, size_t grain=0);
+
+	/*! @cond INTERNAL */
+	//! provides the return type of a zero-argument functor, for async()
+	template<class F> struct FunctorResult { typedef decltype(std::declval<const F&>()()) type; };
+	/*! @endcond */
+
+	//! runs @a f() in the pool, returning a Future for the result
+	template<class F> Future<typename FunctorResult<F>::type> async(const F& f);
+
+	//! Tracks completion of a set of tasks, see TaskPool
+	class TaskGroup {
+	public:
+		//! constructor, tasks will run on @a p
+		explicit TaskGroup(TaskPool& p=TaskPool::getDefault()) : pool(p), pending(0), cancelled(false), failed(false), error() {}
+		//! destructor, waits for any outstanding tasks (discarding their exceptions)
+		~TaskGroup();
+
+		//! queues a copy of @a f, which will be called with no arguments
+		template<class F> void run(const F& f) { submit(new FunctorTask<F>(f)); }
+		//! queues @a t, which will be deleted after it runs
+		void submit(Task* t);
+		//! queues all of @a ts, which will each be deleted after they run
+		void submit(const std::vector<Task*>& ts);
+
+		//! blocks until all submitted tasks have completed, running queued tasks in the meantime; rethrows the first exception thrown by a task
+		void wait();
+
+		//! tasks which have not yet started will be skipped, running tasks can poll isCancelled() to stop early
+		void cancel() { cancelled.store(true); }
+		//! returns true if cancel() has been called, or a task has thrown an exception
+		bool isCancelled() const { return cancelled.load(std::memory_order_relaxed); }
+		//! returns the number of submitted tasks which have not yet completed
+		unsigned int getPending() const { return pending.load(); }
+
+		//! returns the pool the group's tasks run on
+		TaskPool& getPool() const { return pool; }
+
+	protected:
+		friend class TaskPool;
+		//! called by TaskPool as each task finishes (after it has been run, or skipped due to cancellation)
+		void finished();
+		//! records the first exception thrown by a task, and cancels the rest
+		void setError(const std::exception_ptr& e);
+		//! runs queued tasks, or blocks, until #pending reaches 0 (the caller handles thread cancellation)
+		void help();
+
+		TaskPool& pool; //!< the pool tasks are submitted to
+		std::atomic<int> pending; //!< number of tasks which have been submitted but not completed, also serves as a futex for wait()
+		std::atomic<bool> cancelled; //!< set by cancel() or setError()
+		std::atomic<bool> failed; //!< set by the first setError() call, which also stores #error
+		std::exception_ptr error; //!< the first exception thrown by a task
+
+	private:
+		TaskGroup(const TaskGroup&); //!< don't call
+		TaskGroup& operator=(const TaskGroup&); //!< don't call
+	};
+
+	//! The result of a computation started by async()
+	template<typename R>
+	class Future {
+	public:
+		//! returns true if the computation has completed
+		bool ready() const { return state->group.getPending()==0; }
+		//! waits for the computation to complete (running other tasks in the meantime), and returns its result or rethrows its exception
+		R get() { state->group.wait(); return state->result(); }
+	protected:
+		friend class TaskPool;
+		struct State;
+		//! constructor, used by async()
+		explicit Future(const std::shared_ptr<State>& s) : state(s) {}
+		std::shared_ptr<State> state; //!< shared with the task computing the result
+	};
+
+protected:
+	class Worker;
+
+	/*! @cond INTERNAL */
+	//! wraps a functor as a task
+	template<class F> class FunctorTask : public Task {
+	public:
+		explicit FunctorTask(const F& f) : Task(), fun(f) {}
+		virtual void run() { fun(); }
+		F fun;
+	};
+	//! adapts a single index functor for parallel_for_range()
+	template<class F> struct IndexLoop {
+		explicit IndexLoop(const F& f) : fun(f) {}
+		void operator()(size_t b, size_t e) const { for(; b!=e; ++b) fun(b); }
+		const F& fun;
+	private:
+		IndexLoop& operator=(const IndexLoop&); //!< don't call
+	};
+	//! runs one chunk of a parallel_for_range(), refers to the caller's functor since it waits for completion
+	template<class F> class RangeTask : public Task {
+	public:
+		RangeTask(const F& f, size_t b, size_t e) : Task(), fun(f), begin(b), end(e) {}
+		virtual void run() { fun(begin,end); }
+		const F& fun;
+		size_t begin, end;
+	};
+	//! a computation started by async(), calls the functor and stores the result in the future's state
+	template<typename R, class F> class FutureTask : public Task {
+	public:
+		FutureTask(const std::shared_ptr<typename Future<R>::State>& s, const F& f) : Task(), state(s), fun(f) {}
+		virtual void run() { state->compute(fun); }
+		std::shared_ptr<typename Future<R>::State> state;
+		F fun;
+	};
+	/*! @endcond */
+
+	//! queues @a ts, onto the current thread's own deque if it is one of our workers, otherwise #injected
+	void enqueue(Task* const* ts, size_t n);
+	//! finds a task for @a w (NULL if the calling thread isn't one of our workers) to run: from its own deque, then #injected, then stealing from other workers
+	Task* findTask(Worker* w);
+	//! runs @a t (unless its group has been cancelled), then deletes it and notifies its group
+	static void execute(Task* t);
+	//! returns the calling thread's Worker if it belongs to this pool, otherwise NULL
+	Worker* currentWorker() const;
+
+	std::vector<Worker*> workers; //!< the worker threads
+	std::deque<Task*> injected; //!< tasks submitted by threads which aren't workers
+	Thread::Lock injectedLock; //!< protects #injected
+	std::atomic<unsigned int> queued; //!< number of tasks waiting in any queue, lets idle threads skip searching
+	std::atomic<int> epoch; //!< incremented whenever tasks are queued, idle workers block on this as a futex
+	std::atomic<int> sleepers; //!< number of workers blocked on #epoch, so enqueue() can skip the wake call
+	std::atomic<bool> shuttingDown; //!< set by the destructor to tell workers to exit
+
+	static std::atomic<TaskPool*> defaultPool; //!< the pool returned by getDefault()
+	static unsigned int defaultWorkers; //!< number of workers for #defaultPool, -1U to use the hardware thread count
+
+private:
+	TaskPool(const TaskPool&); //!< don't call
+	TaskPool& operator=(const TaskPool&); //!< don't call
+};
+
+/*! @cond INTERNAL */
+//! storage for a Future's result
+template<typename R>
+struct TaskPool::Future<R>::State {
+	explicit State(TaskPool& p) : group(p), value() {}
+	template<class F> void compute(const F& f) { value=f(); }
+	R result() const { return value; }
+	TaskGroup group;
+	R value;
+};
+//! specialization for functors without a result
+template<>
+struct TaskPool::Future<void>::State {
+	explicit State(TaskPool& p) : group(p) {}
+	template<class F> void compute(const F& f) { f(); }
+	void result() const {}
+	TaskGroup group;
+};
+/*! @endcond */
+
+template<class F>
+void TaskPool::parallel_for_range(size_t begin, size_t end, const F& f, size_t grain/*=0*/) {
+	if(end<=begin)
+		return;
+	const size_t n=end-begin;
+	if(grain==0) {
+		grain=n/(getConcurrency()*4);
+		if(grain==0)
+			grain=1;
+	}
+	if(n<=grain || workers.empty()) {
+		f(begin,end);
+		return;
+	}
+	TaskGroup g(*this);
+	std::vector<Task*> chunks;
+	chunks.reserve(n/grain);
+	for(size_t b=begin+grain; b<end; b+=grain)
+		chunks.push_back(new RangeTask<F>(f,b,(end-b>grain) ? b+grain : end));
+	g.submit(chunks);
+	// the caller handles the first chunk itself, before helping with the rest
+	try {
+		f(begin,begin+grain);
+	} catch(...) {
+		g.cancel();
+		g.wait();
+		throw;
+	}
+	g.wait();
+}
+
+template<class F>
+TaskPool::Future<typename TaskPool::FunctorResult<F>::type> TaskPool::async(const F& f) {
+	typedef typename FunctorResult<F>::type R;
+	std::shared_ptr<typename Future<R>::State> st(new typename Future<R>::State(*this));
+	st->group.submit(new FutureTask<R,F>(st,f));
+	return Future<R>(st);
+}
+
+/*! @file
+ * @brief Describes TaskPool, a shared pool of worker threads with work stealing, parallel_for, task groups, and futures
+ */
+
+#endif //Aperios check
+
+#endif
@@ -42,6 +42,7 @@ pthread_key_t Threadstorage_t::selfKey=INVALID_THREADKEY;
 /*! @endcond */
 
 void* Thread::CANCELLED = PTHREAD_CANCELED;
+void (*Thread::applySchedulingRole)(const char* role)=NULL;
 
 Thread::Thread()
 	: pt(new Threadstorage_t), started(false), running(false), exited(false), returnValue(NULL),
@@ -50,7 +51,7 @@ Thread::Thread()
 	reqIntrDepth(0),
 #endif
 	cancelOrig(PTHREAD_CANCEL_ENABLE), cancelRequested(false), cancelInProgress(false),
-	group(NULL), startTrace(NULL), startLock(), stopLock()
+	group(NULL), schedulingRole(NULL), startTrace(NULL), startLock(), stopLock()
 {
 	Thread* cur=getCurrent();
 	if(cur!=NULL)
@@ -314,6 +315,8 @@ void * Thread::launch(void * msg) {
 	if(signal(SIGUSR1,Thread::handle_launch_signal)==SIG_ERR)
 		perror("Thread launch(), signal(SIGUSR1,handle_launch_signal)");
 	cur->running=true;
+	if(cur->schedulingRole!=NULL && applySchedulingRole!=NULL)
+		(*applySchedulingRole)(cur->schedulingRole);
 	if(!cur->launched()) {
 		//subclass's launch cancelled launch
 		--(cur->noCancelDepth);
@@ -199,6 +199,14 @@ public:
 	//! assigns #group, which will then be inherited by any threads instantiated by this one (the constructor call queries the current thread, no the start() or launch())
 	void setGroup(void* g) { group=g; }
 	
+	//! returns #schedulingRole
+	const char* getSchedulingRole() const { return schedulingRole; }
+	//! assigns #schedulingRole, which takes effect the next time the thread is launched (see ThreadScheduling)
+	void setSchedulingRole(const char* role) { schedulingRole=role; }
+	
+	//! if non-NULL, called from within each new thread with its #schedulingRole (if any) before launched(); installed by ThreadScheduling
+	static void (*applySchedulingRole)(const char* role);
+	
 	//! checks to see if stop() has been called for the current thread, and if so, will exit (passing through handle_exit() first)
 	static void testCurrentCancel();
 	
@@ -264,6 +272,9 @@ protected:
 	//! indicates a common group of threads, inherited from the thread which created this one, default NULL if created from main thread
 	void* group;
 	
+	//! names the ThreadScheduling settings (priority, CPU affinity...) to apply when the thread is launched, NULL to leave scheduling as inherited
+	const char* schedulingRole;
+	
 	//! stores a stack trace of the call to start(), for error reporting and debugging
 	stacktrace::StackFrame * startTrace;
 	//! prevents concurrent starts
@@ -0,0 +1,155 @@
+#ifndef PLATFORM_APERIOS
+#include "ThreadScheduling.h"
+#include "Thread.h"
+#include "Shared/MarkScope.h"
+#include <pthread.h>
+#include <sched.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <iostream>
+
+#ifdef __linux__
+#  include <sys/syscall.h>
+#  include <unistd.h>
+#endif
+
+using namespace std;
+
+const char * const ThreadScheduling::policyNames[] = { "DEFAULT", "FIFO", "RR", NULL };
+INSTANTIATE_NAMEDENUMERATION_STATICS(ThreadScheduling::Policy);
+
+//! lock for ThreadScheduling::getRoles(), function static to be safe from static initialization order
+static Thread::Lock& rolesLock() {
+	static Thread::Lock lock;
+	return lock;
+}
+
+bool ThreadScheduling::apply(const char* role) const {
+	bool success=true;
+	const bool warn=!warned.exchange(true);
+
+#ifdef __linux__
+	// thread names are limited to 15 characters, truncate rather than fail
+	char name[16];
+	strncpy(name,role,sizeof(name)-1);
+	name[sizeof(name)-1]='\0';
+	pthread_setname_np(pthread_self(),name);
+#endif
+
+	if(policy==DEFAULT) {
+		if(niceness!=0) {
+#ifdef __linux__
+			// on Linux, nice values are per-thread, addressed by thread id
+			if(setpriority(PRIO_PROCESS,syscall(SYS_gettid),niceness)!=0) {
+				if(warn)
+					cerr << "WARNING: unable to set niceness " << niceness << " for " << role << " thread: " << strerror(errno) << endl;
+				success=false;
+			}
+#else
+			if(warn)
+				cerr << "WARNING: per-thread niceness is not supported on this platform, ignored for " << role << " thread" << endl;
+			success=false;
+#endif
+		}
+	} else {
+		const int pol = (policy==FIFO) ? SCHED_FIFO : SCHED_RR;
+		sched_param sp;
+		memset(&sp,0,sizeof(sp));
+		sp.sched_priority=priority;
+		if(sp.sched_priority<sched_get_priority_min(pol))
+			sp.sched_priority=sched_get_priority_min(pol);
+		if(sp.sched_priority>sched_get_priority_max(pol))
+			sp.sched_priority=sched_get_priority_max(pol);
+		if(int err=pthread_setschedparam(pthread_self(),pol,&sp)) {
+			if(warn) {
+				cerr << "WARNING: unable to set " << policy.get() << " priority " << sp.sched_priority << " for " << role << " thread: " << strerror(err) << endl;
+				if(err==EPERM)
+					cerr << "         (real-time scheduling requires root, CAP_SYS_NICE, or an 'rtprio' entry in /etc/security/limits.conf)" << endl;
+			}
+			success=false;
+		}
+	}
+
+	if(cpus.size()>0) {
+#ifdef __linux__
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		for(unsigned int i=0; i<cpus.size(); ++i) {
+			if(cpus[i]<0 || cpus[i]>=CPU_SETSIZE) {
+				if(warn)
+					cerr << "WARNING: invalid CPU index " << cpus[i] << " for " << role << " thread" << endl;
+				success=false;
+			} else {
+				CPU_SET(cpus[i],&set);
+			}
+		}
+		if(CPU_COUNT(&set)>0) {
+			if(int err=pthread_setaffinity_np(pthread_self(),sizeof(set),&set)) {
+				if(warn)
+					cerr << "WARNING: unable to set CPU affinity for " << role << " thread: " << strerror(err) << endl;
+				success=false;
+			}
+		}
+#else
+		if(warn)
+			cerr << "WARNING: CPU affinity is not supported on this platform, ignored for " << role << " thread" << endl;
+		success=false;
+#endif
+	}
+
+	if(lockMemory) {
+		// applies to the whole process, only needs to succeed once
+		static std::atomic<bool> locked(false);
+		if(!locked.load()) {
+			if(mlockall(MCL_CURRENT|MCL_FUTURE)==0) {
+				locked.store(true);
+			} else {
+				if(warn)
+					cerr << "WARNING: unable to lock memory for " << role << " thread: " << strerror(errno) << endl;
+				success=false;
+			}
+		}
+	}
+
+	if(success)
+		warned.store(false); // allow a warning if a later configuration fails
+	return success;
+}
+
+ThreadScheduling::roles_t& ThreadScheduling::getRoles() {
+	static roles_t roles;
+	return roles;
+}
+
+void ThreadScheduling::registerRole(const std::string& role, const ThreadScheduling& settings) {
+	MarkScope l(rolesLock());
+	getRoles()[role]=&settings;
+	Thread::applySchedulingRole=&ThreadScheduling::applyRole;
+}
+
+void ThreadScheduling::unregisterRole(const std::string& role, const ThreadScheduling& settings) {
+	MarkScope l(rolesLock());
+	roles_t::iterator it=getRoles().find(role);
+	if(it!=getRoles().end() && it->second==&settings)
+		getRoles().erase(it);
+}
+
+void ThreadScheduling::applyRole(const char* role) {
+	const ThreadScheduling* settings=NULL;
+	{
+		MarkScope l(rolesLock());
+		roles_t::const_iterator it=getRoles().find(role);
+		if(it!=getRoles().end())
+			settings=it->second;
+	}
+	if(settings!=NULL)
+		settings->apply(role);
+}
+
+/*! @file
+ * @brief Implements ThreadScheduling, which applies plist-configured scheduling policy, priority, and CPU affinity to threads by role
+ */
+
+#endif //PLATFORM_APERIOS check
@@ -0,0 +1,82 @@
+//-*-c++-*-
+#ifndef INCLUDED_ThreadScheduling_h_
+#define INCLUDED_ThreadScheduling_h_
+
+#ifdef PLATFORM_APERIOS
+#  warning ThreadScheduling is not Aperios compatable
+#else
+
+#include "Shared/plist.h"
+#include <atomic>
+#include <map>
+#include <string>
+
+//! Scheduling settings (policy, priority, CPU affinity, memory locking) for a class of threads, loaded from a configuration plist
+/*! Each instance is registered under a "role" name via registerRole().  Any Thread whose
+ *  Thread::setSchedulingRole() names that role will have the settings applied from within the
+ *  new thread as it launches (before Thread::launched() is called), so the configuration
+ *  only needs to be loaded before the threads are started.
+ *
+ *  Real-time policies (FIFO or RR) generally require root privileges, the CAP_SYS_NICE
+ *  capability, or an 'rtprio' entry in /etc/security/limits.conf.  If a setting can't be
+ *  applied, a warning is displayed (once per role) and the thread continues with whatever
+ *  scheduling it inherited.
+ *
+ *  Memory locking applies to the entire process (mlockall()), not just the thread,
+ *  so page faults can't delay any of the process's threads. */
+class ThreadScheduling : public virtual plist::Dictionary {
+public:
+	//! the scheduling policies which can be selected
+	enum Policy {
+		DEFAULT, //!< leaves the inherited (normally time-shared, SCHED_OTHER) policy in place, only #niceness is applied
+		FIFO, //!< SCHED_FIFO, runs at #priority until it blocks or a higher priority thread becomes ready
+		ROUND_ROBIN //!< SCHED_RR, like FIFO, but time-sliced among threads of the same #priority
+	};
+	static const char * const policyNames[]; //!< names for Policy values, for use in the plist
+
+	//! constructor
+	ThreadScheduling() : plist::Dictionary(), policy(DEFAULT,policyNames), priority(0), niceness(0), cpus(), lockMemory(false), warned(false) {
+		addEntry("Policy",policy,"The scheduling policy to use: DEFAULT (time-sharing), FIFO, or RR (round-robin).\nFIFO and RR are real-time policies, which generally require root, CAP_SYS_NICE, or an 'rtprio' limit.");
+		addEntry("Priority",priority,"Real-time priority for FIFO or RR policies, from 1 (lowest) to 99 (highest); ignored for DEFAULT");
+		addEntry("Niceness",niceness,"Nice value applied to the thread under the DEFAULT policy, from -20 (highest priority) to 19 (lowest priority); only root can decrease this below 0");
+		addEntry("CPUs",cpus,"CPU indices the thread is allowed to run on; an empty array allows any CPU");
+		addEntry("LockMemory",lockMemory,"If true, locks all of the process's current and future memory into RAM (mlockall) when the thread launches, so it can't be delayed by paging");
+		setLoadSavePolicy(FIXED,SYNC);
+	}
+
+	plist::NamedEnumeration<Policy> policy; //!< the scheduling policy
+	plist::Primitive<int> priority; //!< real-time priority for FIFO or ROUND_ROBIN policies
+	plist::Primitive<int> niceness; //!< nice value for the DEFAULT policy
+	plist::ArrayOf<plist::Primitive<int> > cpus; //!< CPU affinity, empty allows any CPU
+	plist::Primitive<bool> lockMemory; //!< if true, calls mlockall() when the thread launches
+
+	//! applies these settings to the calling thread, which is reported as @a role in any warnings; returns false if any setting could not be applied
+	bool apply(const char* role) const;
+
+	//! registers @a settings to be applied to threads with scheduling role @a role, also installs Thread::applySchedulingRole
+	static void registerRole(const std::string& role, const ThreadScheduling& settings);
+	//! removes the settings registered for @a role (if they are still @a settings)
+	static void unregisterRole(const std::string& role, const ThreadScheduling& settings);
+	//! applies the settings registered for @a role to the calling thread, does nothing if the role is not registered
+	static void applyRole(const char* role);
+
+protected:
+	//! the type of the registry of roles
+	typedef std::map<std::string,const ThreadScheduling*> roles_t;
+	//! returns the registry of roles (function static to be safe from static initialization order)
+	static roles_t& getRoles();
+
+	mutable std::atomic<bool> warned; //!< set once a warning has been displayed, so restarting threads don't repeat it
+
+private:
+	ThreadScheduling(const ThreadScheduling&); //!< don't call
+	ThreadScheduling& operator=(const ThreadScheduling&); //!< don't call
+};
+
+/*! @file
+ * @brief Describes ThreadScheduling, which applies plist-configured scheduling policy, priority, and CPU affinity to threads by role
+ */
+
+#endif //Aperios check
+
+#endif
@@ -13,6 +13,7 @@
 #include "Shared/ParticleFilter.h"
 #include "Shared/WorldState.h"
 #include "Vision/VisualOdometry/VisualOdometry.h"
+#include <vector>
 
 
 //! Holds particle-independent odometry code so we can avoid templating and just recompile the cc file
@@ -47,6 +48,7 @@ private:
   float dmean;
   AngTwoPi amean;
   float ddvar, davar, aavar, advar;
+  std::vector<float> noise; //!< scratch space for updateMotion()'s normal samples
 
 public:
   typedef typename ParticleFilter<ParticleT>::MotionModel::particle_type particle_type;
@@ -56,7 +58,7 @@ public:
   //! Constructor
   CreateMotionModel(float dm=0.1f, float am=0.2f, float ddv=0.001f, float dav=0.001f, float aav=0.001f, float adv=0.000001f) :
     BehaviorBase("CreateMotionModel"), ParticleFilter<ParticleT>::MotionModel(), CreateOdometry(),
-    dmean(dm), amean(am), ddvar(ddv), davar(dav), aavar(aav), advar(adv)
+    dmean(dm), amean(am), ddvar(ddv), davar(dav), aavar(aav), advar(adv), noise()
     {}
 
   float sampleNormal(float mean, float var) {
@@ -81,32 +83,39 @@ public:
     estimate.theta += dtheta;
 
     // Now  update the particles using our noise model
-    for(typename particle_collection::iterator it=particles.begin(); it!=particles.end(); ++it) {
-      // noise perturbed distance and angle travelled
-      // Note: original code was:
-      //
-      //    float dnoise = sampleNormal(dmean*dd, ddvar*dd*dd + davar*da*da);
-      //    float anoise = sampleNormal(amean*da, aavar*da*da + advar*dd*dd);
-      //
-      // but with current parameters, this caused a 10% distance
-      // overshoot, while the actual robot seems to show a 3%
-      // undershoot.  Also, for long turns (90 degrees) the angular
-      // error was way too high.  So the version below gives zero mean
-      // translational error; might replace this later with original
-      // code plus better parameter settings.  Our trick doesn't work
-      // for the angular component because if we don't command a turn,
-      // the Create will always report 0 angular change so scaling by
-      // da would zero the noise entirely.
-
-      float dnoise, anoise;
-      dnoise = dmean * dd * sampleNormal(0, ddvar*dd*dd + davar*da*da);
-      anoise = float(amean) * sampleNormal(0, aavar*da*da + advar*dd*dd);
-      float ddn = dd + dnoise;
-      AngSignPi dan = float(da) + anoise;
-      computeCreateMotion(ddn, float(dan), float(it->theta), dx, dy, dtheta);
-      it->x += dx;
-      it->y += dy;
-      it->theta += dtheta;
+    // noise perturbed distance and angle travelled
+    // Note: original code was:
+    //
+    //    float dnoise = sampleNormal(dmean*dd, ddvar*dd*dd + davar*da*da);
+    //    float anoise = sampleNormal(amean*da, aavar*da*da + advar*dd*dd);
+    //
+    // but with current parameters, this caused a 10% distance
+    // overshoot, while the actual robot seems to show a 3%
+    // undershoot.  Also, for long turns (90 degrees) the angular
+    // error was way too high.  So the version below gives zero mean
+    // translational error; might replace this later with original
+    // code plus better parameter settings.  Our trick doesn't work
+    // for the angular component because if we don't command a turn,
+    // the Create will always report 0 angular change so scaling by
+    // da would zero the noise entirely.
+    //
+    // The scales are the same for every particle, so they're computed once,
+    // and the samples are drawn for all of the particles at once.
+    const size_t n = particles.size();
+    if (n == 0)
+      return;
+    const float dscale = dmean * dd * std::sqrt(ddvar*dd*dd + davar*da*da);
+    const float ascale = float(amean) * std::sqrt(aavar*da*da + advar*dd*dd);
+    noise.resize(2*n);
+    RanVecNormalZig32(&noise[0], noise.size());
+    for (size_t i = 0; i < n; i++) {
+      particle_type& p = particles[i];
+      float ddn = dd + dscale * noise[2*i];
+      AngSignPi dan = float(da) + ascale * noise[2*i+1];
+      computeCreateMotion(ddn, float(dan), float(p.theta), dx, dy, dtheta);
+      p.x += dx;
+      p.y += dy;
+      p.theta += dtheta;
     }
   }
 
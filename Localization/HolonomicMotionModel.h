@@ -7,6 +7,7 @@
 #include "Shared/get_time.h"
 #include "Shared/zignor.h"
 #include <cmath>
+#include <vector>
 
 //! the main function -- to avoid numeric issues, treats paths that would result in a radius over 1e6 long as a straight line
 /*! see HolonomicMotionModel class notes for more information on the math involved */
@@ -61,7 +62,7 @@ public:
   HolonomicMotionModel()
     : ParticleFilter<ParticleT>::MotionModel(),
     xvel(0), yvel(0), avel(0), prevtime(get_time()), posx (0), posy(0), posa(0),
-    xvar(.25f), yvar(.25f), avar(.25f), crossAxis(.05f), crossAngle(.001f) {}
+    xvar(.25f), yvar(.25f), avar(.25f), crossAxis(.05f), crossAngle(.001f), noise() {}
 	
   //! constructor, with noise parameters (pass 0's to make it an "ideal" motion model)
   /*! Variance parameters only come into play with updateMotion(), which is called on
@@ -70,7 +71,7 @@ public:
     : ParticleFilter<ParticleT>::MotionModel(),
     xvel(0), yvel(0), avel(0), prevtime(get_time()), posx (0), posy(0), posa(0),
     xvar(xVariance), yvar(yVariance), avar(aVariance),
-    crossAxis((xVariance+yVariance)/10), crossAngle(.001f)  {}
+    crossAxis((xVariance+yVariance)/10), crossAngle(.001f), noise() {}
 	
   //! called by the particle filter when the current position of each particle should be updated
   /*! This will reset the motion model to set the origin at the current location after the particles
@@ -103,20 +104,29 @@ public:
       }
     } else {
       // otherwise have to do the noise generation too...
-      for(typename particle_collection::iterator it=particles.begin(); it!=particles.end(); ++it) {
-	posx=posy=posa=0;
-	// this factor normalizes across update rates
-	// (integrating many small updates otherwise yields lower variance in position than fewer large updates...)
-	float norm=1/std::sqrt(dt);
-	float xv=xvel*(1+(float)DRanNormalZig32()*xvar*norm) + (yvel*(float)DRanNormalZig32()*crossAxis*norm);
-	float yv=yvel*(1+(float)DRanNormalZig32()*yvar*norm) + (xvel*(float)DRanNormalZig32()*crossAxis*norm);
-	float av=avel*(1+(float)DRanNormalZig32()*avar*norm) + ((xvel+yvel)*(float)DRanNormalZig32()*crossAngle*norm);
-	computeHolonomicMotion(xv,yv,av,dt, posx,posy,posa);
-	float c = std::cos(it->theta);
-	float s = std::sin(it->theta);
-	it->x += posx*c - posy*s;
-	it->y += posx*s + posy*c;
-	it->theta += posa;
+      // this factor normalizes across update rates
+      // (integrating many small updates otherwise yields lower variance in position than fewer large updates...)
+      const float norm=1/std::sqrt(dt);
+      // draw all of the noise at once, then convert it to noisy velocities in place (these loops vectorize)
+      const size_t n=particles.size();
+      if(n==0)
+	return;
+      noise.resize(6*n);
+      RanVecNormalZig32(&noise[0],noise.size());
+      float * const xv=&noise[0], * const yv=&noise[n], * const av=&noise[2*n];
+      const float * const xc=&noise[3*n], * const yc=&noise[4*n], * const ac=&noise[5*n];
+      for(size_t i=0; i<n; ++i)
+	xv[i]=xvel*(1+xv[i]*xvar*norm) + (yvel*xc[i]*crossAxis*norm);
+      for(size_t i=0; i<n; ++i)
+	yv[i]=yvel*(1+yv[i]*yvar*norm) + (xvel*yc[i]*crossAxis*norm);
+      for(size_t i=0; i<n; ++i)
+	av[i]=avel*(1+av[i]*avar*norm) + ((xvel+yvel)*ac[i]*crossAngle*norm);
+      for(size_t i=0; i<n; ++i) {
+	// starting from the particle's own pose yields the world frame displacement directly
+	particle_type& p=particles[i];
+	float a=p.theta;
+	computeHolonomicMotion(xv[i],yv[i],av[i],dt, p.x,p.y,a);
+	p.theta=a;
       }
     }
   }
@@ -212,6 +222,7 @@ float yvar; //!< variance of y velocities as ratio of y speed, used when updatin
 float avar; //!< variance of angular velocities as ratio of angular speed, used when updating particle list (updateMotion())
 float crossAxis; //!< cross variance of x speed on y speed and vice versa
 float crossAngle; //!< cross variance of x,y speed on angular speed
+std::vector<float> noise; //!< scratch space for updateMotion()'s normal samples, reused between calls
 };
 
 /*! @file
@@ -0,0 +1,46 @@
+#include "LandmarkGrid.h"
+#include "ShapeLandmarks.h"
+
+#include <algorithm>
+#include <cmath>
+
+long LandmarkGrid::cellOf(float v) const {
+  // clamp so far away (or infinite) coordinates land in the outermost cells instead of overflowing
+  const float c = std::floor(v/cellSize);
+  const float lim = 1e9f;
+  return static_cast<long>(std::max(-lim, std::min(lim, c)));
+}
+
+void LandmarkGrid::build(const std::vector<PfRoot*>& landmarks, const std::vector<unsigned int>& indices, float size) {
+  cellSize = size;
+  entries.clear();
+  for ( unsigned int i=0; i < indices.size(); i++ ) {
+    const PfRoot &lm = *landmarks[indices[i]];
+    float x0 = lm.x, y0 = lm.y, x1 = lm.x, y1 = lm.y;
+    if ( lm.type == lineDataType ) {
+      const PfLine &line = static_cast<const PfLine&>(lm);
+      x0 = std::min<float>(line.x, line.x2);
+      x1 = std::max<float>(line.x, line.x2);
+      y0 = std::min<float>(line.y, line.y2);
+      y1 = std::max<float>(line.y, line.y2);
+    }
+    const long cx1 = cellOf(x1), cy1 = cellOf(y1);
+    for ( long cx = cellOf(x0); cx <= cx1; cx++ )
+      for ( long cy = cellOf(y0); cy <= cy1; cy++ )
+        entries.push_back(Entry(cellKey(cx,cy), indices[i]));
+  }
+  std::sort(entries.begin(), entries.end());
+}
+
+void LandmarkGrid::query(float x, float y, float radius, std::vector<unsigned int>& found) const {
+  if ( entries.empty() )
+    return;
+  const long cx1 = cellOf(x+radius), cy1 = cellOf(y+radius);
+  for ( long cx = cellOf(x-radius); cx <= cx1; cx++ )
+    for ( long cy = cellOf(y-radius); cy <= cy1; cy++ ) {
+      const long long key = cellKey(cx,cy);
+      std::vector<Entry>::const_iterator it = std::lower_bound(entries.begin(), entries.end(), Entry(key,0));
+      for ( ; it != entries.end() && it->first == key; ++it )
+        found.push_back(it->second);
+    }
+}
@@ -0,0 +1,52 @@
+//-*-c++-*-
+#ifndef INCLUDED_LandmarkGrid_h_
+#define INCLUDED_LandmarkGrid_h_
+
+#include <vector>
+#include <utility>
+
+class PfRoot;
+
+//! A spatial hash of particle filter landmarks, to find the landmarks near a point without testing all of them
+/*! Landmarks are entered into the square cells of a grid covering the plane: points into the cell
+ *  containing them, lines (PfLine) into every cell their bounding box overlaps.  The grid is stored
+ *  as a sorted array of (cell, landmark) pairs, so only occupied cells take space, and lookups are
+ *  binary searches.
+ *
+ *  LocalShapeEvaluator builds one of these for each local landmark which has many possible
+ *  matches in the world map, so each particle only scores the world landmarks near where it
+ *  places the local landmark. */
+class LandmarkGrid {
+public:
+  //! constructor, the grid starts out empty
+  LandmarkGrid() : cellSize(0), entries() {}
+
+  //! indexes the landmarks of @a landmarks listed in @a indices, into square cells of width @a size
+  void build(const std::vector<PfRoot*>& landmarks, const std::vector<unsigned int>& indices, float size);
+
+  //! appends to @a found the landmarks in the cells overlapping the square of half-width @a radius centered on (@a x, @a y)
+  /*! This includes every landmark within @a radius of the point, and some which aren't.  A landmark
+   *  may be appended more than once (e.g. a line covering several cells), and the order depends on
+   *  the cells, so sort and remove duplicates if it matters. */
+  void query(float x, float y, float radius, std::vector<unsigned int>& found) const;
+
+  bool empty() const { return entries.empty(); } //!< returns true if nothing has been indexed
+  float getCellSize() const { return cellSize; } //!< returns the width of the cells
+
+protected:
+  typedef std::pair<long long, unsigned int> Entry; //!< a cell key and the index of a landmark in that cell
+
+  //! returns the key of the cell in column @a cx and row @a cy
+  static long long cellKey(long cx, long cy) { return (static_cast<long long>(cx) << 32) ^ static_cast<unsigned int>(cy); }
+  //! returns the column or row of the cell containing coordinate @a v
+  long cellOf(float v) const;
+
+  float cellSize; //!< the width of the cells
+  std::vector<Entry> entries; //!< each landmark's cells, sorted by cell key
+};
+
+/*! @file
+ * @brief Describes LandmarkGrid, a spatial hash of particle filter landmarks
+ */
+
+#endif
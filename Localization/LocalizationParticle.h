@@ -6,6 +6,7 @@
 #include "Shared/zignor.h"
 #include <iostream>
 #include <cmath>
+#include <vector>
 
 template<typename ParticleT> class LocalizationParticleDistributionPolicy;
 
@@ -36,6 +37,45 @@ public:
 
 };
 
+//! The poses and weights of a collection of LocalizationParticles, as a structure of arrays
+/*! Math applied to every particle runs over contiguous floats here, which the compiler can
+ *  vectorize, unlike the interleaved fields of the particles themselves.  LocalShapeEvaluator
+ *  uses this to score all of the particles against each landmark pairing at once. */
+class LocalizationParticleArrays {
+public:
+  std::vector<float> x; //!< X position of each particle
+  std::vector<float> y; //!< Y position of each particle
+  std::vector<float> theta; //!< Orientation of each particle, in [0,2π)
+  std::vector<float> weight; //!< Weight of each particle
+
+  //! constructor
+  LocalizationParticleArrays() : x(), y(), theta(), weight() {}
+
+  //! returns the number of particles
+  size_t size() const { return x.size(); }
+
+  //! copies the poses and weights of @a particles (LocalizationParticles or a subclass)
+  template<class ParticleT> void load(const std::vector<ParticleT>& particles) {
+    const size_t n=particles.size();
+    x.resize(n);
+    y.resize(n);
+    theta.resize(n);
+    weight.resize(n);
+    for(size_t i=0; i<n; ++i) {
+      x[i]=particles[i].x;
+      y[i]=particles[i].y;
+      theta[i]=particles[i].theta;
+      weight[i]=particles[i].weight;
+    }
+  }
+
+  //! copies the weights back into @a particles, which must be the collection passed to load()
+  template<class ParticleT> void storeWeights(std::vector<ParticleT>& particles) const {
+    for(size_t i=0; i<particles.size(); ++i)
+      particles[i].weight=weight[i];
+  }
+};
+
 //! Provides parameters and methods for randomizing and tweaking LocalizationParticles
 template<typename ParticleT>
 class LocalizationParticleDistributionPolicy : public ParticleFilter<ParticleT>::DistributionPolicy {
@@ -53,7 +93,7 @@ public:
   //! constructor -- by default, coordinates will range from -1000 to 1000 for x and y, with variance of 50 and 0.18 for position and orientation
   LocalizationParticleDistributionPolicy()
     : mapMinX(-1000), mapWidth(2000), mapMinY(-1000), mapHeight(2000),
-      positionVariance(50), orientationVariance(0.18f)
+      positionVariance(50), orientationVariance(0.18f), noise()
   {}
 	
   virtual void randomize(particle_type* begin, index_t num) {
@@ -69,15 +109,40 @@ public:
   virtual void jiggle(float var, particle_type* begin, index_t num) {
     if(var==0)
       return;
-    particle_type* end=&begin[num]; 
-    while(begin!=end) {
-      begin->x+=(float)DRanNormalZig32()*positionVariance*var;
-      begin->y+=(float)DRanNormalZig32()*positionVariance*var;
-      begin->theta+=(float)DRanNormalZig32()*orientationVariance*var;
-      //(begin++)->jiggle(var);
-      ++begin;
+    // draw the noise for all of the particles at once
+    noise.resize(3*num);
+    RanVecNormalZig32(&noise[0],noise.size());
+    for(index_t i=0; i<num; ++i) {
+      begin[i].x+=noise[3*i]*positionVariance*var;
+      begin[i].y+=noise[3*i+1]*positionVariance*var;
+      begin[i].theta+=noise[3*i+2]*orientationVariance*var;
     }
   }
+
+protected:
+  std::vector<float> noise; //!< scratch space for jiggle()'s normal samples
+};
+
+//! Divides (x, y, theta) into bins for adapting the number of LocalizationParticles (see ParticleFilter::LowVarianceResamplingPolicy)
+template<typename ParticleT>
+class LocalizationParticleBinningPolicy : public ParticleFilter<ParticleT>::BinningPolicy {
+public:
+  typedef ParticleT particle_type;  //!< just for convenience
+
+  float positionBinSize; //!< the width of the bins along x and y
+  float orientationBinSize; //!< the width of the bins in theta (radians)
+
+  //! constructor -- by default, bins are 100 units (mm) on a side, and 10 degrees wide
+  explicit LocalizationParticleBinningPolicy(float positionBin=100, float orientationBin=float(M_PI/18))
+    : positionBinSize(positionBin), orientationBinSize(orientationBin) {}
+
+  virtual size_t bin(const particle_type& p) const {
+    const long bx = static_cast<long>(std::floor(p.x/positionBinSize));
+    const long by = static_cast<long>(std::floor(p.y/positionBinSize));
+    const long bt = static_cast<long>(std::floor(float(p.theta)/orientationBinSize));
+    // a collision merely merges two bins, slightly underestimating the spread
+    return static_cast<size_t>(bx)*73856093u ^ static_cast<size_t>(by)*19349663u ^ static_cast<size_t>(bt)*83492791u;
+  }
 };
 
 //! dump a particle's state
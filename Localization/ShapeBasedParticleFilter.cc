@@ -20,6 +20,13 @@ void ShapeBasedParticleFilter::resetFilter() {
   VRmixin::particleFilter->resetFilter(w);
 }
 
+void ShapeBasedParticleFilter::resample() {
+  const size_t oldSize = particles.size();
+  ParticleFilter<LocalizationParticle>::resample();
+  if ( particles.size() < oldSize )
+    deleteParticleDisplay(sensorModel->getWorldShS());
+}
+
 void ShapeBasedParticleFilter::resizeParticles(unsigned int numParticles) {
   ShapeSpace &wShS = sensorModel->getWorldShS();
   unsigned int numDisp = select_type<LocalizationParticleData>(wShS).size();
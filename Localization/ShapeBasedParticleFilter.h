@@ -96,7 +96,9 @@ namespace DualCoding {
   //================ ShapeBasedParticleFilter ================
 
   //! Bundles a motion model (DeadReckoningBehavior or CreateMotionModel) and a ShapeSensorModel for easy use of a shape-based particle filter for localization
-
+  /*! The number of particles adapts on each resampling, from a tenth to twice the @a numParticles
+   *  passed to the constructor (see ParticleFilter::LowVarianceResamplingPolicy); call
+   *  setAdaptiveParticles() to change the limits or the bins, or to fix the number of particles. */
   class ShapeBasedParticleFilter : public ParticleFilter<LocalizationParticle> {
   public:
     //! constructor, must pass local and world shape spaces, which will be used in future calls to update()
@@ -106,6 +108,10 @@ namespace DualCoding {
 	sensorModel(new ShapeSensorModel<LocalizationParticle>(camShS,localShS,worldShS))
     {
       getResamplingPolicy()->setDistributionPolicy(new ShapeParticleDistributionPolicy<LocalizationParticle>);
+#ifndef PLATFORM_APERIOS
+      setTaskPool(&TaskPool::getDefault());
+#endif
+      setAdaptiveParticles(numParticles/10, numParticles*2, new LocalizationParticleBinningPolicy<LocalizationParticle>);
       if(BehaviorBase* motBeh = dynamic_cast<BehaviorBase*>(motion))
 	motBeh->start();
     }
@@ -115,6 +121,10 @@ namespace DualCoding {
 	sensorModel(new ShapeSensorModel<LocalizationParticle>(camShS,localShS,worldShS))
     {
       getResamplingPolicy()->setDistributionPolicy(new ShapeParticleDistributionPolicy<LocalizationParticle>);
+#ifndef PLATFORM_APERIOS
+      setTaskPool(&TaskPool::getDefault());
+#endif
+      setAdaptiveParticles(numParticles/10, numParticles*2, new LocalizationParticleBinningPolicy<LocalizationParticle>);
       if(BehaviorBase* motBeh = dynamic_cast<BehaviorBase*>(motion))
 	motBeh->start();
     }
@@ -125,6 +135,10 @@ namespace DualCoding {
     {
       // std::cout<<"ShapeBasedParticleFilter using DeadReckoningBehavior\n";
       getResamplingPolicy()->setDistributionPolicy(new ShapeParticleDistributionPolicy<LocalizationParticle>);
+#ifndef PLATFORM_APERIOS
+      setTaskPool(&TaskPool::getDefault());
+#endif
+      setAdaptiveParticles(numParticles/10, numParticles*2, new LocalizationParticleBinningPolicy<LocalizationParticle>);
       if(BehaviorBase* motBeh = dynamic_cast<BehaviorBase*>(motion))
 	motBeh->start();
     }
@@ -152,12 +166,21 @@ namespace DualCoding {
     //! accessor for #sensorModel
     virtual ShapeSensorModel<LocalizationParticle>& getSensorModel() const { return *sensorModel; }
 
+    //! sets the pool used by both the resampler and #sensorModel
+    virtual void setTaskPool(TaskPool* pool) {
+      ParticleFilter<LocalizationParticle>::setTaskPool(pool);
+      sensorModel->pool=pool;
+    }
+
     //! replaces the sensor model in use, the particle filter will take responsibility for deallocating the sensor model's memory when destructed or replaced
     virtual void setSensorModel(ShapeSensorModel<LocalizationParticle>* customSensorModel) {
       delete sensorModel; 
       sensorModel=customSensorModel;
     }
 
+    //! resamples the particles, clearing the particle display if their number shrank (the displayed shapes refer to particles by index)
+    virtual void resample();
+
     using ParticleFilter<LocalizationParticle>::resetFilter;
 
     //! randomizes all the particles
@@ -31,16 +31,27 @@ namespace DualCoding {
     }
 	
   void ShapeSLAMParticleEvaluator::evaluate(ShapeSLAMParticle& part) {
+    std::vector<float> randvals(localMobile ? localLms.size() : 0);
+    if ( localMobile )
+      drawRandoms(&randvals[0]);
+    evaluate(part, workspace, randvals.empty() ? NULL : &randvals[0]);
+  }
+
+  void ShapeSLAMParticleEvaluator::evaluate(ShapeSLAMParticle& part, Workspace& ws, const float randvals[]) const {
     unsigned int const nLocals = localLms.size();
-    float particleViewX[nLocals],  particleViewY[nLocals], particleViewX2[nLocals],  particleViewY2[nLocals];
-    int localMatches[nLocals];
-    float localScores[nLocals];
+    ws.resize(nLocals);
+    float * const particleViewX = ws.particleViewX.data();
+    float * const particleViewY = ws.particleViewY.data();
+    float * const particleViewX2 = ws.particleViewX2.data();
+    float * const particleViewY2 = ws.particleViewY2.data();
+    int * const localMatches = ws.localMatches.data();
+    float * const localScores = ws.localScores.data();
     LocalShapeEvaluator::evaluateWorkhorse(part, nLocals, particleViewX, particleViewY, particleViewX2, particleViewY2,
 					   localMatches, localScores);
     for(unsigned int indexL=0; indexL < nLocals; indexL++)
       part.addLocal[indexL] = ( localMatches[indexL] == -1 && localLms[indexL]->mobile );
     if ( localMobile )
-      determineAdditions(part, nLocals, localMatches, localScores);
+      determineAdditions(part, nLocals, localMatches, localScores, randvals);
     if ( worldMobile )
       determineDeletions(part, nLocals, localMatches, particleViewX, particleViewY, particleViewX2, particleViewY2);
     updateWeight(part, localMatches, localScores);
@@ -48,11 +59,16 @@ namespace DualCoding {
     // << ": " << bestProb << endl;
   }
 
+  void ShapeSLAMParticleEvaluator::drawRandoms(float randvals[]) const {
+    for (unsigned int indexL = 0; indexL < localLms.size(); indexL++)
+      randvals[indexL] = localLms[indexL]->mobile ? float(rand()) / (float(RAND_MAX)*6) : 0;
+  }
+
   void ShapeSLAMParticleEvaluator::determineAdditions
-  (ShapeSLAMParticle& part, unsigned int const nLocals,  int localMatches[], float localScores[]) {
+  (ShapeSLAMParticle& part, unsigned int const nLocals,  int localMatches[], float localScores[], const float randvals[]) const {
     for (unsigned int indexL = 0; indexL < nLocals; indexL++) {
       if ( localLms[indexL]->mobile  ) {
-	float const randval = float(rand()) / (float(RAND_MAX)*6);
+	float const randval = randvals[indexL];
 	//**** WARNING: this code assumes we're using log weights (which is true by default)
 	if (randval >= localScores[indexL]) {
 	  part.addLocal[indexL] = true;
@@ -80,7 +96,7 @@ namespace DualCoding {
 
   void ShapeSLAMParticleEvaluator::determineDeletions
     (ShapeSLAMParticle& part, unsigned int const nLocals, int const localMatches[],
-     float const particleViewX[], float const particleViewY[], float const particleViewX2[], float const particleViewY2[]) {
+     float const particleViewX[], float const particleViewY[], float const particleViewX2[], float const particleViewY2[]) const {
     part.deleteWorld.assign(part.deleteWorld.size(),true);
     float minXLoc = HUGE_VALF;
     float minYLoc = HUGE_VALF;
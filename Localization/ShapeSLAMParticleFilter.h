@@ -43,14 +43,20 @@ namespace DualCoding {
     ShapeSLAMParticleEvaluator(ShapeSpace &localShS, ShapeSpace &worldShS, float addPenalty);
     using LocalShapeEvaluator::evaluate;
     void evaluate(ShapeSLAMParticle& part); //!< provides evaluation of SLAM-particles
+    //! evaluates @a part using @a ws for scratch space, and @a randvals (from drawRandoms()) in place of calls to rand(); safe to call from several threads at once given separate particles and workspaces
+    void evaluate(ShapeSLAMParticle& part, Workspace& ws, const float randvals[]) const;
+    //! stores the random thresholds determineAdditions() will use for one particle into @a randvals (one entry per local landmark), drawing from rand() in the same order evaluate(ShapeSLAMParticle&) would
+    void drawRandoms(float randvals[]) const;
+    //! returns true if any local landmark is mobile, in which case evaluate() needs drawRandoms()
+    bool needsRandoms() const { return localMobile; }
   protected:
     //! may mark landmarks for addition which don't appear in the world map
     void determineAdditions(ShapeSLAMParticle& part, unsigned int const nLocals,
-			    int localMatches[], float localScores[]);
+			    int localMatches[], float localScores[], const float randvals[]) const;
     //! may mark landmarks for removal which don't appear in the world map
     void determineDeletions(ShapeSLAMParticle& part, unsigned int const nLocals, int const localMatches[],
 			    float const particleViewX[], float const particleViewY[],
-			    float const particleViewX2[], float const particleViewY2[]);
+			    float const particleViewX2[], float const particleViewY2[]) const;
     bool localMobile; //!< set to true if *any* landmarks are marked as "mobile"
     bool worldMobile; //!< set to true if *any* landmarks are marked as "mobile"
     const float ADDITION_PENALTY; //!< the value passed to the constructor, limits how readily landmarks are added to the map
@@ -70,45 +76,76 @@ namespace DualCoding {
 	
     //! constructor, the standard deviation on matches defaults to 60, but you can always reassign #stdevSq directly
     ShapeSLAMSensorModel(ShapeSpace &localShS, ShapeSpace &worldShS) :
-      stdevSq(60*60), addPenalty(50), lShS(localShS), wShS(worldShS),
-      particleLocalLandmarks(0), particleWorldLandmarks(0)
+      stdevSq(60*60), addPenalty(50),
+      pool(NULL), lShS(localShS), wShS(worldShS), particleLocalLandmarks(0), particleWorldLandmarks(0), randvals()
     {}
 	
     //! controls how much weight is given to "near-misses"
     float stdevSq;
     //! controls how readily new landmarks are added to the map, vs. penalizing the particle for a bad match
     float addPenalty;
+    //! if non-NULL, evaluate() splits the particles across the threads of this pool
+    TaskPool* pool;
 	
     //! applies the ShapeSLAMParticleEvaluator across a collection of particles
+    /*! The random draws for landmark additions are made up front, in the same order as evaluating
+     *  the particles one after another would, so the result doesn't depend on #pool. */
     virtual void evaluate(particle_collection& particles, particle_type& estimate) {
-      float bestWeight=-FLT_MAX;
       ShapeSLAMParticleEvaluator eval(lShS,wShS,addPenalty);
 		
-      if(eval.localLms.size()>particleLocalLandmarks || eval.localLms.size()<particleLocalLandmarks/2)
+      if(eval.localLms.size()>particleLocalLandmarks || eval.localLms.size()<particleLocalLandmarks/2) {
+	particleLocalLandmarks=eval.localLms.size();
 	for(typename particle_collection::iterator it=particles.begin(); it!=particles.end(); ++it)
 	  it->addLocal.resize(particleLocalLandmarks);
+      }
 		
-      if(eval.worldLms.size()>particleWorldLandmarks || eval.worldLms.size()<particleWorldLandmarks/2)
+      if(eval.worldLms.size()>particleWorldLandmarks || eval.worldLms.size()<particleWorldLandmarks/2) {
+	particleWorldLandmarks=eval.worldLms.size();
 	for(typename particle_collection::iterator it=particles.begin(); it!=particles.end(); ++it)
 	  it->deleteWorld.resize(particleWorldLandmarks);
+      }
+		
+      const size_t nLocals = eval.localLms.size();
+      randvals.resize(eval.needsRandoms() ? particles.size()*nLocals : 0);
+      for(size_t i=0; i<randvals.size(); i+=nLocals)
+	eval.drawRandoms(&randvals[i]);
 		
-      for(typename particle_collection::size_type p=0; p<particles.size(); ++p) {
-	eval.evaluate(particles[p]);
-	if(particles[p].weight>bestWeight) {
-	  bestWeight=particles[p].weight;
-	}
+      EvaluateRange f(eval,particles,randvals,nLocals);
+#ifndef PLATFORM_APERIOS
+      if(pool!=NULL) {
+	pool->parallel_for_range(0,particles.size(),f,64);
+	return;
       }
+#endif
+      f(0,particles.size());
     }
 	
   ShapeSpace& getLocalShS() const { return lShS; }
   ShapeSpace& getWorldShS() const { return wShS; }
 
   protected:
+    //! evaluates a range of the particles, for TaskPool::parallel_for_range()
+    struct EvaluateRange {
+      //! constructor
+      EvaluateRange(const ShapeSLAMParticleEvaluator& e, particle_collection& p, const std::vector<float>& r, size_t n)
+	: eval(e), particles(p), randvals(r), nLocals(n) {}
+      void operator()(size_t begin, size_t end) const {
+	LocalShapeEvaluator::Workspace ws; // each range gets its own
+	for(size_t p=begin; p<end; ++p)
+	  eval.evaluate(particles[p], ws, randvals.empty() ? NULL : &randvals[p*nLocals]);
+      }
+      const ShapeSLAMParticleEvaluator& eval; //!< the evaluator
+      particle_collection& particles; //!< the particles being evaluated
+      const std::vector<float>& randvals; //!< nLocals random draws per particle, or empty if not needed
+      size_t nLocals; //!< the number of local landmarks
+    };
+
     ShapeSpace &lShS;			//!< Local shape space
     ShapeSpace &wShS;			//!< World shape space
 
     unsigned int particleLocalLandmarks; //!< number of entries in particles' individual addLocal (so we know if we need to resize it in all particles)
     unsigned int particleWorldLandmarks; //!<  number of entries in particles' individual deleteWorld (so we know if we need to resize it in all particles)
+    std::vector<float> randvals; //!< scratch space for the random draws of evaluate(), reused between calls
 
     //! computes a (non-normalized) gaussian distribution
     /*! normalization doesn't matter because it's constant across particles, and so
@@ -127,6 +164,9 @@ namespace DualCoding {
       : ParticleFilter<ShapeSLAMParticle>(numParticles, new DeadReckoningBehavior<ShapeSLAMParticle>),
 	sensorModel(new ShapeSLAMSensorModel<ShapeSLAMParticle>(localShS,worldShS))
     {
+#ifndef PLATFORM_APERIOS
+      setTaskPool(&TaskPool::getDefault());
+#endif
       if(BehaviorBase* motBeh = dynamic_cast<BehaviorBase*>(motion))
 	motBeh->start();
     }
@@ -146,6 +186,12 @@ namespace DualCoding {
     //! accessor for #sensorModel
     virtual ShapeSLAMSensorModel<ShapeSLAMParticle>& getSensorModel() const { return *sensorModel; }
 
+    //! sets the pool used by both the resampler and #sensorModel
+    virtual void setTaskPool(TaskPool* pool) {
+      ParticleFilter<ShapeSLAMParticle>::setTaskPool(pool);
+      sensorModel->pool=pool;
+    }
+
     //! replaces the sensor model in use, the particle filter will take responsibility for deallocating the sensor model's memory when destructed or replaced
     virtual void setSensorModel(ShapeSLAMSensorModel<ShapeSLAMParticle>* customSensorModel) { delete sensorModel; sensorModel=customSensorModel; }
 
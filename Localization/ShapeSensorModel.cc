@@ -4,7 +4,9 @@
 #include "Shared/Config.h"  // for config variable
 #include "DualCoding/VRmixin.h"
 #include "ShapeLandmarks.h"
+#include "IPC/TaskPool.h"
 
+#include <algorithm>
 #include <cmath>
 #include <iostream>
 
@@ -13,8 +15,8 @@ using namespace DualCoding;
 float const LocalShapeEvaluator::maxDist = 1e10;
 float const LocalShapeEvaluator::stdevSq = 150*150; // was 60*60;
 
-LocalShapeEvaluator::LocalShapeEvaluator(ShapeSpace &localShS, ShapeSpace &worldShS) : 
-  localLms(), worldLms() {
+LocalShapeEvaluator::LocalShapeEvaluator(ShapeSpace &localShS, ShapeSpace &worldShS, float radius) : 
+  localLms(), worldLms(), matchRadius(radius), candidates(), grids(), missWeights(), batchScratch(), workspace() {
   PfRoot::loadLms(localShS.allShapes(), false, localLms);
   PfRoot::loadLms(worldShS.allShapes(), true, worldLms);
   std::cout << "LocalShapeEvaluator: " << worldShS.allShapes().size() << " world shapes. "
@@ -26,26 +28,333 @@ LocalShapeEvaluator::LocalShapeEvaluator(ShapeSpace &localShS, ShapeSpace &world
     std::cout << "ParticleFilter::loadLms found " << localLms.size() << " local and "
 	      << worldLms.size() << " world landmarks: can't localize!" << std::endl;
   }
+  indexWorld();
+}
+
+void LocalShapeEvaluator::indexWorld() {
+  candidates.assign(localLms.size(), std::vector<unsigned int>());
+  grids.assign(localLms.size(), LandmarkGrid());
+  missWeights.assign(localLms.size(), 0);
+  for ( unsigned int indexL=0; indexL < localLms.size(); indexL++ ) {
+    PfRoot &landmark = *(localLms[indexL]);
+    switch ( landmark.type ) {
+    case lineDataType:
+    case ellipseDataType:
+    case blobDataType:
+    case cylinderDataType:
+    case naughtDataType:
+    case crossDataType:
+    case markerDataType:
+    case aprilTagDataType:
+      break;
+    case pointDataType:
+      // don't try to match points; they're just placeholders, not landmarks
+      continue;
+    default:
+      std::cout << "ParticleFilter::computeMatchScore() can't match landmark type "
+                << landmark.type << std::endl;
+      continue;
+    }
+    for ( unsigned int indexW=0; indexW<worldLms.size(); indexW++ ) {
+      if ( landmark.type != worldLms[indexW]->type || landmark.color != worldLms[indexW]->color )
+        continue;
+      // check for marker and tag "equality"
+      if ( landmark.type == markerDataType &&
+           !static_cast<PfMarker&>(landmark).data->isMatchingMarker(static_cast<PfMarker*>(worldLms[indexW])->data) )
+        continue;
+      if ( landmark.type == aprilTagDataType &&
+           static_cast<PfAprilTag&>(landmark).data->getTagID() != static_cast<PfAprilTag*>(worldLms[indexW])->data->getTagID() )
+        continue;
+      candidates[indexL].push_back(indexW);
+    }
+    if ( matchRadius > 0 && !candidates[indexL].empty() ) {
+      missWeights[indexL] = -matchRadius*matchRadius/stdevSq;
+      if ( candidates[indexL].size() >= GRID_MIN_CANDIDATES )
+        grids[indexL].build(worldLms, candidates[indexL], matchRadius);
+    }
+  }
+}
+
+void LocalShapeEvaluator::findNearby(unsigned int indexL, float x, float y, float x2, float y2, std::vector<unsigned int>& found) const {
+  found.clear();
+  grids[indexL].query(x, y, matchRadius, found);
+  if ( localLms[indexL]->type == lineDataType ) {
+    grids[indexL].query(x2, y2, matchRadius, found);
+    std::sort(found.begin(), found.end());
+    found.erase(std::unique(found.begin(), found.end()), found.end());
+  } else {
+    std::sort(found.begin(), found.end()); // points are only in one cell, so no duplicates
+  }
+}
+
+//! returns the squared distance of the end of a local line at (@a lx,@a ly) from the matching end (@a wx,@a wy) of @a worldLine
+/*! If endpoints are valid, compare distance between endpoints.
+ *  If not valid, measure perpendicular distance from the local endpoint
+ *  to the world line segment, if the projection of the endpoint onto the
+ *  segment occurs within the segment, not beyond it.  Instead of calculating
+ *  the projection we use a heuristic test: either the x or y endpoint value must
+ *  lie within the range of the line segment. */
+static inline float lineEndDistsq(bool bothValid, PfLine &worldLine, float lx, float ly, float wx, float wy) {
+  if ( bothValid ||
+       !( (lx >= std::min(worldLine.x,worldLine.x2) && lx <= std::max(worldLine.x,worldLine.x2)) ||
+          (ly >= std::min(worldLine.y,worldLine.y2) && ly <= std::max(worldLine.y,worldLine.y2)) ) )
+    return (lx-wx)*(lx-wx) + (ly-wy)*(ly-wy);
+  float const dist = LocalShapeEvaluator::distanceFromLine(lx,ly,worldLine);
+  return dist * dist;
+}
+
+//! returns the squared orientation error of @a localLine, seen from heading @a theta, against @a worldLine
+static inline float lineOrientDistsq(const PfLine &localLine, const PfLine &worldLine, AngTwoPi theta) {
+  AngPi const localOrient = localLine.orientation + theta;
+  AngPi odiff = worldLine.orientation - localOrient;
+  odiff = std::min<float>(odiff, M_PI - odiff);
+  float const odist = 500 * std::sin(odiff);
+  return odist * odist;
+}
+
+//! returns the match score of a local landmark at bearing @a ltheta and range @a ldist against a world landmark at (@a wx,@a wy), seen from the pose (@a px,@a py,@a theta)
+/*! *** EXPERIMENTAL *** used for ellipses, blobs, cylinders, naughts, and crosses */
+static inline float rangeBearingDistsq(AngTwoPi ltheta, float ldist, float wx, float wy, float px, float py, AngTwoPi theta) {
+  AngTwoPi ptheta = atan2(wy-py,wx-px) - theta;
+  float pdist = sqrt((wx-px)*(wx-px) + (wy-py)*(wy-py));
+  float thetadiff = angdist(ptheta,ltheta);
+  return (pdist-ldist)*(pdist-ldist) + 5000*thetadiff; // *pdist*pdist;
+}
+
+//! records @a distsq and @a indexW as the best match if @a distsq is less than @a best (written as selects, so loops over particles vectorize)
+static inline void keepCloser(float distsq, int indexW, float &best, int &match) {
+  bool const closer = distsq < best;
+  best = closer ? distsq : best;
+  match = closer ? indexW : match;
+}
+
+//! returns true if (@a x,@a y) is within the square root of @a radiusSq of @a world, or for lines, of its bounding box
+static inline bool withinRadius(const PfRoot &world, float x, float y, float radiusSq) {
+  float x0 = world.x, x1 = world.x, y0 = world.y, y1 = world.y;
+  if ( world.type == lineDataType ) {
+    const PfLine &line = static_cast<const PfLine&>(world);
+    x0 = std::min<float>(line.x, line.x2);
+    x1 = std::max<float>(line.x, line.x2);
+    y0 = std::min<float>(line.y, line.y2);
+    y1 = std::max<float>(line.y, line.y2);
+  }
+  float const dx = std::max(std::max(x0-x, x-x1), 0.f);
+  float const dy = std::max(std::max(y0-y, y-y1), 0.f);
+  return dx*dx + dy*dy <= radiusSq;
+}
+
+//! returns true if a local landmark placed at (@a lx,@a ly) (ending at (@a lx2,@a ly2) for lines) is close enough to @a world to match it
+static inline bool inMatchRange(const PfRoot &world, float lx, float ly, float lx2, float ly2, float radiusSq) {
+  return withinRadius(world, lx, ly, radiusSq) || ( world.type == lineDataType && withinRadius(world, lx2, ly2, radiusSq) );
+}
+
+//! returns the match score of @a local against @a world, where the particle at (@a px,@a py,@a theta) places @a local at (@a lx,@a ly) (ending at (@a lx2,@a ly2) for lines)
+static float pairDistsq(PfRoot &local, PfRoot &world, float lx, float ly, float lx2, float ly2, float px, float py, AngTwoPi theta) {
+  switch ( local.type ) {
+  case lineDataType: {
+    PfLine &localLine = static_cast<PfLine&>(local);
+    PfLine &worldLine = static_cast<PfLine&>(world);
+    float const tempDistsq1 = lineEndDistsq(localLine.valid1 && worldLine.valid1, worldLine, lx, ly, worldLine.x, worldLine.y);
+    float const tempDistsq2 = lineEndDistsq(localLine.valid2 && worldLine.valid2, worldLine, lx2, ly2, worldLine.x2, worldLine.y2);
+    return tempDistsq1 + tempDistsq2 + lineOrientDistsq(localLine, worldLine, theta); // plus orientation match term?
+  }
+  case ellipseDataType:
+  case blobDataType:
+  case cylinderDataType:
+  case naughtDataType:
+  case crossDataType: {
+    AngTwoPi ltheta = atan2(local.y,local.x);
+    float ldist = sqrt(local.x * local.x + local.y * local.y);
+    return rangeBearingDistsq(ltheta, ldist, world.x, world.y, px, py, theta);
+  }
+  case markerDataType:
+  case aprilTagDataType:
+    return (lx-world.x)*(lx-world.x) + (ly-world.y)*(ly-world.y);
+  default:
+    return LocalShapeEvaluator::maxDist;
+  }
+}
+
+void LocalShapeEvaluator::Workspace::resize(size_t nLocals) {
+  particleViewX.resize(nLocals);
+  particleViewY.resize(nLocals);
+  particleViewX2.resize(nLocals);
+  particleViewY2.resize(nLocals);
+  localMatches.resize(nLocals);
+  localScores.resize(nLocals);
+}
+
+void LocalShapeEvaluator::BatchScratch::resize(size_t n) {
+  cosTheta.resize(n);
+  sinTheta.resize(n);
+  viewX.resize(n);
+  viewY.resize(n);
+  viewX2.resize(n);
+  viewY2.resize(n);
+  bestDistsq.resize(n);
+  bestMatch.resize(n);
 }
 
 void LocalShapeEvaluator::evaluate(LocalizationParticle& p) {
   unsigned int const nLocals = localLms.size();
-  float particleViewX[nLocals],  particleViewY[nLocals], particleViewX2[nLocals],  particleViewY2[nLocals];
-  int localMatches[nLocals];
-  float localScores[nLocals];
-  evaluateWorkhorse(p, nLocals, particleViewX, particleViewY, particleViewX2, particleViewY2,
-		    localMatches, localScores);
+  if ( nLocals == 0 )
+    return;
+  workspace.resize(nLocals);
+  evaluateWorkhorse(p, nLocals, &workspace.particleViewX[0], &workspace.particleViewY[0],
+		    &workspace.particleViewX2[0], &workspace.particleViewY2[0],
+		    &workspace.localMatches[0], &workspace.localScores[0]);
   //  for (unsigned int i=0; i<nLocals; i++)
-  //    std::cout <<"  lm " << i << ":   " << localMatches[i] <<  " score " << localScores[i] << std::endl;
+  //    std::cout <<"  lm " << i << ":   " << workspace.localMatches[i] <<  " score " << workspace.localScores[i] << std::endl;
   //  std::cout << "    oldweight " << p.weight;
-  updateWeight(p, localMatches, localScores);
+  updateWeight(p, &workspace.localMatches[0], &workspace.localScores[0]);
   //  std::cout << "    newweight " << p.weight << std::endl;
 }
 
+struct LocalShapeEvaluator::EvaluateChunk {
+  //! constructor
+  EvaluateChunk(const LocalShapeEvaluator& e, LocalizationParticleArrays& p) : eval(e), particles(p) {}
+  void operator()(size_t begin, size_t end) const {
+    BatchScratch scratch; // each chunk gets its own
+    eval.evaluate(particles, begin, end, scratch);
+  }
+  const LocalShapeEvaluator& eval; //!< the evaluator
+  LocalizationParticleArrays& particles; //!< the particles being evaluated, each chunk writes only its own weights
+};
+
+void LocalShapeEvaluator::evaluate(LocalizationParticleArrays& particles, TaskPool* pool) {
+#ifndef PLATFORM_APERIOS
+  if ( pool != NULL ) {
+    // chunks of a few hundred particles keep the landmark loops worthwhile
+    pool->parallel_for_range(0, particles.size(), EvaluateChunk(*this, particles), 256);
+    return;
+  }
+#endif
+  evaluate(particles, 0, particles.size(), batchScratch);
+}
+
+void LocalShapeEvaluator::evaluate(LocalizationParticleArrays& particles, size_t begin, size_t end, BatchScratch& scratch) const {
+  if ( begin >= end )
+    return;
+  size_t const n = end - begin;
+  float const * const px = &particles.x[begin];
+  float const * const py = &particles.y[begin];
+  float const * const pt = &particles.theta[begin];
+  float * const pw = &particles.weight[begin];
+  scratch.resize(n);
+  float * const cosTheta = &scratch.cosTheta[0];
+  float * const sinTheta = &scratch.sinTheta[0];
+  float * const viewX = &scratch.viewX[0];
+  float * const viewY = &scratch.viewY[0];
+  float * const viewX2 = &scratch.viewX2[0];
+  float * const viewY2 = &scratch.viewY2[0];
+  float * const bestDistsq = &scratch.bestDistsq[0];
+  int * const bestMatch = &scratch.bestMatch[0];
+  for ( size_t i=0; i<n; i++ ) {
+    cosTheta[i] = std::cos(-pt[i]);
+    sinTheta[i] = std::sin(-pt[i]);
+  }
+
+  bool const gated = matchRadius > 0;
+  float const radiusSq = matchRadius * matchRadius;
+  for ( unsigned int indexL=0; indexL < localLms.size(); indexL++ ) {
+    const std::vector<unsigned int> &cands = candidates[indexL];
+    if ( cands.empty() )
+      continue;
+    PfRoot &landmark = *(localLms[indexL]);
+    // position of the local landmark in the world according to each particle
+    for ( size_t i=0; i<n; i++ ) {
+      viewX[i] = landmark.x * cosTheta[i] + landmark.y * sinTheta[i] + px[i];
+      viewY[i] = landmark.x * -sinTheta[i] + landmark.y * cosTheta[i] + py[i];
+    }
+    if ( landmark.type == lineDataType ) {
+      const PfLine &line = static_cast<PfLine&>(landmark);
+      for ( size_t i=0; i<n; i++ ) {
+        viewX2[i] = line.x2 * cosTheta[i] + line.y2 * sinTheta[i] + px[i];
+        viewY2[i] = line.x2 * -sinTheta[i] + line.y2 * cosTheta[i] + py[i];
+      }
+    }
+    std::fill(bestDistsq, bestDistsq+n, maxDist);
+    std::fill(bestMatch, bestMatch+n, -1);
+
+    if ( !grids[indexL].empty() ) {
+      // too many candidates to score them all: each particle only looks near where it puts the landmark
+      std::vector<unsigned int> &nearby = scratch.nearby;
+      for ( size_t i=0; i<n; i++ ) {
+        findNearby(indexL, viewX[i], viewY[i], viewX2[i], viewY2[i], nearby);
+        for ( size_t j=0; j<nearby.size(); j++ ) {
+          PfRoot &world = *(worldLms[nearby[j]]);
+          if ( inMatchRange(world, viewX[i], viewY[i], viewX2[i], viewY2[i], radiusSq) )
+            keepCloser(pairDistsq(landmark, world, viewX[i], viewY[i], viewX2[i], viewY2[i], px[i], py[i], AngTwoPi(pt[i])),
+                       nearby[j], bestDistsq[i], bestMatch[i]);
+        }
+      }
+    } else {
+      // bearing and range of the local landmark, for the experimental score of round shapes
+      AngTwoPi const ltheta = atan2(landmark.y,landmark.x);
+      float const ldist = sqrt(landmark.x * landmark.x + landmark.y * landmark.y);
+
+      for ( size_t c=0; c<cands.size(); c++ ) {
+        unsigned int const indexW = cands[c];
+        PfRoot &world = *(worldLms[indexW]);
+        float const wx = world.x;
+        float const wy = world.y;
+        switch ( landmark.type ) {
+        case lineDataType: {
+          PfLine &localLine = static_cast<PfLine&>(landmark);
+          PfLine &worldLine = static_cast<PfLine&>(world);
+          bool const valid1 = localLine.valid1 && worldLine.valid1;
+          bool const valid2 = localLine.valid2 && worldLine.valid2;
+          for ( size_t i=0; i<n; i++ ) {
+            float const tempDistsq1 = lineEndDistsq(valid1, worldLine, viewX[i], viewY[i], wx, wy);
+            float const tempDistsq2 = lineEndDistsq(valid2, worldLine, viewX2[i], viewY2[i], worldLine.x2, worldLine.y2);
+            float const distsq = tempDistsq1 + tempDistsq2 + lineOrientDistsq(localLine, worldLine, AngTwoPi(pt[i]));
+            bool const out = gated && !inMatchRange(world, viewX[i], viewY[i], viewX2[i], viewY2[i], radiusSq);
+            keepCloser(out ? maxDist : distsq, indexW, bestDistsq[i], bestMatch[i]);
+          }
+          break;
+        }
+        case ellipseDataType:
+        case blobDataType:
+        case cylinderDataType:
+        case naughtDataType:
+        case crossDataType:
+          for ( size_t i=0; i<n; i++ ) {
+            float const distsq = rangeBearingDistsq(ltheta, ldist, wx, wy, px[i], py[i], AngTwoPi(pt[i]));
+            bool const out = gated && !withinRadius(world, viewX[i], viewY[i], radiusSq);
+            keepCloser(out ? maxDist : distsq, indexW, bestDistsq[i], bestMatch[i]);
+          }
+          break;
+        case markerDataType:
+        case aprilTagDataType:
+          // candidates are already the markers and tags with the same identity
+          for ( size_t i=0; i<n; i++ ) {
+            float const distsq = (viewX[i]-wx)*(viewX[i]-wx) + (viewY[i]-wy)*(viewY[i]-wy);
+            keepCloser(gated && distsq > radiusSq ? maxDist : distsq, indexW, bestDistsq[i], bestMatch[i]);
+          }
+          break;
+        default:
+          // indexWorld() doesn't give candidates to other types
+          break;
+        }
+      }
+    }
+
+    // same as updateWeight(), one landmark at a time
+    float const missWeight = missWeights[indexL];
+    if ( gated ) {
+      for ( size_t i=0; i<n; i++ )
+        pw[i] += (bestMatch[i] != -1) ? std::max(-bestDistsq[i]/stdevSq, missWeight) : missWeight;
+    } else {
+      for ( size_t i=0; i<n; i++ )
+        pw[i] += (bestMatch[i] != -1) ? -bestDistsq[i]/stdevSq : missWeight;
+    }
+  }
+}
+
 void LocalShapeEvaluator::evaluateWorkhorse
 (LocalizationParticle& p, const unsigned int nLocals,
  float particleViewX[], float particleViewY[], float particleViewX2[], float particleViewY2[],
- int localMatches[], float localScores[]) {
+ int localMatches[], float localScores[]) const {
   // determine position of local space landmark in world given the current particle
   float const cosT = std::cos(-p.theta);
   float const sinT = std::sin(-p.theta);
@@ -62,125 +371,30 @@ void LocalShapeEvaluator::evaluateWorkhorse
     }
   }
   // Now compute match scores for the particle by finding matches between local landmarks and world landmarks.
+  float const radiusSq = matchRadius * matchRadius;
+  std::vector<unsigned int> nearby;
   for ( unsigned int indexL = 0; indexL < nLocals; indexL++ ) {
     float distsq = maxDist; // distance > this is treated as a non-match; value should be < 1e10 to avoid underflows when not using log weights
     localMatches[indexL] = -1;  // assume no match unless we find something
-    for ( unsigned int indexW=0; indexW<worldLms.size(); indexW++ ) {
-      if ( localLms[indexL]->type == worldLms[indexW]->type &&
-					 localLms[indexL]->color == worldLms[indexW]->color ) {
-				float const lx = particleViewX[indexL];
-				float const ly = particleViewY[indexL];
-				float const wx = worldLms[indexW]->x;
-				float const wy = worldLms[indexW]->y;
-				float tempDistsq;
-
-				// dispatch on landmark type because lines and markers require special match handling
-				switch ( localLms[indexL]->type ) {
-				case lineDataType: {
-					PfLine &localLine = *static_cast<PfLine*>(localLms[indexL]);
-					PfLine &worldLine = *static_cast<PfLine*>(worldLms[indexW]);
-					float tempDistsq1, tempDistsq2;
-					// If endpoints are valid, compare distance between endpoints.
-					// If not valid, measure perpendicular distance from the local endpoint
-					// to the world line segment, if the projection of the endpoint onto the
-					// segment occurs within the segment, not beyond it.  Instead of calculating
-					// the projection we use a heuristic test: either the x or y endpoint value must
-					// lie within the range of the line segment.
-					if ( (localLine.valid1 && worldLine.valid1) ||
-							 !( (lx >= std::min(worldLine.x,worldLine.x2) && lx <= std::max(worldLine.x,worldLine.x2)) ||
-									(ly >= std::min(worldLine.y,worldLine.y2) && ly <= std::max(worldLine.y,worldLine.y2)) ) ) {
-						tempDistsq1 = (lx-wx)*(lx-wx) + (ly-wy)*(ly-wy);
-					} else {
-						float const tempDist1 = distanceFromLine(lx,ly,worldLine);
-						tempDistsq1 = tempDist1 * tempDist1;
-					}
-					float const lx2 = particleViewX2[indexL];
-					float const ly2 = particleViewY2[indexL];
-					float const wx2 = worldLine.x2;
-					float const wy2 = worldLine.y2;
-					if ( (localLine.valid2 && worldLine.valid2) ||
-							 !( (lx2 >= std::min(worldLine.x,worldLine.x2) && lx2 <= std::max(worldLine.x,worldLine.x2)) ||
-									(ly2 >= std::min(worldLine.y,worldLine.y2) && ly2 <= std::max(worldLine.y,worldLine.y2)) ) )
-						tempDistsq2 = (lx2-wx2)*(lx2-wx2) + (ly2-wy2)*(ly2-wy2);
-					else {
-						float const tempDist2 = distanceFromLine(lx2,ly2,worldLine);
-						tempDistsq2 = tempDist2 * tempDist2;
-					}
-					AngPi const localOrient = localLine.orientation + p.theta;
-					AngPi odiff = worldLine.orientation - localOrient;
-					odiff = std::min<float>(odiff, M_PI - odiff);
-					float const odist = 500 * std::sin(odiff);
-					float const odistsq = odist * odist;
-					tempDistsq = tempDistsq1 + tempDistsq2 + odistsq; // plus orientation match term?
-					if ( false && tempDistsq1 <= 10000 && tempDistsq2 <= 10000 ) {
-						std::cout << "line " << lx << "," << ly << " : " << wx << "," << wy
-											<< " end1valid=" << localLine.valid1 << ":" << worldLine.valid1
-											<< " tempDistsq1=" << tempDistsq1
-											<< " indexL:W=" << indexL << ":" << indexW << std::endl;
-						std::cout << "     " << lx2 << "," << ly2 << " : " << wx2 << "," << wy2
-											<< " end2valid=" << localLine.valid2 << ":" << worldLine.valid2
-											<< " tempDistsq2=" << tempDistsq2
-											<< " odistsq = " << odistsq << " total=" << tempDistsq << std::endl;
-					}
-				}
-					break;
-				case ellipseDataType:
-				case blobDataType:
-				case cylinderDataType:
-        case naughtDataType:
-        case crossDataType:
-          {
-					tempDistsq = (lx-wx)*(lx-wx) + (ly-wy)*(ly-wy);
-					// *** EXPERIMENTAL ***
-					PfRoot &landmark = *(localLms[indexL]);
-					AngTwoPi ltheta = atan2(landmark.y,landmark.x);
-					float ldist = sqrt(landmark.x * landmark.x + landmark.y * landmark.y);
-					AngTwoPi ptheta = atan2(wy-p.y,wx-p.x) - p.theta;
-					float pdist = sqrt((wx-p.x)*(wx-p.x) + (wy-p.y)*(wy-p.y));
-					float thetadiff = angdist(ptheta,ltheta);
-					tempDistsq = (pdist-ldist)*(pdist-ldist) + 5000*thetadiff; // *pdist*pdist;
-					if ( false && tempDistsq < 50000 )
-						std::cout << "dists " << ldist << " " << pdist << "   thetas " << ltheta << " " << ptheta
-											<< "  thetadiff=" << thetadiff << "   tempDistsq=" << tempDistsq << std::endl;
-					break;
-				}
-				case markerDataType: {
-					PfMarker &localMarker = *static_cast<PfMarker*>(localLms[indexL]);
-					PfMarker &worldMarker = *static_cast<PfMarker*>(worldLms[indexW]);
-
-					// check for marker "equality"
-					if (localMarker.data->isMatchingMarker(worldMarker.data))
-						tempDistsq = (lx-wx)*(lx-wx) + (ly-wy)*(ly-wy);
-					else
-						continue;
-					break;
-				}
-				case aprilTagDataType: {
-					PfAprilTag &localTag = *static_cast<PfAprilTag*>(localLms[indexL]);
-					PfAprilTag &worldTag = *static_cast<PfAprilTag*>(worldLms[indexW]);
-
-					// check for tag "equality"
-					if ( localTag.data->getTagID() == worldTag.data->getTagID() )
-						tempDistsq = (lx-wx)*(lx-wx) + (ly-wy)*(ly-wy);
-					else
-						continue;
-					break;
-				}
-				case pointDataType:
-					// don't try to match points; they're just placeholders, not landmarks
-					tempDistsq = maxDist;
-					break;
-				default:
-					std::cout << "ParticleFilter::computeMatchScore() can't match landmark type "
-										<< localLms[indexL]->type << std::endl;
-					return;
-				}
-
-				// if this world landmark is a closer match, accept it
-				if ( tempDistsq < distsq ) {
-					distsq = tempDistsq;
-					localMatches[indexL] = indexW;
-				}
+    float const lx = particleViewX[indexL];
+    float const ly = particleViewY[indexL];
+    float const lx2 = particleViewX2[indexL];
+    float const ly2 = particleViewY2[indexL];
+    // candidates[] only holds world landmarks of the same type and color (and identity, for markers and tags)
+    const std::vector<unsigned int> *cands = &candidates[indexL];
+    if ( !grids[indexL].empty() ) {
+      findNearby(indexL, lx, ly, lx2, ly2, nearby);
+      cands = &nearby;
+    }
+    for ( size_t c=0; c<cands->size(); c++ ) {
+      unsigned int const indexW = (*cands)[c];
+      if ( matchRadius > 0 && !inMatchRange(*worldLms[indexW], lx, ly, lx2, ly2, radiusSq) )
+        continue;
+      float const tempDistsq = pairDistsq(*localLms[indexL], *worldLms[indexW], lx, ly, lx2, ly2, p.x, p.y, p.theta);
+      // if this world landmark is a closer match, accept it
+      if ( tempDistsq < distsq ) {
+        distsq = tempDistsq;
+        localMatches[indexL] = indexW;
       }
     }
 
@@ -190,10 +404,15 @@ void LocalShapeEvaluator::evaluateWorkhorse
 }
 
 void LocalShapeEvaluator::updateWeight(LocalizationParticle &p, 
-																			 int const localMatches[], float const localScores[]) {
-  for (unsigned int i=0; i < localLms.size(); i++)
-    if ( localMatches[i] != -1 )
-      p.weight += -localScores[i]/stdevSq;
+																			 int const localMatches[], float const localScores[]) const {
+  // with a match radius, a match never scores worse than missing (see class notes)
+  bool const gated = matchRadius > 0;
+  for (unsigned int i=0; i < localLms.size(); i++) {
+    if ( localMatches[i] == -1 )
+      p.weight += missWeights[i];
+    else
+      p.weight += gated ? std::max(-localScores[i]/stdevSq, missWeights[i]) : -localScores[i]/stdevSq;
+  }
 }
 
 float LocalShapeEvaluator::distanceFromLine(coordinate_t x0, coordinate_t y0, PfLine &wline) {
@@ -2,9 +2,11 @@
 #define _ShapeSensorModel_h_
 
 #include "LocalizationParticle.h"
+#include "LandmarkGrid.h"
 
 class PfRoot;
 class PfLine;
+class TaskPool;
 
 namespace DualCoding {
 	class ShapeSpace;
@@ -17,26 +19,77 @@ namespace DualCoding {
 /*! The reason for separating LocalShapeEvaluator and ShapeSensorModel?  Partly so the
  *  fairly lengthy evaluation code can go in the .cc file to avoid repeated recompilation, but also to
  *  allow inheritance (e.g. ShapeSLAMParticleEvaluator) as a clean way to extend the 
- *  evaluation code for particle sub-types. */
+ *  evaluation code for particle sub-types.
+ *
+ *  The constructor works out which world landmarks could match each local landmark at all (same
+ *  type and color, and the same identity for markers and AprilTags), so evaluation never looks at
+ *  the rest of the world map.  If #matchRadius is positive, a world landmark is also only
+ *  considered if it lies within #matchRadius of where the particle places the local landmark (for
+ *  lines, if either end of the local line comes that close to the world line's bounding box).  A
+ *  local landmark with candidates in the map but none within range counts as a match at
+ *  #matchRadius, so particles don't gain by placing landmarks far from any match; nor does a match
+ *  in range ever score worse than that (the score of a line also counts its ends and orientation,
+ *  so it can exceed #matchRadius squared).  Local landmarks
+ *  with many candidates get a LandmarkGrid, so each particle only looks up the ones nearby, and
+ *  evaluation time doesn't grow with the size of the world map. */
 class LocalShapeEvaluator {
 public:
   //! constructor, pass the local and world shape spaces, these will be used to initialize the appropriate particle-independent fields of the class
-  LocalShapeEvaluator(DualCoding::ShapeSpace &localShS, DualCoding::ShapeSpace &worldShS);
+  /*! If @a matchRadius is positive, world landmarks farther than that from where a particle places
+   *  a local landmark aren't considered as its match (see class notes). */
+  LocalShapeEvaluator(DualCoding::ShapeSpace &localShS, DualCoding::ShapeSpace &worldShS, float matchRadius=0);
   virtual ~LocalShapeEvaluator() {} //!< destructor
 		
   //! the heart of the class, call with a particle, will adjust the weight
   void evaluate(LocalizationParticle& part);
 
+  //! scratch space for evaluating a range of a LocalizationParticleArrays, one entry per particle; each thread needs its own
+  struct BatchScratch {
+    //! constructor
+    BatchScratch() : cosTheta(), sinTheta(), viewX(), viewY(), viewX2(), viewY2(), bestDistsq(), bestMatch(), nearby() {}
+    //! sizes each of the arrays for @a n particles
+    void resize(size_t n);
+    std::vector<float> cosTheta, sinTheta; //!< cosine and sine of the negated heading of each particle
+    std::vector<float> viewX, viewY, viewX2, viewY2; //!< world position of the current local landmark (and the other end of a line) according to each particle
+    std::vector<float> bestDistsq; //!< the score of each particle's best match so far
+    std::vector<int> bestMatch; //!< the best match so far of each particle, -1 if none
+    std::vector<unsigned int> nearby; //!< the candidates near a particle's view of the current local landmark
+  };
+
+  //! adjusts the weight of every particle, as evaluate() would one at a time
+  /*! Loops over the pairings of landmarks outside and the particles inside, so the landmark
+   *  transforms and distances are computed over contiguous arrays, and the per-pairing tests
+   *  (type, color, marker identity) are only done once for all of the particles.
+   *
+   *  If @a pool is non-NULL, the particles are split into chunks which are evaluated in parallel.
+   *  Each particle's evaluation doesn't depend on the others, so the results are the same. */
+  void evaluate(LocalizationParticleArrays& particles, TaskPool* pool=NULL);
+
+  //! evaluates particles [@a begin,@a end) of @a particles as evaluate() does; safe to call from several threads at once given separate @a scratch and ranges
+  void evaluate(LocalizationParticleArrays& particles, size_t begin, size_t end, BatchScratch& scratch) const;
+
+  //! scratch space for evaluateWorkhorse(), one entry per local landmark; each thread needs its own
+  struct Workspace {
+    //! constructor
+    Workspace() : particleViewX(), particleViewY(), particleViewX2(), particleViewY2(), localMatches(), localScores() {}
+    //! sizes each of the arrays for @a nLocals landmarks
+    void resize(size_t nLocals);
+    std::vector<float> particleViewX, particleViewY, particleViewX2, particleViewY2; //!< world position of each local landmark (and the other end of lines) according to the particle
+    std::vector<int> localMatches; //!< index of the world landmark matching each local landmark, -1 if none
+    std::vector<float> localScores; //!< score of each local landmark's match
+  };
+
   //! the real work is done here; shared with SLAM version
   void evaluateWorkhorse (LocalizationParticle& p, const unsigned int nLocals,
 			  float particleViewX[], float particleViewY[], float particleViewX2[], float ParticleViewY2[],
-			  int localMatches[], float localScores[]);
+			  int localMatches[], float localScores[]) const;
 
   //! update the particle weight after computing local match scores (and possibly additions/deletions if SLAM)
-  void updateWeight(LocalizationParticle &p, int const localMatches[], float const localScores[]);
+  void updateWeight(LocalizationParticle &p, int const localMatches[], float const localScores[]) const;
 		
   std::vector<PfRoot*> localLms; //!< a vector of the landmarks in the local space
   std::vector<PfRoot*> worldLms; //!< a vector of landmarks in the world space
+  const float matchRadius; //!< if positive, world landmarks farther than this from where a particle places a local landmark can't match it (see class notes)
 		
   static float const maxDist;  //!< maximum distance for a landmark to be useful in distance error calculation;  value should be < 1e10
   static float const stdevSq;  //!< controls how much weight is given to "near-misses"
@@ -48,6 +101,25 @@ public:
   /*! normalization isn't needed because the scale factor is constant across particles, and so
    *  doesn't matter for purposes of comparison between particles */
   inline float normpdf(float const distsq) { return std::exp(-distsq/stdevSq); }
+
+protected:
+  //! evaluates chunks of a LocalizationParticleArrays, for TaskPool::parallel_for_range()
+  struct EvaluateChunk;
+
+  //! local landmarks with at least this many candidates get a LandmarkGrid (if #matchRadius is set); with fewer, testing them all is faster
+  static const size_t GRID_MIN_CANDIDATES = 16;
+
+  //! fills #candidates, #grids, and #missWeights
+  void indexWorld();
+  //! stores into @a found the candidates of local landmark @a indexL from its grid which may lie near (@a x,@a y) or, for lines, (@a x2,@a y2), in increasing order
+  void findNearby(unsigned int indexL, float x, float y, float x2, float y2, std::vector<unsigned int>& found) const;
+
+  std::vector<std::vector<unsigned int> > candidates; //!< for each local landmark, the world landmarks which could match it, in increasing order
+  std::vector<LandmarkGrid> grids; //!< for each local landmark, a grid of its #candidates, empty if it has few or #matchRadius isn't set
+  std::vector<float> missWeights; //!< for each local landmark, the weight added to a particle which doesn't match it
+
+  BatchScratch batchScratch; //!< scratch space for evaluating a LocalizationParticleArrays on the calling thread, reused between calls
+  Workspace workspace; //!< scratch space for evaluate(LocalizationParticle&), reused between calls
 };
 	
 class CameraShapeEvaluator {
@@ -92,7 +164,7 @@ public:
 	
   //! constructor, the standard deviation on matches defaults to 60, but you can always reassign #stdevSq directly
   ShapeSensorModel(DualCoding::ShapeSpace &camShS, DualCoding::ShapeSpace &localShS, DualCoding::ShapeSpace &worldShS) :
-    cShS(camShS), lShS(localShS), wShS(worldShS)
+    pool(NULL), matchRadius(1000), cShS(camShS), lShS(localShS), wShS(worldShS), batch()
   {}
 	
   //! Applies the ParticleShapeEvaluator across a collection of particles
@@ -105,13 +177,15 @@ public:
     std::cout << "Particle filter updateFromLocal(): old est="
               << estimate.x << "," << estimate.y << " hdg=" << estimate.theta << " wt=" << estimate.weight
               << std::endl;
-    LocalShapeEvaluator localEval(lShS,wShS);
+    LocalShapeEvaluator localEval(lShS,wShS,matchRadius);
+    batch.load(particles);
+    localEval.evaluate(batch,pool);
+    batch.storeWeights(particles);
     float bestWeight = -FLT_MAX;
     typename particle_collection::size_type bestIndex = 0;
     double tx=0, ty=0, tcos=0, tsin=0;
     double totalWeight = 0;
     for(typename particle_collection::size_type p=0; p<particles.size(); ++p) {
-      localEval.evaluate(particles[p]);
       if (particles[p].weight > bestWeight) {
 				bestWeight = particles[p].weight;
 				bestIndex = p;
@@ -158,6 +232,12 @@ public:
     }
   }
 	
+  //! if non-NULL, updateFromLocal() splits the particles across the threads of this pool
+  TaskPool* pool;
+
+  //! world landmarks farther than this (in mm) from where a particle places a local landmark can't match it, 0 to consider every world landmark (see LocalShapeEvaluator)
+  float matchRadius;
+
   DualCoding::ShapeSpace& getcamShS() const { return lShS; }
   DualCoding::ShapeSpace& getLocalShS() const { return lShS; }
   DualCoding::ShapeSpace& getWorldShS() const { return wShS; }
@@ -166,6 +246,7 @@ protected:
   DualCoding::ShapeSpace &cShS;			//!< Camera shape space
   DualCoding::ShapeSpace &lShS;			//!< Local shape space
   DualCoding::ShapeSpace &wShS;			//!< World shape space
+  LocalizationParticleArrays batch; //!< the particles being evaluated by updateFromLocal(), kept to reuse its storage
 };
 
 #endif
@@ -0,0 +1,127 @@
+#ifndef PLATFORM_APERIOS
+#include "IKBatch.h"
+#include "ReachabilityMap.h"
+#include "IPC/TaskPool.h"
+#include "Shared/MarkScope.h"
+#include <stdexcept>
+
+IKBatch::Chain::Chain(const KinematicJoint& eff) : effector(eff.cloneBranch()), joints() {
+	for(KinematicJoint* kj=effector; kj!=NULL; kj=kj->getParent())
+		if(kj->isMobile())
+			joints.insert(joints.begin(),kj);
+}
+
+IKBatch::Chain::~Chain() {
+	// cloneBranch() returns the leaf, the root owns the rest
+	KinematicJoint* root=effector;
+	while(root->getParent()!=NULL)
+		root=root->getParent();
+	delete root;
+}
+
+//! solves a range of targets on one copy of the chain
+class IKBatch::SolveChunk {
+public:
+	//! constructor
+	SolveChunk(IKBatch& b, const std::vector<Target>& t, std::vector<Solution>& s) : batch(b), targets(t), solutions(s) {}
+	//! solves targets [@a begin,@a end)
+	void operator()(size_t begin, size_t end) const {
+		Chain* chain=batch.acquireChain();
+		try {
+			const IKSolver& solver=chain->effector->getIK();
+			const size_t n=chain->joints.size();
+			const ReachabilityMap* map = (batch.map!=NULL && batch.map->isValid() && batch.map->getNumJoints()==n) ? batch.map : NULL;
+			for(size_t i=begin; i!=end; ++i) {
+				const Target& t=targets[i];
+				Solution& s=solutions[i];
+				const float* seed=NULL;
+				if(map!=NULL) {
+					if(const IKSolver::Point* p = dynamic_cast<const IKSolver::Point*>(t.pTgt)) {
+						seed=map->getNearestSeed(*p,batch.mapRadius);
+						if(seed==NULL) {
+							s.q=batch.startQ;
+							s.success=false;
+							s.skipped=true;
+							continue;
+						}
+					}
+				}
+				for(size_t j=0; j<n; ++j)
+					chain->joints[j]->setQ(seed!=NULL ? seed[j] : batch.startQ[j]);
+				s.success = solver.solve(t.pEff,t.oriEff,*chain->effector,*t.pTgt,t.posPri,*t.oriTgt,t.oriPri);
+				s.skipped = false;
+				s.q.resize(n);
+				for(size_t j=0; j<n; ++j)
+					s.q[j]=chain->joints[j]->getQ();
+			}
+		} catch(...) {
+			batch.releaseChain(chain);
+			throw;
+		}
+		batch.releaseChain(chain);
+	}
+protected:
+	IKBatch& batch; //!< the batch being solved
+	const std::vector<Target>& targets; //!< the targets being solved
+	std::vector<Solution>& solutions; //!< where to store the results, already sized to match #targets
+private:
+	SolveChunk& operator=(const SolveChunk&); //!< don't call
+};
+
+IKBatch::IKBatch(const KinematicJoint& effector, TaskPool& p)
+	: prototype(new Chain(effector)), pool(p), map(NULL), mapRadius(1), startQ(), chains(), freeChains(), chainsLock()
+{
+	startQ.resize(prototype->joints.size());
+	for(size_t j=0; j<startQ.size(); ++j)
+		startQ[j]=prototype->joints[j]->getQ();
+}
+
+IKBatch::IKBatch(const KinematicJoint& effector)
+	: prototype(new Chain(effector)), pool(TaskPool::getDefault()), map(NULL), mapRadius(1), startQ(), chains(), freeChains(), chainsLock()
+{
+	startQ.resize(prototype->joints.size());
+	for(size_t j=0; j<startQ.size(); ++j)
+		startQ[j]=prototype->joints[j]->getQ();
+}
+
+IKBatch::~IKBatch() {
+	for(std::vector<Chain*>::const_iterator it=chains.begin(); it!=chains.end(); ++it)
+		delete *it;
+	delete prototype;
+}
+
+void IKBatch::setStartingPosture(const std::vector<float>& q) {
+	if(q.size()!=startQ.size())
+		throw std::invalid_argument("IKBatch::setStartingPosture() size does not match the number of mobile joints");
+	startQ=q;
+}
+
+void IKBatch::solve(const std::vector<Target>& targets, std::vector<Solution>& solutions) {
+	solutions.resize(targets.size());
+	// each solve is fairly expensive, so use small chunks for load balancing
+	pool.parallel_for_range(0,targets.size(),SolveChunk(*this,targets,solutions),4);
+}
+
+IKBatch::Chain* IKBatch::acquireChain() {
+	MarkScope l(chainsLock);
+	if(!freeChains.empty()) {
+		Chain* c=freeChains.back();
+		freeChains.pop_back();
+		return c;
+	}
+	// the prototype is only read, so it's safe to copy while other threads use their own copies
+	Chain* c=new Chain(*prototype->effector);
+	chains.push_back(c);
+	return c;
+}
+
+void IKBatch::releaseChain(Chain* c) {
+	MarkScope l(chainsLock);
+	freeChains.push_back(c);
+}
+
+/*! @file
+ * @brief Implements IKBatch, which solves inverse kinematics for many targets in parallel
+ */
+
+#endif //PLATFORM_APERIOS check
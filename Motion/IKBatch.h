@@ -0,0 +1,132 @@
+//-*-c++-*-
+#ifndef INCLUDED_IKBatch_h_
+#define INCLUDED_IKBatch_h_
+
+#ifdef PLATFORM_APERIOS
+#  warning IKBatch is not Aperios compatable
+#else
+
+#include "IKSolver.h"
+#include "IPC/Thread.h"
+#include <vector>
+
+class ReachabilityMap;
+class TaskPool;
+
+//! Solves inverse kinematics for many targets in parallel, such as the candidate poses of a grasp planner
+/*! The constructor copies the chain leading to the effector; the copy's current joint positions
+ *  are the starting posture for each target.  solve() divides the targets among the threads of
+ *  a TaskPool, each of which works on its own copy of the chain (with its own IKSolver instance,
+ *  as selected by the effector's KinematicJoint::ikSolver).  Each target starts from the
+ *  starting posture, although solvers which warm start from their previous solution (such as
+ *  IKDampedLeastSquares) may instead start from the solution to another target handled by the
+ *  same copy.  The copies are kept between calls to solve().
+ *
+ *  If a ReachabilityMap is provided, targets which are single points (IKSolver::Point) are
+ *  looked up before solving: targets outside the reachable workspace are skipped without
+ *  running IK at all, and the rest start from the map's seed configuration for that voxel rather
+ *  than the starting posture.  Since sparse sampling leaves holes in the map, a target is only
+ *  skipped if no voxel within #mapRadius of it is reachable (see ReachabilityMap::getNearestSeed()).
+ *  The map should have been generated for the same effector and effector point as the targets.
+ *
+ *  @code
+ *  IKBatch batch(*kine->getKinematicJoint(GripperFrameOffset));
+ *  batch.setReachabilityMap(&map);
+ *  std::vector<IKBatch::Target> targets;
+ *  for(...)
+ *  	targets.push_back(IKBatch::Target(pEff, oriEff, candidates[i], 1, orientation, 0.5f));
+ *  std::vector<IKBatch::Solution> solutions;
+ *  batch.solve(targets, solutions);
+ *  @endcode */
+class IKBatch {
+public:
+	//! A single IK problem, the arguments of IKSolver::solve() other than the joint
+	/*! The position and orientation constraints are referenced, not copied, and must remain valid until solve() returns. */
+	struct Target {
+		//! constructor
+		Target(const IKSolver::Point& pEffector, const IKSolver::Rotation& oriEffector,
+			const IKSolver::Position& position, float positionPriority, const IKSolver::Orientation& orientation, float orientationPriority)
+			: pEff(pEffector), oriEff(oriEffector), pTgt(&position), posPri(positionPriority), oriTgt(&orientation), oriPri(orientationPriority) {}
+		IKSolver::Point pEff; //!< the point on the effector to be placed, in the effector's frame
+		IKSolver::Rotation oriEff; //!< the orientation of the effector to be aligned
+		const IKSolver::Position* pTgt; //!< the position constraint
+		float posPri; //!< the priority of the position constraint
+		const IKSolver::Orientation* oriTgt; //!< the orientation constraint
+		float oriPri; //!< the priority of the orientation constraint
+	};
+
+	//! The result for one Target
+	struct Solution {
+		//! constructor
+		Solution() : q(), success(false), skipped(false) {}
+		std::vector<float> q; //!< the final position of each mobile joint in the chain, ordered from the base
+		bool success; //!< the value returned by IKSolver::solve()
+		bool skipped; //!< true if the ReachabilityMap reported the target unreachable, so IK was not attempted (#q is the starting posture)
+	};
+
+	//! constructor, copies the chain leading to @a effector, solving in parallel on @a pool
+	explicit IKBatch(const KinematicJoint& effector, TaskPool& pool);
+	//! constructor, copies the chain leading to @a effector, solving in parallel on the default TaskPool
+	explicit IKBatch(const KinematicJoint& effector);
+	//! destructor
+	~IKBatch();
+
+	//! sets the map used to skip unreachable targets and seed the rest, NULL disables; the map must outlive the batch, or be reset
+	/*! @a radius is the distance (in voxels) to search for a reachable voxel if the target's own voxel is not marked reachable */
+	void setReachabilityMap(const ReachabilityMap* m, unsigned int radius=1) { map=m; mapRadius=radius; }
+	//! returns the map set by setReachabilityMap()
+	const ReachabilityMap* getReachabilityMap() const { return map; }
+
+	//! sets the starting posture, one value per mobile joint, ordered from the base
+	void setStartingPosture(const std::vector<float>& q);
+	//! returns the starting posture
+	const std::vector<float>& getStartingPosture() const { return startQ; }
+
+	//! returns the number of mobile joints in the chain
+	unsigned int getNumJoints() const { return static_cast<unsigned int>(startQ.size()); }
+
+	//! solves each of @a targets, resizing @a solutions to match; not reentrant, but the batch may be used from any one thread at a time
+	void solve(const std::vector<Target>& targets, std::vector<Solution>& solutions);
+
+protected:
+	class SolveChunk;
+
+	//! a private copy of the chain, used by one thread at a time
+	struct Chain {
+		//! constructor, copies the chain leading to @a effector
+		explicit Chain(const KinematicJoint& effector);
+		//! destructor
+		~Chain();
+		KinematicJoint* effector; //!< the leaf of the copied chain
+		std::vector<KinematicJoint*> joints; //!< the mobile joints of the chain, ordered from the base
+	private:
+		Chain(const Chain&); //!< don't call
+		Chain& operator=(const Chain&); //!< don't call
+	};
+
+	//! returns an unused chain, creating one if necessary
+	Chain* acquireChain();
+	//! returns @a c to #freeChains
+	void releaseChain(Chain* c);
+
+	Chain* prototype; //!< the chain other copies are made from, never modified after construction
+	TaskPool& pool; //!< the pool to solve on
+	const ReachabilityMap* map; //!< the map to check targets against, or NULL
+	unsigned int mapRadius; //!< how far to search #map for a reachable voxel, see ReachabilityMap::getNearestSeed()
+	std::vector<float> startQ; //!< the starting posture
+	std::vector<Chain*> chains; //!< all the copies of the chain which have been created
+	std::vector<Chain*> freeChains; //!< the copies not currently in use by a thread
+	Thread::Lock chainsLock; //!< protects #chains and #freeChains
+
+private:
+	IKBatch(const IKBatch&); //!< don't call
+	IKBatch& operator=(const IKBatch&); //!< don't call
+};
+
+/*! @file
+ * @brief Describes IKBatch, which solves inverse kinematics for many targets in parallel
+ */
+
+#endif //Aperios check
+
+#endif
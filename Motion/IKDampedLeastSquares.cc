@@ -0,0 +1,324 @@
+#include "IKDampedLeastSquares.h"
+#include "Shared/fmat.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+using namespace std;
+
+const std::string IKDampedLeastSquares::autoRegisterIKDampedLeastSquares = IKSolver::getRegistry().registerType<IKDampedLeastSquares>("IKDampedLeastSquares");
+
+//! initial damping, relative to the length scale of the chain
+static const fmat::fmatReal LAMBDA_INIT = .01f;
+//! minimum damping, relative to the length scale of the chain (also keeps JJᵀ+λ²I well conditioned when rows are unweighted)
+static const fmat::fmatReal LAMBDA_MIN = .001f;
+//! maximum damping, relative to the length scale of the chain, give up if a step still doesn't help
+static const fmat::fmatReal LAMBDA_MAX = 1000;
+//! largest rotation of any revolute joint in one iteration, larger steps are scaled down (the linearization wouldn't hold, and joints would be slammed into their limits)
+static const fmat::fmatReal MAX_ROTATION_STEP = .3f;
+
+bool IKDampedLeastSquares::solve(const Point& pEff, const Rotation& oriEff, KinematicJoint& j,
+	const Position& pTgt, float posPri, const Orientation& oriTgt, float oriPri) const
+{
+	lastIterations=0;
+	if(posPri<=0 && oriPri<=0)
+		return true;
+	posPri=std::max(0.f,posPri);
+	oriPri=std::max(0.f,oriPri);
+	const float totPri = posPri+oriPri;
+	posPri/=totPri;
+	oriPri/=totPri;
+
+	Chain chain;
+	buildChain(j,chain);
+	if(chain.size()==0)
+		return false;
+
+	// orientation error is scaled by the distance from the first mobile joint to the effector,
+	// so a radian of error is weighted like the distance the effector would move to correct it
+	fmat::Column<3> pEffBase(j.getFullT()*pEff);
+	fmat::fmatReal len = (pEffBase - chain.front()->getWorldPosition()).norm();
+	if(len<1)
+		len=1;
+	const Weights w = { posPri, oriPri*len };
+
+	Evaluation ev;
+	evaluate(pEff,oriEff,j,chain,pTgt,oriTgt,w,ev);
+
+	std::vector<fmat::fmatReal> q, dq;
+	if(lastEffector==&j && lastSolution.size()==chain.size()) {
+		// warm start: use the previous solution if it's closer to the new target
+		getChainQ(chain,q);
+		setChainQ(chain,lastSolution);
+		Evaluation prev;
+		evaluate(pEff,oriEff,j,chain,pTgt,oriTgt,w,prev);
+		if(prev.cost<ev.cost)
+			std::swap(ev,prev);
+		else
+			setChainQ(chain,q);
+	}
+
+	fmat::fmatReal lambda = LAMBDA_INIT*len;
+	bool secondary = (nullSpaceGain>0);
+	bool solved=false;
+	Evaluation next;
+	while(true) {
+		if(converged(ev,posPri,oriPri)) {
+			solved=true;
+			break;
+		}
+		if(lastIterations>=MAX_ITER)
+			break;
+		++lastIterations;
+
+		getChainQ(chain,q);
+		if(!computeStep(chain,ev,lambda,secondary,dq))
+			break; // everything is at its limits
+		const fmat::fmatReal maxdq = limitStep(chain,dq);
+		if(maxdq<QTOL)
+			break; // not making progress, probably out of range
+		for(size_t i=0; i<dq.size(); ++i)
+			dq[i]+=q[i];
+
+		setChainQ(chain,dq);
+		evaluate(pEff,oriEff,j,chain,pTgt,oriTgt,w,next);
+		if(next.cost<ev.cost) {
+			// accept the step, trust the linearization more next time
+			std::swap(ev,next);
+			lambda=std::max(lambda/2,LAMBDA_MIN*len);
+			secondary = (nullSpaceGain>0);
+		} else if(secondary) {
+			// the secondary objective may disturb the effector (the projection is only approximate
+			// with damping), try again without it before blaming the linearization
+			setChainQ(chain,q);
+			secondary=false;
+		} else {
+			// reject the step, and try again closer to gradient descent
+			setChainQ(chain,q);
+			lambda*=4;
+			if(lambda>LAMBDA_MAX*len)
+				break;
+		}
+	}
+
+	lastEffector=&j;
+	getChainQ(chain,lastSolution);
+	return solved;
+}
+
+IKSolver::StepResult_t IKDampedLeastSquares::step(const Point& pEff, const Rotation& oriEff, KinematicJoint& j,
+	const Position& pTgt, float pDist, float posPri,
+	const Orientation& oriTgt, float oriDist, float oriPri) const
+{
+	if((posPri<=0 && oriPri<=0) || (pDist<=0 && oriDist<=0))
+		return SUCCESS;
+	posPri=std::max(0.f,posPri);
+	oriPri=std::max(0.f,oriPri);
+	const float totPri = posPri+oriPri;
+	posPri/=totPri;
+	oriPri/=totPri;
+
+	Chain chain;
+	buildChain(j,chain);
+	if(chain.size()==0)
+		return LIMITS;
+
+	fmat::Column<3> pEffBase(j.getFullT()*pEff);
+	fmat::fmatReal len = (pEffBase - chain.front()->getWorldPosition()).norm();
+	if(len<1)
+		len=1;
+	const Weights w = { posPri, oriPri*len };
+
+	Evaluation ev;
+	evaluate(pEff,oriEff,j,chain,pTgt,oriTgt,w,ev);
+	if(converged(ev,posPri,oriPri))
+		return SUCCESS;
+
+	std::vector<fmat::fmatReal> q, dq;
+	if(!computeStep(chain,ev,LAMBDA_INIT*len,nullSpaceGain>0,dq))
+		return LIMITS;
+
+	// limit the predicted motion of the effector to pDist and oriDist
+	fmat::Column<6> move;
+	for(size_t i=0; i<chain.size(); ++i)
+		move+=ev.J[i]*dq[i];
+	fmat::fmatReal scale=1;
+	if(w.pos>0) {
+		const fmat::fmatReal d = fmat::SubVector<3>(move).norm()/w.pos;
+		if(d>pDist)
+			scale=std::min(scale,pDist/d);
+	}
+	if(w.ori>0) {
+		const fmat::fmatReal d = fmat::SubVector<3>(move,3).norm()/w.ori;
+		if(d>oriDist)
+			scale=std::min(scale,oriDist/d);
+	}
+
+	getChainQ(chain,q);
+	for(size_t i=0; i<dq.size(); ++i)
+		dq[i] = q[i] + dq[i]*scale;
+	setChainQ(chain,dq);
+
+	Evaluation next;
+	evaluate(pEff,oriEff,j,chain,pTgt,oriTgt,w,next);
+	if(converged(next,posPri,oriPri))
+		return SUCCESS;
+	if(next.cost<ev.cost)
+		return PROGRESS;
+	setChainQ(chain,q);
+	return RANGE;
+}
+
+void IKDampedLeastSquares::buildChain(KinematicJoint& j, Chain& chain) {
+	chain.clear();
+	chain.reserve(j.getDepth()+1);
+	for(KinematicJoint * ancestor=&j; ancestor!=NULL; ancestor=ancestor->getParent())
+		if(ancestor->isMobile())
+			chain.push_back(ancestor);
+	std::reverse(chain.begin(),chain.end());
+}
+
+void IKDampedLeastSquares::evaluate(const Point& pEff, const Rotation& oriEff, const KinematicJoint& j, const Chain& chain,
+	const Position& pTgt, const Orientation& oriTgt, const Weights& w, Evaluation& ev)
+{
+	const fmat::Transform& Tj = j.getFullT();
+	const Point pEffBase(Tj*pEff);
+	const Rotation oEffBase(fmat::Quaternion::fromMatrix(Tj.rotation())*oriEff);
+
+	fmat::Column<3> pErr;
+	pTgt.computeErrorGradient(pEffBase,oEffBase,pErr);
+	fmat::Quaternion oriErr;
+	oriTgt.computeErrorGradient(pEffBase,oEffBase,oriErr);
+	oriErr.normalize();
+	const fmat::fmatReal ang = oriErr.angle();
+
+	ev.pErrMagnitude = pErr.norm();
+	ev.oriErrMagnitude = std::abs(ang);
+	fmat::SubVector<3>(ev.err,0) = pErr * w.pos;
+	fmat::SubVector<3>(ev.err,3) = oriErr.axis() * (ang * w.ori);
+	ev.cost = ev.err.sumSq();
+
+	// the Jacobian columns only depend on each joint's world transform, which are cached by the joints
+	ev.J.resize(chain.size());
+	for(size_t i=0; i<chain.size(); ++i) {
+		const fmat::Transform& t = chain[i]->getFullT();
+		const fmat::Column<3> z(t.column(2));
+		fmat::Column<6>& col = ev.J[i];
+		if(chain[i]->jointType==KinematicJoint::PRISMATIC) {
+			fmat::SubVector<3>(col,0) = z * w.pos;
+			fmat::SubVector<3>(col,3) = fmat::Column<3>();
+		} else {
+			const fmat::Column<3> o(t.column(3));
+			fmat::SubVector<3>(col,0) = fmat::crossProduct(z, pEffBase-o) * w.pos;
+			fmat::SubVector<3>(col,3) = z * w.ori;
+		}
+	}
+}
+
+bool IKDampedLeastSquares::computeStep(const Chain& chain, const Evaluation& ev, fmat::fmatReal lambda, bool secondary, std::vector<fmat::fmatReal>& dq) const {
+	const size_t n = chain.size();
+	std::vector<bool> active(n,true);
+	size_t numActive=n;
+	std::vector<fmat::fmatReal> grad;
+	if(secondary)
+		secondaryGradient(chain,grad);
+	dq.resize(n);
+
+	while(numActive>0) {
+		// A = JJᵀ + λ²I, only 6x6 regardless of the number of joints
+		fmat::Matrix<6,6> A = fmat::Matrix<6,6>::identity() * (lambda*lambda);
+		for(size_t i=0; i<n; ++i) {
+			if(!active[i])
+				continue;
+			const fmat::Column<6>& col = ev.J[i];
+			for(unsigned int c=0; c<6; ++c)
+				for(unsigned int r=0; r<6; ++r)
+					A(r,c) += col[r]*col[c];
+		}
+		fmat::Matrix<6,6> Ainv;
+		try {
+			Ainv = fmat::invert(A);
+		} catch(const std::underflow_error&) {
+			return false;
+		}
+
+		// primary task: Δq = Jᵀ(JJᵀ+λ²I)⁻¹e
+		const fmat::Column<6> y = Ainv * ev.err;
+		for(size_t i=0; i<n; ++i)
+			dq[i] = active[i] ? fmat::dotProduct(ev.J[i],y) : 0;
+
+		// secondary task: (I - J⁺J)z, where z descends the secondary gradient
+		if(secondary) {
+			fmat::Column<6> Jz;
+			for(size_t i=0; i<n; ++i)
+				if(active[i])
+					Jz += ev.J[i] * (-nullSpaceGain*grad[i]);
+			const fmat::Column<6> u = Ainv * Jz;
+			for(size_t i=0; i<n; ++i)
+				if(active[i])
+					dq[i] += -nullSpaceGain*grad[i] - fmat::dotProduct(ev.J[i],u);
+		}
+
+		// drop joints which are already at a limit and being pushed past it, then solve again with the rest
+		bool dropped=false;
+		for(size_t i=0; i<n; ++i) {
+			if(!active[i])
+				continue;
+			const KinematicJoint& kj = *chain[i];
+			const fmat::fmatReal q = kj.getQ();
+			if((dq[i]<0 && q<=kj.qmin) || (dq[i]>0 && q>=kj.qmax)) {
+				active[i]=false;
+				--numActive;
+				dropped=true;
+			}
+		}
+		if(!dropped)
+			return true;
+	}
+	return false;
+}
+
+fmat::fmatReal IKDampedLeastSquares::limitStep(const Chain& chain, std::vector<fmat::fmatReal>& dq) {
+	fmat::fmatReal maxdq=0, maxRot=0;
+	for(size_t i=0; i<dq.size(); ++i) {
+		const fmat::fmatReal a = std::abs(dq[i]);
+		maxdq=std::max(maxdq,a);
+		if(chain[i]->jointType==KinematicJoint::REVOLUTE)
+			maxRot=std::max(maxRot,a);
+	}
+	if(maxRot>MAX_ROTATION_STEP) {
+		const fmat::fmatReal s = MAX_ROTATION_STEP/maxRot;
+		for(size_t i=0; i<dq.size(); ++i)
+			dq[i]*=s;
+		maxdq*=s;
+	}
+	return maxdq;
+}
+
+void IKDampedLeastSquares::secondaryGradient(const Chain& chain, std::vector<fmat::fmatReal>& grad) const {
+	grad.resize(chain.size());
+	for(size_t i=0; i<chain.size(); ++i) {
+		const KinematicJoint& kj = *chain[i];
+		const fmat::fmatReal half = (kj.qmax-kj.qmin)/2;
+		// continuous rotation joints don't have limits to avoid
+		if(half<=0 || (kj.jointType==KinematicJoint::REVOLUTE && half>=static_cast<fmat::fmatReal>(M_PI)))
+			grad[i]=0;
+		else
+			grad[i] = 2*(kj.getQ() - (kj.qmin+half)) / (half*half);
+	}
+}
+
+void IKDampedLeastSquares::setChainQ(const Chain& chain, const std::vector<fmat::fmatReal>& q) {
+	for(size_t i=0; i<chain.size(); ++i)
+		chain[i]->tryQ(q[i]);
+}
+
+void IKDampedLeastSquares::getChainQ(const Chain& chain, std::vector<fmat::fmatReal>& q) {
+	q.resize(chain.size());
+	for(size_t i=0; i<chain.size(); ++i)
+		q[i]=chain[i]->getQ();
+}
+
+/*! @file
+ * @brief Implements IKDampedLeastSquares, which performs damped least-squares (Levenberg-Marquardt) iterations on the joints to find a solution
+ */
@@ -0,0 +1,129 @@
+//-*-c++-*-
+#ifndef INCLUDED_IKDampedLeastSquares_h_
+#define INCLUDED_IKDampedLeastSquares_h_
+
+#include "IKSolver.h"
+#include <vector>
+
+//! Performs damped least-squares (Levenberg-Marquardt) iterations on the joints to find a solution
+/*! Like IKGradientSolver, this is a generic solver which can handle any chain, and any
+ *  combination of position and orientation constraints, but it converges in far fewer iterations:
+ *  each iteration solves for the joint motion which best reduces the error, instead of following
+ *  the gradient with a fixed step size.
+ *
+ *  Each iteration:
+ *  - computes the full Jacobian of the chain in a single pass over the joints' cached world
+ *    transforms (see KinematicJoint::getFullT()), instead of one KinematicJoint::getJointJacobian() call per joint
+ *  - solves Δq = Jᵀ(JJᵀ + λ²I)⁻¹e, where e is the error (orientation error is scaled by the length
+ *    of the chain, so it is comparable to position error), and the damping λ is decreased when an
+ *    iteration reduces the error and increased when it doesn't, so the solver behaves like Gauss-Newton
+ *    near the solution and like gradient descent near singularities
+ *  - removes joints which are pushed against their limits from the solution, and clamps the rest
+ *  - projects a secondary objective into the null space of the Jacobian, so redundant joints
+ *    can make progress on it without disturbing the effector (by default, this keeps joints away
+ *    from their limits, subclasses can override secondaryGradient())
+ *
+ *  The solver also remembers the previous solution for the chain it was last used with: when
+ *  solving again, it starts from whichever of the previous solution or the current joint positions
+ *  is closer to the new target.  Since a solver instance is normally owned by its effector
+ *  joint (see KinematicJoint::getIK()), this warm starts a sequence of nearby targets (e.g. reaching along
+ *  a path) even if the joint positions are reset from the robot's current state between solves.
+ *  (This also means solve() isn't thread safe, any more than modifying the KinematicJoint itself is.) */
+class IKDampedLeastSquares : public IKSolver {
+public:
+	//! constructor
+	IKDampedLeastSquares(unsigned int iter=50, float posTolerance=0.5f, float oriTolerance=.001f) :
+		IKSolver(), PTOL(posTolerance), OTOL(oriTolerance), QTOL(oriTolerance/50), MAX_ITER(iter),
+		nullSpaceGain(.1f), lastEffector(NULL), lastSolution(), lastIterations(0) {}
+
+	using IKSolver::solve;
+	using IKSolver::step;
+
+	virtual bool solve(const Point& pEff, const Rotation& oriEff, KinematicJoint& j,
+		const Position& pTgt, float posPri, const Orientation& oriTgt, float oriPri) const;
+
+	virtual StepResult_t step(const Point& pEff, const Rotation& oriEff, KinematicJoint& j,
+		const Position& pTgt, float pDist, float posPri,
+		const Orientation& oriTgt, float oriDist, float oriPri) const;
+
+	//! returns the number of iterations used by the most recent call to solve()
+	unsigned int getLastIterations() const { return lastIterations; }
+
+	//! sets the weight of the secondary objective (see secondaryGradient()), 0 disables it
+	void setNullSpaceGain(float gain) { nullSpaceGain=gain; }
+	//! returns the weight of the secondary objective (see secondaryGradient())
+	float getNullSpaceGain() const { return nullSpaceGain; }
+
+	//! forget the previous solution, so the next solve() starts from the current joint positions
+	void clearWarmStart() const { lastEffector=NULL; lastSolution.clear(); }
+
+protected:
+	//! the mobile joints of the chain being solved, ordered from the base to the effector
+	typedef std::vector<KinematicJoint*> Chain;
+
+	//! the error and Jacobian at the current joint positions, see evaluate()
+	struct Evaluation {
+		Evaluation() : err(), pErrMagnitude(0), oriErrMagnitude(0), cost(0), J() {}
+		fmat::Column<6> err; //!< weighted position error (first 3) and orientation error (last 3, the axis scaled by the angle)
+		fmat::fmatReal pErrMagnitude; //!< unweighted position error
+		fmat::fmatReal oriErrMagnitude; //!< unweighted orientation error, in radians
+		fmat::fmatReal cost; //!< squared norm of #err
+		std::vector<fmat::Column<6> > J; //!< weighted Jacobian columns, one per joint of the chain
+	};
+
+	//! relative weightings of position and orientation error
+	struct Weights {
+		fmat::fmatReal pos; //!< multiplies position error (and the linear rows of the Jacobian)
+		fmat::fmatReal ori; //!< multiplies orientation error (and the angular rows of the Jacobian), includes the length scale of the chain
+	};
+
+	//! fills in @a chain with the mobile joints leading up to and including @a j
+	static void buildChain(KinematicJoint& j, Chain& chain);
+
+	//! computes the error and Jacobian for the current joint positions
+	static void evaluate(const Point& pEff, const Rotation& oriEff, const KinematicJoint& j, const Chain& chain,
+		const Position& pTgt, const Orientation& oriTgt, const Weights& w, Evaluation& ev);
+
+	//! returns true if the error in @a ev is within tolerance
+	bool converged(const Evaluation& ev, fmat::fmatReal posPri, fmat::fmatReal oriPri) const {
+		return ev.pErrMagnitude*posPri < PTOL && ev.oriErrMagnitude*oriPri < OTOL;
+	}
+
+	//! computes the damped least squares joint motion @a dq for the error in @a ev with damping @a lambda, including the null space motion if @a secondary is set
+	/*! Joints which would be pushed past a limit they are already at are removed from the
+	 *  solution.  Returns false if no joints remain. */
+	bool computeStep(const Chain& chain, const Evaluation& ev, fmat::fmatReal lambda, bool secondary, std::vector<fmat::fmatReal>& dq) const;
+
+	//! scales @a dq down if it would rotate any joint too far in one iteration, returns the largest remaining joint motion
+	static fmat::fmatReal limitStep(const Chain& chain, std::vector<fmat::fmatReal>& dq);
+
+	//! fills in @a grad with the gradient of a secondary objective to be <em>minimized</em> in the null space of the primary task, one entry per joint of @a chain
+	/*! The default penalizes the squared distance of each joint from the center of its range,
+	 *  normalized by the range, which keeps redundant joints away from their limits. */
+	virtual void secondaryGradient(const Chain& chain, std::vector<fmat::fmatReal>& grad) const;
+
+	//! sets each joint of @a chain to @a q, clamped to its limits
+	static void setChainQ(const Chain& chain, const std::vector<fmat::fmatReal>& q);
+	//! stores the current positions of the joints of @a chain in @a q
+	static void getChainQ(const Chain& chain, std::vector<fmat::fmatReal>& q);
+
+	const float PTOL; //!< position tolerance
+	const float OTOL; //!< orientation tolerance
+	const float QTOL; //!< joint motion tolerance, stop if no joint moves more than this
+	const unsigned int MAX_ITER; //!< maximum number of iterations to attempt
+	float nullSpaceGain; //!< weight of the secondary objective, see secondaryGradient()
+
+	mutable const KinematicJoint* lastEffector; //!< the effector passed to the previous solve(), for warm starts
+	mutable std::vector<fmat::fmatReal> lastSolution; //!< the joint positions found by the previous solve(), for warm starts
+	mutable unsigned int lastIterations; //!< number of iterations used by the previous solve()
+
+private:
+	//! holds the class name, set via registration with the DeviceDriver registry
+	static const std::string autoRegisterIKDampedLeastSquares;
+};
+
+/*! @file
+ * @brief Describes IKDampedLeastSquares, which performs damped least-squares (Levenberg-Marquardt) iterations on the joints to find a solution
+ */
+
+#endif
@@ -0,0 +1,389 @@
+#include "KeyframeSequenceMC.h"
+#include "DynamicMotionSequence.h"
+#include "PostureEngine.h"
+#include "MotionManager.h"
+#include "Spline.h"
+#include "Events/EventBase.h"
+#include "Shared/get_time.h"
+#include "Shared/WorldState.h"
+#include "Shared/Config.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+using std::cout;
+using std::endl;
+
+const char KeyframeSequenceMC::BINARY_MAGIC[5]="#MSb";
+const unsigned int KeyframeSequenceMC::BINARY_VERSION;
+
+//! for std::upper_bound on keyframe times
+static bool timeBefore(unsigned int t, const KeyframeSequenceMC::KeyFrame& k) { return t<k.time; }
+
+KeyframeSequenceMC::KeyframeSequenceMC()
+	: MotionCommand(), LoadSave(), cursors(), curs(), curstamps(), playtime(1), lasttime(0), endtime(0), playspeed(1.0f),
+	playing(true), hold(true), interpolation(LINEAR), dirty(false)
+{
+	clear();
+}
+
+KeyframeSequenceMC::KeyframeSequenceMC(const std::string& filename)
+	: MotionCommand(), LoadSave(), cursors(), curs(), curstamps(), playtime(1), lasttime(0), endtime(0), playspeed(1.0f),
+	playing(true), hold(true), interpolation(LINEAR), dirty(false)
+{
+	clear();
+	loadFile(filename.c_str());
+	setTime(1);
+}
+
+int KeyframeSequenceMC::updateOutputs() {
+	if(isPlaying()) {
+		if(lasttime==0)
+			play();
+		unsigned int curtime=get_time();
+		float diff=(curtime-lasttime)*playspeed;
+		if(playtime<-diff)
+			setTime(0);
+		else
+			setTime(static_cast<unsigned int>(diff+playtime));
+		lasttime=curtime;
+	} else {
+		lasttime=get_time();
+	}
+
+	if(!isPlaying()) {
+		if(dirty)
+			postEvent(EventBase(EventBase::motmanEGID,getID(),EventBase::statusETID));
+		dirty=false;
+		for(unsigned int i=0; i<NumOutputs; i++) //just copies getOutputCmd(i) across frames
+			motman->setOutput(this,i,getOutputCmd(i));
+	} else {
+		dirty=true;
+		for(unsigned int i=0; i<NumOutputs; i++) { //fill out the buffer of commands for smoother movement
+			unsigned int cursor=cursors[i];
+			OutputCmd frames[NumFrames];
+			frames[0]=getOutputCmd(i);
+			for(unsigned int t=playtime+FrameTime,j=1;j<NumFrames;j++,t+=FrameTime) {
+				seek(i,t,cursor);
+				calcOutput(i,t,cursor,frames[j]);
+			}
+			motman->setOutput(this,i,frames);
+		}
+	}
+	return NumOutputs;
+}
+
+unsigned int KeyframeSequenceMC::getBinSize() const {
+	unsigned int used=strlen(BINARY_MAGIC);
+	used+=getSerializedSize(BINARY_VERSION);
+	used+=getSerializedSize<unsigned int>(); // number of outputs
+	used+=getSerializedSize(endtime);
+	const unsigned int frameSize=getSerializedSize<unsigned int>()+getSerializedSize<float>()*2;
+	for(unsigned int i=0; i<NumOutputs; i++) {
+		if(keys[i].size()==1 && keys[i][0].cmd.weight==0)
+			continue;
+		used+=getSerializedSize(outputNames[i]);
+		used+=getSerializedSize<unsigned int>();
+		used+=keys[i].size()*frameSize;
+	}
+	return used;
+}
+
+unsigned int KeyframeSequenceMC::loadBuffer(const char buf[], unsigned int len, const char* filename) {
+	if(len>=strlen(BINARY_MAGIC) && strncmp(BINARY_MAGIC,buf,strlen(BINARY_MAGIC))==0)
+		return loadBinary(buf,len);
+	// text formats are parsed by MotionSequenceEngine, at our playhead, then copied over
+	DynamicMotionSequence ms;
+	ms.setTime(playtime);
+	unsigned int used=ms.loadBuffer(buf,len,filename);
+	if(used==0)
+		return 0;
+	unsigned int t=ms.getTime();
+	importSequence(ms);
+	setTime(t);
+	return used;
+}
+
+unsigned int KeyframeSequenceMC::loadBinary(const char buf[], unsigned int len) {
+	unsigned int origlen=len;
+	buf+=strlen(BINARY_MAGIC);
+	len-=strlen(BINARY_MAGIC);
+	unsigned int version=0, numOutputs=0, end=0;
+	if(!decodeInc(version,buf,len,"*** ERROR KeyframeSequenceMC load corrupted - missing version\n")) return 0;
+	if(version!=BINARY_VERSION) {
+		cout << "*** ERROR KeyframeSequenceMC load: unknown binary version " << version << endl;
+		return 0;
+	}
+	if(!decodeInc(numOutputs,buf,len,"*** ERROR KeyframeSequenceMC load corrupted - missing output count\n")) return 0;
+	if(!decodeInc(end,buf,len,"*** ERROR KeyframeSequenceMC load corrupted - missing end time\n")) return 0;
+	for(unsigned int n=0; n<numOutputs; n++) {
+		std::string name;
+		unsigned int count=0;
+		if(!decodeInc(name,buf,len,"*** ERROR KeyframeSequenceMC load corrupted - missing output name\n")) return 0;
+		if(!decodeInc(count,buf,len,"*** ERROR KeyframeSequenceMC load corrupted - missing keyframe count\n")) return 0;
+		unsigned int i=0;
+		while(i<NumOutputs && name!=outputNames[i])
+			++i;
+		if(i==NumOutputs)
+			cout << "*** WARNING " << name << " is not a valid joint on this model." << endl;
+		else
+			keys[i].reserve(keys[i].size()+count);
+		for(unsigned int k=0; k<count; k++) {
+			unsigned int t=0;
+			OutputCmd cmd;
+			if(!decodeInc(t,buf,len,"*** ERROR KeyframeSequenceMC load corrupted - %s keyframe %d\n",name.c_str(),k)) return 0;
+			if(!decodeInc(cmd.value,buf,len,"*** ERROR KeyframeSequenceMC load corrupted - %s keyframe %d\n",name.c_str(),k)) return 0;
+			if(!decodeInc(cmd.weight,buf,len,"*** ERROR KeyframeSequenceMC load corrupted - %s keyframe %d\n",name.c_str(),k)) return 0;
+			if(i!=NumOutputs)
+				insertKeyFrame(i,t,cmd);
+		}
+	}
+	if(end>endtime)
+		endtime=end;
+	setTime(end);
+	return origlen-len;
+}
+
+unsigned int KeyframeSequenceMC::saveBuffer(char buf[], unsigned int len) const {
+	unsigned int origlen=len;
+	const unsigned int magicLen=strlen(BINARY_MAGIC);
+	if(len<magicLen) {
+		cout << "*** ERROR KeyframeSequenceMC save overflow on header" << endl;
+		return 0;
+	}
+	memcpy(buf,BINARY_MAGIC,magicLen);
+	buf+=magicLen;
+	len-=magicLen;
+	unsigned int numOutputs=0;
+	for(unsigned int i=0; i<NumOutputs; i++)
+		if(keys[i].size()>1 || keys[i][0].cmd.weight!=0)
+			++numOutputs;
+	if(!encodeInc(BINARY_VERSION,buf,len,"*** ERROR KeyframeSequenceMC save overflow on header\n")) return 0;
+	if(!encodeInc(numOutputs,buf,len,"*** ERROR KeyframeSequenceMC save overflow on header\n")) return 0;
+	if(!encodeInc(endtime,buf,len,"*** ERROR KeyframeSequenceMC save overflow on header\n")) return 0;
+	for(unsigned int i=0; i<NumOutputs; i++) {
+		if(keys[i].size()==1 && keys[i][0].cmd.weight==0)
+			continue;
+		if(!encodeInc(std::string(outputNames[i]),buf,len,"*** ERROR KeyframeSequenceMC save overflow on %s\n",outputNames[i])) return 0;
+		if(!encodeInc(static_cast<unsigned int>(keys[i].size()),buf,len,"*** ERROR KeyframeSequenceMC save overflow on %s\n",outputNames[i])) return 0;
+		for(std::vector<KeyFrame>::const_iterator it=keys[i].begin(); it!=keys[i].end(); ++it) {
+			if(!encodeInc(it->time,buf,len,"*** ERROR KeyframeSequenceMC save overflow on %s\n",outputNames[i])) return 0;
+			if(!encodeInc(it->cmd.value,buf,len,"*** ERROR KeyframeSequenceMC save overflow on %s\n",outputNames[i])) return 0;
+			if(!encodeInc(it->cmd.weight,buf,len,"*** ERROR KeyframeSequenceMC save overflow on %s\n",outputNames[i])) return 0;
+		}
+	}
+	return origlen-len;
+}
+
+unsigned int KeyframeSequenceMC::loadFile(const char filename[]) {
+	return LoadSave::loadFile(config->motion.makePath(filename).c_str());
+}
+unsigned int KeyframeSequenceMC::saveFile(const char filename[]) const {
+	return LoadSave::saveFile(config->motion.makePath(filename).c_str());
+}
+
+void KeyframeSequenceMC::clear() {
+	for(unsigned int i=0; i<NumOutputs; i++) {
+		keys[i].assign(1,KeyFrame());
+		keys[i][0].cmd.unset();
+		cursors[i]=0;
+		curstamps[i]=-1U;
+	}
+	endtime=0;
+	setTime(1);
+}
+
+void KeyframeSequenceMC::setTime(unsigned int x) {
+	playtime=x;
+	const WorldState * st=WorldState::getCurrent();
+	for(unsigned int i=0; i<NumOutputs; i++) {
+		if(seek(i,x,cursors[i])) {
+			unsigned int k=cursors[i];
+			if(playspeed<0 && k+1<keys[i].size())
+				++k;
+			OutputCmd& cmd=keys[i][k].cmd;
+			if(cmd.weight<=0) {
+				cmd.value=st->outputs[i];
+				curstamps[i]=-1U;
+			}
+		}
+	}
+}
+
+void KeyframeSequenceMC::setOutputCmd(unsigned int i, const OutputCmd& cmd) {
+	insertKeyFrame(i,playtime,cmd);
+}
+
+const OutputCmd& KeyframeSequenceMC::getOutputCmd(unsigned int i) {
+	if(curstamps[i]!=playtime) {
+		calcOutput(i,playtime,cursors[i],curs[i]);
+		curstamps[i]=playtime;
+	}
+	return curs[i];
+}
+
+void KeyframeSequenceMC::setPose(const PostureEngine& pose) {
+	for(unsigned int i=0; i<NumOutputs; i++)
+		if(pose.getOutputCmd(i).weight>0)
+			setOutputCmd(i,pose.getOutputCmd(i));
+}
+
+void KeyframeSequenceMC::setExplicitPose(const PostureEngine& pose) {
+	for(unsigned int i=0; i<NumOutputs; i++)
+		setOutputCmd(i,pose.getOutputCmd(i));
+}
+
+void KeyframeSequenceMC::getPose(PostureEngine& pose) {
+	for(unsigned int i=0; i<NumOutputs; i++)
+		pose.setOutputCmd(i,getOutputCmd(i));
+}
+
+void KeyframeSequenceMC::importSequence(const MotionSequenceEngine& ms) {
+	std::vector<std::pair<unsigned int,OutputCmd> > frames;
+	for(unsigned int i=0; i<NumOutputs; i++) {
+		ms.getKeyFrames(i,frames);
+		for(std::vector<std::pair<unsigned int,OutputCmd> >::const_iterator it=frames.begin(); it!=frames.end(); ++it) {
+			// an unweighted initial frame is just a placeholder for the current position, don't clobber ours
+			if(it->first==0 && it->second.weight==0)
+				continue;
+			insertKeyFrame(i,it->first,it->second);
+		}
+	}
+	if(ms.getEndTime()>endtime)
+		endtime=ms.getEndTime();
+	setTime(ms.getEndTime());
+}
+
+void KeyframeSequenceMC::exportSequence(MotionSequenceEngine& ms) const {
+	for(unsigned int i=0; i<NumOutputs; i++) {
+		for(std::vector<KeyFrame>::const_iterator it=keys[i].begin(); it!=keys[i].end(); ++it) {
+			if(it->time==0 && it->cmd.weight==0)
+				continue;
+			ms.setTime(it->time);
+			ms.setOutputCmd(i,it->cmd);
+		}
+	}
+	ms.setTime(endtime);
+}
+
+unsigned int KeyframeSequenceMC::getUsedFrames() const {
+	unsigned int n=0;
+	for(unsigned int i=0; i<NumOutputs; i++)
+		n+=keys[i].size();
+	return n;
+}
+
+void KeyframeSequenceMC::play() {
+	if(playspeed>0)
+		setTime(0);
+	else
+		setTime(endtime);
+	resume();
+}
+
+void KeyframeSequenceMC::resume() {
+	playing=true;
+	lasttime=get_time();
+	const WorldState * st=WorldState::getCurrent();
+	for(unsigned int i=0; i<NumOutputs; i++) {
+		for(std::vector<KeyFrame>::const_iterator it=keys[i].begin(); it!=keys[i].end(); ++it) {
+			if(it->cmd.weight!=0) {
+				keys[i][0].cmd.value=st->outputs[i];
+				curstamps[i]=-1U;
+				break;
+			}
+		}
+	}
+}
+
+void KeyframeSequenceMC::setHold(bool h/*=true*/) {
+	hold=h;
+	for(unsigned int i=0; i<NumOutputs; i++)
+		curstamps[i]=-1U; // cached values past the end depend on hold
+}
+
+void KeyframeSequenceMC::setInterpolation(Interpolation_t i) {
+	interpolation=i;
+	for(unsigned int j=0; j<NumOutputs; j++)
+		curstamps[j]=-1U;
+}
+
+bool KeyframeSequenceMC::seek(unsigned int i, unsigned int t, unsigned int& cursor) const {
+	const std::vector<KeyFrame>& k=keys[i];
+	if(k[cursor].time<=t) {
+		if(cursor+1>=k.size() || k[cursor+1].time>t)
+			return false; // still in the same interval
+		if(cursor+2>=k.size() || k[cursor+2].time>t) {
+			++cursor; // normal playback, just crossed into the next interval
+			return true;
+		}
+	}
+	// seeking, search for the last keyframe at or before t (the first is always at time 0)
+	cursor=std::upper_bound(k.begin(),k.end(),t,timeBefore)-k.begin()-1;
+	return true;
+}
+
+void KeyframeSequenceMC::calcOutput(unsigned int i, unsigned int t, unsigned int cursor, OutputCmd& ans) const {
+	const std::vector<KeyFrame>& k=keys[i];
+	if(cursor+1>=k.size()) {
+		if(hold)
+			ans=k[cursor].cmd;
+		else
+			ans.unset();
+		return;
+	}
+	const KeyFrame& prev=k[cursor];
+	const KeyFrame& next=k[cursor+1];
+	const unsigned int dt=next.time-prev.time;
+	float prevweight=(float)(next.time-t)/(float)dt;
+	ans.set(prev.cmd,next.cmd,prevweight);
+	if(interpolation==HERMITE && prev.cmd.weight>0 && next.cmd.weight>0) {
+		NonUniformHermiteSplineSegment<float,float> seg;
+		seg.create(prev.cmd.value,next.cmd.value,tangent(i,cursor),tangent(i,cursor+1),(float)dt);
+		ans.value=seg.eval((float)(t-prev.time));
+	}
+}
+
+/*! Catmull-Rom tangents, limited as by Fritsch and Carlson so that the curve is monotonic
+ *  between keyframes: zero at the ends, next to unweighted keyframes, and at local extrema,
+ *  and otherwise at most three times the slope of either adjacent segment. */
+float KeyframeSequenceMC::tangent(unsigned int i, unsigned int k) const {
+	const std::vector<KeyFrame>& f=keys[i];
+	if(k==0 || k+1>=f.size())
+		return 0;
+	const KeyFrame& prev=f[k-1];
+	const KeyFrame& cur=f[k];
+	const KeyFrame& next=f[k+1];
+	if(prev.cmd.weight<=0 || next.cmd.weight<=0)
+		return 0;
+	const float d0=(cur.cmd.value-prev.cmd.value)/(float)(cur.time-prev.time);
+	const float d1=(next.cmd.value-cur.cmd.value)/(float)(next.time-cur.time);
+	if(d0*d1<=0)
+		return 0;
+	const float m=(next.cmd.value-prev.cmd.value)/(float)(next.time-prev.time);
+	const float lim=3*std::min(std::abs(d0),std::abs(d1));
+	if(std::abs(m)>lim)
+		return (m<0) ? -lim : lim;
+	return m;
+}
+
+void KeyframeSequenceMC::insertKeyFrame(unsigned int i, unsigned int t, const OutputCmd& cmd) {
+	std::vector<KeyFrame>& k=keys[i];
+	std::vector<KeyFrame>::iterator it=std::upper_bound(k.begin(),k.end(),t,timeBefore);
+	if((it-1)->time==t) {
+		(it-1)->cmd=cmd; // edit existing keyframe
+	} else {
+		const unsigned int idx=it-k.begin();
+		k.insert(it,KeyFrame(t,cmd));
+		if(idx<=cursors[i])
+			++cursors[i];
+		seek(i,playtime,cursors[i]);
+		if(t>endtime)
+			endtime=t;
+	}
+	curstamps[i]=-1U;
+}
+
+/*! @file
+ * @brief Implements KeyframeSequenceMC, which plays motion sequences stored in sorted per-output keyframe arrays, with optional spline interpolation
+ */
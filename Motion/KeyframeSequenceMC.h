@@ -0,0 +1,137 @@
+//-*-c++-*-
+#ifndef INCLUDED_KeyframeSequenceMC_h_
+#define INCLUDED_KeyframeSequenceMC_h_
+
+#include "Motion/MotionCommand.h"
+#include "Shared/LoadSave.h"
+#include <vector>
+
+class MotionSequenceEngine;
+class PostureEngine;
+
+//! Plays a keyframed motion sequence like MotionSequenceMC, but stores each output's keyframes in a sorted array, for long sequences such as recorded motions
+/*! MotionSequenceEngine links keyframes into lists, so seeking walks from frame to frame,
+ *  and its subclasses are limited to 65535 keyframes.  KeyframeSequenceMC keeps each output's
+ *  keyframes in order in a contiguous array: setTime() does a binary search per output, while
+ *  normal playback just steps a cursor forward.
+ *
+ *  Playback semantics match MotionSequenceEngine: each output has an initial, zero-weight frame
+ *  at time 0 which is replaced with the current position when play() is called (so the first
+ *  keyframe fades in from wherever the joint is), and when a joint passes its last keyframe,
+ *  #hold determines whether it keeps that value or goes unused.
+ *
+ *  Between keyframes, values are interpolated linearly by default.  With setInterpolation(HERMITE),
+ *  values follow a cubic Hermite spline (see NonUniformHermiteSplineSegment) through the keyframes,
+ *  which is smoother when keyframes are sparse.  Tangents are Catmull-Rom style (the slope between
+ *  the neighboring keyframes), except that they are zero at the first and last keyframes and at
+ *  keyframes which are a local extremum, so the curve never overshoots the keyframe values.
+ *  Weights are always interpolated linearly.
+ *
+ *  loadFile() accepts the text motion sequence (@c \#MSq) and posture (@c \#POS) formats, as well as
+ *  a binary format written by saveFile(), which is much faster to load for long sequences.  Text
+ *  sequences can be converted with importSequence() and exportSequence().
+ *
+ *  Like DynamicMotionSequence, the keyframes are allocated on the heap, so this shouldn't be
+ *  shared between processes. */
+class KeyframeSequenceMC : public MotionCommand, public LoadSave {
+public:
+	//! how to interpolate between keyframes
+	enum Interpolation_t {
+		LINEAR, //!< straight line between keyframes (like MotionSequenceEngine)
+		HERMITE //!< cubic Hermite spline through the keyframes
+	};
+
+	//! A single keyframe for one output
+	struct KeyFrame {
+		//! constructor
+		KeyFrame() : time(0), cmd() {}
+		//! constructor
+		KeyFrame(unsigned int t, const OutputCmd& c) : time(t), cmd(c) {}
+		unsigned int time; //!< the time (relative to the start of the sequence) this frame should be expressed at
+		OutputCmd cmd; //!< the value and weight of the output at #time
+	};
+
+	//! constructor, will start playing immediately once added to MotionManager
+	KeyframeSequenceMC();
+	//! constructor, loads from a file, then resets the playtime to beginning and begins to play
+	explicit KeyframeSequenceMC(const std::string& filename);
+	//! destructor
+	virtual ~KeyframeSequenceMC() {}
+
+	virtual int updateOutputs();
+	virtual int isDirty() { return isPlaying(); }
+	virtual int isAlive() { return (playspeed>0) ? (playtime<=endtime) : (playtime>0); }
+
+	//!@name LoadSave related
+	virtual unsigned int getBinSize() const; //!< returns the size of the binary format
+	virtual unsigned int loadBuffer(const char buf[], unsigned int len, const char* filename=NULL); //!< loads binary, @c \#MSq, or @c \#POS data; doesn't clear, keyframes overlay existing ones at their own times; leaves playtime at the end of the loaded sequence
+	virtual unsigned int saveBuffer(char buf[], unsigned int len) const; //!< saves in the binary format
+	virtual unsigned int loadFile(const char filename[]); //!< like loadBuffer(), relative paths are relative to the motion directory
+	virtual unsigned int saveFile(const char filename[]) const; //!< saves in the binary format, relative paths are relative to the motion directory
+	//@}
+
+	//!@name Sequence Construction
+	void clear(); //!< removes all keyframes
+	void setTime(unsigned int x); //!< set the time for both playback and editing (in milliseconds)
+	unsigned int advanceTime(unsigned int x) { setTime(playtime+x); return playtime; } //!< advance the play/edit index by @a x milliseconds, and then returns the new getTime()
+	void setOutputCmd(unsigned int i, const OutputCmd& cmd); //!< inserts a keyframe for output @a i at the playhead, or replaces the one already there
+	const OutputCmd& getOutputCmd(unsigned int i); //!< returns the value of output @a i at the playhead
+	void setPose(const PostureEngine& pose); //!< calls setOutputCmd() for all non-zero weighted OutputCmds in @a pose
+	void setExplicitPose(const PostureEngine& pose); //!< calls setOutputCmd() for each of the OutputCmds in @a pose, even if they are zero-weight
+	void getPose(PostureEngine& pose); //!< stores the OutputCmds at the playhead into @a pose
+	void importSequence(const MotionSequenceEngine& ms); //!< copies the keyframes of @a ms (at their own times, replacing any coinciding keyframes) and leaves the playhead at its end
+	void exportSequence(MotionSequenceEngine& ms) const; //!< adds each keyframe to @a ms, e.g. to save in the text format; MotionSequenceEngine's capacity may be exceeded by long sequences
+	unsigned int getNumKeyFrames(unsigned int i) const { return keys[i].size(); } //!< returns the number of keyframes for output @a i, including the initial frame
+	const KeyFrame& getKeyFrame(unsigned int i, unsigned int k) const { return keys[i][k]; } //!< returns keyframe @a k of output @a i, in order of time
+	unsigned int getUsedFrames() const; //!< returns the total number of keyframes for all outputs, including the initial frames
+	//@}
+
+	//!@name Playback Control
+	bool isPlaying() { return playing && ((playspeed>0) ? (playtime<endtime) : (playtime>0)); } //!< returns true if currently playing
+	void play(); //!< restarts playback from the beginning
+	void pause() { playing=false; } //!< pauses playback until another call to play() or resume()
+	void resume(); //!< begins playback from the current playtime
+	unsigned int getTime() const { return playtime; } //!< returns the current position of the playback (in milliseconds), see setTime()
+	unsigned int getEndTime() const { return endtime; } //!< returns the length of the motion sequence (in milliseconds)
+	void setSpeed(float x) { playspeed=x; } //!< sets the playback speed (e.g. 1=regular, 0.5=half speed, -1=@b backwards)
+	float getSpeed() const { return playspeed; } //!< returns the playback speed
+	void setHold(bool h=true); //!< sets #hold
+	bool getHold() const { return hold; } //!< returns #hold
+	void setInterpolation(Interpolation_t i); //!< sets #interpolation
+	Interpolation_t getInterpolation() const { return interpolation; } //!< returns #interpolation
+	//@}
+
+protected:
+	static const char BINARY_MAGIC[5]; //!< identifies the binary format
+	static const unsigned int BINARY_VERSION=1; //!< the version of the binary format
+
+	//! moves @a cursor, an index into #keys[@a i], to the last keyframe at or before @a t (stepping if nearby, otherwise a binary search); returns true if it moved
+	bool seek(unsigned int i, unsigned int t, unsigned int& cursor) const;
+	//! computes the command for output @a i at time @a t, where @a cursor is the result of seek()
+	void calcOutput(unsigned int i, unsigned int t, unsigned int cursor, OutputCmd& ans) const;
+	//! returns the Hermite tangent (value per millisecond) at keyframe @a k of output @a i
+	float tangent(unsigned int i, unsigned int k) const;
+	//! inserts or replaces a keyframe of output @a i at time @a t
+	void insertKeyFrame(unsigned int i, unsigned int t, const OutputCmd& cmd);
+	//! loads the binary format, returns the number of bytes used or 0 on error
+	unsigned int loadBinary(const char buf[], unsigned int len);
+
+	std::vector<KeyFrame> keys[NumOutputs]; //!< the keyframes of each output, sorted by time; the first is always at time 0
+	unsigned int cursors[NumOutputs]; //!< index of the keyframe in #keys at or before #playtime, for each output
+	OutputCmd curs[NumOutputs]; //!< cache of the values at #playtime, see #curstamps
+	unsigned int curstamps[NumOutputs]; //!< the playtime at which the corresponding entry of #curs was computed, -1U if invalid
+	unsigned int playtime; //!< the current time of playback, 0 is start of sequence
+	unsigned int lasttime; //!< the time of the last update
+	unsigned int endtime; //!< the time of the last keyframe
+	float playspeed; //!< multiplies the difference between current time and starttime, negative will cause play backwards
+	bool playing; //!< true if playing, false if paused
+	bool hold; //!< if true, an output holds its last keyframe after passing it; otherwise the output is unused after its last keyframe
+	Interpolation_t interpolation; //!< how to interpolate values between keyframes
+	bool dirty; //!< true if last updateOutputs was dirty, so we know when to post status event
+};
+
+/*! @file
+ * @brief Describes KeyframeSequenceMC, which plays motion sequences stored in sorted per-output keyframe arrays, with optional spline interpolation
+ */
+
+#endif
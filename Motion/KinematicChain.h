@@ -0,0 +1,213 @@
+//-*-c++-*-
+#ifndef INCLUDED_KinematicChain_h_
+#define INCLUDED_KinematicChain_h_
+
+#include "Motion/KinematicJoint.h"
+#include "Shared/fmat.h"
+#include <cmath>
+#include <vector>
+
+//! A flat copy of a serial chain of exactly @a N mobile joints, for fast allocation-free kinematics on the models which have a fixed structure
+/*! The chain is initialized from the KinematicJoint tree loaded from the robot's .kin file, so
+ *  it stays in sync with the configuration, but is then independent of the tree.  Each mobile
+ *  joint is stored as a Link, with any immobile joints which precede it folded into its
+ *  Link::To, and any immobile joints after the last mobile joint folded into #tip.  Since the
+ *  number of links is a compile-time constant, all storage is inline (the chain is copied by
+ *  value, with no heap allocation) and the compiler can unroll the loops over the links.
+ *
+ *  Joint values are passed in as an array of @a N values, ordered from the base, and all results
+ *  are in the frame of the @a base passed to init() (or the root's parent frame, same as
+ *  KinematicJoint::getFullT()).  Unlike the tree, nothing is cached, so the chain can be shared
+ *  between threads.
+ *
+ *  The KinematicJoint tree remains the general representation (branches, editing, plist
+ *  listeners), this is only a fast path for chains which are evaluated often, such as the camera
+ *  chain used by Kinematics::projectToPlane() (the camera frame itself is a prismatic joint along
+ *  the viewing axis, so it counts as one of the mobile joints):
+ *  @code
+ *  KinematicChain<NumHeadJoints+1> camChain;
+ *  if(camChain.init(*kine->getKinematicJoint(CameraFrameOffset))) {
+ *  	fmat::fmatReal q[NumHeadJoints+1];
+ *  	for(unsigned int i=0; i<NumHeadJoints+1; ++i) {
+ *  		const unsigned int o = camChain.getLink(i).output;
+ *  		q[i] = (o<NumOutputs) ? state->outputs[o] : camChain.getLink(i).q;
+ *  	}
+ *  	fmat::Transform camToBase = camChain.getEffectorT(q);
+ *  }
+ *  @endcode */
+template<size_t N>
+class KinematicChain {
+public:
+	static const size_t NumJoints=N; //!< the number of mobile joints in the chain
+
+	//! A mobile joint and the rigid body it moves
+	struct Link {
+		//! constructor
+		Link() : To(), type(KinematicJoint::REVOLUTE), qOffset(0), qmin(0), qmax(0), output(-1U), q(0), mass() {}
+		fmat::Transform To; //!< converts from the joint's frame (where the joint value is 0) to the previous link's frame, including the immobile joints in between
+		KinematicJoint::JointType_t type; //!< whether the joint rotates or slides along its z axis
+		fmat::fmatReal qOffset; //!< the KinematicJoint::qOffset, added to the joint value
+		float qmin; //!< the lower limit of the joint value
+		float qmax; //!< the upper limit of the joint value
+		unsigned int output; //!< the KinematicJoint::outputOffset, or plist::OutputSelector::UNUSED
+		float q; //!< the joint value when the chain was initialized, for use if the joint has no #output
+		fmat::Column<4> mass; //!< unnormalized center of mass of the link, its components, and the immobile joints rigidly attached to it along the chain, in the link's frame
+	};
+
+	//! constructor, the chain is invalid until init() is called
+	KinematicChain() : tip(), baseMass(), valid(false) {}
+
+	//! copies the chain from @a base (exclusive) to @a effector (inclusive), returns false (leaving the chain invalid) if @a base is not an ancestor or there are not exactly @a N mobile joints between them
+	/*! If @a base is NULL, the chain starts at the root of the tree. */
+	bool init(const KinematicJoint& effector, const KinematicJoint* base=NULL);
+
+	//! returns true if init() has succeeded
+	bool isValid() const { return valid; }
+
+	//! returns the parameters of mobile joint @a i, counting from the base
+	const Link& getLink(size_t i) const { return links[i]; }
+	//! returns the transformation from the effector's frame to the last link's frame
+	const fmat::Transform& getTip() const { return tip; }
+
+	//! stores the transformation from each link's frame to the base frame into @a T, given joint values @a q
+	void getLinkTransforms(const fmat::fmatReal q[N], fmat::Transform T[N]) const {
+		fmat::Transform Tq;
+		computeTq(links[0],q[0],T[0]);
+		for(size_t i=1; i<N; ++i) {
+			computeTq(links[i],q[i],Tq);
+			T[i] = T[i-1]*Tq;
+		}
+	}
+
+	//! returns the transformation from the effector's frame to the base frame, given joint values @a q
+	fmat::Transform getEffectorT(const fmat::fmatReal q[N]) const {
+		fmat::Transform T, Tq;
+		computeTq(links[0],q[0],T);
+		for(size_t i=1; i<N; ++i) {
+			computeTq(links[i],q[i],Tq);
+			T = T*Tq;
+		}
+		return T*tip;
+	}
+
+	//! stores the Jacobian of the point @a pEff (in the effector's frame) into @a J, given joint values @a q
+	/*! Like KinematicJoint::getFullJacobian(), column @e i holds the motion of the point per unit of
+	 *  joint @e i in the first 3 rows, and the axis of rotation (or 0's for a prismatic joint) in
+	 *  the last 3 rows, all in base coordinates. */
+	void getJacobian(const fmat::fmatReal q[N], const fmat::Column<3>& pEff, fmat::Matrix<6,N>& J) const {
+		fmat::Transform T[N];
+		getLinkTransforms(q,T);
+		const fmat::Column<3> p = T[N-1]*(tip*pEff);
+		for(size_t i=0; i<N; ++i) {
+			const fmat::fmatReal zx=T[i](0,2), zy=T[i](1,2), zz=T[i](2,2);
+			if(links[i].type==KinematicJoint::REVOLUTE) {
+				const fmat::fmatReal vx=p[0]-T[i](0,3), vy=p[1]-T[i](1,3), vz=p[2]-T[i](2,3);
+				J(0,i) = zy*vz - zz*vy;
+				J(1,i) = zz*vx - zx*vz;
+				J(2,i) = zx*vy - zy*vx;
+				J(3,i) = zx;
+				J(4,i) = zy;
+				J(5,i) = zz;
+			} else {
+				J(0,i) = zx;
+				J(1,i) = zy;
+				J(2,i) = zz;
+				J(3,i) = J(4,i) = J(5,i) = 0;
+			}
+		}
+	}
+
+	//! returns the unnormalized center of mass of the links along the chain (not branches leaving it) in the base frame, given joint values @a q
+	/*! The last element (homogeneous scale factor) is left as the total mass, so divide by this value to normalize. */
+	fmat::Column<4> sumCenterOfMass(const fmat::fmatReal q[N]) const {
+		fmat::Column<4> com = baseMass;
+		fmat::Transform T, Tq;
+		computeTq(links[0],q[0],T);
+		com += T*links[0].mass;
+		for(size_t i=1; i<N; ++i) {
+			computeTq(links[i],q[i],Tq);
+			T = T*Tq;
+			com += T*links[i].mass;
+		}
+		return com;
+	}
+
+protected:
+	//! stores the transformation from @a link's frame to the previous link's frame into @a Tq, like KinematicJoint::computeTq() (but without assuming To(2,0) is 0, since immobile joints are folded in)
+	static void computeTq(const Link& link, fmat::fmatReal q, fmat::Transform& Tq) {
+		const fmat::Transform& To = link.To;
+		const fmat::fmatReal qv = q+link.qOffset;
+		if(link.type==KinematicJoint::REVOLUTE) {
+			const fmat::fmatReal cq = std::cos(qv);
+			const fmat::fmatReal sq = std::sin(qv);
+			for(size_t r=0; r<3; ++r) {
+				Tq(r,0) = cq*To(r,0) + sq*To(r,1);
+				Tq(r,1) = -sq*To(r,0) + cq*To(r,1);
+				Tq(r,2) = To(r,2);
+				Tq(r,3) = To(r,3);
+			}
+		} else {
+			for(size_t r=0; r<3; ++r) {
+				Tq(r,0) = To(r,0);
+				Tq(r,1) = To(r,1);
+				Tq(r,2) = To(r,2);
+				Tq(r,3) = To(r,2)*qv + To(r,3);
+			}
+		}
+	}
+
+	Link links[N]; //!< the mobile joints, ordered from the base
+	fmat::Transform tip; //!< converts from the effector's frame to the last link's frame (the immobile joints after the last mobile joint)
+	fmat::Column<4> baseMass; //!< unnormalized center of mass of the immobile joints before the first mobile joint, in the base frame
+	bool valid; //!< set by init()
+};
+
+template<size_t N>
+bool KinematicChain<N>::init(const KinematicJoint& effector, const KinematicJoint* base/*=NULL*/) {
+	valid=false;
+	std::vector<const KinematicJoint*> path;
+	size_t mobile=0;
+	for(const KinematicJoint* kj=&effector; kj!=base; kj=kj->getParent()) {
+		if(kj==NULL)
+			return false;
+		path.push_back(kj);
+		if(kj->isMobile())
+			++mobile;
+	}
+	if(mobile!=N)
+		return false;
+
+	// walk from the base, accumulating immobile joints until the next mobile joint
+	fmat::Transform fixed;
+	baseMass=fmat::Column<4>();
+	fmat::Column<4>* rigidMass=&baseMass;
+	size_t i=0;
+	for(std::vector<const KinematicJoint*>::const_reverse_iterator it=path.rbegin(); it!=path.rend(); ++it) {
+		const KinematicJoint& kj=**it;
+		if(kj.isMobile()) {
+			Link& l=links[i++];
+			l.To = fixed*kj.getTo();
+			l.type = kj.jointType;
+			l.qOffset = kj.qOffset;
+			l.qmin = kj.qmin;
+			l.qmax = kj.qmax;
+			l.output = kj.outputOffset;
+			l.q = kj.getQ();
+			l.mass = kj.sumLinkCenterOfMass();
+			rigidMass = &l.mass;
+			fixed = fmat::Transform::identity();
+		} else {
+			fixed = fixed*kj.getTq();
+			*rigidMass += fixed*kj.sumLinkCenterOfMass();
+		}
+	}
+	tip=fixed;
+	valid=true;
+	return true;
+}
+
+/*! @file
+ * @brief Describes KinematicChain, a flat fixed-size copy of a serial chain of a KinematicJoint tree for fast forward kinematics
+ */
+
+#endif
@@ -248,10 +248,12 @@ void KinematicJoint::zeroAncestorQ() {
 }
 
 
-fmat::Transform KinematicJoint::getFullT() const {
-	fmat::Transform t;
-	getFullT(t,NULL);
-	return t;
+void KinematicJoint::updateFullT() const {
+	if(parent==NULL)
+		fullT=Tq;
+	else
+		fullT=parent->getFullT()*Tq;
+	fullTDirty=false;
 }
 
 fmat::Transform KinematicJoint::getT(const KinematicJoint& j) const {
@@ -288,11 +290,17 @@ void KinematicJoint::sumCenterOfMass(fmat::Column<3>& cOfM, float& totalMass) co
 	totalMass=com[3];
 }
 
-fmat::Column<4> KinematicJoint::sumCenterOfMass() const {	
-	fmat::Column<4> com = sumLinkCenterOfMass();
+void KinematicJoint::updateCOM() const {
+	subtreeCOM = sumLinkCenterOfMass();
 	for(branch_iterator it=branches.begin(); it!=branches.end(); ++it)
-		com += (*it)->getTq() * (*it)->sumCenterOfMass();
-	return com;
+		subtreeCOM += (*it)->getTq() * (*it)->sumCenterOfMass();
+	comDirty=false;
+}
+
+void KinematicJoint::dirtyCOM() {
+	// ancestors of a dirty joint are already dirty, so we can stop there
+	for(KinematicJoint* j=this; j!=NULL && !j->comDirty; j=j->parent)
+		j->comDirty=true;
 }
 
 void LinkComponent::sumLinkCenterOfMass(fmat::Column<3>& cOfM, float& totalMass) const {
@@ -504,6 +512,13 @@ void KinematicJoint::updateTo() {
 }
 
 void KinematicJoint::updateTq() {
+	computeTq();
+	dirtyFullT();
+	if(parent!=NULL)
+		parent->dirtyCOM();
+}
+
+void KinematicJoint::computeTq() {
 	const fmat::fmatReal qv = static_cast<fmat::fmatReal>(q+qOffset);
 	switch(jointType) {
 		case REVOLUTE: {
@@ -593,6 +608,11 @@ void LinkComponent::dirtyBB() {
 		static_cast<LinkComponent&>(*parent).dirtyBB(); // silly cast because compiler complains about dirtyBB being protected otherwise :-P
 }
 
+void LinkComponent::dirtyCOM() {
+	if(parent!=NULL)
+		static_cast<LinkComponent&>(*parent).dirtyCOM(); // same silly cast as dirtyBB()
+}
+
 void LinkComponent::computeOwnAABB(BoundingBox3D& bb) const {
 	if(collisionModel.size()==0) {
 		// no collision shape, no bounding box
@@ -771,6 +791,8 @@ KinematicJoint* KinematicJoint::addBranch(KinematicJoint* b) {
 		throw std::runtime_error("KinematicJoint was told to add a branch which has a non-zero depth (but doesn't have a parent!?!?  Something's broken.)");
 	b->parent=this;
 	b->updateDepth();
+	b->dirtyFullT();
+	dirtyCOM();
 	fireBranchAdded(*b);
 	return b;
 }
@@ -780,6 +802,8 @@ KinematicJoint* KinematicJoint::removeBranch(KinematicJoint* b) {
 		return NULL;
 	b->parent=NULL;
 	b->depth=0;
+	b->dirtyFullT();
+	dirtyCOM();
 	fireBranchRemoved(*b);
 	return b;
 }
@@ -789,6 +813,7 @@ void KinematicJoint::clearBranches() {
 		for(std::set<KinematicJoint*>::const_iterator it=branches.begin(); it!=branches.end(); ++it)
 			delete *it;
 		branches.clear();
+		dirtyCOM();
 	} else {
 		while(branches.size()>0)
 			delete removeBranch(*branches.begin());
@@ -33,7 +33,9 @@ public:
 		collisionModelListener(collisionModel,*this,&LinkComponent::dirtyBB,false),
 		collisionModelScaleListener(collisionModelScale,*this,&LinkComponent::dirtyBB,false),
 		collisionModelRotationListener(collisionModelRotation,*this,&LinkComponent::dirtyBB,false),
-		collisionModelOffsetListener(collisionModelOffset,*this,&LinkComponent::dirtyBB,false)
+		collisionModelOffsetListener(collisionModelOffset,*this,&LinkComponent::dirtyBB,false),
+		massListener(mass,*this,&LinkComponent::dirtyCOM,false),
+		centerOfMassListener(centerOfMass,*this,&LinkComponent::dirtyCOM,false)
 	{
 		init();
 	}
@@ -48,7 +50,9 @@ public:
 		collisionModelListener(collisionModel,*this,&LinkComponent::dirtyBB,false),
 		collisionModelScaleListener(collisionModelScale,*this,&LinkComponent::dirtyBB,false),
 		collisionModelRotationListener(collisionModelRotation,*this,&LinkComponent::dirtyBB,false),
-		collisionModelOffsetListener(collisionModelOffset,*this,&LinkComponent::dirtyBB,false)
+		collisionModelOffsetListener(collisionModelOffset,*this,&LinkComponent::dirtyBB,false),
+		massListener(mass,*this,&LinkComponent::dirtyCOM,false),
+		centerOfMassListener(centerOfMass,*this,&LinkComponent::dirtyCOM,false)
 	{
 		init();
 	}
@@ -171,6 +175,7 @@ protected:
 	mutable BoundingBox3D boundingBox; //!< bounding box of this link (including subcomponents, but not child links)
 	
 	virtual void dirtyBB(); //!< sets #bbDirty to true to cause it to be recomputed on next getAABB() call
+	virtual void dirtyCOM(); //!< notifies #parent that its cached center of mass (see KinematicJoint::sumCenterOfMass()) needs to be recomputed
 	virtual void updateBB() const; //!< recomputes #boundingBoxLow and #boundingBoxHigh based on collision model parameters
 	void computeOwnAABB(BoundingBox3D& bb) const;
 	static void computeBB2D(const fmat::Transform& fullT, RectangularObstacle& ro, const fmat::Column<3>& obD);
@@ -196,6 +201,8 @@ protected:
 	plist::CollectionCallbackMember<LinkComponent> collisionModelScaleListener; //!< indicates bounding box values need to be rebuilt
 	plist::CollectionCallbackMember<LinkComponent> collisionModelRotationListener; //!< indicates bounding box values need to be rebuilt
 	plist::CollectionCallbackMember<LinkComponent> collisionModelOffsetListener; //!< indicates bounding box values need to be rebuilt
+	plist::PrimitiveCallbackMember<LinkComponent> massListener; //!< indicates cached centers of mass need to be recomputed
+	plist::CollectionCallbackMember<LinkComponent> centerOfMassListener; //!< indicates cached centers of mass need to be recomputed
 };
 
 
@@ -217,7 +224,8 @@ public:
 	  jointType(REVOLUTE, jointTypeNames), theta(0), d(0), alpha(0), r(0), qOffset(0), qmin(0), qmax(0),
 	  components(), frictionForce(0.5f), anistropicFrictionRatio(1,1,1), ikSolver(), sensorInfo(),
 	  controllerInfo(), outputOffset(), branches(), branchListeners(NULL),
-	  depth(0), q(0), To(), Tq(), ik(NULL), componentsListener(components,*this)
+	  depth(0), q(0), To(), Tq(), fullT(), fullTDirty(true), subtreeCOM(), comDirty(true),
+	  ik(NULL), componentsListener(components,*this)
   {
 		initEntries();
   }
@@ -231,6 +239,7 @@ public:
 	  anistropicFrictionRatio(kj.anistropicFrictionRatio), ikSolver(kj.ikSolver), 
 	  sensorInfo(kj.sensorInfo), controllerInfo(kj.controllerInfo), outputOffset(kj.outputOffset),
 	  branches(), branchListeners(NULL), depth(0), q(kj.q), To(kj.To), Tq(kj.Tq),
+	  fullT(), fullTDirty(true), subtreeCOM(), comDirty(true),
 	  ik(NULL), componentsListener(components,*this)
 	{
 		initEntries();
@@ -265,6 +274,8 @@ public:
 		q = kj.q;
 		To = kj.To;
 		Tq = kj.Tq;
+		dirtyFullT();
+		dirtyCOM();
 		fireReconfigured();
 		// ** note what is NOT copied: **
 		//branchListeners = kj.branchListeners;
@@ -398,6 +409,19 @@ public:
 			parent->pullAncestorsQFromArray(values, deoffset, max);
 	}		
 	
+	//! sets the position of this joint and all of its descendants from a flat array (using #outputOffset, see pullChildrenQFromArray()), and recomputes their cached world transforms in a single pass
+	/*! Unlike pullChildrenQFromArray(), immobile joints are set as well (like Kinematics::update()).
+	 *  This is cheaper than calling setQ() on each joint followed by getFullT(), since each
+	 *  transform is computed once from its parent's, instead of invalidating subtrees repeatedly. */
+	template<class M> void updateAll(const M& values, int deoffset=0, unsigned int max=-1U) {
+		if(parent==NULL) {
+			updateAll(values, deoffset, max, fmat::Transform());
+		} else {
+			updateAll(values, deoffset, max, parent->getFullT());
+			parent->dirtyCOM();
+		}
+	}
+	
 	//! sets the joint position and its childrens' to zero
 	void zeroChildrenQ();
 	
@@ -406,7 +430,9 @@ public:
 	
 	
 	//! returns the tranformation matrix which converts from the link's reference frame (i.e. the frame which moves with the joint's #q) to the base frame
-	fmat::Transform getFullT() const;
+	/*! The result is cached, and only recomputed (from the parent's cached transform) after this
+	 *  joint or one of its ancestors has moved or been reconfigured.  Like setQ(), this is not thread safe. */
+	const fmat::Transform& getFullT() const { if(fullTDirty) updateFullT(); return fullT; }
 	
 	//! returns the tranformation matrix which converts from the base frame to the link's reference frame (i.e. the frame which moves with the joint's #q)
 	fmat::Transform getFullInvT() const { return getFullT().rigidInverse(); }
@@ -426,8 +452,9 @@ public:
 	void sumCenterOfMass(fmat::Column<3>& cOfM, float& totalMass) const;
 	
 	//! returns the unnormalized center of mass of this link and all of its branches, given their current positions, relative to this link
-	/*! The last element (homogeneous scale factor) is left as the total mass, so divide by this value to normalize. */
-	fmat::Column<4> sumCenterOfMass() const;
+	/*! The last element (homogeneous scale factor) is left as the total mass, so divide by this value to normalize.
+	 *  The result is cached, and only recomputed after a descendant moves, or a mass in the subtree changes. */
+	const fmat::Column<4>& sumCenterOfMass() const { if(comDirty) updateCOM(); return subtreeCOM; }
 	
 	//! returns the unnormalized center of mass of this link only, not including any branches
 	/*! The last element (homogeneous scale factor) is left as the total mass, so divide by this value to normalize. */
@@ -613,7 +640,9 @@ protected:
 	/*! @a t does not need to be initialized to anything prior to call, but will be 4x4 on return \n
 	  *  @a endj @e must be an ancestor of this joint or the function will segfault (NULL is the ancestor of the root, so that's valid) */
 	void getFullT(fmat::Transform& t, const KinematicJoint* endj) const {
-		if(parent!=endj) {
+		if(endj==NULL) {
+			t=getFullT();
+		} else if(parent!=endj) {
 			parent->getFullT(t,endj);
 			t*=Tq;
 		} else {
@@ -641,7 +670,32 @@ protected:
 	virtual void addSelfListener(); //!< subscribes the instance to be notified of changes to its public plist::Primitive members, and then calls updateTo()
 	virtual void removeSelfListener(); //!< unsubscribes the instance from its public plist::Primitive members
 	void updateTo(); //!< regenerates #To from the a, d, alpha, and theta parameters, includes call to updateTq() as well
-	void updateTq(); //!< updates #Tq from the q and qOffset parameters (based on current #To)
+	void updateTq(); //!< updates #Tq from the q and qOffset parameters (based on current #To), and invalidates the cached transforms and centers of mass which depend on it
+	void computeTq(); //!< does the work of updateTq(), without invalidating caches
+	void updateFullT() const; //!< recomputes #fullT from the parent's full transform and #Tq
+	void updateCOM() const; //!< recomputes #subtreeCOM from the link's components and the branches' cached centers of mass
+	//! marks #fullT of this joint and its descendants as needing to be recomputed; stops at any already marked, since their descendants must be as well
+	void dirtyFullT() {
+		if(fullTDirty)
+			return;
+		fullTDirty=true;
+		for(std::set<KinematicJoint*>::const_iterator it=branches.begin(); it!=branches.end(); ++it)
+			(*it)->dirtyFullT();
+	}
+	virtual void dirtyCOM(); //!< marks #subtreeCOM of this joint and its ancestors as needing to be recomputed
+	
+	//! recursive implementation of updateAll(), @a parentT is the parent's full transform
+	template<class M> void updateAll(const M& values, int deoffset, unsigned int max, const fmat::Transform& parentT) {
+		if(outputOffset!=plist::OutputSelector::UNUSED && static_cast<unsigned int>(outputOffset-deoffset)<max && values[outputOffset-deoffset]!=q) {
+			q=values[outputOffset-deoffset];
+			computeTq();
+		}
+		fullT = parentT * Tq;
+		fullTDirty=false;
+		comDirty=true;
+		for(std::set<KinematicJoint*>::const_iterator it=branches.begin(); it!=branches.end(); ++it)
+			(*it)->updateAll(values, deoffset, max, fullT);
+	}
 	virtual void updateBB() const;
 	void updateDepth() {
 		if(parent==NULL)
@@ -664,10 +718,14 @@ protected:
 	fmat::fmatReal q; //!< current joint position (radian rotation about z if revolute, displacement along z if prismatic)
 	fmat::Transform To; //!< transformation to the joint's origin
 	fmat::Transform Tq; //!< transformation to origin, including final q rotation
+	mutable fmat::Transform fullT; //!< cached transformation from the link frame to the base frame, see getFullT()
+	mutable bool fullTDirty; //!< indicates #fullT needs to be recomputed; if set, is also set for all descendants
+	mutable fmat::Column<4> subtreeCOM; //!< cached unnormalized center of mass of this link and its branches, see sumCenterOfMass()
+	mutable bool comDirty; //!< indicates #subtreeCOM needs to be recomputed; if set, is also set for all ancestors
 	mutable IKSolver * ik; //!< an instance of the IKSolver corresponding to #ikSolver
 
-	void setParent(LinkComponent& link) { link.parent = this; dirtyBB(); } //!< for use by ComponentsListener, work around #parent being protected
-	void unsetParent(LinkComponent& link) { link.parent = NULL; dirtyBB(); } //!< for use by ComponentsListener, work around #parent being protected
+	void setParent(LinkComponent& link) { link.parent = this; dirtyBB(); dirtyCOM(); } //!< for use by ComponentsListener, work around #parent being protected
+	void unsetParent(LinkComponent& link) { link.parent = NULL; dirtyBB(); dirtyCOM(); } //!< for use by ComponentsListener, work around #parent being protected
 	
 	class ComponentsListener : protected plist::CollectionListener {
 	public:
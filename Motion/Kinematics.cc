@@ -29,6 +29,10 @@ Kinematics::init() {
 		return;
 	}
 	root.buildChildMap(jointMaps,0,NumReferenceFrames);
+#if defined(TGT_HAS_CAMERA) && defined(TGT_HAS_HEAD)
+	if(jointMaps[CameraFrameOffset]!=NULL && jointMaps[BaseFrameOffset]!=NULL)
+		cameraChain.init(*jointMaps[CameraFrameOffset], jointMaps[BaseFrameOffset]);
+#endif
 }
 
 void Kinematics::initStatics() {
@@ -471,9 +475,20 @@ Kinematics::projectToPlane(
 			unsigned int f,
 			float objCentroidHeight)
 {
-	update();
-	if((j!=b && (jointMaps[j]==NULL || jointMaps[b]==NULL)) || (f!=b && (jointMaps[f]==NULL || jointMaps[b]==NULL)) )
-		return fmat::Column<4>(0.f);
+	fmat::Transform tr; // converts from j to b
+#if defined(TGT_HAS_CAMERA) && defined(TGT_HAS_HEAD)
+	if(j==CameraFrameOffset && b==BaseFrameOffset && f==b && cameraChain.isValid()) {
+		// projecting a camera ray onto the ground only depends on the head joints, skip updating the rest of the tree
+		tr = cameraToBase();
+	} else
+#endif
+	{
+		update();
+		if((j!=b && (jointMaps[j]==NULL || jointMaps[b]==NULL)) || (f!=b && (jointMaps[f]==NULL || jointMaps[b]==NULL)) )
+			return fmat::Column<4>(0.f);
+		if(j!=b)
+			tr = jointMaps[j]->getT(*jointMaps[b]);
+	}
 	
 	/*! Mathematical implementation:
 	 *  
@@ -509,7 +524,6 @@ Kinematics::projectToPlane(
 	if(j==b)
 		rv_b=r_j;
 	else {
-		fmat::Transform tr = jointMaps[j]->getT(*jointMaps[b]);
 		ro_b = tr.translation();
 		rv_b = tr.rotation() * r_j;
 	}
@@ -554,13 +568,28 @@ void
 Kinematics::update() const {
 	if(lastUpdateTime == state->lastSensorUpdateTime)
 		 return;
-	for(unsigned int j=0; j<NumOutputs; j++) {
-		if(jointMaps[j]!=NULL)
-			jointMaps[j]->setQ(state->outputs[j]);
-	}
+	// like jointMaps, the tree is a cache of the current state, so it is updated even though we're const
+	// (one pass sets all the joints and recomputes their world transforms, instead of invalidating subtrees joint by joint)
+	const_cast<KinematicJoint&>(root).updateAll(state->outputs, 0, NumOutputs);
 	lastUpdateTime = state->lastSensorUpdateTime;
 }
 
+float
+Kinematics::getJointValue(unsigned int i) const {
+	return state->outputs[i];
+}
+
+#if defined(TGT_HAS_CAMERA) && defined(TGT_HAS_HEAD)
+fmat::Transform
+Kinematics::cameraToBase() const {
+	fmat::fmatReal q[NumHeadJoints+1];
+	for(unsigned int i=0; i<NumHeadJoints+1; ++i) {
+		const KinematicChain<NumHeadJoints+1>::Link& l = cameraChain.getLink(i);
+		q[i] = (l.output<NumOutputs) ? getJointValue(l.output) : l.q;
+	}
+	return cameraChain.getEffectorT(q);
+}
+#endif
 
 /*! @file
  * @brief 
@@ -6,6 +6,7 @@
 #include "Shared/fmat.h"
 #include "Shared/Measures.h"
 #include "Motion/KinematicJoint.h"
+#include "Motion/KinematicChain.h"
 
 #include <string>
 #include <vector>
@@ -74,6 +75,9 @@ public:
 	}
 	//!Copy constructor, everything is either update-before-use or static, copy is normal init
 	Kinematics(const Kinematics& k) : root(k.root), lastUpdateTime(0)
+#if defined(TGT_HAS_CAMERA) && defined(TGT_HAS_HEAD)
+		, cameraChain(k.cameraChain)
+#endif
 	{
 		for(unsigned int i=0; i<NumReferenceFrames; ++i)
 			jointMaps[i]=NULL;
@@ -85,6 +89,9 @@ public:
 		for(unsigned int i=0; i<NumReferenceFrames; ++i)
 			jointMaps[i]=NULL;
 		root.buildChildMap(jointMaps,0,NumReferenceFrames);
+#if defined(TGT_HAS_CAMERA) && defined(TGT_HAS_HEAD)
+		cameraChain=k.cameraChain;
+#endif
 		return *this;
 	}
 
@@ -261,9 +268,12 @@ protected:
 	static void checkStatics() { if(!staticsInited) initStatics(); }
 	
 public:
-	//! refresh the joint settings in #root from WorldState::outputs
+	//! refresh the joint settings in #root from WorldState::outputs, and the world transforms cached by each joint (see KinematicJoint::updateAll())
 	virtual void update() const;
 	
+	//! returns the current value of output @a i, as update() would apply it to the tree; used by the fast paths which bypass the tree (see #cameraChain)
+	virtual float getJointValue(unsigned int i) const;
+	
 	//! holds the position and attached link of a given interest point
 	struct InterestPoint {
 		InterestPoint() : p(), output(-1U) {} //!< constructor
@@ -283,6 +293,14 @@ protected:
 	//! holds mapping from tekkotsu output index to chain and link indicies
 	KinematicJoint* jointMaps[NumReferenceFrames];
 	
+#if defined(TGT_HAS_CAMERA) && defined(TGT_HAS_HEAD)
+	//! returns the transformation from the camera frame to the base frame, computed by #cameraChain from getJointValue()
+	fmat::Transform cameraToBase() const;
+	
+	//! a flat copy of the chain from the base frame to the camera, so projectToGround() doesn't need to update the whole tree; the head joints plus the camera frame's own (prismatic) joint; invalid if the camera isn't mounted on exactly the head joints
+	KinematicChain<NumHeadJoints+1> cameraChain;
+#endif
+	
 	//! initially false, set to true after first Kinematics is initialized
 	static bool staticsInited;
 	
@@ -17,8 +17,7 @@
 #include "Shared/ERS220Info.h"
 #include "Shared/ERS7Info.h"
 #include "Shared/Config.h"
-
-#include <list>
+#include <algorithm>
 
 MotionManager * motman=NULL;
 int MotionManager::_MMaccID[ProcessID::NumProcesses];
@@ -37,10 +36,11 @@ using namespace std;
 typedef unsigned int uint;
 
 MotionManager::MotionManager()
-: pidchanges(),cmdlist(),cur_cmd(invalid_MC_ID),MMlock(),numAcc(0)
+: pidchanges(),cmdlist(),cur_cmd(invalid_MC_ID),MMlock(),frameStats(),numAcc(0)
 {
 	for(uint x=0; x<NumOutputs; x++)
 		cmdSums[x]=0;
+	MMlock.setName("MotionManager");
 }
 
 #ifdef PLATFORM_APERIOS
@@ -159,16 +159,17 @@ MotionManager::motionReport() const {
 	bool any=false;
 	for(unsigned int i=0; i<NumOutputs; ++i) {
 		bool first=true;
-		for(unsigned int j=cmdstates[i].begin(); j!=cmdstates[i].end(); j=cmdstates[i].next(j)) {
-			if(cmdstates[i][j].frames[NumFrames-1].weight > 0) {
+		for(MC_ID mc_id=cmdlist.begin(); mc_id!=cmdlist.end(); mc_id=cmdlist.next(mc_id)) {
+			const OutputRequests& req=requests[mc_id];
+			if(req.isUsed[i] && req.weight[NumFrames-1][i] > 0) {
 				if(first) {
 					std::cout << "   " << outputNames[i] << ':';
 					first=false;
 					any=true;
 				}
-				std::cout << " (" << cmdstates[i][j].mcid << " @ " << cmdstates[i][j].frames[NumFrames-1].value;
-				if(cmdstates[i][j].frames[NumFrames-1].weight!=1)
-					std::cout << " * " << cmdstates[i][j].frames[NumFrames-1].weight;
+				std::cout << " (" << mc_id << " @ " << req.value[NumFrames-1][i];
+				if(req.weight[NumFrames-1][i]!=1)
+					std::cout << " * " << req.weight[NumFrames-1][i];
 				std::cout << ")";
 			}
 		}
@@ -177,6 +178,8 @@ MotionManager::motionReport() const {
 	}
 	if(!any)
 		std::cout << "   [No outputs in use]" << std::endl;
+	std::cout << "\nFrames: " << frameStats.frames << ", " << frameStats.lateFrames << " with late updates, "
+		<< frameStats.skippedFrames << " with skipped updates (" << frameStats.skippedUpdates << " skipped in total)" << std::endl;
 	func_end();
 }
 
@@ -193,13 +196,10 @@ MotionManager::setOutput(const MotionCommand* caller, unsigned int output, const
 	if(cur_cmd==invalid_MC_ID) {
 		cmdSums[output]=cmd.value;
 	} else if(getPriority(cur_cmd)>=kBackgroundPriority) {
-		cmdstatelist_t& curstatelist=cmdstates[output];
-		cmdstatelist_t::index_t ent=curstatelist.begin();
-		if(ent==curstatelist.end() || curstatelist[ent].mcid!=cur_cmd)
-			curstatelist.push_front(OutputState(output,getPriority(cur_cmd),cur_cmd,cmd));
-		else
-			for(unsigned int i=0; i<NumFrames; i++)
-				curstatelist[ent].frames[i]=cmd;
+		OutputRequests& req=requests[cur_cmd];
+		req.use(output);
+		for(unsigned int i=0; i<NumFrames; i++)
+			req.set(output,i,cmd);
 	}
 	if(caller==NULL || caller->getID()!=cur_cmd)
 		func_end();
@@ -217,12 +217,9 @@ MotionManager::setOutput(const MotionCommand* caller, unsigned int output, const
 	if(cur_cmd==invalid_MC_ID) {
 		cmdSums[output]=cmd.value;
 	} else if(getPriority(cur_cmd)>=kBackgroundPriority) {
-		cmdstatelist_t& curstatelist=cmdstates[output];
-		cmdstatelist_t::index_t ent=curstatelist.begin();
-		if(ent==curstatelist.end() || curstatelist[ent].mcid!=cur_cmd)
-			curstatelist.push_front(OutputState(output,getPriority(cur_cmd),cur_cmd,cmd,frame));
-		else
-			curstatelist[ent].frames[frame]=cmd;
+		OutputRequests& req=requests[cur_cmd];
+		req.use(output);
+		req.set(output,frame,cmd);
 	}
 	if(caller==NULL || caller->getID()!=cur_cmd)
 		func_end();
@@ -247,13 +244,10 @@ MotionManager::setOutput(const MotionCommand* caller, unsigned int output, const
 	if(cur_cmd==invalid_MC_ID) {
 		cmdSums[output]=ocmds[hasWeight].value;
 	} else if(getPriority(cur_cmd)>=kBackgroundPriority) {
-		cmdstatelist_t& curstatelist=cmdstates[output];
-		cmdstatelist_t::index_t ent=curstatelist.begin();
-		if(ent==curstatelist.end() || curstatelist[ent].mcid!=cur_cmd)
-			curstatelist.push_front(OutputState(output,getPriority(cur_cmd),cur_cmd,ocmds));
-		else
-			for(unsigned int i=0; i<NumFrames; i++)
-				curstatelist[ent].frames[i]=ocmds[i];
+		OutputRequests& req=requests[cur_cmd];
+		req.use(output);
+		for(unsigned int i=0; i<NumFrames; i++)
+			req.set(output,i,ocmds[i]);
 	}
 	if(caller==NULL || caller->getID()!=cur_cmd)
 		func_end();
@@ -269,12 +263,10 @@ MotionManager::setOutput(const MotionCommand* caller, unsigned int output, const
 	if(cur_cmd==invalid_MC_ID) {
 		setPID(output,pid.pid);
 	} else if(getPriority(cur_cmd)>=kBackgroundPriority) {
-		cmdstatelist_t& curstatelist=cmdstates[output];
-		cmdstatelist_t::index_t ent=curstatelist.begin();
-		if(ent==curstatelist.end() || curstatelist[ent].mcid!=cur_cmd)
-			curstatelist.push_front(OutputState(output,getPriority(cur_cmd),cur_cmd,pid));
-		else
-			curstatelist[ent].pid=pid;
+		OutputRequests& req=requests[cur_cmd];
+		req.use(output);
+		if(output>=PIDJointOffset && output<PIDJointOffset+NumPIDJoints)
+			req.pids[output-PIDJointOffset]=pid;
 	}
 	if(caller==NULL || caller->getID()!=cur_cmd)
 		func_end();
@@ -292,15 +284,12 @@ MotionManager::setOutput(const MotionCommand* caller, unsigned int output, const
 			cmdSums[output]=cmd.value;
 		setPID(output,pid.pid);
 	} else if(getPriority(cur_cmd)>=kBackgroundPriority) {
-		cmdstatelist_t& curstatelist=cmdstates[output];
-		cmdstatelist_t::index_t ent=curstatelist.begin();
-		if(ent==curstatelist.end() || curstatelist[ent].mcid!=cur_cmd)
-			curstatelist.push_front(OutputState(output,getPriority(cur_cmd),cur_cmd,cmd,pid));
-		else {
-			for(unsigned int i=0; i<NumFrames; i++)
-				curstatelist[ent].frames[i]=cmd;
-			curstatelist[ent].pid=pid;
-		}
+		OutputRequests& req=requests[cur_cmd];
+		req.use(output);
+		for(unsigned int i=0; i<NumFrames; i++)
+			req.set(output,i,cmd);
+		if(output>=PIDJointOffset && output<PIDJointOffset+NumPIDJoints)
+			req.pids[output-PIDJointOffset]=pid;
 	}
 	if(caller==NULL || caller->getID()!=cur_cmd)
 		func_end();
@@ -318,20 +307,62 @@ MotionManager::setOutput(const MotionCommand* caller, unsigned int output, const
 			cmdSums[output]=ocmds[NumFrames-1].value;
 		setPID(output,pid.pid);
 	} else if(getPriority(cur_cmd)>=kBackgroundPriority) {
-		cmdstatelist_t& curstatelist=cmdstates[output];
-		cmdstatelist_t::index_t ent=curstatelist.begin();
-		if(ent==curstatelist.end() || curstatelist[ent].mcid!=cur_cmd)
-			curstatelist.push_front(OutputState(output,getPriority(cur_cmd),cur_cmd,ocmds,pid));
-		else {
-			for(unsigned int i=0; i<NumFrames; i++)
-				curstatelist[ent].frames[i]=ocmds[i];
-			curstatelist[ent].pid=pid;
-		}
+		OutputRequests& req=requests[cur_cmd];
+		req.use(output);
+		for(unsigned int i=0; i<NumFrames; i++)
+			req.set(output,i,ocmds[i]);
+		if(output>=PIDJointOffset && output<PIDJointOffset+NumPIDJoints)
+			req.pids[output-PIDJointOffset]=pid;
 	}
 	if(caller==NULL || caller->getID()!=cur_cmd)
 		func_end();
 }
 
+/*! Returns false without blocking if the command is currently checked out elsewhere,
+ *  otherwise replaces the command's previous entries in #requests with the results of
+ *  its updateOutputs() (or removes it if it should be pruned) */
+bool
+MotionManager::updateMotion(MC_ID mcid) {
+	MotionCommand* mc=checkoutMotion(mcid,false);
+	if(mc==NULL)
+		return false; // we didn't get a lock, caller will try again or reuse previous outputs
+	purgeOutputStates(mcid);
+	cur_cmd=mcid;
+	bool prune=true;
+	try {
+		prune=mc->shouldPrune();
+	} catch(const std::exception& ex) {
+		ProjectInterface::uncaughtException(__FILE__,__LINE__,"Occurred during MotionCommand prune test, will prune",&ex);
+	} catch(...) {
+		ProjectInterface::uncaughtException(__FILE__,__LINE__,"Occurred during MotionCommand prune test, will prune",NULL);
+	}
+	if(prune) {
+		// cout << "Removing expired " << mcid << " (autoprune)" << endl;
+		checkinMotion(mcid); // release lock, done with motion (don't need to (and shouldn't) keep lock through the removeMotion())
+		//only the last process to receive the remove notification actually does the remove, and
+		//wouldn't be able to undo the thread portion of the lock made in this process
+		//so we have to take off our own lock here first.
+		removeMotion(mcid);
+	} else {
+		try {
+			if ( cmdlist[mcid].priority >= kBackgroundPriority )
+				mc->updateOutputs(); // the MotionCommand should make calls to setOutput from within here
+		} catch(const std::exception& ex) {
+			ProjectInterface::uncaughtException(__FILE__,__LINE__,"Occurred during MotionCommand updateOutputs",&ex);
+		} catch(...) {
+			ProjectInterface::uncaughtException(__FILE__,__LINE__,"Occurred during MotionCommand updateOutputs",NULL);
+		}
+		checkinMotion(mcid); // release lock, done with motion
+	}
+	cur_cmd=invalid_MC_ID;
+	return true;
+}
+
+void
+MotionManager::purgeOutputStates(MC_ID mcid) {
+	requests[mcid].clear();
+}
+
 /*! What's worse? A plethora of functions which are only called, and only useful at one place,
  *  or a big massive function which doesn't pollute the namespace?  This is the latter, for
  *  better or worse. */
@@ -355,8 +386,6 @@ MotionManager::getOutputs(float outputs[][NumOutputs]) {
 	//	if(begin(id)!=end())
 	//	cout << id << "..." << flush;
 	//cout << "CHECKOUT..." << flush;
-	for(uint output=0; output<NumOutputs; output++)
-		cmdstates[output].clear();
 
 	// for each PID joint which is set to 0 power, set the background
 	// position value to current sensed value this prevents jerking back
@@ -374,130 +403,66 @@ MotionManager::getOutputs(float outputs[][NumOutputs]) {
 			cmdSums[output]=state->outputs[output];
 
 	//std::cout << "UPDATE..." << std::flush;
-	std::list<MC_ID> unlocked;
-	for(MC_ID mcNum=begin(); mcNum!=end(); mcNum=next(mcNum)) // check out all the MotionCommands (only one at a time tho)
-		if(cmdlist[mcNum].lastAccessor!=(accID_t)-1)
-			unlocked.push_back(mcNum);
-	unsigned int lastProcessed=get_time();
-	while(unlocked.size()>0) { // keep cycling through all the locks we didn't get
-		for(std::list<MC_ID>::iterator it=unlocked.begin(); it!=unlocked.end(); ) {
-			MotionCommand* mc=checkoutMotion(*it,false);
-			if(mc==NULL)
-				it++; //we didn't get a lock, skip it (we'll keep looping until we get it)
-			else {
-				// we got a lock
-				cur_cmd=*it;
-				bool prune=true;
-				try {
-					prune=mc->shouldPrune();
-				} catch(const std::exception& ex) {
-					ProjectInterface::uncaughtException(__FILE__,__LINE__,"Occurred during MotionCommand prune test, will prune",&ex);
-				} catch(...) {
-					ProjectInterface::uncaughtException(__FILE__,__LINE__,"Occurred during MotionCommand prune test, will prune",NULL);
-				}
-				if(prune) {
-					// cout << "Removing expired " << *it << " (autoprune)" << endl;
-					checkinMotion(*it); // release lock, done with motion (don't need to (and shouldn't) keep lock through the removeMotion())
-					//only the last process to receive the remove notification actually does the remove, and
-					//wouldn't be able to undo the thread portion of the lock made in this process
-					//so we have to take off our own lock here first.
-					removeMotion(*it);
-				} else {
-					try {
-					  if ( cmdlist[mc->getID()].priority >= kBackgroundPriority )
-							mc->updateOutputs(); // the MotionCommand should make calls to setOutput from within here
-					} catch(const std::exception& ex) {
-						ProjectInterface::uncaughtException(__FILE__,__LINE__,"Occurred during MotionCommand updateOutputs",&ex);
-					} catch(...) {
-						ProjectInterface::uncaughtException(__FILE__,__LINE__,"Occurred during MotionCommand updateOutputs",NULL);
-					}
-					checkinMotion(*it); // release lock, done with motion
-				}
-				cur_cmd=invalid_MC_ID;
-				// remove id from list of unprocessed motioncommands
-				std::list<MC_ID>::iterator rem=it++;
-				unlocked.erase(rem);
-				lastProcessed=get_time();
-			}
+	// Commands are updated without blocking: if a behavior currently has a command checked out,
+	// it's deferred until the others are done, and if it's still locked then, the output states it
+	// published on a previous frame remain in #requests and are used again (a consistent snapshot,
+	// since a command's states are only replaced while the Motion thread holds its lock)
+	MC_ID deferred[MAX_MOTIONS];
+	unsigned int numDeferred=0;
+	for(MC_ID mcNum=begin(); mcNum!=end(); ) { // check out all the MotionCommands (only one at a time tho)
+		MC_ID cur=mcNum;
+		mcNum=next(mcNum); // advance first, cur may be pruned
+		if(cmdlist[cur].lastAccessor!=(accID_t)-1 && !updateMotion(cur))
+			deferred[numDeferred++]=cur;
+	}
+	++frameStats.frames;
+	if(numDeferred>0) {
+		unsigned int stillLocked=0;
+		for(unsigned int i=0; i<numDeferred; ++i) {
+			if(cmdlist[deferred[i]].lastAccessor!=(accID_t)-1 && !updateMotion(deferred[i]))
+				deferred[stillLocked++]=deferred[i];
+		}
+		if(stillLocked<numDeferred)
+			++frameStats.lateFrames;
+		if(stillLocked>0) {
+			++frameStats.skippedFrames;
+			frameStats.skippedUpdates+=stillLocked;
 		}
-		if(get_time()-lastProcessed>FrameTime*NumFrames/2)
-			break;
 	}
-	/* Kill annoying warning for now.  -- DST
-	if(unlocked.size()>0) {
-		cerr << "Warning: MotionManager was unable to obtain a lock on MCs: ";
-		for(std::list<MC_ID>::iterator it=unlocked.begin(); it!=unlocked.end(); it++)
-			cerr << *it << ' ';
-		cerr << endl;
-		cerr << (unlocked.size()>1?"They":"It") << " may have been left locked by a Behavior while it was busy." << endl;
-		cerr << "Try reducing the scope of your MMAccessor or call checkinMotion sooner." << endl;
+	
+	// sort the commands by priority (insertion sort, there are usually only a few), skipping
+	// any which are being removed or are below background priority; the priorities are read
+	// fresh each frame, so changes via setPriority() apply to reused requests too
+	MC_ID order[MAX_MOTIONS];
+	unsigned int numOrdered=0;
+	for(MC_ID mc=cmdlist.begin(); mc!=cmdlist.end(); mc=cmdlist.next(mc)) {
+		const CommandEntry& entry=cmdlist[mc];
+		if(entry.lastAccessor==(accID_t)-1 || entry.priority<kBackgroundPriority || requests[mc].numUsed==0)
+			continue;
+		unsigned int i=numOrdered++;
+		for(; i>0 && cmdlist[order[i-1]].priority<entry.priority; i--)
+			order[i]=order[i-1];
+		order[i]=mc;
 	}
-	*/
-
-	// sort the list of requested outputs based on priority
-	// (insertion sort, data structure is linked list)
-	for(uint output=0; output<NumOutputs; output++) {
-		cmdstatelist_t& curstatelist=cmdstates[output];
-		for(cmdstatelist_t::index_t bit=curstatelist.begin(); bit!=curstatelist.end(); bit=curstatelist.next(bit)) {
-			MC_ID high_ent=bit;
-			float high_p=cmdlist[curstatelist[high_ent].mcid].priority;
-			for(cmdstatelist_t::index_t cit=curstatelist.next(bit); cit!=curstatelist.end(); cit=curstatelist.next(cit)) {
-				float curp=cmdlist[curstatelist[cit].mcid].priority;
-				if(curp>high_p) {
-					high_p=curp;
-					high_ent=cit;
-				}
-			}
-			curstatelist.swap(bit,high_ent);
-			/*if(curstatelist.countf()!=curstatelist.countb() || curstatelist.countf()!=curstatelist.size()) {
-				cout << "LOST ONE! " << bit << ' ' << high_ent << endl;
-				cout << curstatelist.countf() << ' ' << curstatelist.countb() << ' ' << curstatelist.size() << endl;
-				}*/
-			bit=high_ent;
-		}
+
+	// now blend the commands' requests in order of priority, a whole command at a time: a
+	// command which sets most of the outputs (e.g. a walk, or an LED pattern) is added with
+	// vectorized loops over all outputs and frames, others only visit the outputs they set
+	blend.reset();
+	for(unsigned int i=0; i<numOrdered; i++) {
+		const OutputRequests& req=requests[order[i]];
+		if(req.numUsed*4>=NumOutputs)
+			blend.addDense(req);
+		else
+			blend.addSparse(req);
+		if(i+1==numOrdered || cmdlist[order[i+1]].priority!=cmdlist[order[i]].priority)
+			blend.endLevel();
 	}
 
-	// now we've got, for each output, a list of requested values sorted by priority
 	// summarize each output
 	for(uint frame=0; frame<NumFrames; frame++) {
 		for(uint output=0; output<NumOutputs; output++) {
-			cmdstatelist_t& curstatelist=cmdstates[output];
-			float alpha=1;
-			OutputCmd sumcmd;
-			/*if(curstatelist.size()>1) {
-				cout << get_time() << "." << frame << " " << outputNames[output] << ": ";
-				for(cmdstatelist_t::index_t ent=curstatelist.begin(); ent!=curstatelist.end(); ent=curstatelist.next(ent))
-					cout << "  (" << curstatelist[ent].frames[frame].value <<',' << curstatelist[ent].frames[frame].weight << ',' << curstatelist[ent].priority << ')';
-				cout << endl;
-			}*/
-			cmdstatelist_t::index_t ent=curstatelist.begin();
-			while(ent!=curstatelist.end() && alpha>0) {
-				OutputCmd curcmd;
-				float curp=curstatelist[ent].priority;
-				float curalpha=1; // curalpha is cumulative product of leftovers (weights between 0 and 1)
-				for(;ent!=curstatelist.end() && curstatelist[ent].priority==curp; ent=curstatelist.next(ent)) {
-					//weighted average within priority level
-					float curweight=curstatelist[ent].frames[frame].weight;
-					ASSERT(curweight>=0,"negative output weights are illegal, MC_ID="<<curstatelist[ent].mcid<<" joint="<<outputNames[output]<<" frame="<<frame<<" weight="<<curweight);
-					if(curweight<0) //negative weights are illegal
-						curweight=0;
-					curcmd.value+=curstatelist[ent].frames[frame].value*curweight;
-					curcmd.weight+=curweight;
-					if(curweight<1)
-						curalpha*=(1-curweight);
-					else
-						curalpha=0;
-				}
-				if(curcmd.weight>0) {
-					//weighted average of priority levels
-					sumcmd.value+=curcmd.value/curcmd.weight*alpha*(1-curalpha);
-					sumcmd.weight+=alpha*(1-curalpha);
-					alpha*=curalpha;
-				}
-			}
-
-			//if(curstatelist.size()>1)
-			//	cout << "   -> " << sumcmd.value/sumcmd.weight << ',' << sumcmd.weight << " @ " << alpha << endl;
+			OutputCmd sumcmd(blend.sumValue[frame][output],blend.sumWeight[frame][output]);
 			if(sumcmd.weight>0) {
 				sumcmd.value/=sumcmd.weight;
 				outputs[frame][output]=sumcmd.value;
@@ -520,28 +485,31 @@ MotionManager::getOutputs(float outputs[][NumOutputs]) {
 				
 	// now summarize each output's PID values (for those which use PID control)
 	for(uint output=PIDJointOffset; output<PIDJointOffset+NumPIDJoints; output++) {
-		cmdstatelist_t& curstatelist=cmdstates[output];
+		const uint joint=output-PIDJointOffset;
 		float alpha=1;
 		float sumpid[3];
 		for(uint i=0; i<3; i++)
 			sumpid[i]=0;
 		float sumweight=0;
-		cmdstatelist_t::index_t ent=curstatelist.begin();
-		while(ent!=curstatelist.end() && alpha>0) {
+		unsigned int ent=0;
+		while(ent<numOrdered && alpha>0) {
 			float tmppid[3];
 			for(uint i=0; i<3; i++)
 				tmppid[i]=0;
 			float tmpweight=0;
-			float curp=curstatelist[ent].priority;
+			float curp=cmdlist[order[ent]].priority;
 			float curalpha=1; // curalpha is multiplicative sum of leftovers (weights between 0 and 1)
-			for(;ent!=curstatelist.end() && curstatelist[ent].priority==curp; ent=curstatelist.next(ent)) {
+			for(;ent<numOrdered && cmdlist[order[ent]].priority==curp; ent++) {
+				const OutputRequests& req=requests[order[ent]];
+				if(!req.isUsed[output])
+					continue;
 				//weighted average within priority level
-				float curweight=curstatelist[ent].pid.weight;
+				float curweight=req.pids[joint].weight;
 				ASSERT(curweight>=0,"negative PID weights are illegal")
 				if(curweight<0) //negative weights are illegal
 					curweight=0;
 				for(uint i=0; i<3; i++)
-					tmppid[i]+=curstatelist[ent].pid.pid[i]*curweight;
+					tmppid[i]+=req.pids[joint].pid[i]*curweight;
 				tmpweight+=curweight;
 				if(curweight<1)
 					curalpha*=(1-curweight);
@@ -959,6 +927,7 @@ MotionManager::removeMotion(MC_ID mcid) {
 	}
 	checkinMotion(mcid);
 	cmdlist[mcid].lastAccessor=(accID_t)-1;
+	purgeOutputStates(mcid); // don't leave its outputs around for getOutputs() to reuse
 	cmdlist[mcid].rcr[MYACCID]->RemoveReference();
 	cmdlist[mcid].rcr[MYACCID]=NULL;
 	cmdlist[mcid].baseaddrs[MYACCID]=NULL;
@@ -1046,42 +1015,104 @@ MotionManager::skip_ahead(MC_ID mcid) const {
 	return mcid;
 }
 
-MotionManager::OutputState::OutputState()
-	: priority(0),mcid(MotionManager::invalid_MC_ID), pid()
-{}
-MotionManager::OutputState::OutputState(unsigned int out, float pri, MC_ID mc, const OutputCmd cmds[NumFrames])
-	: priority(pri),mcid(mc), pid(DefaultPIDs[out])
-{
-	for(unsigned int i=0; i<NumFrames; i++)
-		frames[i]=cmds[i];
+#ifndef TGT_DYNAMIC
+
+MotionManager::OutputRequests::OutputRequests() : numUsed(0) {
+	std::fill(&value[0][0],&value[0][0]+NumFrames*NumOutputs,0.f);
+	std::fill(&weight[0][0],&weight[0][0]+NumFrames*NumOutputs,0.f);
+	std::fill(isUsed,isUsed+NumOutputs,false);
 }
-MotionManager::OutputState::OutputState(unsigned int out, float pri, MC_ID mc, const OutputCmd& cmd)
-	: priority(pri),mcid(mc), pid(DefaultPIDs[out])
-{
-	for(unsigned int i=0; i<NumFrames; i++)
-		frames[i]=cmd;
+
+void
+MotionManager::OutputRequests::set(unsigned int output, unsigned int frame, const OutputCmd& cmd) {
+	ASSERT(cmd.weight>=0,"negative output weights are illegal, joint="<<outputNames[output]<<" frame="<<frame<<" weight="<<cmd.weight);
+	value[frame][output]=cmd.value;
+	weight[frame][output]=(cmd.weight>0) ? cmd.weight : 0; //negative weights are illegal
 }
-MotionManager::OutputState::OutputState(unsigned int out, float pri, MC_ID mc, const OutputCmd& cmd, unsigned int frame)
-	: priority(pri),mcid(mc), pid(DefaultPIDs[out])
-{
-	frames[frame]=cmd;
+
+void
+MotionManager::OutputRequests::use(unsigned int output) {
+	if(isUsed[output])
+		return;
+	isUsed[output]=true;
+	used[numUsed++]=output;
+	if(output>=PIDJointOffset && output<PIDJointOffset+NumPIDJoints)
+		pids[output-PIDJointOffset]=OutputPID(DefaultPIDs[output-PIDJointOffset]);
 }
-MotionManager::OutputState::OutputState(unsigned int /*out*/, float pri, MC_ID mc, const OutputPID& p)
-	: priority(pri),mcid(mc), pid(p)
-{}
-MotionManager::OutputState::OutputState(unsigned int /*out*/, float pri, MC_ID mc, const OutputCmd cmds[NumFrames], const OutputPID& p)
-	: priority(pri),mcid(mc), pid(p)
-{
-	for(unsigned int i=0; i<NumFrames; i++)
-		frames[i]=cmds[i];
+
+void
+MotionManager::OutputRequests::clear() {
+	for(unsigned int i=0; i<numUsed; i++) {
+		const unsigned int output=used[i];
+		for(unsigned int frame=0; frame<NumFrames; frame++)
+			value[frame][output]=weight[frame][output]=0;
+		if(output>=PIDJointOffset && output<PIDJointOffset+NumPIDJoints)
+			pids[output-PIDJointOffset]=OutputPID();
+		isUsed[output]=false;
+	}
+	numUsed=0;
 }
-MotionManager::OutputState::OutputState(unsigned int /*out*/, float pri, MC_ID mc, const OutputCmd& cmd, const OutputPID& p)
-	: priority(pri),mcid(mc), pid(p)
-{
-	for(unsigned int i=0; i<NumFrames; i++)
-		frames[i]=cmd;
+
+void
+MotionManager::BlendBuffers::reset() {
+	std::fill(&levelValue[0][0],&levelValue[0][0]+NumFrames*NumOutputs,0.f);
+	std::fill(&levelWeight[0][0],&levelWeight[0][0]+NumFrames*NumOutputs,0.f);
+	std::fill(&levelAlpha[0][0],&levelAlpha[0][0]+NumFrames*NumOutputs,1.f);
+	std::fill(&sumValue[0][0],&sumValue[0][0]+NumFrames*NumOutputs,0.f);
+	std::fill(&sumWeight[0][0],&sumWeight[0][0]+NumFrames*NumOutputs,0.f);
+	std::fill(&alpha[0][0],&alpha[0][0]+NumFrames*NumOutputs,1.f);
+}
+
+void
+MotionManager::BlendBuffers::addDense(const OutputRequests& req) {
+	// unused outputs have zero value and weight, so they don't change the level
+	const float* v=&req.value[0][0];
+	const float* w=&req.weight[0][0];
+	float* lv=&levelValue[0][0];
+	float* lw=&levelWeight[0][0];
+	float* la=&levelAlpha[0][0];
+	for(uint i=0; i<NumFrames*NumOutputs; i++) {
+		lv[i]+=v[i]*w[i];
+		lw[i]+=w[i];
+		la[i]*=(w[i]<1) ? 1-w[i] : 0;
+	}
+}
+
+void
+MotionManager::BlendBuffers::addSparse(const OutputRequests& req) {
+	for(uint frame=0; frame<NumFrames; frame++) {
+		for(uint i=0; i<req.numUsed; i++) {
+			const uint output=req.used[i];
+			const float w=req.weight[frame][output];
+			levelValue[frame][output]+=req.value[frame][output]*w;
+			levelWeight[frame][output]+=w;
+			levelAlpha[frame][output]*=(w<1) ? 1-w : 0;
+		}
+	}
+}
+
+/*! Once an output has no weight left over, lower levels are ignored, including their values,
+ *  which are not even evaluated, in case they are garbage */
+void
+MotionManager::BlendBuffers::endLevel() {
+	float* lv=&levelValue[0][0];
+	float* lw=&levelWeight[0][0];
+	float* la=&levelAlpha[0][0];
+	float* sv=&sumValue[0][0];
+	float* sw=&sumWeight[0][0];
+	float* a=&alpha[0][0];
+	for(uint i=0; i<NumFrames*NumOutputs; i++) {
+		const bool use=(lw[i]>0 && a[i]>0);
+		sv[i]+=use ? lv[i]/lw[i]*a[i]*(1-la[i]) : 0;
+		sw[i]+=use ? a[i]*(1-la[i]) : 0;
+		a[i]=use ? a[i]*la[i] : a[i];
+		lv[i]=lw[i]=0;
+		la[i]=1;
+	}
 }
 
+#endif
+
 
 /*! @file
  * @brief Implements MotionManager, simplifies sharing of MotionCommand's and provides mutual exclusion to their access
@@ -1110,21 +1141,3 @@ MotionManager::OutputState::OutputState(unsigned int /*out*/, float pri, MC_ID m
 		}
 */
 
-	/*	for(uint output=TlRedLEDOffset-1; output<LEDOffset+NumLEDs-1; output++) {
-		cmdstatelist_t& curstatelist=cmdstates[output];
-		cout << "Out " << output << ": ";
-		for(cmdstatelist_t::index_t bit=curstatelist.begin(); bit!=curstatelist.end(); bit=curstatelist.next(bit))
-			cout << '('<<curstatelist[bit].mcid<<','<<cmdlist[curstatelist[bit].mcid].priority<<','<<curstatelist[bit].frames[0].value<<','<<curstatelist[bit].frames[0].weight<<") ";
-		cout << endl;
-		}*/
-
-
-	/*	cout << get_time() << ' ' << size() << endl;
-	for(uint output=TlRedLEDOffset; output<LEDOffset+NumLEDs-1; output++) {
-		cmdstatelist_t& curstatelist=cmdstates[output];
-		cout << "Out " << output << ": ";
-		for(cmdstatelist_t::index_t bit=curstatelist.begin(); bit!=curstatelist.end(); bit=curstatelist.next(bit))
-			cout << '('<<curstatelist[bit].mcid<<','<<cmdlist[curstatelist[bit].mcid].priority<<','<<curstatelist[bit].frames[0].value<<','<<curstatelist[bit].frames[0].weight<<") ";
-		cout << endl;
-	}
-	*/
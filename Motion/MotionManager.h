@@ -21,6 +21,13 @@ class MessageQueueBase;
 class MessageReceiver;
 #endif
 
+#ifndef TEKKOTSU_MAX_MOTIONS
+//! The default for MotionManager::MAX_MOTIONS, define when building the framework to manage more (or fewer) concurrent motions
+/*! This sets the capacity of MotionManager's command list, and each command has its own buffer
+ *  of requested output values, so the size of the MotionManager's shared memory region grows with it. */
+#define TEKKOTSU_MAX_MOTIONS 64
+#endif
+
 class EventTranslator;
 class MotionCommand;
 class RCRegion;
@@ -90,7 +97,7 @@ public:
 	 *  they're all connected */
 	static const unsigned int MAX_ACCESS=2;
 
-	static const unsigned int MAX_MOTIONS=64;   //!< This is the maximum number of Motions which can be managed, can probably be increased reasonably without trouble
+	static const unsigned int MAX_MOTIONS=TEKKOTSU_MAX_MOTIONS;   //!< This is the maximum number of Motions which can be managed, set by #TEKKOTSU_MAX_MOTIONS
 
 	typedef MotionManagerMsg::MC_ID MC_ID;      //!< use this type when referring to the ID numbers that MotionManager hands out
 	static const MC_ID invalid_MC_ID=MotionManagerMsg::invalid_MC_ID; //!< for errors and undefined stuff
@@ -164,10 +171,25 @@ public:
 	void unlock() { MMlock.unlock(); } //!< releases a lock on the motion manager
 	//@}
 
+	//! counts of motion frames in which a MotionCommand couldn't be updated on time, because it was checked out by another thread (e.g. an MMAccessor in a behavior)
+	struct FrameStats {
+		//! constructor
+		FrameStats() : frames(0), lateFrames(0), skippedFrames(0), skippedUpdates(0) {}
+		unsigned int frames; //!< number of calls to getOutputs()
+		unsigned int lateFrames; //!< number of frames in which a command was locked at first, but became available after the other commands were updated
+		unsigned int skippedFrames; //!< number of frames in which a command was still locked after the other commands were updated, so its previous outputs were reused
+		unsigned int skippedUpdates; //!< total number of command updates which were skipped (reusing the command's previous outputs)
+	};
+	
 	//@{
 #ifndef TGT_DYNAMIC
-	void getOutputs(float outputs[][NumOutputs]);  //!< @b LOCKS @b MotionManager called by MotionObject to fill in the output values for the next ::NumFrames frames (only MotoObj should call this...)
+	//! @b LOCKS @b MotionManager called by MotionObject to fill in the output values for the next ::NumFrames frames (only MotoObj should call this...)
+	/*! This never blocks on an individual MotionCommand: if one is checked out elsewhere, its
+	 *  outputs from the previous frame are reused (see getFrameStats()) */
+	void getOutputs(float outputs[][NumOutputs]);
 #endif
+	FrameStats getFrameStats() const { return frameStats; } //!< returns counts of frames in which command updates were late or skipped by getOutputs()
+	void resetFrameStats() { frameStats=FrameStats(); } //!< clears the counts returned by getFrameStats()
 #ifdef PLATFORM_APERIOS
 	bool updatePIDs(OPrimitiveID primIDs[NumOutputs]);      //!< call this when you want MotionManager to update modified PID values, returns true if changes made (only MotoObj should be calling this...), see PIDMC for general PID documentation
 #else
@@ -175,25 +197,6 @@ public:
 #endif
 	//@}
 
-	//! holds the full requested value of an output
-	class OutputState {
-	public:
-		//!@name Constructors
-		//!Constructor
-		OutputState();
-		OutputState(unsigned int out, float pri, MC_ID mc, const OutputCmd cmds[NumFrames]);
-		OutputState(unsigned int out, float pri, MC_ID mc, const OutputCmd& cmd);
-		OutputState(unsigned int out, float pri, MC_ID mc, const OutputCmd& cmd, unsigned int frame);
-		OutputState(unsigned int out, float pri, MC_ID mc, const OutputPID& p);
-		OutputState(unsigned int out, float pri, MC_ID mc, const OutputCmd cmds[NumFrames], const OutputPID& p);
-		OutputState(unsigned int out, float pri, MC_ID mc, const OutputCmd& cmd, const OutputPID& p);
-		//@}
-		float priority;             //!< priority level
-		MC_ID mcid;                 //!< MC_ID of requester
-		OutputCmd frames[NumFrames]; //!< values of output planned ahead
-		OutputPID pid;               //!< pid of output
-	};
-	
 	bool hasReference(ProcessID::ProcessID_t proc, MC_ID mcid) const { return cmdlist[mcid].rcr[_MMaccID[proc]]!=NULL; }
 
 protected:
@@ -226,6 +229,11 @@ protected:
 	template<class T> T func_end(T val) const { func_end(); return val; } //!< same as func_end(), except passes return value through
 
 	MC_ID skip_ahead(MC_ID mcid) const; //!< during iteration, skips over motioncommands which are still in transit from on OObject to another
+	
+	//! called by getOutputs() for each command, returns false without blocking if the command is checked out elsewhere
+	bool updateMotion(MC_ID mcid);
+	//! clears the output values and PIDs requested by @a mcid in #requests
+	void purgeOutputStates(MC_ID mcid);
 		
 	//!All the information we need to maintain about a MotionCommand
 	struct CommandEntry {
@@ -235,6 +243,7 @@ protected:
 				baseaddrs[i]=NULL;
 				rcr[i]=NULL;
 			}
+			lock.setName("MotionCommand");
 		}
 		~CommandEntry() { stacktrace::freeStackTrace(trace); trace=NULL; }
 		MotionCommand * baseaddrs[MAX_ACCESS]; //!< for each accessor, the base address of the motion command
@@ -256,12 +265,52 @@ protected:
 
 	mutable MutexLock<MAX_ACCESS> MMlock;          //!< The main lock for the class
 
-	typedef ListMemBuf<OutputState,MAX_MOTIONS> cmdstatelist_t; //!< shorthand for a list of OutputState's
 #ifndef TGT_DYNAMIC
-	cmdstatelist_t cmdstates[NumOutputs];  //!< requested positions by each of the MC's for each of the outputs
+	//! the output values and PIDs requested by one MotionCommand, in structure-of-arrays form so getOutputs() can blend whole rows at once
+	/*! Outputs the command hasn't set have zero value and weight, so they don't affect a blend. */
+	struct OutputRequests {
+		//! constructor, nothing is requested
+		OutputRequests();
+		//! sets the value of @a output in @a frame to @a cmd (negative weights are illegal, and treated as 0)
+		void set(unsigned int output, unsigned int frame, const OutputCmd& cmd);
+		//! marks @a output as used, initializing its PID to the default the first time (if it is a PID joint)
+		void use(unsigned int output);
+		//! resets the requests of all used outputs
+		void clear();
+		float value[NumFrames][NumOutputs]; //!< the requested value of each output in each frame
+		float weight[NumFrames][NumOutputs]; //!< the weight of each value in #value
+		OutputPID pids[NumPIDJoints]; //!< the requested PID of each PID joint
+		bool isUsed[NumOutputs]; //!< true for each output the command has set a value or PID for
+		unsigned short used[NumOutputs]; //!< the outputs which are marked in #isUsed, in the order they were first set
+		unsigned int numUsed; //!< the number of entries in #used
+	};
+	
+	//! structure-of-arrays buffers used by getOutputs() to blend the #requests of all outputs and frames at once
+	/*! Commands are added in order of decreasing priority.  Within a priority level, values are
+	 *  averaged by weight, then endLevel() adds the level's average to the sums, weighted by what's
+	 *  left over by the levels above it (the product of 1-weight of their values, so a weight of 1
+	 *  blocks all lower levels).  Each array is indexed by frame and then output, so addDense() and
+	 *  endLevel() are flat loops over all NumFrames x NumOutputs values without branches, which the
+	 *  compiler can vectorize; addSparse() only visits the outputs a command has actually set. */
+	struct BlendBuffers {
+		void reset(); //!< clears the sums before blending a new frame
+		void addDense(const OutputRequests& req); //!< adds all outputs of @a req to the current priority level
+		void addSparse(const OutputRequests& req); //!< adds the used outputs of @a req to the current priority level
+		void endLevel(); //!< adds the current priority level into the sums, and starts a new level
+		float levelValue[NumFrames][NumOutputs]; //!< weighted sum of values within the current priority level
+		float levelWeight[NumFrames][NumOutputs]; //!< sum of weights within the current priority level
+		float levelAlpha[NumFrames][NumOutputs]; //!< product of the leftover weights (1-weight) within the current priority level
+		float sumValue[NumFrames][NumOutputs]; //!< weighted sum of the priority levels so far
+		float sumWeight[NumFrames][NumOutputs]; //!< total weight of the priority levels so far
+		float alpha[NumFrames][NumOutputs]; //!< the weight left over for lower priority levels
+	};
+	
+	OutputRequests requests[MAX_MOTIONS];  //!< requested values and PIDs by each of the MC's for each of the outputs, indexed by MC_ID
+	BlendBuffers blend;                    //!< working space for getOutputs()
 	float cmdSums[NumOutputs];             //!<Holds the final values for the outputs of the last frame generated
 	OutputCmd cmds[NumOutputs];            //!<Holds the weighted values and total weight for the outputs of the last frame
 #endif
+	FrameStats frameStats;                 //!<Counts frames in which getOutputs() had to defer or skip command updates
 
 	accID_t numAcc;                        //!<The number of accessors who have registered with InitAccess()
 #ifdef PLATFORM_APERIOS
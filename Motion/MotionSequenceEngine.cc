@@ -505,6 +505,12 @@ void MotionSequenceEngine::makeSafe(const float vels[NumOutputs], float margin)
 	
 }	
 
+void MotionSequenceEngine::getKeyFrames(unsigned int i, std::vector<std::pair<unsigned int,OutputCmd> >& frames) const {
+	frames.clear();
+	for(Move_idx_t cur=starts[i]; cur!=invalid_move; cur=getKeyFrame(cur).next)
+		frames.push_back(std::make_pair(getKeyFrame(cur).starttime,getKeyFrame(cur).cmd));
+}
+
 bool MotionSequenceEngine::isPlaying() {
 	return playing && ((playspeed>0) ? (playtime<endtime) : (playtime>0)); 
 }
@@ -6,6 +6,8 @@
 #include "IPC/ListMemBuf.h"
 #include "PostureEngine.h"
 #include "Shared/attributes.h"
+#include <vector>
+#include <utility>
 
 //! A handy class for storing a sequence of keyframed movements
 /*! Each outputs is handled independently.  It's easy to add keyframes
@@ -218,6 +220,7 @@ public:
 	virtual unsigned int getMaxFrames() const=0; //!< returns the maximum number of key frames (Move's) which can be stored, determined by the instantiating MotionSequenceMC's template parameter
 	virtual unsigned int getUsedFrames() const=0; //!< returns the number of used key frames (Move's) which have been stored by the instantiation MotionSequenceEngine subclass
 	void makeSafe(const float vels[NumOutputs], float margin); //!< will insert time into the motion where needed to keep the joint velocities at or below the speeds given in @a vels * @a margin
+	void getKeyFrames(unsigned int i, std::vector<std::pair<unsigned int,OutputCmd> >& frames) const; //!< stores the (time,command) of each keyframe of output @a i into @a frames, in order of time, including the initial frame
 	//@}
 
 	//!@name Playback Control
@@ -300,6 +300,8 @@ protected:
 
 	//! overriding Kinematics::update, make all updates come from this posture engine's own state, not WorldState
 	virtual void update() const;
+	//! overriding Kinematics::getJointValue, returns this posture engine's own value for output @a i
+	virtual float getJointValue(unsigned int i) const { return getOutputCmd(i).value; }
 
 	//!the table of outputs' values and weights, can be accessed through setOutputCmd() and getOutputCmd()
 	OutputCmd cmds[NumOutputs];
@@ -0,0 +1,327 @@
+#ifndef PLATFORM_APERIOS
+#include "ReachabilityMap.h"
+#include "KinematicJoint.h"
+#include "IPC/TaskPool.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+const char ReachabilityMap::MAGIC[8] = { 'T','K','R','E','A','C','H','\0' };
+const uint32_t ReachabilityMap::VERSION;
+
+/*! @cond INTERNAL */
+namespace {
+	//! returns a well mixed function of @a x (the splitmix64 finalizer), so each sample can draw from its own sequence regardless of which thread computes it
+	inline uint64_t mix(uint64_t x) {
+		x = (x ^ (x>>30)) * 0xbf58476d1ce4e5b9ULL;
+		x = (x ^ (x>>27)) * 0x94d049bb133111ebULL;
+		return x ^ (x>>31);
+	}
+
+	//! deletes the tree containing @a kj, as created by KinematicJoint::cloneBranch()
+	void deleteBranch(KinematicJoint* kj) {
+		while(kj->getParent()!=NULL)
+			kj=kj->getParent();
+		delete kj;
+	}
+
+	//! computes forward kinematics for a range of random samples, see ReachabilityMap::generate()
+	struct SampleChunk {
+		SampleChunk(const KinematicJoint& t, const fmat::Column<3>& p, const fmat::Column<3>& a, unsigned int n,
+			std::vector<float>& pos, std::vector<uint8_t>& b, std::vector<float>& qs)
+			: tmpl(t), pEff(p), axis(a), numJoints(n), positions(pos), bins(b), q(qs) {}
+		void operator()(size_t begin, size_t end) const {
+			// each chunk gets a private copy, the caller's template is only read
+			KinematicJoint* eff = tmpl.cloneBranch();
+			std::vector<KinematicJoint*> chain;
+			for(KinematicJoint* kj=eff; kj!=NULL; kj=kj->getParent())
+				if(kj->isMobile())
+					chain.insert(chain.begin(),kj);
+			for(size_t i=begin; i!=end; ++i) {
+				uint64_t s=mix(i+1);
+				float* qi=&q[i*numJoints];
+				for(unsigned int j=0; j<numJoints; ++j) {
+					s=mix(s);
+					const float r = (s>>40) / static_cast<float>(1<<24);
+					qi[j] = chain[j]->qmin + (chain[j]->qmax-chain[j]->qmin)*r;
+					chain[j]->setQ(qi[j]);
+				}
+				const fmat::Transform& T = eff->getFullT();
+				fmat::Column<3> p(T*pEff);
+				positions[i*3+0]=p[0];
+				positions[i*3+1]=p[1];
+				positions[i*3+2]=p[2];
+				bins[i] = ReachabilityMap::directionBin(T.rotation()*axis);
+			}
+			deleteBranch(eff);
+		}
+		const KinematicJoint& tmpl;
+		const fmat::Column<3> pEff, axis;
+		const unsigned int numJoints;
+		std::vector<float>& positions;
+		std::vector<uint8_t>& bins;
+		std::vector<float>& q;
+	private:
+		SampleChunk& operator=(const SampleChunk&); //!< don't call
+	};
+}
+/*! @endcond */
+
+void ReachabilityMap::generate(const KinematicJoint& effector, const fmat::Column<3>& pEff, const fmat::Column<3>& axis, float voxelSize, unsigned int samples, TaskPool& pool) {
+	if(!(voxelSize>0))
+		throw std::invalid_argument("ReachabilityMap::generate() voxelSize must be positive");
+	if(samples==0)
+		throw std::invalid_argument("ReachabilityMap::generate() requires at least one sample");
+	clear();
+
+	// a private copy of the chain, in case the caller's tree is being updated by another thread
+	KinematicJoint* tmpl = effector.cloneBranch();
+	unsigned int numJoints=0;
+	for(KinematicJoint* kj=tmpl; kj!=NULL; kj=kj->getParent())
+		if(kj->isMobile())
+			++numJoints;
+
+	std::vector<float> positions(samples*3), q(samples*numJoints);
+	std::vector<uint8_t> bins(samples);
+	// fixed grain so chunks are large enough to amortize cloning the chain
+	pool.parallel_for_range(0,samples,SampleChunk(*tmpl,pEff,axis,numJoints,positions,bins,q),1024);
+	deleteBranch(tmpl);
+
+	// fit the grid to the samples
+	float lo[3], hi[3];
+	for(unsigned int d=0; d<3; ++d)
+		lo[d]=hi[d]=positions[d];
+	for(size_t i=1; i<samples; ++i) {
+		for(unsigned int d=0; d<3; ++d) {
+			const float x=positions[i*3+d];
+			if(x<lo[d])
+				lo[d]=x;
+			else if(x>hi[d])
+				hi[d]=x;
+		}
+	}
+	uint32_t dims[3];
+	for(unsigned int d=0; d<3; ++d)
+		dims[d] = static_cast<uint32_t>(std::floor((hi[d]-lo[d])/voxelSize))+1;
+	const size_t numVoxels = static_cast<size_t>(dims[0])*dims[1]*dims[2];
+
+	storage.assign(seedsOffset(numVoxels)+numVoxels*numJoints*sizeof(float),0);
+	Header* h = reinterpret_cast<Header*>(&storage[0]);
+	memcpy(h->magic,MAGIC,sizeof(MAGIC));
+	h->version=VERSION;
+	h->numJoints=numJoints;
+	h->samples=samples;
+	for(unsigned int d=0; d<3; ++d) {
+		h->dims[d]=dims[d];
+		h->origin[d]=lo[d];
+		h->pEff[d]=pEff[d];
+		h->axis[d]=axis[d];
+	}
+	h->voxelSize=voxelSize;
+	strncpy(h->effector,effector.outputOffset.get().c_str(),sizeof(h->effector)-1);
+	setPointers(&storage[0]);
+
+	// keep the sample closest to the center of each voxel as its seed
+	uint8_t* dirs = reinterpret_cast<uint8_t*>(&storage[sizeof(Header)]);
+	float* sd = reinterpret_cast<float*>(&storage[seedsOffset(numVoxels)]);
+	std::vector<float> best(numVoxels,std::numeric_limits<float>::infinity());
+	for(size_t i=0; i<samples; ++i) {
+		const fmat::Column<3> p = fmat::pack(positions[i*3+0],positions[i*3+1],positions[i*3+2]);
+		const size_t idx=voxelIndex(p);
+		if(idx==static_cast<size_t>(-1))
+			continue; // can't happen, the grid was fit to the samples
+		dirs[idx] |= 1<<bins[i];
+		const float dist = (p-voxelCenter(idx)).sumSq();
+		if(dist<best[idx]) {
+			best[idx]=dist;
+			memcpy(&sd[idx*numJoints],&q[i*numJoints],numJoints*sizeof(float));
+		}
+	}
+}
+
+bool ReachabilityMap::saveFile(const std::string& file) const {
+	if(!isValid())
+		return false;
+	const size_t size = seedsOffset(getNumVoxels())+getNumVoxels()*getNumJoints()*sizeof(float);
+	FILE* f = fopen(file.c_str(),"wb");
+	if(f==NULL) {
+		std::string err="ReachabilityMap::saveFile() unable to open file ";
+		err+=file;
+		perror(err.c_str());
+		return false;
+	}
+	const bool ok = fwrite(header,1,size,f)==size;
+	if(!ok)
+		std::cerr << "ReachabilityMap::saveFile() unable to write " << file << std::endl;
+	if(fclose(f)!=0) {
+		std::string err="ReachabilityMap::saveFile() unable to close file ";
+		err+=file;
+		perror(err.c_str());
+		return false;
+	}
+	return ok;
+}
+
+bool ReachabilityMap::loadFile(const std::string& file) {
+	clear();
+	int fd=open(file.c_str(),O_RDONLY);
+	if(fd<0) {
+		std::string err="ReachabilityMap::loadFile() unable to open file ";
+		err+=file;
+		perror(err.c_str());
+		return false;
+	}
+	struct stat statbuf;
+	if(fstat(fd,&statbuf)!=0) {
+		std::string err="ReachabilityMap::loadFile() failed to stat file ";
+		err+=file;
+		perror(err.c_str());
+		close(fd);
+		return false;
+	}
+	const size_t size=static_cast<size_t>(statbuf.st_size);
+	if(size<sizeof(Header)) {
+		std::cerr << "ReachabilityMap::loadFile() " << file << " is too small to be a reachability map" << std::endl;
+		close(fd);
+		return false;
+	}
+	void* data=mmap(NULL,size,PROT_READ,MAP_SHARED,fd,0);
+	if(data==MAP_FAILED) {
+		std::string err="ReachabilityMap::loadFile() unable to mmap file ";
+		err+=file;
+		perror(err.c_str());
+		close(fd);
+		return false;
+	}
+	close(fd); // the mapping remains valid
+	mapped=data;
+	mappedSize=size;
+
+	const Header* h = static_cast<const Header*>(data);
+	if(memcmp(h->magic,MAGIC,sizeof(MAGIC))!=0 || h->version!=VERSION) {
+		std::cerr << "ReachabilityMap::loadFile() " << file << " is not a reachability map (or is from an incompatible version)" << std::endl;
+		clear();
+		return false;
+	}
+	const size_t numVoxels = static_cast<size_t>(h->dims[0])*h->dims[1]*h->dims[2];
+	if(size != seedsOffset(numVoxels)+numVoxels*h->numJoints*sizeof(float)) {
+		std::cerr << "ReachabilityMap::loadFile() " << file << " is truncated or corrupt" << std::endl;
+		clear();
+		return false;
+	}
+	setPointers(static_cast<const char*>(data));
+	return true;
+}
+
+void ReachabilityMap::clear() {
+	if(mapped!=NULL) {
+		if(munmap(mapped,mappedSize)!=0)
+			perror("ReachabilityMap::clear() unable to munmap file");
+		mapped=NULL;
+		mappedSize=0;
+	}
+	std::vector<char>().swap(storage);
+	header=NULL;
+	directions=NULL;
+	seeds=NULL;
+}
+
+size_t ReachabilityMap::getNumReachable() const {
+	size_t n=0;
+	for(size_t i=getNumVoxels(); i!=0; --i)
+		if(directions[i-1]!=0)
+			++n;
+	return n;
+}
+
+fmat::Column<3> ReachabilityMap::getMaxBound() const {
+	fmat::Column<3> b=getMinBound();
+	for(unsigned int d=0; d<3; ++d)
+		b[d]+=header->dims[d]*header->voxelSize;
+	return b;
+}
+
+size_t ReachabilityMap::voxelIndex(const fmat::Column<3>& p) const {
+	if(header==NULL)
+		return static_cast<size_t>(-1);
+	size_t idx=0, stride=1;
+	for(unsigned int d=0; d<3; ++d) {
+		const float x = std::floor((p[d]-header->origin[d])/header->voxelSize);
+		// (also rejects NaN)
+		if(!(x>=0 && x<header->dims[d]))
+			return static_cast<size_t>(-1);
+		idx += static_cast<size_t>(x)*stride;
+		stride *= header->dims[d];
+	}
+	return idx;
+}
+
+const float* ReachabilityMap::getNearestSeed(const fmat::Column<3>& p, unsigned int radius) const {
+	if(const float* seed=getSeed(p))
+		return seed;
+	if(header==NULL || radius==0)
+		return NULL;
+	// voxel coordinates of p, which may be up to radius outside the grid
+	long c[3];
+	for(unsigned int d=0; d<3; ++d) {
+		const float x = std::floor((p[d]-header->origin[d])/header->voxelSize);
+		if(!(x>=-static_cast<float>(radius) && x<header->dims[d]+radius))
+			return NULL;
+		c[d]=static_cast<long>(x);
+	}
+	const long r=radius;
+	const float* best=NULL;
+	float bestDist=std::numeric_limits<float>::infinity();
+	for(long z=std::max(c[2]-r,0L); z<=std::min(c[2]+r,static_cast<long>(header->dims[2])-1); ++z) {
+		for(long y=std::max(c[1]-r,0L); y<=std::min(c[1]+r,static_cast<long>(header->dims[1])-1); ++y) {
+			for(long x=std::max(c[0]-r,0L); x<=std::min(c[0]+r,static_cast<long>(header->dims[0])-1); ++x) {
+				const size_t idx = x + header->dims[0]*(y + static_cast<size_t>(header->dims[1])*z);
+				if(directions[idx]==0)
+					continue;
+				const float dist = (p-voxelCenter(idx)).sumSq();
+				if(dist<bestDist) {
+					bestDist=dist;
+					best=seeds+idx*header->numJoints;
+				}
+			}
+		}
+	}
+	return best;
+}
+
+fmat::Column<3> ReachabilityMap::voxelCenter(size_t idx) const {
+	fmat::Column<3> c;
+	for(unsigned int d=0; d<3; ++d) {
+		c[d] = header->origin[d] + (idx%header->dims[d] + .5f)*header->voxelSize;
+		idx /= header->dims[d];
+	}
+	return c;
+}
+
+unsigned int ReachabilityMap::directionBin(const fmat::Column<3>& dir) {
+	unsigned int axis=0;
+	for(unsigned int d=1; d<3; ++d)
+		if(std::abs(dir[d])>std::abs(dir[axis]))
+			axis=d;
+	return axis*2 + (dir[axis]<0 ? 1 : 0);
+}
+
+void ReachabilityMap::setPointers(const char* data) {
+	header = reinterpret_cast<const Header*>(data);
+	directions = reinterpret_cast<const uint8_t*>(data+sizeof(Header));
+	seeds = reinterpret_cast<const float*>(data+seedsOffset(getNumVoxels()));
+}
+
+/*! @file
+ * @brief Implements ReachabilityMap, a voxel grid of reachable effector positions with seed configurations for inverse kinematics
+ */
+
+#endif //PLATFORM_APERIOS check
@@ -0,0 +1,156 @@
+//-*-c++-*-
+#ifndef INCLUDED_ReachabilityMap_h_
+#define INCLUDED_ReachabilityMap_h_
+
+#ifdef PLATFORM_APERIOS
+#  warning ReachabilityMap is not Aperios compatable
+#else
+
+#include "Shared/fmat.h"
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+class KinematicJoint;
+class TaskPool;
+
+//! A voxel grid recording which effector positions a kinematic chain can reach, and a joint configuration to seed inverse kinematics for each
+/*! The map is generated offline by generate(), which samples random configurations of the chain
+ *  and bins the resulting effector positions (in the base frame) into voxels.  For each voxel, it
+ *  records the set of approach directions seen (the direction of an axis of the effector frame,
+ *  quantized to the six principal directions), and the configuration which placed the effector
+ *  closest to the center of the voxel.
+ *
+ *  The map is saved in a compact binary file which loadFile() maps into memory read-only, so
+ *  loading is nearly free and the pages are shared between processes.  Checking whether a grasp
+ *  candidate can possibly be reached is then a table lookup, and candidates which can be reached
+ *  start IK from a nearby configuration, see IKBatch.
+ *
+ *  The map is approximate: a voxel is marked reachable if @e any sample fell inside it, so
+ *  positions at the edge of the workspace may be reported as reachable when they aren't (IK
+ *  still has the final say), while sparse sampling can leave holes inside the workspace.
+ *
+ *  The file is in native byte order; it is a cache to be regenerated for each robot, not an interchange format. */
+class ReachabilityMap {
+public:
+	static const unsigned int NUM_DIRECTIONS=6; //!< number of approach direction bins: +x, -x, +y, -y, +z, -z
+
+	//! constructor, the map is empty until generate() or loadFile()
+	ReachabilityMap() : storage(), mapped(NULL), mappedSize(0), header(NULL), directions(NULL), seeds(NULL) {}
+	//! destructor
+	~ReachabilityMap() { clear(); }
+
+	//! samples @a samples random configurations of the chain leading to @a effector, and records the reachable voxels
+	/*! @param effector the joint to map, the chain runs from the root of its tree (the base frame) to this joint
+	 *  @param pEff the point on the effector to map, in the effector's frame
+	 *  @param axis the axis of the effector's frame whose direction is recorded as the approach direction
+	 *  @param voxelSize the edge length of each voxel
+	 *  @param samples the number of configurations to sample
+	 *  @param pool the pool used to compute forward kinematics of the samples in parallel
+	 *
+	 *  The bounds of the grid are fit to the samples.  Results do not depend on the number of threads. */
+	void generate(const KinematicJoint& effector, const fmat::Column<3>& pEff, const fmat::Column<3>& axis, float voxelSize, unsigned int samples, TaskPool& pool);
+
+	//! saves the map to @a file, returns false on error
+	bool saveFile(const std::string& file) const;
+	//! maps @a file into memory, replacing the current map; returns false (leaving the map empty) if the file can't be read or isn't a reachability map
+	bool loadFile(const std::string& file);
+	//! releases the map
+	void clear();
+
+	//! returns true if the map has been generated or loaded
+	bool isValid() const { return header!=NULL; }
+
+	//! returns the number of joint values in each seed (the mobile joints of the chain, ordered from the base)
+	unsigned int getNumJoints() const { return header->numJoints; }
+	//! returns the number of configurations which were sampled to build the map
+	unsigned int getNumSamples() const { return header->samples; }
+	//! returns the name of the effector's output (the KinematicJoint::outputOffset) when the map was generated
+	std::string getEffectorName() const { return header->effector; }
+	//! returns the point on the effector which was mapped, in the effector's frame
+	fmat::Column<3> getEffectorPoint() const { return fmat::pack(header->pEff[0],header->pEff[1],header->pEff[2]); }
+	//! returns the effector axis which approach directions refer to
+	fmat::Column<3> getApproachAxis() const { return fmat::pack(header->axis[0],header->axis[1],header->axis[2]); }
+	//! returns the edge length of each voxel
+	float getVoxelSize() const { return header->voxelSize; }
+	//! returns the number of voxels along each dimension
+	unsigned int getDimension(unsigned int i) const { return header->dims[i]; }
+	//! returns the total number of voxels
+	size_t getNumVoxels() const { return static_cast<size_t>(header->dims[0])*header->dims[1]*header->dims[2]; }
+	//! returns the number of voxels which are reachable from any direction
+	size_t getNumReachable() const;
+	//! returns the corner of the grid with the lowest coordinates
+	fmat::Column<3> getMinBound() const { return fmat::pack(header->origin[0],header->origin[1],header->origin[2]); }
+	//! returns the corner of the grid with the highest coordinates
+	fmat::Column<3> getMaxBound() const;
+
+	//! returns the index of the voxel containing @a p, or -1U if @a p is outside the grid
+	size_t voxelIndex(const fmat::Column<3>& p) const;
+	//! returns the center of voxel @a idx
+	fmat::Column<3> voxelCenter(size_t idx) const;
+
+	//! returns a bitmask of the approach directions recorded for the voxel containing @a p (bit @e i is set if direction bin @e i was seen), 0 if unreachable
+	unsigned int getDirections(const fmat::Column<3>& p) const {
+		size_t idx=voxelIndex(p);
+		return idx==static_cast<size_t>(-1) ? 0 : directions[idx];
+	}
+	//! returns true if the effector reached the voxel containing @a p in any configuration
+	bool isReachable(const fmat::Column<3>& p) const { return getDirections(p)!=0; }
+	//! returns true if the effector reached the voxel containing @a p with the approach axis in the direction bin of @a approach
+	bool isReachable(const fmat::Column<3>& p, const fmat::Column<3>& approach) const { return (getDirections(p)>>directionBin(approach)) & 1; }
+
+	//! returns the joint values (getNumJoints() of them) of the configuration which came closest to the center of the voxel containing @a p, or NULL if unreachable
+	const float* getSeed(const fmat::Column<3>& p) const {
+		size_t idx=voxelIndex(p);
+		return (idx==static_cast<size_t>(-1) || directions[idx]==0) ? NULL : seeds+idx*header->numJoints;
+	}
+
+	//! like getSeed(), but if the voxel containing @a p is unreachable, returns the seed of the closest reachable voxel within @a radius voxels (in each dimension), or NULL if there is none
+	/*! Sparse sampling can leave unmarked voxels inside the workspace, so this is a more
+	 *  forgiving test of whether to attempt IK on @a p. */
+	const float* getNearestSeed(const fmat::Column<3>& p, unsigned int radius) const;
+
+	//! returns the direction bin of @a dir, the index of its largest magnitude component times 2, plus 1 if that component is negative
+	static unsigned int directionBin(const fmat::Column<3>& dir);
+
+protected:
+	//! the beginning of the file, followed by the #directions and #seeds arrays
+	struct Header {
+		char magic[8]; //!< identifies the file type, see MAGIC
+		uint32_t version; //!< file format version, see VERSION
+		uint32_t numJoints; //!< number of joint values in each seed
+		uint32_t dims[3]; //!< number of voxels along each axis
+		uint32_t samples; //!< number of configurations sampled
+		float origin[3]; //!< lowest corner of the grid
+		float voxelSize; //!< edge length of each voxel
+		float pEff[3]; //!< the point on the effector which was mapped
+		float axis[3]; //!< the effector axis used for approach directions
+		char effector[32]; //!< name of the effector's output, null terminated
+	};
+	static const char MAGIC[8]; //!< the value of Header::magic
+	static const uint32_t VERSION=1; //!< the value of Header::version
+
+	//! returns the offset of the #seeds array from the start of the file, for a grid of @a numVoxels
+	static size_t seedsOffset(size_t numVoxels) { return (sizeof(Header)+numVoxels+3) & ~static_cast<size_t>(3); }
+	//! points #header, #directions, and #seeds into @a data, which must hold the whole file
+	void setPointers(const char* data);
+
+	std::vector<char> storage; //!< holds the map after generate(), empty if the map was loaded from a file
+	void* mapped; //!< the memory mapped file, if the map was loaded
+	size_t mappedSize; //!< the size of #mapped
+	const Header* header; //!< the file header, NULL if the map is empty
+	const uint8_t* directions; //!< one bitmask of approach directions per voxel, indexed by x + y*dims[0] + z*dims[0]*dims[1]
+	const float* seeds; //!< numJoints joint values per voxel, only meaningful where #directions is non-zero
+
+private:
+	ReachabilityMap(const ReachabilityMap&); //!< don't call
+	ReachabilityMap& operator=(const ReachabilityMap&); //!< don't call
+};
+
+/*! @file
+ * @brief Describes ReachabilityMap, a voxel grid of reachable effector positions with seed configurations for inverse kinematics
+ */
+
+#endif //Aperios check
+
+#endif
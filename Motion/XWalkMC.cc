@@ -13,12 +13,14 @@ using namespace std;
 
 KinematicJoint* XWalkMC::kine=NULL;
 KinematicJoint* XWalkMC::childMap[NumReferenceFrames];
+const float XWalkMC::GAIT_VEL_RESOLUTION=2;
+const float XWalkMC::GAIT_ANGVEL_RESOLUTION=0.01f;
 
 XWalkMC::XWalkMC() : MotionCommand(), XWalkParameters(), dirty(false),
 										 targetVel(), targetAngVel(0), targetDisp(), targetAngDisp(0),
 										 velocityMode(true), displacementTime(0), plantingLegs(false), initialPlacement(true), p(),
 										 transitions(), active(), startTime(get_time()), period(0), 
-										 globPhase(0), rotationCenter(), contactMsg() {
+										 globPhase(0), rotationCenter(), contactMsg(), gaitTables(), gaitOutputs(), gaitQ(), gaitSteadyTime(0) {
 	if (kine==NULL) {
 		kine = new KinematicJoint;
 		kine->loadFile(::config->makePath(config->motion.kinematics).c_str());
@@ -42,6 +44,7 @@ void XWalkMC::setTargetVelocity(float x, float y, float a) {
 	unsigned int sysTime = get_time();
 	float time = (sysTime-startTime)/1000.f;
 	computePhase(time);
+	gaitSteadyTime = sysTime;
 	
 	float speed=targetVel.norm(), origSpeed=speed;
 	bool inAir[NumLegs];
@@ -271,6 +274,7 @@ int XWalkMC::updateOutputs() {
 	
 	if(active.size()>0) {
 		updateNeutralPos(curTime);
+		clearGaitTables(curTime);
 		// could probably be more selective about when we do the rest of this...
 		/*computePhase(dt);
 		 resetPeriod(dt,speed);
@@ -285,10 +289,12 @@ int XWalkMC::updateOutputs() {
 	
 	IKSolver::Point tgts[NumLegs];
 	
-	if(initialPlacement)
+	if(initialPlacement) {
 		updateOutputsInitial(curTime,ground,gravity,tgts);
-	else
+		gaitSteadyTime=curTime;
+	} else {
 		updateOutputsWalking(dt,ground,gravity,speed,tgts);
+	}
 	
 	sendLoadPredictions(tgts);
 	
@@ -720,6 +726,10 @@ void XWalkMC::updateOutputsWalking(float dt, const fmat::Column<3>& ground, cons
 	}
 	
 	bool contactChanged=false; // in the following loop, will set this flag if a foot has transitioned to/from full support (LegState::onGround toggled)
+	
+	// in a steady gait, joint angles can be interpolated from those recorded on previous strides instead of solving IK
+	GaitTable* gait = getSteadyGait(get_time(),speed);
+	const bool replayGait = (gait!=NULL && interpolateGait(*gait));
 
 	// for each leg, project foot position to ground plane along gravity vector,
 	// solve inverse kinematics, and send joint angles to motion manager
@@ -782,10 +792,15 @@ void XWalkMC::updateOutputsWalking(float dt, const fmat::Column<3>& ground, cons
 		
 		// inverse kinematics to get leg to target, and send values to motion manager
 		//TimeET ikTime;
-		solveIK(leg,tgts[leg]);
+		if(replayGait)
+			applyGait(leg);
+		else
+			solveIK(leg,tgts[leg]);
 		//ikAvg+=ikTime.Age().Value();
 		//++ikcnt;
 	}
+	if(gait!=NULL && !replayGait)
+		recordGait(*gait);
 	
 	if(contactChanged) {
 		// send driver message reporting leg contacts
@@ -1024,6 +1039,111 @@ void XWalkMC::solveIK(unsigned int leg, const IKSolver::Point& tgt) {
 	}
 }
 
+XWalkMC::GaitTable* XWalkMC::getSteadyGait(unsigned int curTime, float speed) {
+	if(!active.empty() || plantingLegs || (speed<=EPSILON && std::abs(targetAngVel)<=EPSILON))
+		return NULL;
+	// each leg needs one period to lift onto the new trajectory, and up to another to land from it
+	if(curTime-gaitSteadyTime < 2*period*1000)
+		return NULL;
+	
+	if(gaitOutputs.empty()) {
+		for(unsigned int leg=0; leg<NumLegs; ++leg) {
+			gaitLegBegin[leg]=gaitOutputs.size();
+			if(!legParams[leg].usable)
+				continue;
+			// same outputs as solveIK() sends
+			for(KinematicJoint* kj=childMap[FootFrameOffset+leg]; kj!=NULL; kj=kj->getParent())
+				if(kj->outputOffset!=plist::OutputSelector::UNUSED && kj->outputOffset<NumOutputs)
+					gaitOutputs.push_back(kj->outputOffset);
+		}
+		gaitLegBegin[NumLegs]=gaitOutputs.size();
+		gaitQ.resize(gaitOutputs.size());
+	}
+	
+	const GaitKey key(targetVel,targetAngVel);
+	std::map<GaitKey,GaitTable>::iterator it=gaitTables.find(key);
+	if(it==gaitTables.end()) {
+		if(gaitTables.size()>=MAX_GAIT_TABLES) {
+			// discard the least recently used
+			std::map<GaitKey,GaitTable>::iterator lru=gaitTables.begin();
+			for(it=gaitTables.begin(); it!=gaitTables.end(); ++it)
+				if(it->second.lastUsed<lru->second.lastUsed)
+					lru=it;
+			gaitTables.erase(lru);
+		}
+		it=gaitTables.insert(std::make_pair(key,GaitTable())).first;
+		it->second.q.resize(NUM_GAIT_BINS*gaitOutputs.size());
+	}
+	it->second.lastUsed=curTime;
+	return &it->second;
+}
+
+bool XWalkMC::interpolateGait(const GaitTable& gait) {
+	const size_t n=gaitOutputs.size();
+	if(n==0)
+		return false;
+	const unsigned int bin = std::min(static_cast<unsigned int>(globPhase*NUM_GAIT_BINS), NUM_GAIT_BINS-1);
+	if(gait.phases[bin]<0)
+		return false;
+	// find the recorded bins on either side of globPhase
+	unsigned int a, b;
+	if(globPhase>=gait.phases[bin]) {
+		a=bin;
+		b=(bin+1)%NUM_GAIT_BINS;
+	} else {
+		a=(bin+NUM_GAIT_BINS-1)%NUM_GAIT_BINS;
+		b=bin;
+	}
+	if(gait.phases[a]<0 || gait.phases[b]<0)
+		return false;
+	float pa=gait.phases[a], pb=gait.phases[b], ph=globPhase;
+	// unwrap the end of the stride
+	if(pb<pa)
+		pb+=1;
+	if(ph<pa)
+		ph+=1;
+	const float t = (pb>pa) ? (ph-pa)/(pb-pa) : 0;
+	const float* qa=&gait.q[a*n];
+	const float* qb=&gait.q[b*n];
+	for(size_t i=0; i<n; ++i)
+		gaitQ[i] = qa[i] + t*(qb[i]-qa[i]);
+	return true;
+}
+
+void XWalkMC::applyGait(unsigned int leg) {
+	for(unsigned int i=gaitLegBegin[leg]; i!=gaitLegBegin[leg+1]; ++i) {
+		KinematicJoint * kj = childMap[gaitOutputs[i]];
+		// immobile joints (e.g. frozen non-leg joints) already hold this frame's value
+		if(kj->isMobile())
+			kj->setQ(gaitQ[i]);
+		motman->setOutput(this, gaitOutputs[i], kj->getQ());
+	}
+}
+
+void XWalkMC::recordGait(GaitTable& gait) {
+	const size_t n=gaitOutputs.size();
+	if(n==0)
+		return;
+	const unsigned int bin = std::min(static_cast<unsigned int>(globPhase*NUM_GAIT_BINS), NUM_GAIT_BINS-1);
+	float* q=&gait.q[bin*n];
+	for(size_t i=0; i<n; ++i) {
+		q[i] = childMap[gaitOutputs[i]]->getQ();
+#ifndef PLATFORM_APERIOS
+		if(std::isnan(q[i])) { // IK failed, solveIK() didn't send this one
+			gait.phases[bin]=-1;
+			return;
+		}
+#endif
+	}
+	gait.phases[bin]=globPhase;
+}
+
+void XWalkMC::clearGaitTables(unsigned int curTime) {
+	gaitTables.clear();
+	gaitOutputs.clear();
+	gaitSteadyTime=curTime;
+}
+
 void XWalkMC::computePressure(float mass, float massx, float massy, const std::vector<fmat::Column<2> >& contacts, std::vector<float>& pressures) {
 	const float gAcc = 9.80665f;
 	NEWMAT::ColumnVector weight(3);
@@ -11,7 +11,9 @@
 #include "Shared/Config.h"
 #include "Shared/get_time.h"
 #include "IPC/DriverMessaging.h"
+#include <map>
 #include <set>
+#include <vector>
 
 //! Extreme walk engine handles legged locomotion on hexapods and beyond
 class XWalkMC : public MotionCommand, public XWalkParameters {
@@ -94,6 +96,18 @@ protected:
 	//! solves inverse kinematics and send affected output values to motion manager
 	void solveIK(unsigned int leg, const IKSolver::Point& tgt);
 	
+	struct GaitTable;
+	//! returns the gait table for the current target velocity if the walk is in a steady, periodic gait, otherwise NULL (see GaitTable)
+	GaitTable* getSteadyGait(unsigned int curTime, float speed);
+	//! interpolates joint values for the current #globPhase from @a gait into #gaitQ, returns false if the bins around #globPhase haven't been recorded yet
+	bool interpolateGait(const GaitTable& gait);
+	//! sends the joint values in #gaitQ for @a leg to the motion manager, in place of solveIK()
+	void applyGait(unsigned int leg);
+	//! stores the joint values just solved by solveIK() into the bin of @a gait for the current #globPhase
+	void recordGait(GaitTable& gait);
+	//! discards all gait tables, e.g. because parameters changed
+	void clearGaitTables(unsigned int curTime);
+	
 	// Given the mass, its position x and y, and a list of contact points, stores results into @a pressures
 	/*! @param mass being supported in kilograms
 	 *  @param massx center of mass along x axis, in millimeters
@@ -174,6 +188,44 @@ protected:
 	};
 	LegState legStates[NumLegs]; //!< storage of cached stride information for each leg
 	
+	//! joint values recorded from inverse kinematics while walking at a particular target velocity, indexed by phase within the stride
+	/*! Once a velocity has been held long enough for every leg to complete a stride at it, the gait is
+	 *  periodic in #globPhase: the foot trajectories, body offsets, and thus the leg joint angles, repeat
+	 *  each period.  Each frame of steady walking records the solved joint angles in the bin for its phase,
+	 *  and once the bins on either side of the current phase are filled, the joint angles are interpolated
+	 *  instead of solving inverse kinematics for each leg.  Phases which haven't been seen yet are solved
+	 *  live (and recorded).  Foot trajectories and leg states are still computed each frame, they are cheap
+	 *  and later velocity changes depend on them; IK is the expensive part. */
+	struct GaitTable {
+		//! constructor
+		GaitTable() : phases(NUM_GAIT_BINS,-1.f), q(), lastUsed(0) {}
+		std::vector<float> phases; //!< the #globPhase at which each bin was recorded, in [i/NUM_GAIT_BINS, (i+1)/NUM_GAIT_BINS) for bin i, or -1 if not recorded
+		std::vector<float> q; //!< the joint values of each bin, gaitOutputs.size() per bin
+		unsigned int lastUsed; //!< time the table was last used, to choose which to discard when there are too many
+	};
+	static const unsigned int NUM_GAIT_BINS=32; //!< number of phase bins in each GaitTable
+	static const unsigned int MAX_GAIT_TABLES=16; //!< number of target velocities to keep a GaitTable for
+	static const float GAIT_VEL_RESOLUTION; //!< target velocities (mm/s) within this distance share a GaitTable
+	static const float GAIT_ANGVEL_RESOLUTION; //!< target angular velocities (rad/s) within this distance share a GaitTable
+	
+	//! the target velocity quantized by #GAIT_VEL_RESOLUTION and #GAIT_ANGVEL_RESOLUTION, indexes #gaitTables
+	struct GaitKey {
+		//! constructor
+		GaitKey(const fmat::Column<2>& vel, float angVel)
+			: x(static_cast<int>(std::floor(vel[0]/GAIT_VEL_RESOLUTION+.5f))), y(static_cast<int>(std::floor(vel[1]/GAIT_VEL_RESOLUTION+.5f))),
+			a(static_cast<int>(std::floor(angVel/GAIT_ANGVEL_RESOLUTION+.5f))) {}
+		//! lexicographic ordering for std::map
+		bool operator<(const GaitKey& k) const { return x!=k.x ? x<k.x : y!=k.y ? y<k.y : a<k.a; }
+		int x; //!< quantized x velocity
+		int y; //!< quantized y velocity
+		int a; //!< quantized angular velocity
+	};
+	std::map<GaitKey,GaitTable> gaitTables; //!< steady gaits seen so far, see GaitTable
+	std::vector<unsigned int> gaitOutputs; //!< the outputs recorded in each GaitTable bin, the joints leading to each leg's foot, grouped by leg
+	unsigned int gaitLegBegin[NumLegs+1]; //!< index of each leg's first entry in #gaitOutputs, with the end of the last leg in the final entry
+	std::vector<float> gaitQ; //!< joint values interpolated by interpolateGait(), parallel to #gaitOutputs
+	unsigned int gaitSteadyTime; //!< time at which the target velocity last changed (or parameters, or initial placement), the gait is steady two periods later
+	
 	static KinematicJoint* kine;
 	static KinematicJoint* childMap[NumReferenceFrames];
 };
@@ -2,12 +2,14 @@
 #ifndef INCLUDED_AStar_h_
 #define INCLUDED_AStar_h_
 
+#include "Shared/TimeET.h"
 #include <vector>
-#include <deque>
 #include <set>
 #include <algorithm>
 #include <functional>
+#include <new>
 #include <tr1/unordered_set>
+#include <tr1/unordered_map>
 
 //! Holds data structures for search context, results, and implementation of A★ path planning algorithm, see AStar::astar
 namespace AStar {
@@ -15,14 +17,17 @@ namespace AStar {
 	//! Stores user state along with search context
 	template<class State>
 	struct Node {
-		//! constructor, pass parent node @a p, cost so far @a c, remaining cost heuristic @a r, and user state @a st
-		Node(const Node* p, float c, float r, const State& st) : parent(p), cost(c), remain(r), total(c+r), state(st) {}
+		//! constructor, pass parent node @a p, cost so far @a c, remaining cost heuristic @a r, and user state @a st, with the heuristic inflated by @a w for the search order
+		Node(const Node* p, float c, float r, const State& st, float w=1) : parent(p), cost(c), remain(r), total(c+w*r), state(st), heapIndex(NOT_OPEN) {}
 		
 		const Node* parent; //!< source for this search node
 		float cost; //!< cost to reach this node from start state
 		float remain; //!< estimated cost remaining to goal
-		float total; //!< cached value of #cost + #remain
+		float total; //!< cached value of #cost + #remain, with #remain multiplied by the search's weight (see astar())
 		State state; //!< user state
+		size_t heapIndex; //!< position of the node in its PriorityQueue, or #NOT_OPEN if it isn't in one
+		
+		static const size_t NOT_OPEN=-1U; //!< value of #heapIndex for nodes which aren't in the queue (i.e. closed nodes)
 		
 		//! Search nodes should be sorted based on total cost (#total)
 		/*! Note the inverted comparison, STL heap operations put max at the heap root, but we want the min */
@@ -34,6 +39,162 @@ namespace AStar {
 		};
 	};
 
+	//! A binary heap of search nodes, ordered by Node::CostCmp, which tracks each node's position (Node::heapIndex) so a node's priority can be changed in place
+	/*! The best node is at front(), and the other nodes follow in heap order.  Like the STL heap
+	 *  functions, @a Cmp(a,b) should return true if @a a comes @e after @a b.  @a Node must have a
+	 *  @c heapIndex member and a @c NOT_OPEN constant, as AStar::Node does. */
+	template<class Node, class Cmp=typename Node::CostCmp>
+	class PriorityQueue {
+	public:
+		typedef typename std::vector<Node*>::iterator iterator; //!< iterates over the nodes in heap order
+		typedef typename std::vector<Node*>::const_iterator const_iterator; //!< iterates over the nodes in heap order
+		
+		//! constructor
+		PriorityQueue() : heap() {}
+		
+		bool empty() const { return heap.empty(); } //!< returns true if there are no nodes
+		size_t size() const { return heap.size(); } //!< returns the number of nodes
+		Node* front() const { return heap.front(); } //!< returns the best node
+		iterator begin() { return heap.begin(); } //!< returns the first node (the best)
+		const_iterator begin() const { return heap.begin(); } //!< returns the first node (the best)
+		iterator end() { return heap.end(); } //!< returns one past the last node
+		const_iterator end() const { return heap.end(); } //!< returns one past the last node
+		
+		//! adds @a n to the queue
+		void push(Node* n) {
+			n->heapIndex = heap.size();
+			heap.push_back(n);
+			siftUp(n->heapIndex);
+		}
+		//! removes the best node, setting its Node::heapIndex to Node::NOT_OPEN
+		void pop() {
+			Node* last = heap.back();
+			heap.front()->heapIndex = Node::NOT_OPEN;
+			heap.pop_back();
+			if(!heap.empty()) {
+				heap.front() = last;
+				last->heapIndex = 0;
+				siftDown(0);
+			}
+		}
+		//! restores the heap order after the priority of @a n (which must be in the queue) has improved
+		void decrease(Node* n) { siftUp(n->heapIndex); }
+		//! restores the heap order after the priority of @a n (which must be in the queue) has changed either way
+		void update(Node* n) {
+			siftUp(n->heapIndex);
+			siftDown(n->heapIndex);
+		}
+		//! removes @a n (which must be in the queue), setting its Node::heapIndex to Node::NOT_OPEN
+		void remove(Node* n) {
+			const size_t i = n->heapIndex;
+			Node* last = heap.back();
+			heap.pop_back();
+			n->heapIndex = Node::NOT_OPEN;
+			if(i<heap.size()) {
+				heap[i] = last;
+				last->heapIndex = i;
+				update(last);
+			}
+		}
+		//! restores the heap order after the priorities of any number of nodes have changed
+		void reorder() {
+			for(size_t i=heap.size()/2; i-->0; )
+				siftDown(i);
+		}
+		//! removes all nodes (without changing their Node::heapIndex)
+		void clear() { heap.clear(); }
+		//! exchanges contents with @a q
+		void swap(PriorityQueue& q) { heap.swap(q.heap); }
+		
+	protected:
+		//! returns true if @a a should come before @a b
+		static bool before(const Node* a, const Node* b) { return Cmp()(b,a); }
+		//! moves the node at @a i toward the root until its parent comes before it
+		void siftUp(size_t i) {
+			Node* n = heap[i];
+			while(i>0) {
+				const size_t p = (i-1)/2;
+				if(!before(n,heap[p]))
+					break;
+				heap[i] = heap[p];
+				heap[i]->heapIndex = i;
+				i = p;
+			}
+			heap[i] = n;
+			n->heapIndex = i;
+		}
+		//! moves the node at @a i toward the leaves until it comes before its children
+		void siftDown(size_t i) {
+			Node* n = heap[i];
+			const size_t num = heap.size();
+			while(true) {
+				size_t c = 2*i+1;
+				if(c>=num)
+					break;
+				if(c+1<num && before(heap[c+1],heap[c]))
+					++c;
+				if(!before(heap[c],n))
+					break;
+				heap[i] = heap[c];
+				heap[i]->heapIndex = i;
+				i = c;
+			}
+			heap[i] = n;
+			n->heapIndex = i;
+		}
+		
+		std::vector<Node*> heap; //!< the nodes, each node comes before its children (at 2i+1 and 2i+2)
+	};
+	
+	//! Allocates the nodes of a search in blocks, which are all released together when the arena is destroyed
+	template<class Node>
+	class NodeArena {
+	public:
+		//! constructor
+		NodeArena() : blocks(), used(BLOCK_SIZE) {}
+		//! move constructor, takes the nodes of @a a
+		NodeArena(NodeArena&& a) : blocks(), used(BLOCK_SIZE) { swap(a); }
+		//! destructor, destroys all the nodes
+		~NodeArena() { clear(); }
+		
+		//! returns a new node copied from @a n, which remains valid until the arena is cleared or destroyed
+		Node* create(const Node& n) {
+			if(used==BLOCK_SIZE) {
+				blocks.push_back(static_cast<Node*>(::operator new(BLOCK_SIZE*sizeof(Node))));
+				used=0;
+			}
+			Node* ans = new(blocks.back()+used) Node(n);
+			++used;
+			return ans;
+		}
+		//! returns the number of nodes
+		size_t size() const { return blocks.empty() ? 0 : (blocks.size()-1)*BLOCK_SIZE+used; }
+		//! destroys all the nodes
+		void clear() {
+			for(size_t b=0; b<blocks.size(); ++b) {
+				const size_t n = (b+1==blocks.size()) ? used : BLOCK_SIZE;
+				for(size_t i=0; i<n; ++i)
+					blocks[b][i].~Node();
+				::operator delete(blocks[b]);
+			}
+			blocks.clear();
+			used=BLOCK_SIZE;
+		}
+		//! exchanges contents with @a a
+		void swap(NodeArena& a) {
+			blocks.swap(a.blocks);
+			std::swap(used,a.used);
+		}
+		
+	protected:
+		static const size_t BLOCK_SIZE=1024; //!< the number of nodes allocated at once
+		std::vector<Node*> blocks; //!< storage for the nodes, each holds BLOCK_SIZE nodes
+		size_t used; //!< the number of nodes created in the last block
+	private:
+		NodeArena(const NodeArena&); //!< don't call
+		NodeArena& operator=(const NodeArena&); //!< don't call
+	};
+	
 	//! For efficient lookup of existance of states in open or closed list, uses user's Cmp on the user state within the search node
 	template<class State, class Cmp>
 	struct StateCmp : public std::binary_function<Node<State>*, Node<State>*, bool> {
@@ -71,63 +232,68 @@ namespace AStar {
 		typedef typename std::vector<State>::const_iterator path_const_iterator;
 		typedef typename NodeSet::iterator set_iterator;
 		typedef typename NodeSet::const_iterator set_const_iterator;
-		typedef typename std::deque<Node*>::iterator priority_iterator;
-		typedef typename std::deque<Node*>::const_iterator priority_const_iterator;
+		typedef typename PriorityQueue<Node>::iterator priority_iterator;
+		typedef typename PriorityQueue<Node>::const_iterator priority_const_iterator;
+		
+		//! constructor
+		Results() : cost(0), path(), closed(), open(), priorities(), nodes() {}
+		//! move constructor, takes ownership of the nodes of @a r
+		Results(Results&& r) : cost(0), path(), closed(), open(), priorities(), nodes() { swap(r); }
 		
 		float cost;
 		std::vector<State> path;
 		NodeSet closed;
 		NodeSet open;
-		std::deque<Node*> priorities;
-		~Results() {
-			// don't need to delete from priorities... everything is either open or closed
-			/*for(typename std::deque<Node*>::const_iterator it=priorities.begin(); it!=priorities.end(); ++it)
-				delete *it;*/
-			priorities.clear();
-			for(set_const_iterator it=open.begin(); it!=open.end(); ++it)
-				delete *it;
-			open.clear();
-			for(set_const_iterator it=closed.begin(); it!=closed.end(); ++it)
-				delete *it;
-			closed.clear();
+		PriorityQueue<Node> priorities; //!< the open nodes in heap order, with the best (the goal, if a path was found) at the front
+		NodeArena<Node> nodes; //!< storage for all of the nodes in #open and #closed, released when the results are destroyed
+		//! exchanges contents with @a r (including ownership of the nodes)
+		void swap(Results& r) {
+			std::swap(cost,r.cost);
+			path.swap(r.path);
+			closed.swap(r.closed);
+			open.swap(r.open);
+			priorities.swap(r.priorities);
+			nodes.swap(r.nodes);
 		}
+	private:
+		Results(const Results&); //!< don't call (would share nodes)
+		Results& operator=(const Results&); //!< don't call (would share nodes)
 	};
 	
 	//! A★ search using custom comparison on State type
 	/*! Expand is expected to be compatible with const std::vector<std::pair<float,State> >& (Context::*expand)(const State& st, const State& goal) const \n
 	 * Heuristic is expected to be compatible with float (Context::*heuristic)(const State& st, const State& goal) const \n
-	 * The Cmp argument is not actually used, but the function accepts an instance so you can avoid specifying all of the template parameters */
+	 * The Cmp argument is not actually used, but the function accepts an instance so you can avoid specifying all of the template parameters \n
+	 * Nodes whose cost plus heuristic exceeds @a bound (if non-zero) are pruned.  A @a weight greater than 1 gives weighted A★:
+	 * the heuristic is multiplied by @a weight to order the search, which usually expands far fewer nodes, and the path found
+	 * costs at most @a weight times the optimal cost (with an admissable heuristic).  See anytime(). */
 	template<class Context, class State, class Expand, class Heuristic, class Validate, class Cmp>
 	Results<State,Cmp>
-	astar(const Context& ctxt, const State& initial, const State& goal, Expand expand, Heuristic heuristic, Validate validate, const Cmp&, float bound=0) {
+	astar(const Context& ctxt, const State& initial, const State& goal, Expand expand, Heuristic heuristic, Validate validate, const Cmp&, float bound=0, float weight=1) {
 		typedef Node<State> Node;
-		typedef StateCmp<State,Cmp> StateCmp;
 		Results<State,Cmp> results;
-		typename Results<State,Cmp>::NodeSet& closed = results.closed;
-		typename Results<State,Cmp>::NodeSet& open = results.open;
-		std::deque<Node*>& priorities = results.priorities;
-		typename Node::CostCmp costCmp;
+		// all nodes go in 'closed' during the search, with Node::heapIndex telling whether they are open;
+		// the open nodes are moved to 'open' at the end, so each neighbor takes a single lookup
+		typename Results<State,Cmp>::NodeSet& nodes = results.closed;
+		PriorityQueue<Node>& priorities = results.priorities;
 		
 		{
-			Node* n = new Node(NULL,0,(ctxt.*heuristic)(initial,goal),initial);
-			open.insert(n);
-			priorities.push_back(n);
+			Node* n = results.nodes.create(Node(NULL,0,(ctxt.*heuristic)(initial,goal),initial,weight));
+			nodes.insert(n);
+			priorities.push(n);
 		}
 		
-		while(!open.empty()) {
+		while(!priorities.empty()) {
 			Node* cur = priorities.front();
 			bool valid = (ctxt.*validate)(cur->state);
 			
 			if(valid && cur->state == goal) { // or test (cur->remain==0) ?
 				reconstruct(cur,results.path);
 				results.cost = cur->cost;
-				return results;
+				break;
 			}
 			
-			std::pop_heap(priorities.begin(),priorities.end(),costCmp);
-			priorities.pop_back();
-			open.erase(cur);
-			closed.insert(cur);
+			priorities.pop();
 			if(!valid)
 				continue;
 			//std::cout << "Closing " << cur->state << " cost " << cur->cost << " total " << cur->total << std::endl;
@@ -135,27 +301,35 @@ namespace AStar {
 			const State* parentState = (cur->parent!=NULL) ? &cur->parent->state : static_cast<State*>(NULL);
 			const std::vector<std::pair<float,State> >& neighbors = (ctxt.*expand)(parentState,cur->state, goal);
 			for(typename std::vector<std::pair<float,State> >::const_iterator it=neighbors.begin(); it!=neighbors.end(); ++it) {
-				Node n(cur, cur->cost+it->first, (ctxt.*heuristic)(it->second,goal), it->second);
-				if(closed.count(&n) > 0 || (bound>0 && n.total>bound))
-					continue;
-				typename Results<State,Cmp>::set_const_iterator op = open.find(&n);
-				if(op == open.end()) {
+				Node n(cur, cur->cost+it->first, (ctxt.*heuristic)(it->second,goal), it->second, weight);
+				typename Results<State,Cmp>::set_const_iterator op = nodes.find(&n);
+				if(op == nodes.end()) {
+					if(bound>0 && n.cost+n.remain>bound)
+						continue;
 					// new node, add it
-					Node * hn = new Node(n); // clone to get heap storage
-					open.insert(hn);
-					//std::cout << "open insert " << hn->cost << ' ' << hn->remain << ' ' << hn->total << ' ' << open.size() << std::endl;
-					priorities.push_back(hn);
-					std::push_heap(priorities.begin(), priorities.end(),costCmp);
-				} else if(n.cost < (*op)->cost) {
-					// better path to previous node, update it
-					**op = n;
-					std::make_heap(priorities.begin(), priorities.end(),costCmp); // can we do something more efficient?
+					Node * hn = results.nodes.create(n);
+					nodes.insert(hn);
+					//std::cout << "open insert " << hn->cost << ' ' << hn->remain << ' ' << hn->total << ' ' << nodes.size() << std::endl;
+					priorities.push(hn);
+				} else if((*op)->heapIndex!=Node::NOT_OPEN && n.cost < (*op)->cost) {
+					// better path to an open node, update it (closed nodes are never reopened)
+					Node& prev = **op;
+					prev.parent = n.parent;
+					prev.cost = n.cost;
+					prev.remain = n.remain;
+					prev.total = n.total;
+					priorities.decrease(&prev);
 				} else {
 					// we can already do better, drop new node
 					// since we used stack allocation for n, this is a no-op
 				}
 			}
 		}
+		
+		for(typename PriorityQueue<Node>::const_iterator it=priorities.begin(); it!=priorities.end(); ++it) {
+			nodes.erase(*it);
+			results.open.insert(*it);
+		}
 		return results;
 	}
 	
@@ -175,6 +349,179 @@ namespace AStar {
 		return astar(ctxt,initial,goal,&Context::expand,&Context::heuristic,&Context::validate,std::less<State>(),bound);
 	}
 	
+	//! Anytime weighted A★: returns a first path quickly, then searches again with decreasing weights for better paths until cancelled
+	/*! Each iteration is astar() with the current weight, bounded by the cost of the best path so far, so it only
+	 *  finds strictly better paths.  The weight starts at @a weight, and is reduced by @a decrement after each
+	 *  iteration (to a minimum of 1; if @a decrement isn't positive, the second iteration uses weight 1).  Each time a better path is found, @a improved is called with the results
+	 *  and the weight they were found with: e.g. the caller can start executing the first path while the search
+	 *  continues, and switch to a later one.  Return false from @a improved to stop searching.
+	 *
+	 *  Searching stops after the iteration with weight 1, or when an iteration finds no better path (with an
+	 *  admissable heuristic, the best path is then optimal).  Returns the results containing the best path.
+	 *
+	 *  Each iteration repeats much of the work of the previous ones, so domains with expensive expansions should
+	 *  store them, e.g. GaitedFootsteps::cacheExpansions.
+	 *
+	 *  @a improved should be compatible with bool improved(const Results<State,Cmp>& res, float weight) */
+	template<class Context, class State, class Expand, class Heuristic, class Validate, class Cmp, class Improved>
+	Results<State,Cmp>
+	anytime(const Context& ctxt, const State& initial, const State& goal, Expand expand, Heuristic heuristic, Validate validate, const Cmp& cmp, Improved improved, float weight, float decrement, float bound=0) {
+		Results<State,Cmp> best;
+		best.cost = bound;
+		if(!(weight>=1))
+			weight=1;
+		while(true) {
+			Results<State,Cmp> res = astar(ctxt,initial,goal,expand,heuristic,validate,cmp,best.cost,weight);
+			if(res.path.empty())
+				break; // nothing better within the bound
+			if(best.path.empty() || res.cost<best.cost) {
+				best.swap(res);
+				if(!improved(static_cast<const Results<State,Cmp>&>(best),weight))
+					break;
+			}
+			if(weight<=1)
+				break;
+			weight = (decrement>0) ? std::max(1.f, weight-decrement) : 1; // a non-positive decrement would never reach 1
+		}
+		if(best.path.empty())
+			best.cost=0;
+		return best;
+	}
+	
+	//! Anytime weighted A★ using operator< to sort user State type, assumes Context has functions named "expand", "heuristic", and "validate", see the full version of anytime()
+	template<class Context, class State, class Improved>
+	Results<State, std::less<State> >
+	anytime(const Context& ctxt, const State& initial, const State& goal, Improved improved, float weight, float decrement, float bound=0) {
+		return anytime(ctxt,initial,goal,&Context::expand,&Context::heuristic,&Context::validate,std::less<State>(),improved,weight,decrement,bound);
+	}
+	
+	//! Anytime repairing A★ (ARA★, Likhachev, Gordon & Thrun 2003): like anytime(), but each iteration continues the previous search instead of starting over
+	/*! The first iteration is weighted astar() with @a weight.  Each later iteration reduces the weight by
+	 *  @a decrement (to a minimum of 1; if @a decrement isn't positive, the second iteration uses weight 1)
+	 *  and reuses the costs found so far: only nodes whose cost improved after they were expanded are
+	 *  reconsidered, along with the nodes which were still open, so the later iterations are usually much cheaper than anytime()'s repeated searches.  Each path found
+	 *  costs at most the current weight times the optimal cost (with an admissable heuristic).
+	 *
+	 *  Each time a better path is found, @a improved is called with the results and the weight, as with
+	 *  anytime() (while searching, all of the nodes are in Results::closed, only the path and cost are
+	 *  final).  Return false from @a improved to stop searching.  Searching also stops after the
+	 *  iteration with weight 1, or after @a budget seconds if non-zero, so the caller can bound the time
+	 *  spent replanning: the best path found so far is returned, which is empty if the first iteration
+	 *  didn't finish in time.
+	 *
+	 *  Each state is validated once, the first time it is expanded.  */
+	template<class Context, class State, class Expand, class Heuristic, class Validate, class Cmp, class Improved>
+	Results<State,Cmp>
+	ara(const Context& ctxt, const State& initial, const State& goal, Expand expand, Heuristic heuristic, Validate validate, const Cmp&, Improved improved, float weight, float decrement, float budget=0) {
+		typedef Node<State> Node;
+		typedef std::tr1::unordered_map<const Node*,unsigned int> ExpandedMap;
+		const unsigned int INVALID=-1U; // marks nodes which failed validation in 'expanded'
+		TimeET timer;
+		Results<State,Cmp> results;
+		typename Results<State,Cmp>::NodeSet& nodes = results.closed; // as in astar(), open nodes are moved at the end
+		PriorityQueue<Node>& priorities = results.priorities;
+		ExpandedMap expanded; // the iteration in which each node was last expanded
+		std::vector<Node*> incons; // nodes whose cost improved after they were expanded in this iteration
+		Node* goalNode = NULL;
+		if(!(weight>=1))
+			weight=1;
+		
+		{
+			Node* n = results.nodes.create(Node(NULL,0,(ctxt.*heuristic)(initial,goal),initial,weight));
+			nodes.insert(n);
+			priorities.push(n);
+		}
+		
+		bool timeout=false;
+		for(unsigned int iteration=0; ; ++iteration) {
+			for(size_t i=1; !priorities.empty(); ++i) {
+				Node* cur = priorities.front();
+				if(goalNode!=NULL && !typename Node::CostCmp()(goalNode,cur))
+					break; // nothing open can improve on the goal at this weight
+				if(budget>0 && i%64==0 && timer.Age().Value()>budget) {
+					timeout=true;
+					break;
+				}
+				priorities.pop();
+				
+				typename ExpandedMap::iterator ex = expanded.find(cur);
+				if(ex==expanded.end()) {
+					if(!(ctxt.*validate)(cur->state)) {
+						expanded[cur] = INVALID;
+						continue;
+					}
+					ex = expanded.insert(std::make_pair(cur,iteration)).first;
+				}
+				ex->second = iteration;
+				if(cur->state == goal) {
+					goalNode = cur;
+					continue;
+				}
+				
+				const State* parentState = (cur->parent!=NULL) ? &cur->parent->state : static_cast<State*>(NULL);
+				const std::vector<std::pair<float,State> >& neighbors = (ctxt.*expand)(parentState,cur->state, goal);
+				for(typename std::vector<std::pair<float,State> >::const_iterator it=neighbors.begin(); it!=neighbors.end(); ++it) {
+					Node n(cur, cur->cost+it->first, (ctxt.*heuristic)(it->second,goal), it->second, weight);
+					typename Results<State,Cmp>::set_const_iterator op = nodes.find(&n);
+					if(op == nodes.end()) {
+						Node * hn = results.nodes.create(n);
+						nodes.insert(hn);
+						priorities.push(hn);
+					} else if(n.cost < (*op)->cost) {
+						Node& prev = **op;
+						prev.parent = n.parent;
+						prev.cost = n.cost;
+						prev.total = n.total;
+						if(prev.heapIndex!=Node::NOT_OPEN) {
+							priorities.decrease(&prev);
+						} else {
+							typename ExpandedMap::const_iterator pex = expanded.find(&prev);
+							if(pex==expanded.end() || (pex->second!=iteration && pex->second!=INVALID))
+								priorities.push(&prev); // expanded in an earlier iteration, so it can be reopened
+							else if(pex->second==iteration)
+								incons.push_back(&prev); // reconsider in the next iteration
+						}
+					}
+				}
+			}
+			
+			if(goalNode!=NULL && (results.path.empty() || goalNode->cost<results.cost)) {
+				results.path.clear();
+				reconstruct(goalNode,results.path);
+				results.cost = goalNode->cost;
+				if(!improved(static_cast<const Results<State,Cmp>&>(results),weight))
+					break;
+			}
+			if(timeout || weight<=1 || (priorities.empty() && incons.empty()))
+				break;
+			
+			// lower the weight, reopen the inconsistent nodes, and reorder for the new weight
+			weight = (decrement>0) ? std::max(1.f, weight-decrement) : 1; // a non-positive decrement would never reach 1
+			for(typename std::vector<Node*>::const_iterator it=incons.begin(); it!=incons.end(); ++it)
+				if((*it)->heapIndex==Node::NOT_OPEN)
+					priorities.push(*it);
+			incons.clear();
+			for(typename PriorityQueue<Node>::iterator it=priorities.begin(); it!=priorities.end(); ++it)
+				(*it)->total = (*it)->cost + weight*(*it)->remain;
+			if(goalNode!=NULL)
+				goalNode->total = goalNode->cost + weight*goalNode->remain;
+			priorities.reorder();
+		}
+		
+		for(typename PriorityQueue<Node>::const_iterator it=priorities.begin(); it!=priorities.end(); ++it) {
+			nodes.erase(*it);
+			results.open.insert(*it);
+		}
+		return results;
+	}
+	
+	//! ARA★ using operator< to sort user State type, assumes Context has functions named "expand", "heuristic", and "validate", see the full version of ara()
+	template<class Context, class State, class Improved>
+	Results<State, std::less<State> >
+	ara(const Context& ctxt, const State& initial, const State& goal, Improved improved, float weight, float decrement, float budget=0) {
+		return ara(ctxt,initial,goal,&Context::expand,&Context::heuristic,&Context::validate,std::less<State>(),improved,weight,decrement,budget);
+	}
+	
 	//! constructs @a path by following parent pointers from @a n; the specified node is included in the path
 	template<class Node, class State>
 	void reconstruct(const Node* n, std::vector<State>& path, size_t depth=1) {
@@ -0,0 +1,288 @@
+//-*-c++-*-
+#ifndef INCLUDED_DStarLite_h_
+#define INCLUDED_DStarLite_h_
+
+#include "Planners/AStar.h"
+#include "Shared/TimeET.h"
+#include <vector>
+#include <limits>
+#include <tr1/unordered_set>
+
+//! Incremental shortest path search (D★ Lite, Koenig & Likhachev 2002): after the map changes or the robot moves, repairs the previous search instead of starting over
+/*! The search runs backward from the goal, so each state's cost-to-goal (@c g) survives moves of
+ *  the start.  When edges change, only states whose cost-to-goal is affected are re-expanded, which
+ *  is usually a small part of the map when obstacles appear or disappear near the robot.
+ *
+ *  Context is a search domain like the one used by AStar::astar(), e.g. GridWorld, providing:
+ *  - <tt>expand(const State* parent, const State& st, const State& goal)</tt>, the successors of
+ *    @a st paired with their costs (@a parent is always NULL, the search has no forward parents)
+ *  - <tt>predecessors(const State& st)</tt>, the states which expand() to @a st, paired with the
+ *    costs of those moves
+ *  - <tt>heuristic(const State& st, const State& goal)</tt>, an admissable and consistent estimate
+ *    of the cost from @a st to @a goal
+ *
+ *  Context's validate() isn't used: the domain should leave invalid states out of its expansions.
+ *  The context is held by reference, so the caller can modify it (e.g. block cells of a
+ *  GridWorld, perhaps by exporting a ConfigurationSpaceMap) and then report each state whose
+ *  expansion changed with updateState() (see GridWorld::affected()).  Moving the robot along the
+ *  path is reported with setStart().  Neither does any searching; the next call to plan() does.
+ *
+ *  Usage:
+ *  @code
+ *  DStarLite<GridWorld> dstar(gw, start, goal);
+ *  dstar.plan();
+ *  dstar.getPath(path);
+ *  // ...later, after blocking cell x of gw:
+ *  std::vector<GridWorld::State> changed;
+ *  gw.affected(x, changed);
+ *  dstar.updateStates(changed);
+ *  dstar.plan(0.05); // at most 50ms
+ *  @endcode */
+template<class Context, class State=typename Context::State>
+class DStarLite {
+public:
+	//! the outcomes of plan()
+	enum Status_t {
+		PATH_FOUND, //!< getPath() will return the shortest path
+		NO_PATH, //!< the goal can't be reached from the start
+		TIMEOUT //!< the time budget ran out, call plan() again to continue the search
+	};
+
+	//! constructor, plans paths from @a start to @a goal in @a context, which must outlive the planner
+	DStarLite(const Context& context, const State& start, const State& goal)
+		: ctxt(context), startState(start), goalState(goal), km(0), nodes(), arena(), queue(), succ(), pred(), expansions(0)
+	{
+		Node* g = lookup(goal);
+		g->rhs = 0;
+		enqueue(g);
+	}
+
+	//! brings the search up to date with any changes, returns PATH_FOUND once getPath() will return a shortest path
+	/*! If @a budget is non-zero, stops after about @a budget seconds and returns TIMEOUT; the search
+	 *  is left consistent, so another call to plan() picks up where this one stopped. */
+	Status_t plan(float budget=0);
+
+	//! moves the start of the path to @a st, e.g. as the robot follows the path
+	void setStart(const State& st) {
+		km += ctxt.heuristic(startState,st);
+		startState = st;
+	}
+
+	//! tells the planner that the successors of @a st, or their costs, have changed
+	void updateState(const State& st) { updateVertex(lookup(st)); }
+	//! calls updateState() for each of @a states
+	void updateStates(const std::vector<State>& states) {
+		for(typename std::vector<State>::const_iterator it=states.begin(); it!=states.end(); ++it)
+			updateState(*it);
+	}
+
+	//! stores the path from the start to the goal into @a path, returns false (and clears @a path) if there isn't one
+	/*! Only valid after plan() returns PATH_FOUND, with no changes since */
+	bool getPath(std::vector<State>& path) const;
+
+	//! returns the cost of the path from the start to the goal (infinity if there isn't one), only valid after plan() returns PATH_FOUND
+	float getCost() const { return getG(startState); }
+
+	const State& getStart() const { return startState; } //!< returns the start of the path
+	const State& getGoal() const { return goalState; } //!< returns the goal of the path
+	size_t getNumExpansions() const { return expansions; } //!< returns the number of states expanded by all calls to plan()
+	size_t getNumStates() const { return nodes.size(); } //!< returns the number of states the search has reached
+
+protected:
+	//! search state for each state reached by the search
+	struct Node {
+		//! constructor, the state starts unreached
+		explicit Node(const State& st) : state(st), g(INF), rhs(INF), key1(INF), key2(INF), heapIndex(NOT_OPEN) {}
+
+		State state; //!< user state
+		float g; //!< cost from this state to the goal, as of its last expansion
+		float rhs; //!< cost from this state to the goal through its best successor; the state needs expanding if this differs from #g
+		float key1; //!< the primary priority of the node in the queue: min(#g,#rhs) plus the heuristic from the start (plus DStarLite::km)
+		float key2; //!< the secondary priority, min(#g,#rhs)
+		size_t heapIndex; //!< position of the node in the queue, or #NOT_OPEN
+
+		static const size_t NOT_OPEN=-1U; //!< value of #heapIndex for nodes which aren't in the queue
+
+		//! orders nodes by #key1, then #key2, inverted for AStar::PriorityQueue
+		struct KeyCmp {
+			bool operator()(const Node* left, const Node* right) const {
+				return left->key1 > right->key1 || ( left->key1==right->key1 && left->key2 > right->key2 );
+			}
+		};
+	};
+
+	//! Calls State::hash()
+	struct NodeHash {
+		size_t operator()(const Node* n) const { return n->state.hash(); }
+	};
+	//! Tests equality of states using State::operator==
+	struct NodeEq {
+		bool operator()(const Node* left, const Node* right) const { return left->state == right->state; }
+	};
+	typedef std::tr1::unordered_set<Node*, NodeHash, NodeEq> NodeSet;
+	typedef std::vector<std::pair<float,State> > Neighbors;
+
+	static const float INF; //!< cost of unreachable states
+
+	//! returns the node for @a st, creating it if needed
+	Node* lookup(const State& st) {
+		Node key(st);
+		typename NodeSet::const_iterator it = nodes.find(&key);
+		if(it!=nodes.end())
+			return *it;
+		Node* n = arena.create(key);
+		nodes.insert(n);
+		return n;
+	}
+	//! returns the cost-to-goal of @a st (infinity if it hasn't been reached)
+	float getG(const State& st) const {
+		Node key(st);
+		typename NodeSet::const_iterator it = nodes.find(&key);
+		return (it==nodes.end()) ? INF : (*it)->g;
+	}
+	//! sets the priority of @a n from its current costs
+	void computeKey(Node* n) const {
+		n->key2 = std::min(n->g,n->rhs);
+		n->key1 = n->key2 + ctxt.heuristic(startState,n->state) + km;
+	}
+	//! adds @a n to the queue with its current priority
+	void enqueue(Node* n) {
+		computeKey(n);
+		queue.push(n);
+	}
+	//! recomputes the @c rhs of @a n from its successors, then requeue()s it
+	void updateVertex(Node* n);
+	//! queues @a n if its @c g is out of date, removes it from the queue otherwise
+	void requeue(Node* n);
+
+	const Context& ctxt; //!< the search domain
+	State startState; //!< the start of the path (the search runs backward, so this is where it ends)
+	State goalState; //!< the goal of the path (the root of the search)
+	float km; //!< the accumulated heuristic distance the start has moved, added to priorities so the queue stays ordered without recomputing it
+	NodeSet nodes; //!< all of the nodes reached by the search
+	AStar::NodeArena<Node> arena; //!< storage for #nodes
+	AStar::PriorityQueue<Node, typename Node::KeyCmp> queue; //!< the nodes which need expanding
+	Neighbors succ; //!< scratch copy of an expansion (the domain may reuse its storage)
+	Neighbors pred; //!< scratch copy of predecessors (the domain may reuse its storage)
+	size_t expansions; //!< number of nodes expanded
+
+private:
+	DStarLite(const DStarLite&); //!< don't call (nodes are shared)
+	DStarLite& operator=(const DStarLite&); //!< don't call (nodes are shared)
+};
+
+template<class Context, class State>
+const float DStarLite<Context,State>::INF = std::numeric_limits<float>::infinity();
+
+template<class Context, class State>
+void DStarLite<Context,State>::updateVertex(Node* n) {
+	if(!(n->state == goalState)) {
+		succ = ctxt.expand(NULL,n->state,goalState);
+		n->rhs = INF;
+		for(typename Neighbors::const_iterator it=succ.begin(); it!=succ.end(); ++it)
+			n->rhs = std::min(n->rhs, it->first+getG(it->second));
+	}
+	requeue(n);
+}
+
+template<class Context, class State>
+void DStarLite<Context,State>::requeue(Node* n) {
+	if(n->g!=n->rhs) {
+		if(n->heapIndex==Node::NOT_OPEN) {
+			enqueue(n);
+		} else {
+			computeKey(n);
+			queue.update(n);
+		}
+	} else if(n->heapIndex!=Node::NOT_OPEN) {
+		queue.remove(n);
+	}
+}
+
+template<class Context, class State>
+typename DStarLite<Context,State>::Status_t DStarLite<Context,State>::plan(float budget) {
+	TimeET timer;
+	Node* start = lookup(startState);
+	typename Node::KeyCmp after;
+	for(size_t i=1; ; ++i) {
+		computeKey(start);
+		if(queue.empty() || (!after(start,queue.front()) && start->rhs==start->g)) {
+			// nothing left in the queue can improve the start, but its rhs is only maintained as a
+			// predecessor of other states, which it may not be (e.g. if the map blocks the robot's own cell)
+			updateVertex(start);
+			if(start->rhs==start->g)
+				break;
+			continue;
+		}
+		Node* cur = queue.front();
+		if(budget>0 && i%64==0 && timer.Age().Value()>budget)
+			return TIMEOUT;
+
+		const float oldKey1 = cur->key1, oldKey2 = cur->key2;
+		computeKey(cur);
+		if(cur->key1>oldKey1 || (cur->key1==oldKey1 && cur->key2>oldKey2)) {
+			// queued before the start moved away, put it back in its proper place
+			queue.update(cur);
+			continue;
+		}
+
+		++expansions;
+		queue.pop();
+		pred = ctxt.predecessors(cur->state);
+		if(cur->g > cur->rhs) {
+			// cost-to-goal improved: the predecessors may now do better through cur
+			cur->g = cur->rhs;
+			for(typename Neighbors::const_iterator it=pred.begin(); it!=pred.end(); ++it) {
+				Node* p = lookup(it->second);
+				if(!(p->state == goalState) && it->first+cur->g < p->rhs) {
+					p->rhs = it->first+cur->g;
+					requeue(p);
+				}
+			}
+		} else {
+			// cost-to-goal got worse: the predecessors (and cur) may have to route elsewhere
+			cur->g = INF;
+			updateVertex(cur);
+			for(typename Neighbors::const_iterator it=pred.begin(); it!=pred.end(); ++it)
+				updateVertex(lookup(it->second));
+		}
+	}
+	return (start->g<INF) ? PATH_FOUND : NO_PATH;
+}
+
+template<class Context, class State>
+bool DStarLite<Context,State>::getPath(std::vector<State>& path) const {
+	path.clear();
+	if(!(getCost()<INF))
+		return false;
+	path.push_back(startState);
+	// each step decreases the cost-to-goal, so there can't be more steps than states
+	while(!(path.back() == goalState) && path.size()<=nodes.size()) {
+		const Neighbors& neighbors = ctxt.expand(NULL,path.back(),goalState);
+		float best = INF;
+		const State* next = NULL;
+		for(typename Neighbors::const_iterator it=neighbors.begin(); it!=neighbors.end(); ++it) {
+			const float c = it->first+getG(it->second);
+			if(c<best) {
+				best = c;
+				next = &it->second;
+			}
+		}
+		if(next==NULL) {
+			path.clear();
+			return false;
+		}
+		path.push_back(*next);
+	}
+	if(!(path.back() == goalState)) {
+		path.clear();
+		return false;
+	}
+	return true;
+}
+
+/*! @file
+ * @brief Describes DStarLite, an incremental planner which repairs its search as the map changes and the robot moves
+ */
+
+#endif
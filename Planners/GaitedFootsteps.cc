@@ -5,13 +5,62 @@
 #include "GaitedFootsteps.h"
 #include "Motion/KinematicJoint.h"
 #include "Motion/IKSolver.h"
+#include "IPC/TaskPool.h"
+#include "Shared/MarkScope.h"
 #include <algorithm>
 #include <iterator>
+#include <cmath>
 
 fmat::fmatReal GaitedFootsteps::State::ROUND=1/6.0;
 const fmat::fmatReal GaitedFootsteps::State::ORIROUND=30/M_PI;
 
+//! the default cell size is doubled until the obstacle grid has no more than this many cells
+static const size_t MAX_GRID_CELLS=1<<16;
+
+//! returns true if all the coordinates of @a bb are finite
+static bool isBounded(const BoundingBox2D& bb) {
+	return std::isfinite(bb.min[0]) && std::isfinite(bb.min[1]) && std::isfinite(bb.max[0]) && std::isfinite(bb.max[1]);
+}
+
+GaitedFootsteps::LegKinematics::LegKinematics(const KinematicJoint& kj) : root(dynamic_cast<KinematicJoint*>(kj.clone())) {
+	std::fill(childMap, childMap+NumReferenceFrames, static_cast<KinematicJoint*>(NULL));
+	root->buildChildMap(childMap,0,NumReferenceFrames);
+}
+
+GaitedFootsteps::LegKinematics::~LegKinematics() {
+	delete root;
+}
+
+//! evaluates a range of candidate step directions on one copy of the kinematics
+class GaitedFootsteps::ExpandChunk {
+public:
+	//! constructor
+	ExpandChunk(const GaitedFootsteps& f, const State* p, const State& s, const std::vector<std::pair<float,float> >& d, std::vector< std::vector<Successor> >& r)
+		: footsteps(f), parent(p), st(s), dirs(d), results(r) {}
+	//! evaluates directions [@a begin,@a end)
+	void operator()(size_t begin, size_t end) const {
+		LegKinematics* legs=footsteps.acquireLegs();
+		try {
+			for(size_t i=begin; i<end; ++i)
+				footsteps.addCandidate(parent, st, dirs[i].first, results[i], dirs[i].second, legs->childMap);
+		} catch(...) {
+			footsteps.releaseLegs(legs);
+			throw;
+		}
+		footsteps.releaseLegs(legs);
+	}
+protected:
+	const GaitedFootsteps& footsteps; //!< the planner being expanded
+	const State* parent; //!< the parent of #st, or NULL
+	const State& st; //!< the state being expanded
+	const std::vector<std::pair<float,float> >& dirs; //!< the angle and maximum distance of each candidate
+	std::vector< std::vector<Successor> >& results; //!< where to store the successors of each candidate, already sized to match #dirs
+private:
+	ExpandChunk& operator=(const ExpandChunk&); //!< don't call
+};
+
 GaitedFootsteps::~GaitedFootsteps() {
+	clearLegCopies();
 	delete kinematics;
 	kinematics=NULL;
 	for(std::vector<PlannerObstacle2D*>::const_iterator it=obstacles.begin(); it!=obstacles.end(); ++it)
@@ -19,6 +68,104 @@ GaitedFootsteps::~GaitedFootsteps() {
 	obstacles.clear();
 }
 
+void GaitedFootsteps::addObstacle(PlannerObstacle2D* obs) {
+	obstacles.push_back(obs);
+	expansions.clear();
+	if(indexedObstacles+1!=obstacles.size())
+		return; // grid was already out of date, leave it for indexObstacles()
+	const BoundingBox2D bb = obs->getBoundingBox();
+	if(!isBounded(bb)) {
+		unindexed.push_back(obstacles.size()-1);
+	} else {
+		const fmat::Column<2> gridMax = gridMin + fmat::pack(gridCols*gridCell, gridRows*gridCell);
+		if(!(bb.min[0]>=gridMin[0] && bb.min[1]>=gridMin[1] && bb.max[0]<gridMax[0] && bb.max[1]<gridMax[1]))
+			return; // doesn't fit, the grid will be ignored until indexObstacles() is called
+		gridInsert(obstacles.size()-1,bb);
+	}
+	++indexedObstacles;
+}
+
+void GaitedFootsteps::indexObstacles(float cellSize/*=0*/) {
+	expansions.clear();
+	obstacleGrid.clear();
+	unindexed.clear();
+	gridCols=gridRows=0;
+	
+	std::vector<BoundingBox2D> boxes(obstacles.size());
+	BoundingBox2D bounds;
+	bool bounded=false;
+	for(size_t i=0; i<obstacles.size(); ++i) {
+		boxes[i] = obstacles[i]->getBoundingBox();
+		if(isBounded(boxes[i])) {
+			bounds.expand(boxes[i]);
+			bounded=true;
+		}
+	}
+	if(bounded) {
+		const fmat::Column<2> dim = bounds.getDimensions();
+		if(cellSize<=0) {
+			cellSize = 1/State::ROUND;
+			while((dim[0]/cellSize+1)*(dim[1]/cellSize+1) > MAX_GRID_CELLS)
+				cellSize*=2;
+		}
+		gridCell = cellSize;
+		gridMin = bounds.min;
+		gridCols = static_cast<size_t>(dim[0]/cellSize)+1;
+		gridRows = static_cast<size_t>(dim[1]/cellSize)+1;
+		obstacleGrid.resize(gridCols*gridRows);
+	}
+	for(size_t i=0; i<obstacles.size(); ++i) {
+		if(isBounded(boxes[i]))
+			gridInsert(i,boxes[i]);
+		else
+			unindexed.push_back(i);
+	}
+	indexedObstacles = obstacles.size();
+}
+
+void GaitedFootsteps::gridInsert(size_t i, const BoundingBox2D& bb) {
+	const size_t c0 = static_cast<size_t>((bb.min[0]-gridMin[0])/gridCell);
+	const size_t r0 = static_cast<size_t>((bb.min[1]-gridMin[1])/gridCell);
+	const size_t c1 = std::min(static_cast<size_t>((bb.max[0]-gridMin[0])/gridCell), gridCols-1);
+	const size_t r1 = std::min(static_cast<size_t>((bb.max[1]-gridMin[1])/gridCell), gridRows-1);
+	for(size_t r=r0; r<=r1; ++r)
+		for(size_t c=c0; c<=c1; ++c)
+			obstacleGrid[r*gridCols+c].push_back(i);
+}
+
+size_t GaitedFootsteps::gridIndex(const fmat::Column<2>& pt) const {
+	const fmat::fmatReal x = (pt[0]-gridMin[0])/gridCell;
+	const fmat::fmatReal y = (pt[1]-gridMin[1])/gridCell;
+	if(!(x>=0 && y>=0 && x<gridCols && y<gridRows)) // also rejects NaN
+		return -1U;
+	return static_cast<size_t>(y)*gridCols + static_cast<size_t>(x);
+}
+
+GaitedFootsteps::LegKinematics* GaitedFootsteps::acquireLegs() const {
+	MarkScope l(legCopiesLock);
+	if(!freeLegCopies.empty()) {
+		LegKinematics* c=freeLegCopies.back();
+		freeLegCopies.pop_back();
+		return c;
+	}
+	// the kinematics are only read during expansion, so it's safe to copy while other threads use their own copies
+	LegKinematics* c=new LegKinematics(*kinematics);
+	legCopies.push_back(c);
+	return c;
+}
+
+void GaitedFootsteps::releaseLegs(LegKinematics* l) const {
+	MarkScope lock(legCopiesLock);
+	freeLegCopies.push_back(l);
+}
+
+void GaitedFootsteps::clearLegCopies() {
+	for(std::vector<LegKinematics*>::const_iterator it=legCopies.begin(); it!=legCopies.end(); ++it)
+		delete *it;
+	legCopies.clear();
+	freeLegCopies.clear();
+}
+
 float GaitedFootsteps::heuristic(const State& st, const State& goal) const {
 	if(speed>0)
 		return (st.pos - goal.pos).norm() / speed * relaxation;
@@ -49,8 +196,52 @@ bool GaitedFootsteps::validate(const State& st) const {
 const std::vector<std::pair<float,GaitedFootsteps::State> >& GaitedFootsteps::expand(const State* parent, const State& st, const State& goal) const {
 	//std::cout << "Expanding " << st << std::endl;
 	static std::vector<std::pair<float,GaitedFootsteps::State> > ans;
+	static std::vector<Successor> succ;
 	ans.clear();
 	
+	const std::vector<Successor>* candidates = &succ;
+	if(cacheExpansions) {
+		if(cacheGoal != goal.pos) {
+			expansions.clear();
+			cacheGoal = goal.pos;
+		}
+		ExpansionCache::iterator it = expansions.find(st);
+		if(it==expansions.end()) {
+			// store all successors, the parent filter is applied below
+			it = expansions.insert(std::make_pair(st,std::vector<Successor>())).first;
+			addSuccessors(NULL, st, goal, it->second);
+		}
+		candidates = &it->second;
+	} else {
+		succ.clear();
+		addSuccessors(parent, st, goal, succ);
+	}
+	
+	ans.reserve(candidates->size());
+	for(std::vector<Successor>::const_iterator it=candidates->begin(); it!=candidates->end(); ++it) {
+		if(parent!=NULL && fmat::dotProduct(it->dir,st.pos-parent->pos)<-0.5)
+			continue; // don't consider actions which reverse previous motion
+		ans.push_back(std::make_pair(it->cost,it->state));
+	}
+	
+	/*if(groups.size()>2) {
+		// if more than two groups, consider a no-op to go out of phase
+		// this relies on checking leg kinematics however, to ensure a
+		// leg doesn't get ignored and dragged along
+		ans.push_back(std::make_pair(0,st));
+		State& nxt = ans.back().second;
+		if(++nxt.phase >= groups.size())
+			nxt.phase=0;
+	}*/
+	
+	/*for(size_t i=0; i<ans.size(); ++i) {
+		std::cout << ans[i].first << ' ' << ans[i].second << std::endl;
+	}*/
+
+	return ans;
+}
+
+void GaitedFootsteps::addSuccessors(const State* parent, const State& st, const State& goal, std::vector<Successor>& candidates) const {
 	// check stability of support feet...
 	std::vector<fmat::Column<2> > support;
 	support.reserve(NumLegs - groups[st.phase].size());
@@ -65,7 +256,7 @@ const std::vector<std::pair<float,GaitedFootsteps::State> >& GaitedFootsteps::ex
 			IKSolver& solver = childMap[FootFrameOffset + i]->getIK();
 			bool success = solver.solve(fmat::Column<3>(),*childMap[FootFrameOffset + i],IKSolver::Point(lpos3));
 			if(!success) // foot has stretched out of reach
-				return ans;
+				return;
 		}
 	}
 	ConvexPolyObstacle supportPoly;
@@ -73,37 +264,54 @@ const std::vector<std::pair<float,GaitedFootsteps::State> >& GaitedFootsteps::ex
 	fmat::Column<3> com; float totalMass;
 	kinematics->sumCenterOfMass(com,totalMass); // not accounting for motion of flight legs on center of mass (com)!
 	if(!supportPoly.collides(fmat::SubVector<2,const fmat::fmatReal>(gravOri * com)))
-		return ans;
+		return;
 
+	// angle and maximum distance of each candidate step
 	const fmat::Column<2> gd = goal.pos - st.pos;
 	const float goalDir = stepReorient ? std::atan2(gd[1],gd[0])-st.oriAngle : 0;
-	addCandidate(parent, st, goalDir, ans, gd.norm());
-	addCandidate(parent, st, goalDir+(float)M_PI, ans);
+	std::vector<std::pair<float,float> > dirs;
+	dirs.reserve(ncand);
+	dirs.push_back(std::make_pair(goalDir, gd.norm()));
+	dirs.push_back(std::make_pair(goalDir+(float)M_PI, 0.f));
 	for(size_t i=1; i<ncand/2; ++i) {
 		float per = i/float(ncand/2);
 		//per*=per; // weights steps "forward" (but commented-out because too tight)
-		addCandidate(parent, st, goalDir + static_cast<float>(M_PI)*per, ans);
-		addCandidate(parent, st, goalDir - static_cast<float>(M_PI)*per, ans);
+		dirs.push_back(std::make_pair(goalDir + static_cast<float>(M_PI)*per, 0.f));
+		dirs.push_back(std::make_pair(goalDir - static_cast<float>(M_PI)*per, 0.f));
 	}
 	
-	/*if(groups.size()>2) {
-		// if more than two groups, consider a no-op to go out of phase
-		// this relies on checking leg kinematics however, to ensure a
-		// leg doesn't get ignored and dragged along
-		ans.push_back(std::make_pair(0,st));
-		State& nxt = ans.back().second;
-		if(++nxt.phase >= groups.size())
-			nxt.phase=0;
-	}*/
-	
-	/*for(size_t i=0; i<ans.size(); ++i) {
-		std::cout << ans[i].first << ' ' << ans[i].second << std::endl;
-	}*/
-
-	return ans;
+	if(pool==NULL || pool->getNumWorkers()==0) {
+		for(size_t i=0; i<dirs.size(); ++i)
+			addCandidate(parent, st, dirs[i].first, candidates, dirs[i].second, childMap);
+	} else {
+		// each direction gets its own list, so the results can be concatenated in serial order
+		std::vector< std::vector<Successor> > results(dirs.size());
+		pool->parallel_for_range(0,dirs.size(),ExpandChunk(*this,parent,st,dirs,results),1);
+		for(size_t i=0; i<results.size(); ++i)
+			candidates.insert(candidates.end(), results[i].begin(), results[i].end());
+	}
 }
 
 PlannerObstacle2D* GaitedFootsteps::checkObstacles(const fmat::Column<2>& pt) const {
+	if(indexedObstacles==obstacles.size()) {
+		// both lists are in increasing order, so the first hit in the cell bounds the unindexed obstacles to test
+		size_t hit=obstacles.size();
+		const size_t cell = gridIndex(pt);
+		if(cell!=-1U) {
+			const std::vector<size_t>& cellObs = obstacleGrid[cell];
+			for(std::vector<size_t>::const_iterator it=cellObs.begin(); it!=cellObs.end(); ++it) {
+				if(obstacles[*it]->collides(pt)) {
+					hit=*it;
+					break;
+				}
+			}
+		}
+		for(std::vector<size_t>::const_iterator it=unindexed.begin(); it!=unindexed.end() && *it<hit; ++it) {
+			if(obstacles[*it]->collides(pt))
+				return obstacles[*it];
+		}
+		return (hit<obstacles.size()) ? obstacles[hit] : NULL;
+	}
 	for(std::vector< PlannerObstacle2D* >::const_iterator oit=obstacles.begin(); oit!=obstacles.end(); ++oit) {
 		//cout << ' ' << (*oit)->collides(lpos2);
 		if((*oit)->collides(pt)) {
@@ -114,7 +322,7 @@ PlannerObstacle2D* GaitedFootsteps::checkObstacles(const fmat::Column<2>& pt) co
 	return NULL;
 }
 
-bool GaitedFootsteps::addRotation(const State& st, float strideAngle, float strideDist, const fmat::Column<2>& strideDir, const fmat::Column<2>& stride, std::vector<std::pair<float,GaitedFootsteps::State> >& candidates, float maxDist) const {
+bool GaitedFootsteps::addRotation(const State& st, float strideAngle, float strideDist, const fmat::Column<2>& strideDir, const fmat::Column<2>& stride, std::vector<Successor>& candidates, float maxDist, KinematicJoint* const legMap[]) const {
 	float rotAngle = 2 * std::atan2(strideDist/2,rotDist); // heuristic to limit rotation speed
 	if(strideDir[0]>0) {
 		//forward motion
@@ -150,8 +358,8 @@ bool GaitedFootsteps::addRotation(const State& st, float strideAngle, float stri
 			// now check IK is still valid (or update lpos2 with reached position?)
 			//bool success=true;
 			p.projectToGround(ground, p.groundPlane[3], gravity, lpos3);
-			IKSolver& solver = childMap[FootFrameOffset + *lit]->getIK();
-			bool success = solver.solve(fmat::Column<3>(),*childMap[FootFrameOffset + *lit],IKSolver::Point(lpos3));
+			IKSolver& solver = legMap[FootFrameOffset + *lit]->getIK();
+			bool success = solver.solve(fmat::Column<3>(),*legMap[FootFrameOffset + *lit],IKSolver::Point(lpos3));
 			/*for(unsigned int j=0; j<JointsPerLeg; ++j) {
 				KinematicJoint * ckj = childMap[LegOffset + JointsPerLeg*leg + j];
 				if(ckj!=NULL)
@@ -175,8 +383,8 @@ bool GaitedFootsteps::addRotation(const State& st, float strideAngle, float stri
 	if(maxDist>0)
 		t = std::min(maxDist,t);
 	
-	candidates.push_back(std::make_pair(speed>0?t/speed:flightDuration,st));
-	State& nxt = candidates.back().second;
+	candidates.push_back(Successor(strideDir,speed>0?t/speed:flightDuration,st));
+	State& nxt = candidates.back().state;
 	if(++nxt.phase >= groups.size())
 		nxt.phase=0;
 	for(size_t i=0; i<footPos.size(); ++i)
@@ -188,7 +396,7 @@ bool GaitedFootsteps::addRotation(const State& st, float strideAngle, float stri
 	return true;
 }
 
-void GaitedFootsteps::addCandidate(const State* parent, const State& st, float angle, std::vector<std::pair<float,GaitedFootsteps::State> >& candidates, float maxDist/*=0*/) const {
+void GaitedFootsteps::addCandidate(const State* parent, const State& st, float angle, std::vector<Successor>& candidates, float maxDist, KinematicJoint* const legMap[]) const {
 	const fmat::Column<2> dir = fmat::pack(std::cos(angle),std::sin(angle));
 	if(parent!=NULL && fmat::dotProduct(dir,st.pos-parent->pos)<-0.5)
 		return; // don't consider actions which reverse previous motion
@@ -196,7 +404,7 @@ void GaitedFootsteps::addCandidate(const State* parent, const State& st, float a
 	const float strideDist = p.strideLenX*p.strideLenY / d.norm(); // distance of this step
 	
 	const fmat::Column<2> stride = dir*strideDist;
-	addRotation(st,angle,strideDist,dir,stride,candidates,maxDist);
+	addRotation(st,angle,strideDist,dir,stride,candidates,maxDist,legMap);
 	//if(addRotation(st,angle,strideDist,dir,stride,candidates,maxDist))
 	//	return;
 	
@@ -219,8 +427,8 @@ void GaitedFootsteps::addCandidate(const State* parent, const State& st, float a
 			// now check IK is still valid (or update lpos2 with reached position?)
 			//bool success=true;
 			p.projectToGround(ground, p.groundPlane[3], gravity, lpos3);
-			IKSolver& solver = childMap[FootFrameOffset + *lit]->getIK();
-			bool success = solver.solve(fmat::Column<3>(),*childMap[FootFrameOffset + *lit],IKSolver::Point(lpos3));
+			IKSolver& solver = legMap[FootFrameOffset + *lit]->getIK();
+			bool success = solver.solve(fmat::Column<3>(),*legMap[FootFrameOffset + *lit],IKSolver::Point(lpos3));
 			/*for(unsigned int j=0; j<JointsPerLeg; ++j) {
 				KinematicJoint * ckj = childMap[LegOffset + JointsPerLeg*leg + j];
 				if(ckj!=NULL)
@@ -244,8 +452,8 @@ void GaitedFootsteps::addCandidate(const State* parent, const State& st, float a
 	if(maxDist>0)
 		t = std::min(maxDist,t);
 	
-	candidates.push_back(std::make_pair(speed>0?t/speed:flightDuration,st));
-	State& nxt = candidates.back().second;
+	candidates.push_back(Successor(dir,speed>0?t/speed:flightDuration,st));
+	State& nxt = candidates.back().state;
 	if(++nxt.phase >= groups.size())
 		nxt.phase=0;
 	for(size_t i=0; i<footPos.size(); ++i)
@@ -253,7 +461,7 @@ void GaitedFootsteps::addCandidate(const State* parent, const State& st, float a
 	
 	nxt.pos += st.oriRot*dir*t;
 	
-	//std::cout << "\tCandidate " << candidates.back().first << ' ' << nxt.pos << std::endl;
+	//std::cout << "\tCandidate " << candidates.back().cost << ' ' << nxt.pos << std::endl;
 	
 	/*for(size_t leg=0; leg<NumLegs; ++leg) {
 		StepData sd;
@@ -277,6 +485,8 @@ void GaitedFootsteps::addCandidate(const State* parent, const State& st, float a
 
 void GaitedFootsteps::setGait(const KinematicJoint& kj, const XWalkParameters& xp, size_t discretization) {
 	std::fill(childMap, childMap+NumReferenceFrames, static_cast<KinematicJoint*>(NULL));
+	clearLegCopies();
+	expansions.clear();
 	delete kinematics;
 	kinematics = dynamic_cast<KinematicJoint*>(kj.clone());
 	kinematics->buildChildMap(childMap,0,NumReferenceFrames);
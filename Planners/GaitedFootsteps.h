@@ -21,15 +21,20 @@
 #include "Shared/RobotInfo.h"
 #include "Motion/XWalkParameters.h"
 #include "Planners/PlannerObstacles.h"
+#include "IPC/Thread.h"
 #include <tr1/functional>
+#include <tr1/unordered_map>
 
 class KinematicJoint;
+class TaskPool;
 
 class GaitedFootsteps {
 public:
 	GaitedFootsteps()
 		: speed(0), flightDuration(0), stepDuration(), relaxation(1), rotDist(0), stepReorient(true), stepRehab(true),
-		kinematics(NULL), ncand(), p(), ground(), gravity(), neutrals(), groups(), obstacles()
+		cacheExpansions(false), pool(NULL), kinematics(NULL), ncand(), p(), ground(), gravity(), neutrals(), groups(), obstacles(),
+		obstacleGrid(), unindexed(), gridMin(), gridCols(0), gridRows(0), gridCell(0), indexedObstacles(0),
+		expansions(), cacheGoal(), legCopies(), freeLegCopies(), legCopiesLock()
 	{}
 	
 	struct State {
@@ -77,6 +82,19 @@ public:
 			return os << &st << ": " << st.pos << " @ "  << st.oriAngle << '\n'
 			<< fmat::SubMatrix<2,NumLegs,const float>(&st.footPos[0][0]) << std::endl;
 		}
+		//! calls State::hash(), for use as a key in unordered containers
+		struct Hash : public std::unary_function<State,size_t> {
+			size_t operator()(const State& st) const { return st.hash(); }
+		};
+	};
+	
+	//! A successor of an expanded state, along with the direction of the step which reached it (used to filter steps which reverse the parent's motion)
+	struct Successor {
+		//! constructor
+		Successor(const fmat::Column<2>& d, float c, const State& st) : dir(d), cost(c), state(st) {}
+		fmat::Column<2> dir; //!< unit direction of the step, in the body frame of the expanded state
+		float cost; //!< the cost of the step
+		State state; //!< the resulting state
 	};
 	
 	~GaitedFootsteps();
@@ -93,10 +111,23 @@ public:
 	
 	void setGait(const KinematicJoint& kj, const XWalkParameters& xp, size_t discretization);
 	
-	void addObstacle(PlannerObstacle2D* obs) { obstacles.push_back(obs); }
+	//! adds an obstacle (which will be deleted by the destructor), also adding it to the obstacle grid if it lies within the grid, and clearing the expansion cache
+	void addObstacle(PlannerObstacle2D* obs);
+	//! if you modify obstacles through this, call indexObstacles() when done, otherwise checkObstacles() falls back to testing each obstacle in turn
 	std::vector< PlannerObstacle2D* >& getObstacles() { return obstacles; }
 	const std::vector< PlannerObstacle2D* >& getObstacles() const { return obstacles; }
 	
+	//! sorts the obstacles into a grid of square cells, so checkObstacles() only tests the obstacles whose bounding box overlaps the point's cell; also clears the expansion cache
+	/*! If @a cellSize is 0, the cell size is based on the footstep rounding (State::ROUND), enlarged if
+	 *  necessary to keep the grid to a reasonable number of cells.  Obstacles with unbounded extent
+	 *  are kept in a separate list and always tested. */
+	void indexObstacles(float cellSize=0);
+	
+	//! discards the successors stored for #cacheExpansions, needed if the obstacles or gait are changed other than through addObstacle(), indexObstacles(), or setGait()
+	void clearExpansionCache() const { expansions.clear(); }
+	//! returns the number of states whose successors have been stored for #cacheExpansions
+	size_t getExpansionCacheSize() const { return expansions.size(); }
+	
 	float speed;
 	float flightDuration;
 	float stepDuration;
@@ -106,6 +137,17 @@ public:
 	bool stepReorient;
 	bool stepRehab;
 	
+	//! if true, expand() stores the successors of each state (keyed by State::hash() and State::operator==), so expanding an equivalent state again (e.g. in later iterations of AStar::anytime()) skips the IK and obstacle tests
+	/*! The successors are stored before the parent-reversal filter is applied, so they can be shared between
+	 *  different parents.  States which compare equal (after rounding) share the successors of the first one
+	 *  expanded, so a path may differ slightly from an uncached search.  The cache is cleared when the goal changes. */
+	bool cacheExpansions;
+	
+	//! if non-NULL, expand() evaluates the candidate step directions in parallel on this pool, each thread using its own copy of #kinematics
+	/*! The successors are returned in the same order as a serial expansion.  This pays off with a large
+	 *  discretization, or with #stepRehab in cluttered environments, where each candidate needs IK. */
+	TaskPool* pool;
+	
 	KinematicJoint * kinematics;
 	KinematicJoint* childMap[NumReferenceFrames];
 	struct StepData {
@@ -125,9 +167,57 @@ public:
 	std::vector< std::set<size_t> > groups;
 	std::vector< PlannerObstacle2D* > obstacles;
 	
+	//! returns the first obstacle (in order of #obstacles) which contains @a pt, or NULL
 	PlannerObstacle2D* checkObstacles(const fmat::Column<2>& pt) const;
-	bool addRotation(const State& st, float strideAngle, float strideDist, const fmat::Column<2>& strideDir, const fmat::Column<2>& stride, std::vector<std::pair<float,GaitedFootsteps::State> >& candidates, float maxDist) const;
-	void addCandidate(const State* parent, const State& st, float angle, std::vector<std::pair<float,GaitedFootsteps::State> >& candidates, float maxDist=0) const;
+	//! adds the successors of @a st which do not reverse @a parent's motion (@a parent may be NULL), evaluating the step directions in parallel if #pool is set
+	void addSuccessors(const State* parent, const State& st, const State& goal, std::vector<Successor>& candidates) const;
+	bool addRotation(const State& st, float strideAngle, float strideDist, const fmat::Column<2>& strideDir, const fmat::Column<2>& stride, std::vector<Successor>& candidates, float maxDist, KinematicJoint* const legMap[]) const;
+	void addCandidate(const State* parent, const State& st, float angle, std::vector<Successor>& candidates, float maxDist, KinematicJoint* const legMap[]) const;
+	
+protected:
+	class ExpandChunk;
+	
+	//! a private copy of #kinematics, used by one thread at a time when expanding in parallel
+	struct LegKinematics {
+		//! constructor, copies @a kj
+		explicit LegKinematics(const KinematicJoint& kj);
+		//! destructor
+		~LegKinematics();
+		KinematicJoint* root; //!< the copy
+		KinematicJoint* childMap[NumReferenceFrames]; //!< maps reference frames to joints of #root
+	private:
+		LegKinematics(const LegKinematics&); //!< don't call
+		LegKinematics& operator=(const LegKinematics&); //!< don't call
+	};
+	
+	//! returns an unused copy of the kinematics, creating one if necessary
+	LegKinematics* acquireLegs() const;
+	//! returns @a l to #freeLegCopies
+	void releaseLegs(LegKinematics* l) const;
+	//! deletes all the copies of the kinematics (not thread safe, call only while not expanding)
+	void clearLegCopies();
+	
+	//! adds obstacle index @a i to each cell of #obstacleGrid overlapped by @a bb, which must lie within the grid
+	void gridInsert(size_t i, const BoundingBox2D& bb);
+	//! returns the index of the grid cell containing @a pt, or -1U if @a pt is outside the grid
+	size_t gridIndex(const fmat::Column<2>& pt) const;
+	
+	typedef std::tr1::unordered_map<State, std::vector<Successor>, State::Hash> ExpansionCache; //!< type of #expansions
+	
+	std::vector< std::vector<size_t> > obstacleGrid; //!< for each cell (row-major from #gridMin), the indices of the obstacles whose bounding box overlaps the cell, in increasing order
+	std::vector<size_t> unindexed; //!< indices of obstacles without a finite bounding box, which are tested for every point
+	fmat::Column<2> gridMin; //!< the minimum corner of the grid
+	size_t gridCols; //!< the number of cells along x
+	size_t gridRows; //!< the number of cells along y
+	float gridCell; //!< the size of each cell
+	size_t indexedObstacles; //!< the number of obstacles in the grid, if this doesn't match the size of #obstacles, the grid is ignored
+	
+	mutable ExpansionCache expansions; //!< the stored successors when #cacheExpansions is set
+	mutable fmat::Column<2> cacheGoal; //!< the goal position #expansions were generated for
+	
+	mutable std::vector<LegKinematics*> legCopies; //!< all the copies of the kinematics which have been created
+	mutable std::vector<LegKinematics*> freeLegCopies; //!< the copies not currently in use by a thread
+	mutable Thread::Lock legCopiesLock; //!< protects #legCopies and #freeLegCopies
 	
 private:
 	GaitedFootsteps(const GaitedFootsteps&); //!< do not use
@@ -57,6 +57,40 @@ const std::vector<std::pair<float,GridWorld::State> >& GridWorld::expand(const S
 	return neighbors;
 }
 
+const std::vector<std::pair<float,GridWorld::State> >& GridWorld::predecessors(const State& st) const {
+	using std::make_pair;
+	static std::vector<std::pair<float,GridWorld::State> > neighbors;
+	neighbors.resize(0);
+	if(!isspace(world[st.r][st.c]))
+		return neighbors; // nothing moves into a blocked cell
+	for(int dr=-1; dr<=1; ++dr) {
+		if((dr<0 && st.r==0) || (dr>0 && st.r+1>=world.size()))
+			continue;
+		const size_t r=st.r+dr;
+		for(int dc=-1; dc<=1; ++dc) {
+			if((dc<0 && st.c==0) || (dc>0 && st.c+1>=world[r].size()) || (dr==0 && dc==0))
+				continue;
+			const size_t c=st.c+dc;
+			if(!isspace(world[r][c]))
+				continue;
+			if(dr==0)
+				neighbors.push_back(make_pair(HCOST,State(r,c)));
+			else if(dc==0)
+				neighbors.push_back(make_pair(VCOST,State(r,c)));
+			else if(DCOST>0 && isspace(world[st.r][c])) // expand() moves diagonally from (r,c) only if (st.r,c) is clear
+				neighbors.push_back(make_pair(DCOST,State(r,c)));
+		}
+	}
+	return neighbors;
+}
+
+void GridWorld::affected(const State& st, std::vector<State>& states) const {
+	// expand() looks at most one row and one column away
+	for(size_t r=(st.r>0 ? st.r-1 : 0); r<=st.r+1 && r<world.size(); ++r)
+		for(size_t c=(st.c>0 ? st.c-1 : 0); c<=st.c+1 && c<world[r].size(); ++c)
+			states.push_back(State(r,c));
+}
+
 std::istream& operator>>(std::istream& is, GridWorld& gw) {
 	gw.world.clear();
 	std::string str;
@@ -61,6 +61,16 @@ public:
 	/*! Note that this implementation returns a reference to a static instance, which is not thread safe but slightly faster */
 	const std::vector<std::pair<float,GridWorld::State> >& expand(const State* parent, const State& st, const State& goal) const;
 	
+	//! Generates a vector of the states which can move to @a st, paired with the cost of that move (the inverse of expand(), for backward searches such as DStarLite)
+	/*! Like expand(), returns a reference to a static instance */
+	const std::vector<std::pair<float,GridWorld::State> >& predecessors(const State& st) const;
+	
+	//! appends to @a states the states whose expansions depend on cell @a st, i.e. those to tell DStarLite::updateState() about after blocking or clearing @a st
+	void affected(const State& st, std::vector<State>& states) const;
+	
+	size_t getRows() const { return world.size(); } //!< returns the number of rows
+	size_t getCols() const { return world.empty() ? 0 : world[0].size(); } //!< returns the number of columns (of the first row)
+	
 	char& operator()(size_t r, size_t c) { return world[r][c]; } //!< map cell accessor
 	char operator()(size_t r, size_t c) const { return world[r][c]; } //!< map cell accessor
 	
@@ -107,23 +107,30 @@ public:
 	  std::cout << "Error: ShapSpacePlanner2DR CollisionChecker constructor ran out of joints!" << std::endl;
     }
     
-    CollisionChecker(const CollisionChecker& other) : rootJ(other.rootJ) {}
+    //! Copy constructor, copies the joints too, so the copy can be used on another thread
+    CollisionChecker(const CollisionChecker& other) :
+      ShapeSpaceCollisionCheckerBase<2>(other), rootJ(cloneChain(other.rootJ)), worldT(other.worldT) {}
     
-    CollisionChecker operator=(const CollisionChecker& other) {
-      rootJ = other.rootJ;
-      return *this;
-    }
+    //! Destructor, deletes the joints
+    virtual ~CollisionChecker() { if ( rootJ ) delete rootJ->getRoot(); }
     
     virtual bool collides(const NodeValue_t &qnew, PlannerResult* result=NULL) const;
     
     template<class T, class U>
     static bool checkComponent(std::vector<T>& full, const U& newObs, T& collisionObs);
     
+  private:
+    CollisionChecker& operator=(const CollisionChecker&); //!< don't call
   };
   
   static const unsigned int maxInterpolations = 100; //!< Maximum number of interpolation steps in interpolate() when @a truncate is true
   
   virtual float distance(const NodeValue_t &target);
+  //!@name Coordinates for RRTNearestIndex: the joint angles, which wrap around like distance() and interpolate()
+  static const size_t KeyDims = N;
+  static void getKey(const NodeValue_t &q, float key[]) { for (size_t i = 0; i < N; i++) key[i] = q[i]; }
+  static bool isKeyAngular(size_t) { return true; }
+  //@}
   static void generateSample(const NodeValue_t &lower, const NodeValue_t &upper, NodeValue_t &sample);
   static Interp_t interpolate(const NodeValue_t &start, const NodeValue_t &target, const NodeValue_t &interp, 
                               bool truncate, CollisionChecker *cc, NodeValue_t &reached, bool fromOtherTree);
@@ -135,7 +142,8 @@ template<size_t N>
 float RRTNode2DR<N>::distance(const NodeValue_t &target) {
   float result = 0;
   for (size_t i = 0; i < N; i++) {
-    result += target[i]*target[i];
+    const float d = target[i]-q[i];
+    result += d*d;
   }
   return result;
 }
@@ -236,7 +244,9 @@ bool RRTNode2DR<N>::CollisionChecker::collides(const NodeValue_t &qnew, RRTNode2
 		
 		// test if new joint obstacle collides with any planner obstacle
 		std::vector<PlannerObstacle2D*> collidingPObs;
-		for (unsigned int k = 0; k < obstacles.size(); k++) {
+		const std::vector<unsigned int>& candidates = findCandidates(obs[i].obstacle.getBoundingBox());
+		for (unsigned int c = 0; c < candidates.size(); c++) {
+			const unsigned int k = candidates[c];
 			if ((i != 0 || !(obstacles[k]->isBodyObstacle())) && obs[i].collides(*(obstacles[k]))) {
 				collidingPObs.push_back(obstacles[k]);
 			}
@@ -438,6 +448,11 @@ public:
   //! Returns BoundingBox of each link, for plotTree()
   void getBoxes(std::vector<std::vector<std::pair<float,float> > >& boxes, const KinematicJoint& joint);
   
+protected:
+  //! copies the collision checker (and its joints) for parallel searches, see setParallelPlanners()
+  virtual typename NodeType_t::CollisionChecker* cloneCollisionChecker() const {
+    return new typename NodeType_t::CollisionChecker(*this->cc);
+  }
 };
 
 template<size_t N>
@@ -0,0 +1,208 @@
+#include "ConfigurationSpaceMap.h"
+#include "DualCoding/DualCoding.h"
+#include "IPC/TaskPool.h"
+#include "Planners/GridWorld.h"
+#include <algorithm>
+#include <cmath>
+#include <map>
+
+using namespace DualCoding;
+
+//! returns true if @a bb has a finite extent
+static bool isBounded(const BoundingBox2D& bb) {
+  return std::isfinite(bb.min[0]) && std::isfinite(bb.min[1]) && std::isfinite(bb.max[0]) && std::isfinite(bb.max[1])
+    && bb.min[0] <= bb.max[0] && bb.min[1] <= bb.max[1];
+}
+
+//! returns a copy of @a footprint centered on the origin, rotated by @a rot; rotate() recomputes its bounding box from the components
+static HierarchicalObstacle normalizedFootprint(const HierarchicalObstacle& footprint, const fmat::Matrix<2,2>& rot) {
+  HierarchicalObstacle fp(footprint);
+  fp.updatePosition(fmat::ZERO2);
+  fp.updateRotation(fmat::Matrix<2,2>::identity());
+  fp.rotate(fmat::ZERO2, rot);
+  return fp;
+}
+
+//! returns the distance from the center of @a footprint to the farthest corner of its unrotated bounding box
+static float footprintRadius(const HierarchicalObstacle& footprint) {
+  const BoundingBox2D bb = normalizedFootprint(footprint, fmat::Matrix<2,2>::identity()).getBoundingBox();
+  if ( bb.empty() )
+    return 0;
+  const float dx = std::max(std::abs(bb.min[0]), std::abs(bb.max[0]));
+  const float dy = std::max(std::abs(bb.min[1]), std::abs(bb.max[1]));
+  return std::sqrt(dx*dx + dy*dy);
+}
+
+ConfigurationSpaceMap::ConfigurationSpaceMap(const BoundingBox2D& area, float _cellSize, unsigned int _numHeadings) :
+  gridMin(area.min), cellSize(_cellSize),
+  cols(std::max(static_cast<size_t>(std::ceil(area.getDimension(0)/_cellSize)), size_t(1))),
+  rows(std::max(static_cast<size_t>(std::ceil(area.getDimension(1)/_cellSize)), size_t(1))),
+  numHeadings(std::max(_numHeadings, 1u)), occupancy(cols*rows*numHeadings, 1),
+  obstacles(), signatures(), inflation(0), footprintSignature() {}
+
+void ConfigurationSpaceMap::clear() {
+  std::fill(occupancy.begin(), occupancy.end(), 1);
+  clearObstacles();
+  footprintSignature.clear();
+}
+
+void ConfigurationSpaceMap::clearObstacles() {
+  for (size_t i = 0; i < obstacles.size(); i++)
+    delete obstacles[i];
+  obstacles.clear();
+  signatures.clear();
+}
+
+float ConfigurationSpaceMap::getMargin(const HierarchicalObstacle& footprint) const {
+  // points move at most radius*angle turning by angle, and the bins are 2π/numHeadings wide
+  const float sweep = (numHeadings > 1) ? footprintRadius(footprint)*float(M_PI)/numHeadings : 0;
+  return cellSize*float(M_SQRT1_2) + sweep;
+}
+
+size_t ConfigurationSpaceMap::update(ShapeSpace& shs, float _inflation, const HierarchicalObstacle& footprint, TaskPool& pool) {
+  const float margin = getMargin(footprint);
+  std::vector<PlannerObstacle2D*> obs;
+  SHAPEROOTVEC_ITERATE(shs, s) {
+    if ( s->getId() != VRmixin::theAgent->getId() && s->isObstacle() )
+      PlannerObstacle2D::convertShapeToPlannerObstacle(s, _inflation+margin, obs);
+  } END_ITERATE;
+  return updateObstacles(obs, _inflation, footprint, pool);
+}
+
+struct ConfigurationSpaceMap::ComputeRows {
+  //! constructor
+  ComputeRows(ConfigurationSpaceMap& m, const std::vector<unsigned char>& d, const std::vector<BoundingBox2D>& b,
+              const HierarchicalObstacle& fp, float r)
+    : map(m), dirty(d), obstacleBoxes(b), footprint(fp), radius(r), rotations(), footprintBoxes()
+  {
+    for (unsigned int h = 0; h < map.numHeadings; h++) {
+      // a single bin means the footprint doesn't turn
+      rotations.push_back((map.numHeadings > 1) ? fmat::rotation2D(map.binHeading(h)) : fmat::Matrix<2,2>::identity());
+      footprintBoxes.push_back(normalizedFootprint(footprint, rotations.back()).getBoundingBox());
+    }
+  }
+
+  void operator()(size_t begin, size_t end) const {
+    HierarchicalObstacle fp(footprint); // each chunk poses its own copy
+    std::vector<size_t> candidates;
+    for (size_t r = begin; r < end; r++) {
+      // obstacles which can reach this row
+      const float y = map.cellCenter(r,0)[1];
+      candidates.clear();
+      for (size_t i = 0; i < obstacleBoxes.size(); i++)
+        if ( !isBounded(obstacleBoxes[i]) || (obstacleBoxes[i].min[1] <= y+radius && obstacleBoxes[i].max[1] >= y-radius) )
+          candidates.push_back(i);
+      for (size_t c = 0; c < map.cols; c++) {
+        if ( !dirty[r*map.cols+c] )
+          continue;
+        const fmat::Column<2> center = map.cellCenter(r,c);
+        fp.updatePosition(center);
+        for (unsigned int h = 0; h < map.numHeadings; h++) {
+          const BoundingBox2D box(footprintBoxes[h].min+center, footprintBoxes[h].max+center);
+          fp.updateRotation(rotations[h]);
+          bool hit = false;
+          for (size_t k = 0; k < candidates.size() && !hit; k++) {
+            const BoundingBox2D& ob = obstacleBoxes[candidates[k]];
+            if ( isBounded(ob) && (ob.min[0] > box.max[0] || box.min[0] > ob.max[0] || ob.min[1] > box.max[1] || box.min[1] > ob.max[1]) )
+              continue;
+            hit = map.obstacles[candidates[k]]->collides(fp);
+          }
+          map.occupancy[(h*map.rows+r)*map.cols+c] = hit;
+        }
+      }
+    }
+  }
+
+  ConfigurationSpaceMap& map; //!< the map being computed
+  const std::vector<unsigned char>& dirty; //!< for each cell, non-zero if it needs to be recomputed
+  const std::vector<BoundingBox2D>& obstacleBoxes; //!< bounding box of each of the map's obstacles
+  const HierarchicalObstacle& footprint; //!< the robot's footprint
+  float radius; //!< the farthest any point of the footprint lies from its center
+  std::vector< fmat::Matrix<2,2> > rotations; //!< the rotation of the footprint for each heading bin
+  std::vector<BoundingBox2D> footprintBoxes; //!< the bounding box of the footprint about its center for each heading bin
+};
+
+size_t ConfigurationSpaceMap::updateObstacles(const std::vector<PlannerObstacle2D*>& newObstacles, float _inflation,
+                                              const HierarchicalObstacle& footprint, TaskPool& pool) {
+  const std::string fpSignature = normalizedFootprint(footprint, fmat::Matrix<2,2>::identity()).componentsToString();
+  const float radius = footprintRadius(footprint);
+  std::vector<unsigned char> dirty(rows*cols, 0);
+  std::vector<std::string> newSignatures(newObstacles.size());
+  for (size_t i = 0; i < newObstacles.size(); i++)
+    newSignatures[i] = newObstacles[i]->toString();
+
+  if ( fpSignature != footprintSignature || _inflation != inflation ) {
+    std::fill(dirty.begin(), dirty.end(), 1);
+  } else {
+    // match up unchanged obstacles, anything left over appeared or disappeared
+    std::multimap<std::string,size_t> previous;
+    for (size_t i = 0; i < signatures.size(); i++)
+      previous.insert(std::make_pair(signatures[i], i));
+    for (size_t i = 0; i < newObstacles.size(); i++) {
+      std::multimap<std::string,size_t>::iterator it = previous.find(newSignatures[i]);
+      if ( it != previous.end() )
+        previous.erase(it);
+      else
+        markDirty(newObstacles[i]->getBoundingBox(), radius, dirty);
+    }
+    for (std::multimap<std::string,size_t>::const_iterator it = previous.begin(); it != previous.end(); ++it)
+      markDirty(obstacles[it->second]->getBoundingBox(), radius, dirty);
+  }
+
+  clearObstacles();
+  obstacles = newObstacles;
+  signatures.swap(newSignatures);
+  inflation = _inflation;
+  footprintSignature = fpSignature;
+
+  std::vector<BoundingBox2D> obstacleBoxes(obstacles.size());
+  for (size_t i = 0; i < obstacles.size(); i++)
+    obstacleBoxes[i] = obstacles[i]->getBoundingBox();
+  pool.parallel_for_range(0, rows, ComputeRows(*this, dirty, obstacleBoxes, footprint, radius), 1);
+  return std::count(dirty.begin(), dirty.end(), 1);
+}
+
+void ConfigurationSpaceMap::markDirty(const BoundingBox2D& bb, float reach, std::vector<unsigned char>& dirty) const {
+  if ( !isBounded(bb) ) {
+    std::fill(dirty.begin(), dirty.end(), 1);
+    return;
+  }
+  const float c0 = std::floor((bb.min[0]-reach-gridMin[0])/cellSize), c1 = std::floor((bb.max[0]+reach-gridMin[0])/cellSize);
+  const float r0 = std::floor((bb.min[1]-reach-gridMin[1])/cellSize), r1 = std::floor((bb.max[1]+reach-gridMin[1])/cellSize);
+  if ( c1 < 0 || r1 < 0 || c0 >= cols || r0 >= rows )
+    return;
+  const size_t cmin = static_cast<size_t>(std::max(c0, 0.f)), cmax = static_cast<size_t>(std::min(c1, float(cols-1)));
+  const size_t rmin = static_cast<size_t>(std::max(r0, 0.f)), rmax = static_cast<size_t>(std::min(r1, float(rows-1)));
+  for (size_t r = rmin; r <= rmax; r++)
+    std::fill(dirty.begin()+r*cols+cmin, dirty.begin()+r*cols+cmax+1, 1);
+}
+
+size_t ConfigurationSpaceMap::getNumFree(unsigned int heading) const {
+  const std::vector<unsigned char>::const_iterator layer = occupancy.begin() + heading*rows*cols;
+  return std::count(layer, layer+rows*cols, 0);
+}
+
+void ConfigurationSpaceMap::exportGridWorld(unsigned int heading, GridWorld& gw) const {
+  gw = GridWorld(rows, cols);
+  for (size_t r = 0; r < rows; r++)
+    for (size_t c = 0; c < cols; c++)
+      if ( isOccupied(r, c, heading) )
+        gw(r,c) = '#';
+}
+
+size_t ConfigurationSpaceMap::updateGridWorld(unsigned int heading, GridWorld& gw, std::vector<GridWorld::State>& affected) const {
+  const bool fresh = ( gw.getRows() != rows || gw.getCols() != cols );
+  if ( fresh )
+    gw = GridWorld(rows, cols);
+  size_t changed = 0;
+  for (size_t r = 0; r < rows; r++)
+    for (size_t c = 0; c < cols; c++) {
+      const char cell = isOccupied(r, c, heading) ? '#' : ' ';
+      if ( !fresh && cell == gw(r,c) )
+        continue;
+      gw(r,c) = cell;
+      gw.affected(GridWorld::State(r,c), affected);
+      changed++;
+    }
+  return changed;
+}
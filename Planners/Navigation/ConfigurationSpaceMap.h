@@ -0,0 +1,127 @@
+//-*-c++-*-
+#ifndef INCLUDED_ConfigurationSpaceMap_h_
+#define INCLUDED_ConfigurationSpaceMap_h_
+
+#include "Planners/PlannerObstacles.h"
+#include "Planners/GridWorld.h"
+#include "Shared/Measures.h"
+#include <string>
+#include <vector>
+
+namespace DualCoding {
+  class ShapeSpace;
+}
+class TaskPool;
+
+//! A rasterized configuration space for a robot moving in the plane: an occupancy grid over x and y for each of a number of heading bins
+/*! Each cell of each heading layer records whether the robot's footprint (a HierarchicalObstacle
+ *  in the robot's frame, such as RRTNodeXYTheta::CollisionChecker::body) may collide with an
+ *  obstacle anywhere in the cell, at any heading in the bin.  The map is conservative: a cell is
+ *  only marked free if no configuration within it collides, so ShapeSpacePlannerXY and
+ *  ShapeSpacePlannerXYTheta can answer most collision queries with a lookup (see their
+ *  setConfigurationSpace()), and only run the geometric test near obstacles.
+ *
+ *  To make this guarantee, each cell is tested with the footprint at the cell's center and the
+ *  bin's middle heading, against obstacles inflated by getMargin(): half the cell's diagonal, plus
+ *  the distance the footprint's farthest point moves turning to the edge of the bin.  With a
+ *  single heading bin the footprint isn't rotated at all, which is only valid for a footprint
+ *  which doesn't depend on heading (e.g. ShapeSpacePlannerXY's circular robot).
+ *
+ *  update() compares the obstacles against those of the previous update, and only recomputes the
+ *  cells within reach of obstacles which appeared, disappeared, or moved.  Cells are computed in
+ *  parallel on a TaskPool.
+ *
+ *  Each layer can also be exported to a GridWorld, to plan on the grid directly with AStar, or
+ *  incrementally with DStarLite (see updateGridWorld()). */
+class ConfigurationSpaceMap {
+public:
+  //! constructor, covers @a area with square cells of size @a cellSize, and divides the circle into @a numHeadings bins
+  ConfigurationSpaceMap(const BoundingBox2D& area, float cellSize, unsigned int numHeadings);
+
+  //! destructor
+  ~ConfigurationSpaceMap() { clearObstacles(); }
+
+  //! brings the map up to date with the obstacles in @a shs (inflated by @a inflation, as by ShapeSpaceCollisionCheckerBase), returns the number of cells recomputed
+  /*! If @a inflation or @a footprint differ from the last update, all cells are recomputed. */
+  size_t update(DualCoding::ShapeSpace& shs, float inflation, const HierarchicalObstacle& footprint, TaskPool& pool);
+
+  //! like update(), but takes the obstacles directly, which must already be inflated by getMargin() beyond the planner's inflation; takes ownership of the obstacles
+  size_t updateObstacles(const std::vector<PlannerObstacle2D*>& obstacles, float inflation, const HierarchicalObstacle& footprint, TaskPool& pool);
+
+  //! marks every cell as occupied until the next update
+  void clear();
+
+  //! returns the extra inflation needed on the obstacles to make the map conservative for @a footprint, see the class documentation
+  float getMargin(const HierarchicalObstacle& footprint) const;
+
+  //! returns true if the robot is known not to collide anywhere in the cell and heading bin containing the configuration; false if it might, or if (@a x, @a y) is outside the map
+  bool isFree(float x, float y, AngTwoPi theta) const {
+    const size_t idx = cellIndex(x,y);
+    return idx != -1U && !occupancy[headingBin(theta)*cols*rows + idx];
+  }
+  //! returns true if cell (@a row, @a col) of heading bin @a heading may collide
+  bool isOccupied(size_t row, size_t col, unsigned int heading) const { return occupancy[(heading*rows+row)*cols+col]; }
+
+  //! returns the index of the cell (row-major from getMinBound()) containing (@a x, @a y), or -1U if outside the map
+  size_t cellIndex(float x, float y) const {
+    const float c = (x-gridMin[0])/cellSize, r = (y-gridMin[1])/cellSize;
+    if ( !(c >= 0 && r >= 0 && c < cols && r < rows) ) // also rejects NaN
+      return -1U;
+    return static_cast<size_t>(r)*cols + static_cast<size_t>(c);
+  }
+  //! returns the heading bin containing @a theta
+  unsigned int headingBin(AngTwoPi theta) const {
+    const unsigned int bin = static_cast<unsigned int>(float(theta)/(2*M_PI)*numHeadings);
+    return (bin < numHeadings) ? bin : 0; // also handles NaN and rounding up to 2π
+  }
+  //! returns the center of cell (@a row, @a col)
+  fmat::Column<2> cellCenter(size_t row, size_t col) const { return gridMin + fmat::pack((col+0.5f)*cellSize, (row+0.5f)*cellSize); }
+  //! returns the middle heading of bin @a heading
+  AngTwoPi binHeading(unsigned int heading) const { return float((heading+0.5f)*2*M_PI/numHeadings); }
+
+  float getCellSize() const { return cellSize; } //!< returns the size of each cell
+  size_t getCols() const { return cols; } //!< returns the number of cells along x
+  size_t getRows() const { return rows; } //!< returns the number of cells along y
+  unsigned int getNumHeadings() const { return numHeadings; } //!< returns the number of heading bins
+  const fmat::Column<2>& getMinBound() const { return gridMin; } //!< returns the corner of the map with the lowest coordinates
+  float getInflation() const { return inflation; } //!< returns the obstacle inflation of the last update
+  size_t getNumFree(unsigned int heading) const; //!< returns the number of free cells in heading bin @a heading
+
+  //! stores heading bin @a heading into @a gw, one character per cell (row @e r of @a gw is row @e r of the map, increasing y), spaces are free, '#' may collide
+  void exportGridWorld(unsigned int heading, GridWorld& gw) const;
+
+  //! brings @a gw, previously exported from heading bin @a heading, up to date, appending the GridWorld::affected() states of each cell which changed to @a affected; returns the number of cells changed
+  /*! This is what DStarLite::updateStates() needs to repair a plan after update().  If @a gw is
+   *  the wrong size, it is exported from scratch, and every cell counts as changed. */
+  size_t updateGridWorld(unsigned int heading, GridWorld& gw, std::vector<GridWorld::State>& affected) const;
+
+protected:
+  //! computes the dirty cells of rows [@a begin, @a end), for TaskPool::parallel_for_range()
+  struct ComputeRows;
+
+  //! marks the cells whose centers are within @a reach of @a bb as dirty
+  void markDirty(const BoundingBox2D& bb, float reach, std::vector<unsigned char>& dirty) const;
+  //! deletes #obstacles
+  void clearObstacles();
+
+  fmat::Column<2> gridMin; //!< the corner of the map with the lowest coordinates
+  float cellSize; //!< the size of each cell
+  size_t cols; //!< the number of cells along x
+  size_t rows; //!< the number of cells along y
+  unsigned int numHeadings; //!< the number of heading bins
+  std::vector<unsigned char> occupancy; //!< for each heading bin, row, and column (in that order), non-zero if the robot may collide
+  std::vector<PlannerObstacle2D*> obstacles; //!< the (inflated) obstacles of the last update
+  std::vector<std::string> signatures; //!< the toString() of each of #obstacles, to find the ones which changed
+  float inflation; //!< the planner's obstacle inflation at the last update
+  std::string footprintSignature; //!< describes the footprint used in the last update, empty if the map needs to be recomputed
+
+private:
+  ConfigurationSpaceMap(const ConfigurationSpaceMap&); //!< don't call (owns obstacles)
+  ConfigurationSpaceMap& operator=(const ConfigurationSpaceMap&); //!< don't call (owns obstacles)
+};
+
+/*! @file
+ * @brief Describes ConfigurationSpaceMap, which rasterizes the configuration space of a robot moving in the plane for fast collision lookups
+ */
+
+#endif
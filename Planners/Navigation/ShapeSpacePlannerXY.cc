@@ -69,7 +69,11 @@ bool RRTNodeXY::CollisionChecker::collides(const NodeValue_t &qnew, ShapeSpacePl
     return true;
   }
   
-  for (size_t i = 0; i < obstacles.size(); i++)
+  if ( cspace && cspace->isFree(qnew.first, qnew.second, 0) )
+    return false;
+  const std::vector<unsigned int>& candidates = findCandidates(robot.getBoundingBox());
+  for (size_t c = 0; c < candidates.size(); c++) {
+    const size_t i = candidates[c];
     if ( !obstacles[i]->isBodyObstacle() && obstacles[i]->collides(robot)) {
       //std::cout << "Collision: " << robot.toString() << " with " << obstacles[i]->toString() << std::endl;
       if (result) {
@@ -81,6 +85,7 @@ bool RRTNodeXY::CollisionChecker::collides(const NodeValue_t &qnew, ShapeSpacePl
       }
       return true;
     }
+  }
   return false;
 }
 
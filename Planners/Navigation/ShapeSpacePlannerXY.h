@@ -3,6 +3,7 @@
 #define _SHAPE_SPACE_PLANNER_XY_H_
 
 #include "Planners/RRT/ShapeSpacePlannerBase.h"
+#include "Planners/Navigation/ConfigurationSpaceMap.h"
 
 class ShapeSpacePlannerXY;
 
@@ -26,17 +27,31 @@ public:
     CollisionChecker(ShapeSpace &shs,
                      const Shape<PolygonData> &_worldBounds,
                      float _inflation, float _robotRadius) :
-    ShapeSpaceCollisionCheckerBase<2>(shs, _worldBounds, _inflation), robotRadius(_robotRadius) {}
+    ShapeSpaceCollisionCheckerBase<2>(shs, _worldBounds, _inflation), robotRadius(_robotRadius), cspace(NULL) {}
     
     float robotRadius;
     
+    //! if set, positions in free cells of this map (which should have a single heading bin, and getFootprint()) are accepted without testing obstacles
+    const ConfigurationSpaceMap* cspace;
+    
     virtual bool collides(const NodeValue_t &qnew, PlannerResult* result=NULL) const;
     
+    //! returns the robot's footprint, a circle of #robotRadius, e.g. for ConfigurationSpaceMap::update()
+    HierarchicalObstacle getFootprint() const {
+      HierarchicalObstacle footprint;
+      footprint.add(new CircularObstacle(0, 0, robotRadius));
+      return footprint;
+    }
   };
   
   static const unsigned int maxInterpolations = 10; //!< Maximum number of interpolation steps in interpolate() when @a truncate is true
   
   virtual float distance(const NodeValue_t &target);
+  //!@name Coordinates for RRTNearestIndex
+  static const size_t KeyDims = 2;
+  static void getKey(const NodeValue_t &q, float key[]) { key[0] = q.first; key[1] = q.second; }
+  static bool isKeyAngular(size_t) { return false; }
+  //@}
   static void generateSample(const NodeValue_t &lower, const NodeValue_t &upper, NodeValue_t &sample);
   static Interp_t interpolate(const NodeValue_t &start, const NodeValue_t &target, const NodeValue_t &interp, 
                               bool truncate, CollisionChecker *cc, NodeValue_t &reached, bool searchingBackwards);
@@ -71,6 +86,9 @@ public:
   
   float robotRadius; //!< radius in mm of the CircularObstacle describing the robot
   
+  //! uses @a map (or the geometric test alone, if NULL) to answer collision queries; the map must be kept up to date with the ShapeSpace and inflation by the caller
+  void setConfigurationSpace(const ConfigurationSpaceMap* map) { cc->cspace = map; }
+  
   static void plotPath(const std::vector<NodeValue_t> &path,
 		       Shape<GraphicsData> &graphics,
 		       rgb color = rgb(0,0,255));
@@ -79,6 +97,9 @@ public:
 		       Shape<GraphicsData> &graphics,
 		       rgb color = rgb(0,0,255));
 
+protected:
+  //! copies the collision checker for parallel searches, see setParallelPlanners()
+  virtual NodeType_t::CollisionChecker* cloneCollisionChecker() const { return new NodeType_t::CollisionChecker(*cc); }
 };
 
 #endif
@@ -170,10 +170,16 @@ bool RRTNodeXYTheta::CollisionChecker::collides(const NodeValue_t &qnew, Generic
     return true;
   }
   
+  if ( cspace && cspace->isFree(qnew.x, qnew.y, qnew.theta) )
+    return false;
+  const std::vector<unsigned int>& candidates = findCandidates(bodyBoundingBox(qnew.x, qnew.y, qnew.theta));
+  if ( candidates.empty() )
+    return false;
   body.updatePosition(fmat::pack(qnew.x, qnew.y));
   body.updateRotation(fmat::rotation2D(qnew.theta));
   
-  for (size_t i = 0; i < obstacles.size(); i++) {
+  for (size_t c = 0; c < candidates.size(); c++) {
+    const size_t i = candidates[c];
     if ( !obstacles[i]->isBodyObstacle() && obstacles[i]->collides(body)) {
       if (result) {
         ostringstream os;
@@ -190,15 +196,58 @@ bool RRTNodeXYTheta::CollisionChecker::collides(const NodeValue_t &qnew, Generic
 }
 
 std::vector<PlannerObstacle2D*> RRTNodeXYTheta::CollisionChecker::colliders(const NodeValue_t &qnew) {
+  if ( cspace && cspace->isFree(qnew.x, qnew.y, qnew.theta) )
+    return std::vector<PlannerObstacle2D*>();
+  const std::vector<unsigned int>& candidates = findCandidates(bodyBoundingBox(qnew.x, qnew.y, qnew.theta));
   body.updatePosition(fmat::pack(qnew.x, qnew.y));
   body.updateRotation(fmat::rotation2D(qnew.theta));
   std::vector<PlannerObstacle2D*> result;
-  for (size_t i = 0; i < obstacles.size(); i++)
+  for (size_t c = 0; c < candidates.size(); c++) {
+    const size_t i = candidates[c];
     if ( !obstacles[i]->isBodyObstacle() && obstacles[i]->collides(body))
       result.push_back(obstacles[i]);
+  }
   return result;
 }
 
+BoundingBox2D RRTNodeXYTheta::CollisionChecker::bodyBoundingBox(float x, float y, AngTwoPi theta) {
+  const float binWidth = 2*M_PI/numHeadingBins;
+  if ( headingBoxes.empty() ) {
+    headingBoxes.resize(numHeadingBins);
+    // rotating a copy about its own center recomputes its bounding box from the components
+    HierarchicalObstacle unrotated(body);
+    unrotated.updatePosition(fmat::ZERO2);
+    unrotated.updateRotation(fmat::Matrix<2,2>::identity());
+    unrotated.rotate(fmat::ZERO2, fmat::Matrix<2,2>::identity());
+    const BoundingBox2D bb = unrotated.getBoundingBox();
+    bodyRadius = 0;
+    if ( !bb.empty() )
+      for (int i = 0; i < 2; i++)
+        for (int j = 0; j < 2; j++)
+          bodyRadius = std::max(bodyRadius, std::sqrt((i ? bb.max[0] : bb.min[0])*(i ? bb.max[0] : bb.min[0]) +
+                                                      (j ? bb.max[1] : bb.min[1])*(j ? bb.max[1] : bb.min[1])));
+  }
+  if ( std::isnan(float(theta)) ) // no heading (e.g. a dummy node), so can't rule anything out
+    return BoundingBox2D();
+  const unsigned int bin = std::min((unsigned int)(float(theta)/binWidth), numHeadingBins-1);
+  BoundingBox2D& box = headingBoxes[bin];
+  if ( box.empty() ) {
+    HierarchicalObstacle rotated(body);
+    rotated.updatePosition(fmat::ZERO2);
+    rotated.updateRotation(fmat::Matrix<2,2>::identity());
+    rotated.rotate(fmat::ZERO2, fmat::rotation2D((bin+0.5f)*binWidth));
+    box = rotated.getBoundingBox();
+    // points of the body move at most bodyRadius*binWidth/2 as it turns to the edges of the bin
+    const float sweep = bodyRadius*binWidth/2;
+    box.min -= fmat::pack(sweep, sweep);
+    box.max += fmat::pack(sweep, sweep);
+    if ( box.empty() ) // the body has no components and can't collide with anything, so use a point to keep the query cheap
+      box = BoundingBox2D(fmat::ZERO2);
+  }
+  const fmat::Column<2> pos = fmat::pack(x, y);
+  return BoundingBox2D(box.min+pos, box.max+pos);
+}
+
 
 //================ ShapeSpacePlannerXYTheta ================
 
@@ -5,6 +5,7 @@
 #include "Motion/Kinematics.h"
 
 #include "Planners/RRT/ShapeSpacePlannerBase.h"
+#include "Planners/Navigation/ConfigurationSpaceMap.h"
 
 class ShapeSpacePlannerXYTheta;
 
@@ -35,7 +36,7 @@ public:
     CollisionChecker(DualCoding::ShapeSpace & shs,
                      const DualCoding::Shape<DualCoding::PolygonData> &_worldBounds,
                      float _inflation) :
-      ShapeSpaceCollisionCheckerBase<2>(shs, _worldBounds, _inflation), body() {
+      ShapeSpaceCollisionCheckerBase<2>(shs, _worldBounds, _inflation), body(), cspace(NULL), headingBoxes(), bodyRadius(-1) {
       for (unsigned int i = 0; i < obstacles.size(); i++) {
         if (obstacles[i]->isBodyObstacle())
           body.add(dynamic_cast<PlannerObstacle<2>*>(obstacles[i]->clone()));
@@ -44,9 +45,24 @@ public:
       
     HierarchicalObstacle body;
     
+    //! if set, configurations in free cells of this map (built for #body) are accepted without testing obstacles
+    const ConfigurationSpaceMap* cspace;
+    
     virtual bool collides(const NodeValue_t &qnew, GenericRRTBase::PlannerResult2D* result=NULL);
 
     std::vector<PlannerObstacle2D*> colliders(const NodeValue_t &q);
+    
+    //! Returns a bounding box of #body at (@a x, @a y), covering every heading in the bin containing @a theta
+    /*! Used to find the obstacles which may collide with the body (see findCandidates()).
+     *  The box for each of #numHeadingBins headings is computed from the body's components the
+     *  first time it's needed, then just translated. */
+    BoundingBox2D bodyBoundingBox(float x, float y, AngTwoPi theta);
+    
+    static const unsigned int numHeadingBins = 64; //!< number of headings whose body bounding box is cached
+    
+  protected:
+    std::vector<BoundingBox2D> headingBoxes; //!< the bounding box of #body relative to its center, swept over each heading bin; empty boxes haven't been computed
+    float bodyRadius; //!< distance from the body's center to the farthest corner of its unrotated bounding box, negative until computed
   };
   
   static const unsigned int maxInterpolations = 10; //!< Maximum number of interpolation steps in interpolate() when @a truncate is true
@@ -54,6 +70,11 @@ public:
   static const AngSignPi turnLimit; //!< Maximum theta difference between adjacent nodes without interpolated collision checking
   
   virtual float distance(const NodeValue_t &target);
+  //!@name Coordinates for RRTNearestIndex: only the position, like distance(), since samples have no heading
+  static const size_t KeyDims = 2;
+  static void getKey(const NodeValue_t &q, float key[]) { key[0] = q.x; key[1] = q.y; }
+  static bool isKeyAngular(size_t) { return false; }
+  //@}
 
   static void generateSample(const NodeValue_t &lower, const NodeValue_t &upper, NodeValue_t &sample);
 
@@ -103,6 +124,9 @@ public:
   
 	static unsigned int const numDivisions = 18; //!< Number of divisions of the circle to try when targetHeading unspecified
 
+  //! uses @a map (or the geometric test alone, if NULL) to answer collision queries; the map must be kept up to date with the ShapeSpace and inflation by the caller, for getCC()->body
+  void setConfigurationSpace(const ConfigurationSpaceMap* map) { cc->cspace = map; }
+
   using GenericRRT<NodeType_t, 2>::planPath;
 
   //! Plan a robot path from @a startPoint to @a endPoint with optional @a targetHeading at the end
@@ -137,6 +161,10 @@ public:
 											 Shape<GraphicsData> &graphics,
 											 rgb color = rgb(0,0,255));
 
+protected:
+  //! copies the collision checker for parallel searches, see setParallelPlanners()
+  virtual NodeType_t::CollisionChecker* cloneCollisionChecker() const { return new NodeType_t::CollisionChecker(*cc); }
+
 private:
   float targetHeading;  //!< Set by planPath() and used by initialize()
   fmat::Column<3> baseOffset;  //!< Set by planPath() and used by initialize()
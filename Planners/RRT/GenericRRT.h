@@ -5,8 +5,13 @@
 #include <vector>
 #include <ostream>
 #include <cmath>
+#include <cstdlib>
+#include <algorithm>
+#include <atomic>
 
 #include "Shared/Measures.h"  // AngTwoPi
+#include "Planners/RRT/RRTNearestIndex.h"
+#include "IPC/TaskPool.h"
 
 using namespace DualCoding;
 
@@ -15,7 +20,8 @@ using namespace DualCoding;
 //! Base class for RRT nodes used by GenericRRT
 /*! Subclasses of RRTNodeBase must provide a NodeValue_t type, a
   CollisionChecker class, and the following methods: distance,
-  generateSample, interpolate, toString.
+  generateSample, interpolate, toString.  They must also provide the
+  coordinates used by RRTNearestIndex: KeyDims, getKey, and isKeyAngular.
 */
 class RRTNodeBase {
 public:
@@ -24,10 +30,28 @@ public:
   enum Interp_t { COLLISION, APPROACHED, REACHED };
   //! returns a value in the range [minVal, maxVal), i.e. inclusive minVal, exclusive maxVal
   static float randRange(float minVal, float maxVal) {
-    return (maxVal - minVal) * (rand()/((float)RAND_MAX)) + minVal;
+    return (maxVal - minVal) * (randInt()/((float)RAND_MAX)) + minVal;
   }
+  //! returns rand(), or rand_r() of the calling thread's seed while a SeedScope is active, so parallel searches draw independent samples
+  static int randInt() {
+    unsigned int* seed = threadSeed();
+    return (seed != NULL) ? rand_r(seed) : rand();
+  }
+  //! makes randInt() on the constructing thread use @a seed until destroyed
+  class SeedScope {
+  public:
+    explicit SeedScope(unsigned int* seed) : prev(threadSeed()) { threadSeed() = seed; } //!< constructor
+    ~SeedScope() { threadSeed() = prev; } //!< destructor, restores the previous seed
+  private:
+    unsigned int* prev; //!< the seed in use before this scope
+    SeedScope(const SeedScope&); //!< don't call
+    SeedScope& operator=(const SeedScope&); //!< don't call
+  };
   virtual ~RRTNodeBase() {}
   virtual std::string toString() const = 0;
+private:
+  //! the calling thread's seed for randInt(), NULL to use rand()
+  static unsigned int*& threadSeed() { static thread_local unsigned int* seed = NULL; return seed; }
 };
 
 //================ AdmissibilityPredicate ================
@@ -116,6 +140,74 @@ protected:
 
   AdmissibilityPredicate<NODE> *predicate;  //!< admissibility predicate
 
+  std::vector<float> distanceWeights;  //!< weight of each of NODE's coordinates when finding the nearest node, empty for all 1's
+
+  bool useNearestIndex;  //!< if true, nearest nodes are found with a k-d tree, otherwise by scanning the tree
+
+  unsigned int parallelPlanners;  //!< number of searches planPath() runs at once, see setParallelPlanners()
+
+  TaskPool *pool;  //!< the pool parallel searches run on, NULL for TaskPool::getDefault()
+
+  std::vector<typename NODE::CollisionChecker*> workerCCs;  //!< copies of #cc for the other threads, during a parallel planPath()
+
+  //! The state of one search of planPath(): its collision checker, and indices of the nearest nodes of its trees
+  struct Search {
+    Search() : cc(NULL), nearestIndex(), indexedTree(), seed(0), iterations(0), trees() {}
+    typename NODE::CollisionChecker *cc;  //!< the collision checker used by this search
+    RRTNearestIndex<NODE> nearestIndex[2];  //!< indices of the start and end trees
+    const std::vector<NODE> *indexedTree[2];  //!< the trees indexed by #nearestIndex
+    unsigned int seed;  //!< random number state of a parallel search, see RRTNodeBase::randInt()
+    unsigned int iterations;  //!< the number of iterations a parallel search took (more than the maximum if it failed)
+    std::vector<NODE> trees[2];  //!< the start and end trees of a parallel search
+  };
+
+  //! runs connect() for one of several parallel searches, and cancels the others on success
+  struct ConnectTask {
+    //! constructor
+    ConnectTask(GenericRRT &r, Search &s, int i, const NodeValue_t &st, unsigned int max, std::atomic<int> &w, TaskPool::TaskGroup &g)
+      : rrt(r), search(s), index(i), start(st), maxIterations(max), winner(w), group(g) {}
+    void operator()() const {
+      RRTNodeBase::SeedScope seed(&search.seed);
+      search.iterations = rrt.connect(search, &search.trees[0], &search.trees[1], start, maxIterations, &group);
+      int none = -1;
+      if ( search.iterations < maxIterations && winner.compare_exchange_strong(none, index) )
+        group.cancel();
+    }
+    GenericRRT &rrt;  //!< the planner
+    Search &search;  //!< the state of this search
+    int index;  //!< the index of this search
+    const NodeValue_t &start;  //!< the start of the path
+    unsigned int maxIterations;  //!< the iteration limit
+    std::atomic<int> &winner;  //!< index of the first search to succeed, -1 until then
+    TaskPool::TaskGroup &group;  //!< the group running the searches
+  };
+
+  //! tests shortcuts between pairs of points of a path for smoothPath(), each on its own collision checker
+  struct ShortcutTask {
+    //! constructor
+    ShortcutTask(const std::vector<NodeValue_t> &p, const std::vector<std::pair<size_t,size_t> > &c, std::vector<char> &r,
+                 const std::vector<typename NODE::CollisionChecker*> &checkers, const NodeValue_t &s)
+      : path(p), candidates(c), reached(r), ccs(checkers), step(s) {}
+    void operator()(size_t begin, size_t end) const {
+      for (size_t i = begin; i < end; i++) {
+        NodeValue_t dummy;
+        reached[i] = NODE::interpolate(path[candidates[i].first], path[candidates[i].second], step, false, ccs[i], dummy, true) == RRTNodeBase::REACHED;
+      }
+    }
+    const std::vector<NodeValue_t> &path;  //!< the path being smoothed
+    const std::vector<std::pair<size_t,size_t> > &candidates;  //!< the pairs of indices into #path to test
+    std::vector<char> &reached;  //!< set to non-zero for each candidate whose shortcut is clear
+    const std::vector<typename NODE::CollisionChecker*> &ccs;  //!< a collision checker for each candidate
+    const NodeValue_t &step;  //!< the interpolation step
+  };
+
+  //! orders shortcuts longest first, for smoothPath()
+  struct ShortcutLonger {
+    bool operator()(const std::pair<size_t,size_t> &a, const std::pair<size_t,size_t> &b) const {
+      return a.second-a.first > b.second-b.first;
+    }
+  };
+
 public:
   //! Constructor; will delete @a collCheck argument when destructed
   GenericRRT(typename NODE::CollisionChecker *collCheck, AdmissibilityPredicate<NODE> *predicate=NULL);
@@ -126,7 +218,9 @@ public:
     lowerLimits(other.lowerLimits), upperLimits(other.upperLimits),
     extendingInterpolationStep(other.extendingInterpolationStep),
     smoothingInterpolationStep(other.smoothingInterpolationStep),
-    cc(other.cc), predicate(other.predicate) {}
+    cc(other.cc), predicate(other.predicate),
+    distanceWeights(other.distanceWeights), useNearestIndex(other.useNearestIndex),
+    parallelPlanners(other.parallelPlanners), pool(other.pool), workerCCs() {}
 
 
   //! Destructor: deletes the collision checker
@@ -154,6 +248,22 @@ public:
     smoothingInterpolationStep = _smoothingInterpolationStep;
   }
 
+  //! Set the weight of each of NODE's coordinates (see RRTNearestIndex) in the distance used to find the nearest node of a tree, e.g. to favor moving the distal joints of an arm; an empty vector weights them all 1
+  void setDistanceWeights(const std::vector<float> &weights) { distanceWeights = weights; }
+
+  //! Controls whether the nearest node of a tree is found with an incrementally built k-d tree (the default), or by scanning the whole tree, which is faster only for small trees
+  void setUseNearestIndex(bool use) { useNearestIndex = use; }
+
+  //! Sets the number of independent searches planPath() runs in parallel on @a taskPool (NULL for TaskPool::getDefault()); 0 runs one per thread of the pool, 1 (the default) plans serially
+  /*! Each search grows its own pair of trees from a different random seed, and the first to
+   *  connect them wins; the others are cancelled.  This cuts the long tail of planning times,
+   *  since an unlucky search no longer holds up the result.  Path smoothing also tests several
+   *  shortcuts at once.  Each search needs its own collision checker, so this only takes effect if
+   *  cloneCollisionChecker() is overridden, and there is no admissibility predicate (which may
+   *  keep state between calls).  The seeds are drawn from rand(), so srand() still makes planning
+   *  repeatable, although which search wins may vary. */
+  void setParallelPlanners(unsigned int n, TaskPool *taskPool=NULL) { parallelPlanners = n; pool = taskPool; }
+
   //! Plan a path from start to end
   virtual PlannerResult<N> planPath(const NodeValue_t &start,
                                     const NodeValue_t &end,
@@ -177,9 +287,24 @@ protected:
 
   void addNode(std::vector<NODE> *tree, const NodeValue_t &q, unsigned int parent);
 
+  //! Returns a new copy of #cc for a parallel search to use on another thread, or NULL if the collision checker can't be copied (the default), see setParallelPlanners()
+  virtual typename NODE::CollisionChecker* cloneCollisionChecker() const { return NULL; }
+
+  //! Removes unnecessary waypoints from @a path with shortcuts, testing several at once on #workerCCs during a parallel planPath()
+  void smoothPath(std::vector<NodeValue_t> &path);
+
 private:
-  unsigned int nearestNode(std::vector<NODE> *tree, const NodeValue_t &target);
-  RRTNodeBase::Interp_t extend(std::vector<NODE> *tree, const NodeValue_t &q, bool truncate, bool searchingBackwards);
+  //! Prepares @a search to plan with @a checker on @a treeStart and @a treeEnd
+  void resetSearch(Search &search, typename NODE::CollisionChecker *checker, const std::vector<NODE> *treeStart, const std::vector<NODE> *treeEnd);
+  //! Grows @a treeStart and @a treeEnd toward each other until they connect, returning the number of iterations (more than @a maxIterations if they didn't, or @a maxIterations if @a group was cancelled)
+  unsigned int connect(Search &search, std::vector<NODE> *treeStart, std::vector<NODE> *treeEnd, const NodeValue_t &start,
+                       unsigned int maxIterations, const TaskPool::TaskGroup *group);
+  //! Runs connect() in parallel from copies of the trees, one search per collision checker, and stores the trees of the first to succeed
+  unsigned int connectParallel(std::vector<NODE> *treeStart, std::vector<NODE> *treeEnd, const NodeValue_t &start, unsigned int maxIterations);
+  //! Deletes #workerCCs
+  void releaseWorkers();
+  unsigned int nearestNode(Search &search, std::vector<NODE> *tree, const NodeValue_t &target);
+  RRTNodeBase::Interp_t extend(Search &search, std::vector<NODE> *tree, const NodeValue_t &q, bool truncate, bool searchingBackwards);
 
   GenericRRT& operator=(const GenericRRT&);   //!< Don't call this
 };
@@ -189,7 +314,8 @@ private:
 template<typename NODE, size_t N>
 GenericRRT<NODE, N>::GenericRRT(typename NODE::CollisionChecker *collCheck,
 			     AdmissibilityPredicate<NODE> *_predicate) :
-  lowerLimits(), upperLimits(), extendingInterpolationStep(), smoothingInterpolationStep(), cc(collCheck), predicate(_predicate) {}
+  lowerLimits(), upperLimits(), extendingInterpolationStep(), smoothingInterpolationStep(), cc(collCheck), predicate(_predicate),
+  distanceWeights(), useNearestIndex(true), parallelPlanners(1), pool(NULL), workerCCs() {}
 
 template<typename NODE, size_t N>
 void GenericRRT<NODE, N>::initialize(const NodeValue_t &start, std::vector<NODE> &treeStart,
@@ -212,12 +338,13 @@ GenericRRT<NODE, N>::planPath(const NodeValue_t &start, const NodeValue_t &end,
   std::vector<NODE> *treeEnd = treeEndResult ? treeEndResult : &privateTreeEnd;
   treeStart->clear();
   treeEnd->clear();
+  Search search;
+  resetSearch(search, cc, treeStart, treeEnd);
 
   // add initial configs in if we're searching in a circle around the designated endpoint
   initialize(start, *treeStart, end, *treeEnd);
 
   std::vector<NODE> *A = treeStart;
-  std::vector<NODE> *B = treeEnd;
   
   // check start/end configurations
   if ( cc->collides(start, &result) ) {
@@ -234,26 +361,31 @@ GenericRRT<NODE, N>::planPath(const NodeValue_t &start, const NodeValue_t &end,
     return result;
   }
 
+  // copies of the collision checker for parallel searches and smoothing
+  struct ReleaseWorkers {
+    ReleaseWorkers(GenericRRT &r) : rrt(r) {}
+    ~ReleaseWorkers() { rrt.releaseWorkers(); }
+    GenericRRT &rrt;
+  } workerGuard(*this);
+  if ( parallelPlanners != 1 && predicate == NULL ) {
+    const unsigned int n = (parallelPlanners != 0) ? parallelPlanners : (pool ? *pool : TaskPool::getDefault()).getConcurrency();
+    while ( workerCCs.size()+1 < n ) {
+      typename NODE::CollisionChecker *copy = cloneCollisionChecker();
+      if ( copy == NULL )
+        break;
+      workerCCs.push_back(copy);
+    }
+  }
+
   unsigned int iter = 0;
-  bool searchingBackwards = false;
   // first test for direct path from start to end if there is a unique end
-  if ( treeEnd->size() == 1 && extend(A, end, false, searchingBackwards) == RRTNodeBase::REACHED )
+  if ( treeEnd->size() == 1 && extend(search, A, end, false, false) == RRTNodeBase::REACHED )
     /* we're done */ ;
-  else
+  else if ( workerCCs.empty() )
     // there is no direct path, so build the tree
-    while ( iter++ < maxIterations ) {
-      NodeValue_t qrand;
-      if ( iter == 1 && (*B)[0].parent < B->size() )  // tree must have at least one non-dummy node
-				qrand = (*B)[nearestNode(B, start)].q;
-      else
-				NODE::generateSample(lowerLimits,upperLimits,qrand);
-      if ( extend(A, qrand, true, searchingBackwards) != RRTNodeBase::COLLISION ) {
-        if ( extend(B, A->back().q, true, !searchingBackwards) == RRTNodeBase::REACHED )
-          break;
-	swap(A,B);
-	searchingBackwards = ! searchingBackwards;
-      }
-    }
+    iter = connect(search, treeStart, treeEnd, start, maxIterations, NULL);
+  else
+    iter = connectParallel(treeStart, treeEnd, start, maxIterations);
 
   if ( iter >= maxIterations ) {
     // dumpTree(*treeStart,"treeStart: ================");
@@ -269,13 +401,85 @@ GenericRRT<NODE, N>::planPath(const NodeValue_t &start, const NodeValue_t &end,
   return result;
 }
 
+template<typename NODE, size_t N>
+void GenericRRT<NODE, N>::resetSearch(Search &search, typename NODE::CollisionChecker *checker,
+                                      const std::vector<NODE> *treeStart, const std::vector<NODE> *treeEnd) {
+  search.cc = checker;
+  search.indexedTree[0] = treeStart;
+  search.indexedTree[1] = treeEnd;
+  for (unsigned int i = 0; i < 2; i++)
+    search.nearestIndex[i].reset(distanceWeights, useNearestIndex);
+}
+
+template<typename NODE, size_t N>
+unsigned int GenericRRT<NODE, N>::connect(Search &search, std::vector<NODE> *treeStart, std::vector<NODE> *treeEnd,
+                                          const NodeValue_t &start, unsigned int maxIterations, const TaskPool::TaskGroup *group) {
+  std::vector<NODE> *A = treeStart;
+  std::vector<NODE> *B = treeEnd;
+  bool searchingBackwards = false;
+  unsigned int iter = 0;
+  while ( iter++ < maxIterations ) {
+    if ( group != NULL && group->isCancelled() )
+      return maxIterations;  // another search got there first
+    NodeValue_t qrand;
+    if ( iter == 1 && (*B)[0].parent < B->size() )  // tree must have at least one non-dummy node
+      qrand = (*B)[nearestNode(search, B, start)].q;
+    else
+      NODE::generateSample(lowerLimits,upperLimits,qrand);
+    if ( extend(search, A, qrand, true, searchingBackwards) != RRTNodeBase::COLLISION ) {
+      if ( extend(search, B, A->back().q, true, !searchingBackwards) == RRTNodeBase::REACHED )
+        break;
+      swap(A,B);
+      searchingBackwards = ! searchingBackwards;
+    }
+  }
+  return iter;
+}
+
+template<typename NODE, size_t N>
+unsigned int GenericRRT<NODE, N>::connectParallel(std::vector<NODE> *treeStart, std::vector<NODE> *treeEnd,
+                                                  const NodeValue_t &start, unsigned int maxIterations) {
+  std::vector<Search> searches(workerCCs.size()+1);
+  for (size_t i = 0; i < searches.size(); i++) {
+    Search &s = searches[i];
+    s.trees[0] = *treeStart;
+    s.trees[1] = *treeEnd;
+    resetSearch(s, (i == 0) ? cc : workerCCs[i-1], &s.trees[0], &s.trees[1]);
+    s.seed = static_cast<unsigned int>(rand());
+    s.iterations = maxIterations+1;
+  }
+  std::atomic<int> winner(-1);
+  {
+    TaskPool::TaskGroup group(pool ? *pool : TaskPool::getDefault());
+    for (size_t i = 0; i < searches.size(); i++)
+      group.run(ConnectTask(*this, searches[i], static_cast<int>(i), start, maxIterations, winner, group));
+    group.wait();
+  }
+  if ( winner.load() < 0 )
+    return maxIterations+1;
+  Search &best = searches[winner.load()];
+  treeStart->swap(best.trees[0]);
+  treeEnd->swap(best.trees[1]);
+  return best.iterations;
+}
+
+template<typename NODE, size_t N>
+void GenericRRT<NODE, N>::releaseWorkers() {
+  for (size_t i = 0; i < workerCCs.size(); i++)
+    delete workerCCs[i];
+  workerCCs.clear();
+}
+
 // nearestNode
 template<typename NODE, size_t N>
-unsigned int GenericRRT<NODE, N>::nearestNode(std::vector<NODE> *tree, const NodeValue_t &target) {
+unsigned int GenericRRT<NODE, N>::nearestNode(Search &search, std::vector<NODE> *tree, const NodeValue_t &target) {
   // Root node's parent field contains the index of the first
   // matchable node for nearestNode.  This allows us to initialize the
   // end tree with special nodes that contribute to a path but can not
   // be matched directly.  Use in ShapeSpacePlannerXYTheta.
+  for (unsigned int i = 0; i < 2; i++)
+    if (tree == search.indexedTree[i])
+      return search.nearestIndex[i].nearest(*tree, target);
   unsigned int nearest = (*tree)[0].parent;  // index of first matchable node
   float dist = (*tree)[nearest].distance(target);
   for (unsigned int i = nearest+1; i < tree->size(); i++) {
@@ -290,13 +494,13 @@ unsigned int GenericRRT<NODE, N>::nearestNode(std::vector<NODE> *tree, const Nod
 
 // extend
 template<typename NODE, size_t N>
-RRTNodeBase::Interp_t GenericRRT<NODE, N>::extend(std::vector<NODE> *tree, const NodeValue_t &target,
+RRTNodeBase::Interp_t GenericRRT<NODE, N>::extend(Search &search, std::vector<NODE> *tree, const NodeValue_t &target,
 						  bool truncate, bool searchingBackwards) {
-  unsigned int nearest = nearestNode(tree, target);
+  unsigned int nearest = nearestNode(search, tree, target);
   NodeValue_t reached;
   // interpolate towards target
   RRTNodeBase::Interp_t result = 
-    NODE::interpolate((*tree)[nearest].q, target, extendingInterpolationStep, truncate, cc, reached, searchingBackwards);
+    NODE::interpolate((*tree)[nearest].q, target, extendingInterpolationStep, truncate, search.cc, reached, searchingBackwards);
   if ( result != RRTNodeBase::COLLISION ) {
     if ( predicate != NULL && predicate->admissible(reached, *tree, nearest) == false )
       result = RRTNodeBase::COLLISION;  // pretend inadmissible node causes a collision
@@ -333,29 +537,92 @@ void GenericRRT<NODE, N>::buildPath(const std::vector<NODE> *treeStart, const st
     path.push_back((*treeEnd)[n].q);
   }
 
-  // smooth path
+  smoothPath(path);
+}
+
+template<typename NODE, size_t N>
+void GenericRRT<NODE, N>::smoothPath(std::vector<NodeValue_t> &path) {
   size_t maxIter = max((size_t)20, 2*path.size());
 
-  for (size_t i = 0; i < maxIter; i++) {
-    int a = rand() % path.size();
-    int b = rand() % path.size();
-    if (a > b)
-      std::swap(a,b);
-    else if (a == b)
-      continue;
-
-    NodeValue_t dummy;
-    if ( NODE::interpolate(path[a], path[b], smoothingInterpolationStep, false, cc, dummy, true) == RRTNodeBase::REACHED ) {
-      path.erase(path.begin()+a+1,path.begin()+b);
+  if ( workerCCs.empty() ) {
+    for (size_t i = 0; i < maxIter; i++) {
+      int a = rand() % path.size();
+      int b = rand() % path.size();
+      if (a > b)
+        std::swap(a,b);
+      else if (a == b)
+        continue;
+
+      NodeValue_t dummy;
+      if ( NODE::interpolate(path[a], path[b], smoothingInterpolationStep, false, cc, dummy, true) == RRTNodeBase::REACHED ) {
+        path.erase(path.begin()+a+1,path.begin()+b);
+      }
+    }
+
+    for (size_t i = 0; i+2 < path.size(); i++) {
+      size_t j;
+      for (j = i + 2; j < path.size(); j++) {
+        NodeValue_t dummy;
+        if ( NODE::interpolate(path[i], path[j], smoothingInterpolationStep, false, cc, dummy, true) != RRTNodeBase::REACHED )
+          break;
+      }
+      if (j > i + 3 && j < path.size())
+        path.erase(path.begin()+i+1, path.begin()+j-1);
     }
+    return;
   }
 
+  // Same two passes, but testing a batch of shortcuts at once, one per collision checker
+  TaskPool &tp = pool ? *pool : TaskPool::getDefault();
+  std::vector<typename NODE::CollisionChecker*> ccs(1, cc);
+  ccs.insert(ccs.end(), workerCCs.begin(), workerCCs.end());
+  std::vector<std::pair<size_t,size_t> > candidates;
+  std::vector<char> reached;
+
+  // random shortcuts: keep the longest clear ones which don't overlap, and cut them from the back so indices stay valid
+  for (size_t i = 0; i < maxIter; i += ccs.size()) {
+    candidates.clear();
+    for (size_t k = 0; k < ccs.size() && i+k < maxIter; k++) {
+      size_t a = rand() % path.size();
+      size_t b = rand() % path.size();
+      if (a > b)
+        std::swap(a,b);
+      if (b > a+1)
+        candidates.push_back(std::make_pair(a,b));
+    }
+    std::sort(candidates.begin(), candidates.end(), ShortcutLonger());
+    reached.assign(candidates.size(), 0);
+    tp.parallel_for_range(0, candidates.size(), ShortcutTask(path, candidates, reached, ccs, smoothingInterpolationStep), 1);
+    std::vector<std::pair<size_t,size_t> > cuts;
+    for (size_t c = 0; c < candidates.size(); c++) {
+      if ( !reached[c] )
+        continue;
+      bool overlaps = false;
+      for (size_t k = 0; k < cuts.size() && !overlaps; k++)
+        overlaps = candidates[c].first < cuts[k].second && cuts[k].first < candidates[c].second;
+      if ( !overlaps )
+        cuts.push_back(candidates[c]);
+    }
+    std::sort(cuts.begin(), cuts.end());
+    for (size_t k = cuts.size(); k-- > 0; )
+      path.erase(path.begin()+cuts[k].first+1, path.begin()+cuts[k].second);
+  }
+
+  // systematic pass: find the first blocked shortcut from each point, testing a batch of endpoints at a time
   for (size_t i = 0; i+2 < path.size(); i++) {
-    size_t j;
-    for (j = i + 2; j < path.size(); j++) {
-      NodeValue_t dummy;
-      if ( NODE::interpolate(path[i], path[j], smoothingInterpolationStep, false, cc, dummy, true) != RRTNodeBase::REACHED )
-	break;
+    size_t j = i + 2;
+    while ( j < path.size() ) {
+      candidates.clear();
+      for (size_t k = j; k < path.size() && candidates.size() < ccs.size(); k++)
+        candidates.push_back(std::make_pair(i,k));
+      reached.assign(candidates.size(), 0);
+      tp.parallel_for_range(0, candidates.size(), ShortcutTask(path, candidates, reached, ccs, smoothingInterpolationStep), 1);
+      size_t c = 0;
+      while ( c < candidates.size() && reached[c] )
+        c++;
+      j += c;
+      if ( c < candidates.size() )
+        break;
     }
     if (j > i + 3 && j < path.size())
       path.erase(path.begin()+i+1, path.begin()+j-1);
@@ -0,0 +1,272 @@
+//-*-c++-*-
+#ifndef INCLUDED_RRTNearestIndex_h_
+#define INCLUDED_RRTNearestIndex_h_
+
+#include "Shared/Measures.h"
+#include <vector>
+#include <algorithm>
+#include <limits>
+
+//! An incrementally built k-d tree over the nodes of a GenericRRT search tree, to find the node nearest a sample without scanning the whole tree
+/*! The distance between node values is the weighted sum of squared differences of their
+ *  coordinates, as provided by the NODE type, which must define:
+ *  - <tt>static const size_t KeyDims</tt>, the number of coordinates
+ *  - <tt>static void getKey(const NodeValue_t &q, float key[])</tt>, which stores the coordinates of @a q
+ *  - <tt>static bool isKeyAngular(size_t i)</tt>, true if coordinate @a i is an angle in (-π,π],
+ *    so its differences wrap around like AngSignPi (the short way around, as a joint interpolates)
+ *
+ *  With the default weights of 1, this is the same metric as NODE::distance(), so nearest() gives
+ *  the same answer as a linear scan, including ties (the lowest index wins).
+ *
+ *  The index is kept in sync with the tree lazily: each call to nearest() first inserts any
+ *  nodes which were appended since the last call, so nodes added by subclasses or admissibility
+ *  predicates are found too.  Like GenericRRT's linear scan, nodes before the index stored in the
+ *  root's @c parent field are not matchable, and are skipped.  Nodes are inserted into the k-d
+ *  tree as they arrive, which usually keeps it reasonably balanced since RRT samples are random,
+ *  but the tree is rebuilt around medians if an insertion goes unusually deep. */
+template<typename NODE>
+class RRTNearestIndex {
+public:
+	typedef typename NODE::NodeValue_t NodeValue_t; //!< type of the values being indexed
+	static const size_t K=NODE::KeyDims; //!< the number of coordinates of each node value
+
+	//! constructor
+	RRTNearestIndex() : entries(), root(NONE), firstNode(0), weights(), angular(), useTree(true), maxDepth(0) { reset(std::vector<float>(), true); }
+
+	//! clears the index, and sets the weight of each coordinate (an empty vector means 1 for all) and whether to use the k-d tree or a linear scan
+	void reset(const std::vector<float>& w, bool tree) {
+		clear();
+		for(size_t i=0; i<K; i++) {
+			weights[i] = (i<w.size()) ? w[i] : 1;
+			angular[i] = NODE::isKeyAngular(i);
+		}
+		useTree=tree;
+	}
+
+	//! removes all nodes from the index
+	void clear() { entries.clear(); root=NONE; firstNode=0; maxDepth=0; }
+
+	//! returns the number of nodes in the index
+	size_t size() const { return entries.size(); }
+
+	//! returns the index of the node in @a tree nearest @a target, after indexing any new nodes of @a tree
+	unsigned int nearest(const std::vector<NODE>& tree, const NodeValue_t& target);
+
+protected:
+	static const unsigned int NONE=-1U; //!< marks a missing child
+	static const size_t KS=(K==0)?1:K; //!< array size for coordinates, to avoid zero-sized arrays
+
+	//! a node of the tree, and its position in the k-d tree
+	struct Entry {
+		float key[KS]; //!< the coordinates of the node
+		unsigned int node; //!< the index of the node in the RRT tree
+		unsigned int child[2]; //!< entries with key[dim] less than this one's, and greater or equal
+		unsigned int dim; //!< the coordinate this entry splits on
+	};
+
+	//! holds the state of a query, the bounds of the current k-d tree cell are adjusted as the search descends
+	struct Query {
+		float target[KS]; //!< the coordinates of the target
+		float lo[KS]; //!< lower bound of the current cell
+		float hi[KS]; //!< upper bound of the current cell
+		float best; //!< the distance to #bestNode
+		unsigned int bestNode; //!< the nearest node found so far
+	};
+
+	//! returns the difference of @a b from @a a along coordinate @a i (wrapping angles into (-π,π])
+	float delta(size_t i, float a, float b) const {
+		const float d=a-b;
+		if(!angular[i])
+			return d;
+		// keys are normalized, so at most one turn is needed (written as selects, which don't branch)
+		return d + ((d>Pi) ? -TwoPi : 0) + ((d<=-Pi) ? TwoPi : 0);
+	}
+
+	//! returns the weighted squared distance between two sets of coordinates
+	float distance(const float a[], const float b[]) const {
+		float sum=0;
+		for(size_t i=0; i<K; i++) {
+			const float d=delta(i,a[i],b[i]);
+			sum+=weights[i]*(d*d);
+		}
+		return sum;
+	}
+
+	//! returns the weighted squared distance along coordinate @a i from @a t to the interval [lo,hi]
+	float cellDistance(size_t i, float t, float lo, float hi) const {
+		float d;
+		if(t>=lo && t<=hi)
+			return 0;
+		if(angular[i])
+			d=std::min(std::abs(delta(i,t,lo)),std::abs(delta(i,t,hi)));
+		else
+			d=(t<lo) ? lo-t : t-hi;
+		return weights[i]*(d*d);
+	}
+
+	void insert(unsigned int e); //!< links entry @a e into the k-d tree
+	void rebuild(); //!< rebuilds the k-d tree around medians
+	unsigned int build(std::vector<unsigned int>& order, size_t begin, size_t end); //!< builds a balanced subtree of the entries in @a order, returning its root
+	void search(unsigned int e, float bound, Query& q) const; //!< searches the subtree at entry @a e, whose cell is at least @a bound from the target
+
+	std::vector<Entry> entries; //!< the indexed nodes, in order of their index in the tree (starting from #firstNode)
+	unsigned int root; //!< the entry at the root of the k-d tree
+	unsigned int firstNode; //!< the first matchable node of the tree, from the root's @c parent field
+	float weights[KS]; //!< the weight of each coordinate
+	bool angular[KS]; //!< whether each coordinate is an angle
+	bool useTree; //!< if false, nearest() scans all the entries
+	unsigned int maxDepth; //!< an insertion deeper than this triggers rebuild()
+};
+
+template<typename NODE>
+unsigned int RRTNearestIndex<NODE>::nearest(const std::vector<NODE>& tree, const NodeValue_t& target) {
+	const unsigned int first=tree[0].parent;
+	if(first!=firstNode || tree.size()<firstNode+entries.size()) {
+		clear();
+		firstNode=first;
+	}
+	while(firstNode+entries.size()<tree.size()) {
+		entries.push_back(Entry());
+		Entry& ent=entries.back();
+		ent.node=firstNode+entries.size()-1;
+		NODE::getKey(tree[ent.node].q,ent.key);
+		ent.child[0]=ent.child[1]=NONE;
+		ent.dim=0;
+		if(useTree)
+			insert(entries.size()-1);
+	}
+
+	Query q;
+	NODE::getKey(target,q.target);
+	q.best=std::numeric_limits<float>::infinity();
+	q.bestNode=firstNode;
+	if(!useTree || entries.size()<128) {
+		for(size_t e=0; e<entries.size(); e++) {
+			const float d=distance(entries[e].key,q.target);
+			if(d<q.best) {
+				q.best=d;
+				q.bestNode=entries[e].node;
+			}
+		}
+		return q.bestNode;
+	}
+	for(size_t i=0; i<K; i++) {
+		q.lo[i]=angular[i] ? -Pi : -std::numeric_limits<float>::infinity();
+		q.hi[i]=angular[i] ? Pi : std::numeric_limits<float>::infinity();
+	}
+	search(root,0,q);
+	return q.bestNode;
+}
+
+template<typename NODE>
+void RRTNearestIndex<NODE>::insert(unsigned int e) {
+	if(root==NONE) {
+		root=e;
+		return;
+	}
+	Entry& ent=entries[e];
+	unsigned int cur=root, depth=1;
+	while(true) {
+		Entry& parent=entries[cur];
+		unsigned int& next=parent.child[ent.key[parent.dim]<parent.key[parent.dim] ? 0 : 1];
+		depth++;
+		if(next==NONE) {
+			next=e;
+			ent.dim=(parent.dim+1)%KS;
+			break;
+		}
+		cur=next;
+	}
+	if(depth>maxDepth) {
+		// allow roughly twice the depth of a balanced tree before rebuilding
+		unsigned int lg=0;
+		while((2u<<lg)<=entries.size())
+			lg++;
+		maxDepth=2*lg+8;
+		if(depth>maxDepth)
+			rebuild();
+	}
+}
+
+template<typename NODE>
+void RRTNearestIndex<NODE>::rebuild() {
+	std::vector<unsigned int> order(entries.size());
+	for(size_t e=0; e<entries.size(); e++)
+		order[e]=e;
+	root=build(order,0,order.size());
+}
+
+//! orders entries by one coordinate, for RRTNearestIndex::build()
+template<typename ENTRY>
+struct RRTNearestIndexKeyLess {
+	//! constructor
+	RRTNearestIndexKeyLess(const std::vector<ENTRY>& e, unsigned int d) : entries(e), dim(d) {}
+	//! compares entries @a a and @a b by coordinate #dim
+	bool operator()(unsigned int a, unsigned int b) const { return entries[a].key[dim]<entries[b].key[dim]; }
+	const std::vector<ENTRY>& entries; //!< the entries being sorted
+	unsigned int dim; //!< the coordinate to compare
+};
+
+template<typename NODE>
+unsigned int RRTNearestIndex<NODE>::build(std::vector<unsigned int>& order, size_t begin, size_t end) {
+	if(begin==end)
+		return NONE;
+	// split on the coordinate with the widest (weighted) spread
+	unsigned int dim=0;
+	float spread=-1;
+	for(size_t i=0; i<K; i++) {
+		float lo=entries[order[begin]].key[i], hi=lo;
+		for(size_t j=begin+1; j<end; j++) {
+			lo=std::min(lo,entries[order[j]].key[i]);
+			hi=std::max(hi,entries[order[j]].key[i]);
+		}
+		if((hi-lo)*(hi-lo)*weights[i]>spread) {
+			spread=(hi-lo)*(hi-lo)*weights[i];
+			dim=i;
+		}
+	}
+	const size_t mid=(begin+end)/2;
+	std::nth_element(order.begin()+begin, order.begin()+mid, order.begin()+end, RRTNearestIndexKeyLess<Entry>(entries,dim));
+	Entry& ent=entries[order[mid]];
+	ent.dim=dim;
+	// entries before the median have keys <= the split and after it >=, which is all search() relies on
+	ent.child[0]=build(order,begin,mid);
+	ent.child[1]=build(order,mid+1,end);
+	return order[mid];
+}
+
+template<typename NODE>
+void RRTNearestIndex<NODE>::search(unsigned int e, float bound, Query& q) const {
+	if(e==NONE || bound>q.best)
+		return;
+	const Entry& ent=entries[e];
+	const float d=distance(ent.key,q.target);
+	if(d<q.best || (d==q.best && ent.node<q.bestNode)) {
+		q.best=d;
+		q.bestNode=ent.node;
+	}
+	const unsigned int dim=ent.dim;
+	const float split=ent.key[dim];
+	const float t=q.target[dim];
+	const float lo=q.lo[dim], hi=q.hi[dim];
+	const float cur=cellDistance(dim,t,lo,hi);
+	const unsigned int nearSide=(t<split) ? 0 : 1;
+	for(unsigned int side=0; side<2; side++) {
+		const unsigned int s=(side==0) ? nearSide : 1-nearSide;
+		if(ent.child[s]==NONE)
+			continue;
+		if(s==0)
+			q.hi[dim]=split;
+		else
+			q.lo[dim]=split;
+		search(ent.child[s], bound-cur+cellDistance(dim,t,q.lo[dim],q.hi[dim]), q);
+		q.lo[dim]=lo;
+		q.hi[dim]=hi;
+	}
+}
+
+/*! @file
+ * @brief Describes RRTNearestIndex, an incremental k-d tree for finding the nearest node of a GenericRRT search tree
+ */
+
+#endif
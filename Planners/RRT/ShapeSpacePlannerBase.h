@@ -8,6 +8,8 @@
 #include "DualCoding/DualCoding.h"
 #include "DualCoding/ShapeCylinder.h"
 #include "GenericRRT.h"
+#include <algorithm>
+#include <cmath>
 
 //================ ShapeSpaceCollisionCheckerBase ================
 
@@ -36,11 +38,40 @@ protected:
   
   void addDisplayRobotObstacles(const KinematicJoint &j);
   
+  //! Returns a copy of the chain of joints from cloneBranch() which starts at @a first, or NULL if @a first is NULL; the copy is freed by deleting its getRoot()
+  static KinematicJoint* cloneChain(const KinematicJoint *first);
+  
+  //! Constructor for subclasses which fill in #obstacles themselves, nothing is taken from a ShapeSpace or the robot's kinematics
+  ShapeSpaceCollisionCheckerBase(const Shape<PolygonData> &_worldBounds, float _inflation);
+  
+  //! Returns the indices of the obstacles whose bounding boxes overlap @a box, in increasing order
+  /*! This is the broad phase of collision checking: subclasses only need to run the narrow
+   *  phase (PlannerObstacle::collides) on the returned obstacles.  The obstacles are sorted
+   *  into a uniform grid over x and y by their bounding boxes, which is built on the first call
+   *  and rebuilt whenever the number of obstacles changes (call rebuildBroadPhase() if obstacles
+   *  are moved or replaced in place).  Obstacles without a finite bounding box (e.g. cylinders
+   *  and ellipsoids, whose getBoundingBox() is empty) are always returned.  Overlap is tested
+   *  inclusively, so obstacles which only touch @a box are kept.  The returned vector is reused
+   *  by the next call. */
+  const std::vector<unsigned int>& findCandidates(const BoundingBox<N>& box) const;
+  
 public:
+  //! Counts of the work done by findCandidates(), see getBroadPhaseStats()
+  struct BroadPhaseStats {
+    BroadPhaseStats() : queries(0), candidates(0), rejected(0) {}
+    unsigned long queries; //!< number of calls to findCandidates()
+    unsigned long candidates; //!< number of obstacles passed on to the narrow phase
+    unsigned long rejected; //!< number of obstacles skipped because their bounding boxes didn't overlap the query
+  };
+  
+
   ShapeSpaceCollisionCheckerBase(ShapeSpace &shs,
                                  const Shape<PolygonData> &_worldBounds,
                                  float _inflation);
   
+  //! Copy constructor, copies the obstacles so the copy can check collisions on another thread (see GenericRRT::setParallelPlanners())
+  ShapeSpaceCollisionCheckerBase(const ShapeSpaceCollisionCheckerBase &other);
+  
   virtual ~ShapeSpaceCollisionCheckerBase();
   
   const Shape<PolygonData> getWorldBounds() const { return worldBounds; }
@@ -50,8 +81,146 @@ public:
   
   //! Debugging tool to make obstacles visible
   void addObstaclesToShapeSpace(DualCoding::ShapeSpace & shs, const fmat::Transform &t=fmat::Transform());
+  
+  //! Returns the broad phase statistics accumulated since construction or resetBroadPhaseStats()
+  const BroadPhaseStats& getBroadPhaseStats() const { return broadPhaseStats; }
+  //! Zeros the broad phase statistics
+  void resetBroadPhaseStats() { broadPhaseStats = BroadPhaseStats(); }
+  //! Discards the obstacle grid, so it is rebuilt on the next collision check
+  void rebuildBroadPhase() { indexedObstacles = -1U; }
+  
+private:
+  static const size_t MAX_GRID_CELLS = 1<<12; //!< limits the size of #obstacleGrid
+  
+  //! returns true if @a bb has a finite extent in x and y
+  static bool isBounded(const BoundingBox<N>& bb) {
+    return std::isfinite(bb.min[0]) && std::isfinite(bb.min[1]) && std::isfinite(bb.max[0]) && std::isfinite(bb.max[1])
+      && bb.min[0]<=bb.max[0] && bb.min[1]<=bb.max[1];
+  }
+  
+  //! returns true if @a a and @a b overlap or touch in every dimension
+  static bool boxesOverlap(const BoundingBox<N>& a, const BoundingBox<N>& b) {
+    for (size_t d = 0; d < N; d++)
+      if (a.min[d] > b.max[d] || b.min[d] > a.max[d])
+        return false;
+    return true;
+  }
+  
+  //! sorts the obstacles into #obstacleGrid
+  void buildBroadPhase() const;
+  
+  mutable std::vector< std::vector<unsigned int> > obstacleGrid; //!< for each cell (row-major from #gridMin), the indices of the obstacles whose bounding box overlaps the cell
+  mutable std::vector<unsigned int> unindexed; //!< indices of obstacles without a finite bounding box, which are candidates for every query
+  mutable std::vector< BoundingBox<N> > obstacleBoxes; //!< the bounding box of each obstacle when the grid was built
+  mutable std::vector<unsigned int> obstacleStamps; //!< for each obstacle, the value of #queryStamp when it was last seen, to skip obstacles spanning several cells
+  mutable std::vector<unsigned int> candidateList; //!< the result of findCandidates()
+  mutable unsigned int queryStamp; //!< incremented by each call to findCandidates()
+  mutable fmat::Column<2> gridMin; //!< the minimum corner of the grid
+  mutable size_t gridCols; //!< the number of cells along x
+  mutable size_t gridRows; //!< the number of cells along y
+  mutable float gridCell; //!< the size of each cell
+  mutable unsigned int indexedObstacles; //!< the size of #obstacles when the grid was built, -1U if it needs to be built
+  mutable BroadPhaseStats broadPhaseStats; //!< counts calls to findCandidates() and their results
+  
+  ShapeSpaceCollisionCheckerBase& operator=(const ShapeSpaceCollisionCheckerBase&); //!< don't call
 };
 
+template <size_t N>
+void ShapeSpaceCollisionCheckerBase<N>::buildBroadPhase() const {
+  obstacleGrid.clear();
+  unindexed.clear();
+  gridCols = gridRows = 0;
+  obstacleBoxes.resize(obstacles.size());
+  obstacleStamps.assign(obstacles.size(), 0);
+  queryStamp = 0;
+  
+  // size the cells like the average obstacle, so most obstacles land in a few cells
+  BoundingBox2D bounds;
+  float sumSize = 0;
+  unsigned int numBounded = 0;
+  for (unsigned int i = 0; i < obstacles.size(); i++) {
+    obstacleBoxes[i] = obstacles[i]->getBoundingBox();
+    if (isBounded(obstacleBoxes[i])) {
+      bounds.expand(BoundingBox2D(obstacleBoxes[i]));
+      sumSize += std::max(obstacleBoxes[i].getDimension(0), obstacleBoxes[i].getDimension(1));
+      numBounded++;
+    }
+  }
+  if (numBounded > 0) {
+    const fmat::Column<2> dim = bounds.getDimensions();
+    gridCell = std::max(sumSize/numBounded, std::max(dim[0],dim[1])*1e-3f);
+    if (!(gridCell > 0))
+      gridCell = 1;
+    while ((dim[0]/gridCell+1)*(dim[1]/gridCell+1) > MAX_GRID_CELLS)
+      gridCell *= 2;
+    gridMin = bounds.min;
+    gridCols = static_cast<size_t>(dim[0]/gridCell)+1;
+    gridRows = static_cast<size_t>(dim[1]/gridCell)+1;
+    obstacleGrid.resize(gridCols*gridRows);
+  }
+  for (unsigned int i = 0; i < obstacles.size(); i++) {
+    const BoundingBox<N>& bb = obstacleBoxes[i];
+    if (!isBounded(bb)) {
+      unindexed.push_back(i);
+      continue;
+    }
+    const size_t c0 = static_cast<size_t>((bb.min[0]-gridMin[0])/gridCell);
+    const size_t r0 = static_cast<size_t>((bb.min[1]-gridMin[1])/gridCell);
+    const size_t c1 = std::min(static_cast<size_t>((bb.max[0]-gridMin[0])/gridCell), gridCols-1);
+    const size_t r1 = std::min(static_cast<size_t>((bb.max[1]-gridMin[1])/gridCell), gridRows-1);
+    for (size_t r = r0; r <= r1; r++)
+      for (size_t c = c0; c <= c1; c++)
+        obstacleGrid[r*gridCols+c].push_back(i);
+  }
+  indexedObstacles = obstacles.size();
+}
+
+template <size_t N>
+const std::vector<unsigned int>& ShapeSpaceCollisionCheckerBase<N>::findCandidates(const BoundingBox<N>& box) const {
+  if (indexedObstacles != obstacles.size())
+    buildBroadPhase();
+  broadPhaseStats.queries++;
+  candidateList.clear();
+  if (!isBounded(box)) {
+    // can't locate the query in the grid, so everything is a candidate
+    for (unsigned int i = 0; i < obstacles.size(); i++)
+      candidateList.push_back(i);
+    broadPhaseStats.candidates += candidateList.size();
+    return candidateList;
+  }
+  candidateList = unindexed;
+  if (gridCols > 0) {
+    const float x0 = (box.min[0]-gridMin[0])/gridCell, y0 = (box.min[1]-gridMin[1])/gridCell;
+    const float x1 = (box.max[0]-gridMin[0])/gridCell, y1 = (box.max[1]-gridMin[1])/gridCell;
+    if (x1 >= 0 && y1 >= 0 && x0 < gridCols && y0 < gridRows) {
+      if (++queryStamp == 0) { // wrapped around, old stamps could match again
+        std::fill(obstacleStamps.begin(), obstacleStamps.end(), 0);
+        queryStamp = 1;
+      }
+      const size_t c0 = static_cast<size_t>(std::max(x0,0.f)), r0 = static_cast<size_t>(std::max(y0,0.f));
+      const size_t c1 = static_cast<size_t>(std::min(x1,float(gridCols-1))), r1 = static_cast<size_t>(std::min(y1,float(gridRows-1)));
+      for (size_t r = r0; r <= r1; r++) {
+        for (size_t c = c0; c <= c1; c++) {
+          const std::vector<unsigned int>& cell = obstacleGrid[r*gridCols+c];
+          for (size_t k = 0; k < cell.size(); k++) {
+            const unsigned int i = cell[k];
+            if (obstacleStamps[i] == queryStamp)
+              continue;
+            obstacleStamps[i] = queryStamp;
+            if (boxesOverlap(obstacleBoxes[i], box))
+              candidateList.push_back(i);
+          }
+        }
+      }
+      // keep the order of the obstacle list, so the first collision found doesn't depend on the grid
+      std::sort(candidateList.begin(), candidateList.end());
+    }
+  }
+  broadPhaseStats.candidates += candidateList.size();
+  broadPhaseStats.rejected += obstacles.size() - candidateList.size();
+  return candidateList;
+}
+
 template <size_t N>
 BoundingBox<N> ShapeSpaceCollisionCheckerBase<N>::getObstacleBoundingBox() const {
   if (obstacles.empty()) return BoundingBox<N>();
@@ -83,7 +252,9 @@ ShapeSpaceCollisionCheckerBase<N>::ShapeSpaceCollisionCheckerBase(ShapeSpace &sh
                                                                   const Shape<PolygonData> &_worldBounds,
                                                                   float _inflation) :
 	worldBounds(_worldBounds), inflation(_inflation), obstacles(),
-	displayWorldObstacles(), displayRobotObstacles() {
+	displayWorldObstacles(), displayRobotObstacles(),
+	obstacleGrid(), unindexed(), obstacleBoxes(), obstacleStamps(), candidateList(), queryStamp(0),
+	gridMin(), gridCols(0), gridRows(0), gridCell(0), indexedObstacles(-1U), broadPhaseStats() {
   SHAPEROOTVEC_ITERATE(shs, s) {
     if ( s->getId() != DualCoding::VRmixin::theAgent->getId() && s->isObstacle() )
       PlannerObstacle<N>::convertShapeToPlannerObstacle(s, inflation, obstacles);
@@ -95,6 +266,49 @@ ShapeSpaceCollisionCheckerBase<N>::ShapeSpaceCollisionCheckerBase(ShapeSpace &sh
   DualCoding::Point location = VRmixin::theAgent->getCentroid();
 }
 
+template <size_t N>
+ShapeSpaceCollisionCheckerBase<N>::ShapeSpaceCollisionCheckerBase(const Shape<PolygonData> &_worldBounds, float _inflation) :
+	worldBounds(_worldBounds), inflation(_inflation), obstacles(),
+	displayWorldObstacles(), displayRobotObstacles(),
+	obstacleGrid(), unindexed(), obstacleBoxes(), obstacleStamps(), candidateList(), queryStamp(0),
+	gridMin(), gridCols(0), gridRows(0), gridCell(0), indexedObstacles(-1U), broadPhaseStats() {}
+
+template <size_t N>
+ShapeSpaceCollisionCheckerBase<N>::ShapeSpaceCollisionCheckerBase(const ShapeSpaceCollisionCheckerBase &other) :
+	worldBounds(other.worldBounds), inflation(other.inflation), obstacles(),
+	displayWorldObstacles(), displayRobotObstacles(),
+	obstacleGrid(), unindexed(), obstacleBoxes(), obstacleStamps(), candidateList(), queryStamp(0),
+	gridMin(), gridCols(0), gridRows(0), gridCell(0), indexedObstacles(-1U), broadPhaseStats() {
+  for (unsigned int i = 0; i < other.obstacles.size(); i++)
+    obstacles.push_back(dynamic_cast<PlannerObstacle<N>*>(other.obstacles[i]->clone()));
+  // displayWorldObstacles[] points into obstacles[], so point at the corresponding copies
+  for (unsigned int i = 0; i < other.displayWorldObstacles.size(); i++) {
+    const typename std::vector<PlannerObstacle<N>*>::const_iterator it =
+      std::find(other.obstacles.begin(), other.obstacles.end(), other.displayWorldObstacles[i]);
+    if (it != other.obstacles.end())
+      displayWorldObstacles.push_back(obstacles[it-other.obstacles.begin()]);
+  }
+  for (unsigned int i = 0; i < other.displayRobotObstacles.size(); i++)
+    displayRobotObstacles.push_back(dynamic_cast<PlannerObstacle<N>*>(other.displayRobotObstacles[i]->clone()));
+}
+
+template <size_t N>
+KinematicJoint* ShapeSpaceCollisionCheckerBase<N>::cloneChain(const KinematicJoint *first) {
+  if (first == NULL)
+    return NULL;
+  // cloneBranch() copies from the leaf up to the root, so find the leaf, and then climb back to the copy of first
+  unsigned int depth = 0;
+  const KinematicJoint *leaf = first;
+  while (!leaf->getBranches().empty()) {
+    leaf = *leaf->getBranches().begin();
+    depth++;
+  }
+  KinematicJoint *copy = leaf->cloneBranch();
+  for (unsigned int i = 0; i < depth; i++)
+    copy = copy->getParent();
+  return copy;
+}
+
 template <size_t N>
 ShapeSpaceCollisionCheckerBase<N>::~ShapeSpaceCollisionCheckerBase() {
   for (unsigned int i = 0; i < obstacles.size(); i++)
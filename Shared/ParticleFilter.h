@@ -6,6 +6,11 @@
 #include <iostream>
 #include <cfloat>
 #include <cmath>
+#ifndef PLATFORM_APERIOS
+#  include "IPC/TaskPool.h"
+#else
+class TaskPool;
+#endif
 
 //! Provides a common base class for particles used by the ParticleFilter
 /*! Each particle represents a hypothesis regarding a position in state space.
@@ -202,6 +207,19 @@ class ParticleFilter {
      *  sensors and particle evaluation, the smaller the jiggle variance can be. */
     virtual void jiggle(float var, particle_type* begin, index_t num)=0;// { particle_type* end=begin+num; while(begin!=end) (begin++)->jiggle(var); }
   };
+
+  //! A binning policy divides the state space into a histogram, so LowVarianceResamplingPolicy can adapt the number of particles to how spread out they are (KLD-sampling)
+  /*! The bins should be about the size of the precision you want from the filter: too small and the
+   *  particle count stays high even when the filter has converged, too large and a broad cluster
+   *  looks converged. */
+  class BinningPolicy {
+  public:
+    typedef ParticleT particle_type; //!< redefinition here allows reference to the particle type even if the template parameter may be abstracted away due to a typedef
+    virtual ~BinningPolicy() {} //!< destructor
+		
+    //! returns a key identifying the bin containing @a p; particles in the same bin must get the same key, and particles in different bins should rarely share one
+    virtual size_t bin(const particle_type& p) const=0;
+  };
 	
   //! The resampling policy focuses the particle filter on those particles which are performing well, and dropping those which are poorly rated
   /*! Resampling should replicate particles proportionally to how well their weights compare
@@ -278,16 +296,48 @@ class ParticleFilter {
    *
    *  This policy can interpret weights in either "log space" or "linear space".  It defaults to "log space",
    *  but if your sensor model is providing linear weights, set #logWeights to false.
+   *
+   *  If #maxParticles is non-zero and a #binning policy is installed (see setBinningPolicy()), the
+   *  number of particles adapts on each resampling by KLD-sampling (Fox, "Adapting the Sample
+   *  Size in Particle Filters Through KLD-Sampling", 2003): the resampled particles are sorted
+   *  into the histogram bins of the binning policy, and enough particles are kept so that, with
+   *  probability 1-δ, the distance (Kullback-Leibler divergence) between the particles and the
+   *  true distribution stays below #kldError.  Fox's algorithm counts the occupied bins as it
+   *  draws each sample; since selection here is systematic, the bins are counted over a
+   *  resampling of the current size, and the result sets the size of the new set of particles.
+   *  A concentrated filter shrinks toward #minParticles, a lost one grows toward #maxParticles.
+   *
+   *  If #pool is set, the cumulative weights are computed as a parallel prefix sum, and the
+   *  selected particles are copied in parallel, once there are at least #MIN_PARALLEL particles
+   *  (below that, handing the blocks to the pool costs more than it saves, so the resampling
+   *  stays on the calling thread).  The sums are taken over blocks of a fixed size
+   *  whether or not there is a pool, so the particles selected only depend on the seed of rand(),
+   *  not on the number of threads.  Jiggling and redistribution still run on the calling thread,
+   *  so they draw their random numbers in the same order.
    */
   class LowVarianceResamplingPolicy : public ResamplingPolicy {
   public:
     //! constructor
     LowVarianceResamplingPolicy()
       : varianceScale(-2), maxRedistribute(1/2.f), minAcceptableWeight(-30),
-      logWeights(true), resampleDelay(0), newParticles(), resampleCount(0)
+      logWeights(true), resampleDelay(0), pool(NULL), minParticles(0), maxParticles(0), kldError(0.05f), kldQuantile(2.326f),
+      newParticles(), resampleCount(0), weights(), blockTotals(), binning(NULL), binKeys(), numBins(0)
       {}
+      //! destructor
+      virtual ~LowVarianceResamplingPolicy() { delete binning; }
       virtual void resample(particle_collection& particles);
 		
+      //! replaces #binning, taking responsibility for deallocating it; NULL keeps the number of particles fixed
+      virtual void setBinningPolicy(BinningPolicy* b) { delete binning; binning=b; }
+      //! returns the current binning policy (#binning), may be NULL
+      virtual BinningPolicy* getBinningPolicy() const { return binning; }
+      //! returns true if the number of particles adapts on each resampling (see class notes)
+      bool isAdaptive() const { return binning!=NULL && maxParticles>0; }
+      //! returns the number of histogram bins occupied by the last adaptive resampling
+      unsigned int getNumOccupiedBins() const { return numBins; }
+      //! returns the number of particles KLD-sampling calls for when they occupy @a k bins, limited to [#minParticles,#maxParticles], and never fewer than 1
+      unsigned int kldParticles(unsigned int k) const;
+		
       //! returns true if the next call to resample will trigger a "real" resampling (is #resampleCount greater than #resampleDelay?)
       bool nextResampleIsFull() { return resampleCount>=resampleDelay; }
 		
@@ -307,9 +357,118 @@ class ParticleFilter {
       bool logWeights;
       //! This indicates how many resampling attempts should be skipped before actually doing it.  See class notes for rationale.
       unsigned int resampleDelay;
+      //! If non-NULL, resampling is split across the threads of this pool (see class notes)
+      TaskPool * pool;
+      //! The fewest particles an adaptive resampling will keep
+      unsigned int minParticles;
+      //! The most particles an adaptive resampling will create; if 0, the number of particles is fixed (see class notes)
+      unsigned int maxParticles;
+      //! The bound on the error (KL divergence) of the particles' distribution for adaptive resampling; smaller values call for more particles
+      float kldError;
+      //! The upper 1-δ quantile of the standard normal distribution, where δ is the chance of exceeding #kldError (2.326 is 1%)
+      float kldQuantile;
   protected:
+      //! number of particles in each block of the cumulative weights; fixed so the rounding of the sums doesn't depend on the number of threads
+      static const size_t BLOCK_SIZE=512;
+      //! the fewest particles for which resampling is split across #pool
+      static const size_t MIN_PARALLEL=16*BLOCK_SIZE;
+
+      //! computes the cumulative weights within each of a range of blocks, and each block's total, for TaskPool::parallel_for_range()
+      struct BlockWeights {
+	//! constructor
+	BlockWeights(const particle_collection& p, float best, bool logW, std::vector<float>& w, std::vector<float>& totals)
+	  : particles(p), bestWeight(best), logWeights(logW), weights(w), blockTotals(totals) {}
+	//! processes blocks [@a begin,@a end)
+	void operator()(size_t begin, size_t end) const {
+	  for(size_t b=begin; b<end; ++b) {
+	    const size_t last=std::min((b+1)*BLOCK_SIZE,particles.size());
+	    float sum=0;
+	    for(size_t i=b*BLOCK_SIZE; i<last; ++i) {
+	      sum += logWeights ? std::exp(particles[i].weight-bestWeight) : particles[i].weight/bestWeight;
+	      weights[i]=sum;
+	    }
+	    blockTotals[b]=sum;
+	  }
+	}
+	const particle_collection& particles; //!< the particles being resampled
+	float bestWeight; //!< the highest weight of the particles, weights are scaled relative to it
+	bool logWeights; //!< copy of LowVarianceResamplingPolicy::logWeights
+	std::vector<float>& weights; //!< the cumulative weights being computed
+	std::vector<float>& blockTotals; //!< the sum of the weights in each block
+      private:
+	BlockWeights& operator=(const BlockWeights&); //!< don't call
+      };
+
+      //! adds the total weight of the preceding blocks to the cumulative weights of a range of blocks, for TaskPool::parallel_for_range()
+      struct AddOffsets {
+	//! constructor
+	AddOffsets(std::vector<float>& w, const std::vector<float>& offsets) : weights(w), blockOffsets(offsets) {}
+	//! processes blocks [@a begin,@a end)
+	void operator()(size_t begin, size_t end) const {
+	  for(size_t b=begin; b<end; ++b) {
+	    const size_t last=std::min((b+1)*BLOCK_SIZE,weights.size());
+	    for(size_t i=b*BLOCK_SIZE; i<last; ++i)
+	      weights[i]+=blockOffsets[b];
+	  }
+	}
+	std::vector<float>& weights; //!< the cumulative weights
+	const std::vector<float>& blockOffsets; //!< the total weight before each block
+      private:
+	AddOffsets& operator=(const AddOffsets&); //!< don't call
+      };
+
+      //! copies the particles selected by systematic resampling for a range of the new particles, for TaskPool::parallel_for_range()
+      struct CopySelected {
+	//! constructor
+	CopySelected(const particle_collection& p, const std::vector<float>& w, float off, float step, particle_collection& np)
+	  : particles(p), weights(w), offset(off), r(step), newParticles(np) {}
+	//! fills new particles [@a begin,@a end)
+	void operator()(size_t begin, size_t end) const {
+	  // find where this range starts, then step through the cumulative weights as usual
+	  const size_t last=weights.size()-1;
+	  size_t pos = std::upper_bound(weights.begin(), weights.end(), offset+r*begin) - weights.begin();
+	  for (size_t i=begin; i < end; i++){
+	    float target = offset+r*i; // multiply instead of repeatedly adding to avoid rounding issues
+	    while (pos < last && target >= weights[pos])
+	      pos++;
+	    // copy over particle (we'll "jiggle" it later if desired)
+	    newParticles[i]=particles[std::min(pos,last)];
+	  }
+	}
+	const particle_collection& particles; //!< the particles being resampled
+	const std::vector<float>& weights; //!< cumulative weights of #particles
+	float offset; //!< the random offset of the first selection
+	float r; //!< the spacing of the selections
+	particle_collection& newParticles; //!< receives the selected particles
+      private:
+	CopySelected& operator=(const CopySelected&); //!< don't call
+      };
+
+      //! fills #weights with the cumulative weights of @a particles (relative to @a bestWeight), returns false if they total zero
+      bool computeWeights(const particle_collection& particles, float bestWeight);
+
+      //! calls @a f over [0,@a n), split up on #pool if it's set and @a numParticles is at least #MIN_PARALLEL
+      template<class F> void runRange(size_t n, const F& f, size_t grain, size_t numParticles) {
+#ifndef PLATFORM_APERIOS
+	if(pool!=NULL && numParticles>=MIN_PARALLEL) {
+	  pool->parallel_for_range(0,n,f,grain);
+	  return;
+	}
+#endif
+	f(0,n);
+      }
+
       particle_collection newParticles; //!< temporary scratch space as particles are created
       unsigned int resampleCount; //!< the number of resampling attempts which have occurred.
+      std::vector<float> weights; //!< scratch space for the cumulative weights of the particles
+      std::vector<float> blockTotals; //!< scratch space for the sum of the weights within each block of #weights
+      BinningPolicy * binning; //!< divides the state space into bins for adaptive resampling, NULL if the number of particles is fixed
+      std::vector<size_t> binKeys; //!< scratch space for the bins of the particles an adaptive resampling would select
+      unsigned int numBins; //!< the number of bins occupied at the last adaptive resampling
+
+  private:
+      LowVarianceResamplingPolicy(const LowVarianceResamplingPolicy&); //!< don't call (copy constructor)
+      LowVarianceResamplingPolicy& operator=(const LowVarianceResamplingPolicy&); //!< don't call (assignment operator)
   };
 	
 	
@@ -362,6 +521,37 @@ class ParticleFilter {
 	std::cout << "Warning: setMaxRedistribute found getResamplingPolicy() returns wrong type policy; maxRedistribute not set." << std::endl;
     }
 	
+    //! If getResamplingPolicy() returns a LowVarianceResamplingPolicy instance, this will set LowVarianceResamplingPolicy::pool; otherwise will display a warning
+    virtual void setTaskPool(TaskPool* pool) {
+      LowVarianceResamplingPolicy* p = dynamic_cast<LowVarianceResamplingPolicy*>(getResamplingPolicy());
+      if ( p )
+	p->pool = pool;
+      else
+	std::cout << "Warning: setTaskPool found getResamplingPolicy() returns wrong type policy; pool not set." << std::endl;
+    }
+	
+    //! If getResamplingPolicy() returns a LowVarianceResamplingPolicy instance, this will adapt the number of particles between @a minParticles and @a maxParticles on each resampling, based on the bins of @a binning; otherwise will display a warning
+    /*! Takes responsibility for deallocating @a binning.  Pass a @a maxParticles of 0 (or a NULL
+     *  @a binning) to keep the number of particles fixed.  A @a minParticles of 0 is raised to 1, and
+     *  one above @a maxParticles is lowered to it.  See LowVarianceResamplingPolicy. */
+    virtual void setAdaptiveParticles(unsigned int minParticles, unsigned int maxParticles, BinningPolicy* binning) {
+      LowVarianceResamplingPolicy* p = dynamic_cast<LowVarianceResamplingPolicy*>(getResamplingPolicy());
+      if ( p ) {
+	if ( minParticles < 1 )
+	  minParticles = 1;
+	if ( maxParticles > 0 && minParticles > maxParticles ) {
+	  std::cout << "Warning: setAdaptiveParticles given minParticles " << minParticles << " above maxParticles " << maxParticles << "; using " << maxParticles << " for both." << std::endl;
+	  minParticles = maxParticles;
+	}
+	p->minParticles = minParticles;
+	p->maxParticles = maxParticles;
+	p->setBinningPolicy(binning);
+      } else {
+	std::cout << "Warning: setAdaptiveParticles found getResamplingPolicy() returns wrong type policy; particle count not adapted." << std::endl;
+	delete binning;
+      }
+    }
+	
     //! If getResamplingPolicy() returns a LowVarianceResamplingPolicy instance, this will set LowVarianceResamplingPolicy::varianceScale; otherwise will display a warning
     virtual void setVarianceScale(float s) {
       LowVarianceResamplingPolicy* p = dynamic_cast<LowVarianceResamplingPolicy*>(getResamplingPolicy());
@@ -412,12 +602,19 @@ class ParticleFilter {
     /*! You might want to do this if you believe you have been "kidnapped" by some unmodeled motion
      *  to a new area of state space, and need to restart the filter to determine the new location. */
     virtual void resetFilter(float w) {
-      if(resampler!=NULL)
-				resampler->getDistributionPolicy().randomize(&particles[0],particles.size());
+      if(resampler!=NULL) {
+	// nothing is known about the position now, so an adaptive filter starts from its most particles
+	LowVarianceResamplingPolicy* p = dynamic_cast<LowVarianceResamplingPolicy*>(resampler);
+	if(p!=NULL && p->isAdaptive() && particles.size()<p->maxParticles)
+	  particles.resize(p->maxParticles);
+	if(!particles.empty())
+	  resampler->getDistributionPolicy().randomize(&particles[0],particles.size());
+      }
       resetWeights(w);
     }
 
     virtual const particle_type& getEstimate() const { return estimate; } //!< Returns the weighted mean of all the #particles
+    virtual index_t getNumParticles() const { return particles.size(); } //!< Returns the number of #particles, which changes on resampling if the resampler is adaptive
 
     //! Returns the variance of the #particles
     virtual const particle_type& getVariance() {
@@ -499,10 +696,6 @@ void ParticleFilter<ParticleT>::LowVarianceResamplingPolicy::resample(particle_c
   // std::cerr << "RESAMPLE UNDERWAY" << std::endl;
   // std::cerr << "Best particle is " << bestIndex << " @ " << particles[bestIndex].weight << std::endl;
 	
-  // we reuse newParticles each time, doing an STL O(1) swap to quickly exchange contents
-  // have to make sure it's still the right size though...
-  if(newParticles.size()<particles.size() || newParticles.size()>particles.size()*2)
-    newParticles.resize(particles.size());
   if(particles.size()==0)
     return;
 	
@@ -526,41 +719,50 @@ void ParticleFilter<ParticleT>::LowVarianceResamplingPolicy::resample(particle_c
     if ( bestWeight > min )
       redistributeRatio = (1-bestWeight/min);
   }
-  unsigned int numRedistribute = (unsigned int)(particles.size() * redistributeRatio * maxRedistribute);
+  // the number of particles to create: the same as before, unless adapting it to how many bins
+  // a resampling of the current particles would occupy
+  size_t numParticles = particles.size();
+  bool haveWeights = false;
+  if(isAdaptive()) {
+    haveWeights = computeWeights(particles,bestWeight);
+    if(haveWeights) {
+      const float r = weights.back() / particles.size();
+      const float offset = r*float(rand())/RAND_MAX;
+      binKeys.resize(particles.size());
+      size_t pos=0;
+      for (size_t i=0; i < particles.size(); i++) {
+	const float target = offset+r*i;
+	while (pos < particles.size()-1 && target >= weights[pos])
+	  pos++;
+	binKeys[i]=binning->bin(particles[pos]);
+      }
+      std::sort(binKeys.begin(),binKeys.end());
+      numBins = std::unique(binKeys.begin(),binKeys.end()) - binKeys.begin();
+      numParticles = kldParticles(numBins);
+    }
+  }
+  // we reuse newParticles each time, doing an STL O(1) swap to quickly exchange contents
+  newParticles.resize(numParticles);
+	
+  unsigned int numRedistribute = (unsigned int)(numParticles * redistributeRatio * maxRedistribute);
   std::cout << "Particle filter resampling: minAcceptable=" << minAcceptableWeight << "  best=" << bestWeight
-						<< "  redistRatio=" << redistributeRatio << "  numRedist=" << numRedistribute << std::endl;
+						<< "  redistRatio=" << redistributeRatio << "  numRedist=" << numRedistribute;
+  if(isAdaptive())
+    std::cout << "  bins=" << numBins << "  numParticles=" << numParticles;
+  std::cout << std::endl;
 	
   // now do resampling, writing into newParticles
   const unsigned int numResample=newParticles.size()-numRedistribute;
   //std::cerr << "best " << bestIndex << " @ " << bestWeight << " numRedist. " << numRedistribute << " of " << particles.size() << std::endl;
   if(numResample>0) {
-    // add up the cumulative weights for each particle...
-    std::vector<float> weights(particles.size());
-    if(logWeights) {
-      weights[0]=std::exp(particles.front().weight-bestWeight);
-      for (unsigned int i=1; i < particles.size(); i++)
-	weights[i] = weights[i-1] + std::exp(particles[i].weight-bestWeight);
-    } else {
-      weights[0]=particles.front().weight/bestWeight;
-      for (unsigned int i=1; i < particles.size(); i++)
-	weights[i] = weights[i-1] + particles[i].weight/bestWeight;
-    }
-    if(weights.back()<=0) {
+    if(!haveWeights && !computeWeights(particles,bestWeight)) {
       std::cerr << "Warning particle filter attempted resampling with weight total " << weights.back() << std::endl;
       return;
     }
 		
     float r = weights.back() / numResample; // last element of weights/number of particles
     float offset = r*float(rand())/RAND_MAX;
-    unsigned int pos = 0;
-		
-    for (unsigned int i=0; i < numResample; i++){
-      float target = offset+r*i; // multiply instead of repeatedly adding to avoid rounding issues
-      while (target >= weights[pos])
-				pos++;
-      // copy over particle (we'll "jiggle" it later if desired)
-      newParticles[i]=particles[pos];
-    }
+    runRange(numResample, CopySelected(particles,weights,offset,r,newParticles), BLOCK_SIZE, numResample);
 		
     // now jiggle all of the particles we've resampled
     if(varianceScale!=0) {
@@ -595,6 +797,39 @@ void ParticleFilter<ParticleT>::LowVarianceResamplingPolicy::resample(particle_c
   particles.swap(newParticles); // all done!  swap the particle lists
 }
 
+template<typename ParticleT>
+bool ParticleFilter<ParticleT>::LowVarianceResamplingPolicy::computeWeights(const particle_collection& particles, float bestWeight) {
+  // add up the cumulative weights for each particle: sums within fixed size blocks, then the
+  // totals of the preceding blocks are added on (a prefix sum, which can be split across threads)
+  const size_t numBlocks = (particles.size()+BLOCK_SIZE-1)/BLOCK_SIZE;
+  weights.resize(particles.size());
+  blockTotals.resize(numBlocks);
+  runRange(numBlocks, BlockWeights(particles,bestWeight,logWeights,weights,blockTotals), 1, particles.size());
+  float total=0;
+  for (size_t b=0; b < numBlocks; b++) {
+    const float t=blockTotals[b];
+    blockTotals[b]=total; // now the offset of block b
+    total+=t;
+  }
+  if(numBlocks>1)
+    runRange(numBlocks, AddOffsets(weights,blockTotals), 1, particles.size());
+  return weights.back()>0;
+}
+
+template<typename ParticleT>
+unsigned int ParticleFilter<ParticleT>::LowVarianceResamplingPolicy::kldParticles(unsigned int k) const {
+  float n = 0;
+  if(k>1) {
+    // Wilson-Hilferty approximation of the chi-square quantile with k-1 degrees of freedom
+    const float a = 2.f/(9*(k-1));
+    const float c = 1 - a + std::sqrt(a)*kldQuantile;
+    n = (k-1)/(2*kldError)*c*c*c;
+  }
+  if(!(n < maxParticles)) // also catches overflow
+    return std::max(maxParticles,1U);
+  return std::max(std::max(static_cast<unsigned int>(std::ceil(n)),minParticles),1U); // never resample down to no particles
+}
+
 /*! @file
  * @brief 
  * @author ejt (Creator)
@@ -256,6 +256,48 @@ void  RanNormalSetSeedZig32Vec(int *piSeed, int cSeed)
 	s_cZig32Stored = 0;
 	RanNormalSetSeedZig32(piSeed, cSeed);
 }
+void  RanVecNormalZig32(float *afX, int cX)
+{
+	unsigned int auiRan[ZIGNOR32_STORE], auiBox[ZIGNOR32_STORE / 4];
+	unsigned int i;
+	int j, c, u;
+	double x, y, f0, f1;
+	
+	for (; cX > 0; cX -= c, afX += c)
+	{
+		/* draw a block of uniforms at once, and take the box from a byte of auiBox */
+		c = cX < ZIGNOR32_STORE ? cX : ZIGNOR32_STORE;
+		RanVecIntU(auiRan, c);
+		RanVecIntU(auiBox, (c + 3) / 4);
+		for (j = 0; j < c; ++j)
+		{
+			u = (int)auiRan[j];
+			i = (auiBox[j >> 2] >> (8 * (j & 3))) & 0x7F;
+			/* first try the rectangles */
+			if ((unsigned int)abs(u) < s_aiZigRm[i])
+			{
+				afX[j] = (float)(u * s_adZigXm[i]);
+				continue;
+			}
+			/* bottom box: sample from the tail */
+			if (i == 0)
+			{
+				afX[j] = (float)DRanNormalTail(ZIGNOR_R, u < 0);
+				continue;
+			}
+			/* is this a sample from the wedges? if not, start over */
+			x = u * s_adZigXm[i];
+			y = 0.5 * s_adZigXm[i] / ZIGNOR_INVM;
+			f0 = exp(-0.5 * (y * y - x * x) );
+			y = 0.5 * s_adZigXm[i + 1] / ZIGNOR_INVM;
+			f1 = exp(-0.5 * (y * y - x * x) );
+			if (f1 + IRanU() * ZIGNOR_INVM * (f0 - f1) < 1.0)
+				afX[j] = (float)x;
+			else
+				afX[j] = (float)DRanNormalZig32();
+		}
+	}
+}
 /*--------------------------- END Integer Ziggurat -------------------------*/
 
 /*--------------------------- functions for testing ------------------------*/
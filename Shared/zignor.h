@@ -30,6 +30,8 @@ void    RanNormalSetSeedZig32(int *piSeed, int cSeed);
 double  DRanNormalZig32(void);
 void    RanNormalSetSeedZig32Vec(int *piSeed, int cSeed);
 double  DRanNormalZig32Vec(void);
+/* fills afX[0..cX-1] with normal samples from the same generator as DRanNormalZig32(), drawing the uniforms in blocks */
+void    RanVecNormalZig32(float *afX, int cX);
 
 double  DRanQuanNormalZig(void);
 double  DRanQuanNormalZigVec(void);
@@ -165,6 +165,7 @@ public:
                   prevEncoderLeft(0), prevEncoderRight(0), distOffset(0), angleOffset(0)
 	{
 	  resetStatus(globalStatus);
+		poller.setSchedulingRole("Drivers");
 		addEntry("CommPort",commName,"The name of the comm port where output will be sent");
 	}
 	virtual ~CreateDriver() {}
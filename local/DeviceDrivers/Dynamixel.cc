@@ -78,11 +78,10 @@ void DynamixelDriver::motionStopping() {
 }
 
 void DynamixelDriver::motionCheck(const float outputs[][NumOutputs]) {
-	float * buf = commThread.getWriteBuffer();
-	for(unsigned int i=NumOutputs; i!=0; ) {
-		--i;
-		buf[i] = outputs[NumFrames-1][i];
-	}
+	CommThread::OutputBuffer * buf = commThread.getWriteBuffer();
+	memcpy(buf->frames,outputs,sizeof(buf->frames));
+	buf->bufferTime = bufferTime;
+	buf->created = bufferCreated;
 	commThread.setWriteBufferTimestamp(buf);
 }
 
@@ -406,46 +405,46 @@ void DynamixelDriver::CommThread::waitForUpdate() {
 	ASSERT(!failsafe.isStarted(),"DynamixelDriver::CommThread ended, but failsafe still running?");
 }
 
-float * DynamixelDriver::CommThread::getWriteBuffer() {
-	float * bufs[3];
+DynamixelDriver::CommThread::OutputBuffer * DynamixelDriver::CommThread::getWriteBuffer() {
+	OutputBuffer * bufs[3];
 	if(timestampBufA<timestampBufB) {
 		if(timestampBufA<timestampBufC) {
-			bufs[0]=outputBufA;
+			bufs[0]=&outputBufA;
 			if(timestampBufB<timestampBufC) {
-				bufs[1]=outputBufB;
-				bufs[2]=outputBufC;
+				bufs[1]=&outputBufB;
+				bufs[2]=&outputBufC;
 			} else {
-				bufs[1]=outputBufC;
-				bufs[2]=outputBufB;
+				bufs[1]=&outputBufC;
+				bufs[2]=&outputBufB;
 			}
 		}  else {
-			bufs[0]=outputBufC;
-			bufs[1]=outputBufA;
-			bufs[2]=outputBufB;
+			bufs[0]=&outputBufC;
+			bufs[1]=&outputBufA;
+			bufs[2]=&outputBufB;
 		}
 	} else if(timestampBufB<timestampBufC) {
-		bufs[0]=outputBufB;
+		bufs[0]=&outputBufB;
 		if(timestampBufA<timestampBufC) {
-			bufs[1]=outputBufA;
-			bufs[2]=outputBufC;
+			bufs[1]=&outputBufA;
+			bufs[2]=&outputBufC;
 		}  else {
-			bufs[1]=outputBufC;
-			bufs[2]=outputBufA;
+			bufs[1]=&outputBufC;
+			bufs[2]=&outputBufA;
 		}
 	} else {
-		bufs[0]=outputBufC;
-		bufs[1]=outputBufB;
-		bufs[2]=outputBufA;
+		bufs[0]=&outputBufC;
+		bufs[1]=&outputBufB;
+		bufs[2]=&outputBufA;
 	}
 	return (bufs[0]==curBuf) ? bufs[1] : bufs[0];
 }
 
-void DynamixelDriver::CommThread::setWriteBufferTimestamp(float * buf) {
-	if(buf==outputBufA)
+void DynamixelDriver::CommThread::setWriteBufferTimestamp(OutputBuffer * buf) {
+	if(buf==&outputBufA)
 		timestampBufA=get_time();
-	else if(buf==outputBufB)
+	else if(buf==&outputBufB)
 		timestampBufB=get_time();
-	else if(buf==outputBufC)
+	else if(buf==&outputBufC)
 		timestampBufC=get_time();
 	else
 		std::cerr << "DynamixelDriver::CommThread::setWriteBufferTimestamp was passed a unknown buffer" << std::endl;
@@ -739,29 +738,33 @@ void DynamixelDriver::provideValues(ServoInfo& info, const DynamixelProtocol::AX
 }
 
 void DynamixelDriver::CommThread::updateCommands(std::istream& is, std::ostream& os) {
+	OutputBuffer * newest;
 	if(timestampBufA>timestampBufB) {
-		if(timestampBufA>timestampBufC) {
-			if(curBuf == outputBufA)
-				return;
-			curBuf = outputBufA;
-		}  else {
-			if(curBuf == outputBufC)
-				return;
-			curBuf = outputBufC;
-		}
+		newest = (timestampBufA>timestampBufC) ? &outputBufA : &outputBufC;
 	} else if(timestampBufB>timestampBufC) {
-		if(curBuf == outputBufB)
-			return;
-		curBuf = outputBufB;
+		newest = &outputBufB;
 	} else {
 		if(timestampBufC==0)
 			return; // no data yet, don't send commands to servos
-		if(curBuf == outputBufC)
-			return;
-		curBuf = outputBufC;
+		newest = &outputBufC;
 	}
 	
+	// send the values for when the command will reach the servos, rather than the end of the buffer,
+	// so updates between motion frames follow the frames instead of waiting for the next buffer
+	const unsigned int sendTime = get_time();
+	float tgtOutputs[NumOutputs];
+	MotionHook::interpolateOutputs(newest->frames, newest->bufferTime, sendTime+driver.commLatency, tgtOutputs);
+	const bool newBuffer = (newest!=curBuf);
+	if(!newBuffer && memcmp(tgtOutputs,curOutputs,sizeof(curOutputs))==0)
+		return; // nothing has changed since the last update
+	curBuf = newest;
+	memcpy(curOutputs,tgtOutputs,sizeof(curOutputs));
+	
+	// speeds cover the time since the previous update, which may be less than the buffer period
 	float period = NumFrames*FrameTime;
+	if(lastSendTime!=0 && sendTime>lastSendTime)
+		period = std::max<float>(std::min<float>(sendTime-lastSendTime, period), FrameTime);
+	lastSendTime = sendTime;
 	if(getTimeScale()>0)
 		period /= ::getTimeScale();
 	
@@ -811,11 +814,11 @@ void DynamixelDriver::CommThread::updateCommands(std::istream& is, std::ostream&
 				std::cerr << "Warning: Dynamixel driver mapping servo " << it->first << " to invalid led output index " << ledidx << std::endl;
 		} else if(static_cast<unsigned int>(ledsubidx)>=NumLEDs) {
 			std::cerr << "Warning: Dynamixel driver mapping servo " << it->first << " to invalid led index " << ledsubidx << std::endl;
-		} else if(lastOutputs[ledidx]!=curBuf[ledidx] || lastLEDState[ledsubidx]==LED_UNKNOWN || (curBuf[ledidx]>0 && curBuf[ledidx]<1)) {
+		} else if(lastOutputs[ledidx]!=curOutputs[ledidx] || lastLEDState[ledsubidx]==LED_UNKNOWN || (curOutputs[ledidx]>0 && curOutputs[ledidx]<1)) {
 			if(seenLEDs[ledsubidx]==LED_UNSEEN) {
 				// ensures we only calculate the led activation value once per LED signal
 				// (even if it might be mapped to several servo LEDs...)
-				LedState cur = calcLEDValue(ledsubidx,curBuf[ledidx]) ? LED_ON : LED_OFF;
+				LedState cur = calcLEDValue(ledsubidx,curOutputs[ledidx]) ? LED_ON : LED_OFF;
 				seenLEDs[ledsubidx] = (cur==lastLEDState[ledsubidx]) ? LED_SAME : LED_DIFF;
 				lastLEDState[ledsubidx]=cur;
 			}
@@ -834,7 +837,7 @@ void DynamixelDriver::CommThread::updateCommands(std::istream& is, std::ostream&
 					std::cerr << "Warning: Dynamixel driver mapping servo " << it->first << " to invalid free spin output index " << it->second->freeSpinOutput << std::endl;
 				idx = it->second->output;
 				rm = ServoInfo::POSITION;
-			} else if(curBuf[it->second->freeSpinOutput]==0) {
+			} else if(curOutputs[it->second->freeSpinOutput]==0) {
 				idx = it->second->output;
 				rm = ServoInfo::POSITION;
 			}
@@ -846,19 +849,19 @@ void DynamixelDriver::CommThread::updateCommands(std::istream& is, std::ostream&
 		}
 		/*if(it->second->predictedLoad==0) {
 			// send position if first starting, if changed value, or if rotation mode changed
-			if(isFirstCheck || lastOutputs[idx]!=curBuf[idx] || rm!=it->second->curRotationMode) {
+			if(isFirstCheck || lastOutputs[idx]!=curOutputs[idx] || rm!=it->second->curRotationMode) {
 				float speed;
 				if(rm==ServoInfo::CONTINUOUS) {
 					// continuous rotation mode, speed specified directly
-					speed = curBuf[idx];
-				} else if(lastOutputs[idx]!=curBuf[idx]) {
+					speed = curOutputs[idx];
+				} else if(lastOutputs[idx]!=curOutputs[idx]) {
 					// here because value changed, speed based on distance to travel
-					speed = (curBuf[idx] - lastOutputs[idx]) / (period/1000);
+					speed = (curOutputs[idx] - lastOutputs[idx]) / (period/1000);
 				} else {
 					// initial start or change of mode, choose a reasonable speed
 					speed = .35;
 				}
-				packets.push_back(setServo(it, rm, curBuf[idx], speed));
+				packets.push_back(setServo(it, rm, curOutputs[idx], speed));
 			}
 		} else*/ 
 		{ // subject to load prediction, may need to adjust command
@@ -866,16 +869,16 @@ void DynamixelDriver::CommThread::updateCommands(std::istream& is, std::ostream&
 			float speed;
 			if(rm==ServoInfo::CONTINUOUS) {
 				// continuous rotation mode, speed specified directly
-				speed = curBuf[idx];
-			} else if(lastOutputs[idx]!=curBuf[idx]) {
+				speed = curOutputs[idx];
+			} else if(lastOutputs[idx]!=curOutputs[idx]) {
 				// here because value changed, speed based on distance to travel
-				speed = (curBuf[idx] - lastOutputs[idx]) / (period/1000);
+				speed = (curOutputs[idx] - lastOutputs[idx]) / (period/1000);
 			} else {
 				// initial start or change of mode, choose a reasonable speed
 				speed = .35f;
 			}
 			unsigned short oldLastCmd = it->second->lastCmd;
-			DynamixelProtocol::SyncWritePosSpeedEntry packet = setServo(it, rm, curBuf[idx], speed);
+			DynamixelProtocol::SyncWritePosSpeedEntry packet = setServo(it, rm, curOutputs[idx], speed);
 			// send position if first starting, if changed value, or if rotation mode changed
 			if(isFirstCheck || oldLastCmd!=it->second->lastCmd || rm!=it->second->curRotationMode) {
 				packets.push_back(packet);
@@ -938,6 +941,8 @@ void DynamixelDriver::CommThread::updateCommands(std::istream& is, std::ostream&
 		// now dump it on the wire
 		os.flush();
 		if(os) {
+			if(newBuffer)
+				driver.reportWrite(curBuf->created);
 			for(modeUpdates_t::const_iterator it=modeUpdates.begin(); it!=modeUpdates.end(); ++it) {
 				//printf("\t\t%s Mode switch (%d -> %d)\n",it->first.c_str(),servos[it->first].curRotationMode,it->second);
 				servos[it->first].curRotationMode=it->second;
@@ -946,7 +951,7 @@ void DynamixelDriver::CommThread::updateCommands(std::istream& is, std::ostream&
 			std::cerr << "WARNING: DynamixelDriver couldn't write update, bad output stream" << std::endl;
 		}
 	}
-	memcpy(lastOutputs,curBuf,sizeof(lastOutputs));
+	memcpy(lastOutputs,curOutputs,sizeof(lastOutputs));
 	isFirstCheck=false;
 }
 
@@ -272,9 +272,10 @@ protected:
 		CommThread(plist::DictionaryOf< ServoInfo >& servoList, const plist::Primitive<std::string>& comm, DynamixelDriver& parent)
 			: Thread(), pidLock(), dirtyPIDs(0), commName(comm), servos(servoList), driver(parent), servoPollQueue(),
 			failsafe(*this,FrameTime*NumFrames*3/2000.0,false), continuousUpdates(), updated(false), responsePending(false), lastSensorTime(0), 
-			servoDeflection(0), isFirstCheck(true), timestampBufA(0), timestampBufB(0), timestampBufC(0), curBuf(NULL)
+			servoDeflection(0), isFirstCheck(true), outputBufA(), timestampBufA(0), outputBufB(), timestampBufB(0), outputBufC(), timestampBufC(0), curBuf(NULL), lastSendTime(0)
 		{
 			failsafe.restartFlag=true;
+			setSchedulingRole("Drivers");
 			for(unsigned int i=0; i<NumLEDs; ++i)
 				lastLEDState[i]=LED_UNKNOWN;
 			servos.addCollectionListener(this);
@@ -315,10 +316,19 @@ protected:
 		virtual bool isStarted() const { return Thread::isStarted() || failsafe.isStarted(); }
 		bool takeUpdate() { if(!updated) { return false; } else { updated=false; return true; } }
 		
+		//! the frames passed to motionCheck(), with their timestamps
+		struct OutputBuffer {
+			//! constructor
+			OutputBuffer() : bufferTime(0), created() {}
+			float frames[NumFrames][NumOutputs]; //!< the output values
+			unsigned int bufferTime; //!< simulator time of the first frame, see MotionHook::bufferTime
+			TimeET created; //!< when the frames were computed, see MotionHook::bufferCreated
+		};
+		
 		//! find the oldest of the output buffers that isn't currently in use
-		float* getWriteBuffer();
+		OutputBuffer* getWriteBuffer();
 		//! sets the timestamp on the indicated buffer (indicates you're done writing)
-		void setWriteBufferTimestamp(float * buf);
+		void setWriteBufferTimestamp(OutputBuffer * buf);
 		
 		unsigned int nextTimestamp() const { return lastSensorTime + driver.commLatency; }
 		
@@ -349,14 +359,16 @@ protected:
 		float servoDeflection; //!< 'tics' of servo deflection from target per newton·meter of torque applied
 		
 		bool isFirstCheck;
-		float outputBufA[NumOutputs];
+		OutputBuffer outputBufA;
 		unsigned int timestampBufA;
-		float outputBufB[NumOutputs];
+		OutputBuffer outputBufB;
 		unsigned int timestampBufB;
-		float outputBufC[NumOutputs];
+		OutputBuffer outputBufC;
 		unsigned int timestampBufC;
 		float lastOutputs[NumOutputs];
-		float * curBuf;
+		OutputBuffer * curBuf; //!< the buffer most recently sent from
+		float curOutputs[NumOutputs]; //!< the values most recently sent, interpolated from #curBuf for the time they reach the servos
+		unsigned int lastSendTime; //!< the time of the most recent update, for calculating servo speeds
 		
 		//! allows LEDs to flicker at various frequencies to emulate having linear brightness control instead of boolean control
 		inline bool calcLEDValue(unsigned int i,float x) {
@@ -69,7 +69,8 @@ void SSC32Driver::motionCheck(const float outputs[][NumOutputs]) {
 	string s=ss.str();
 	if(s.size()>0) { // if sparse and no changes, skip update altogether
 		Thread::Lock& l = comm->getLock();
-		unsigned int t=get_time();
+		// the move should finish when the buffer ends, measured from when the buffer was computed rather than when we got called
+		unsigned int t = (bufferTime!=0) ? bufferTime : get_time();
 		// keep trying to get the lock, sleeping 1 ms each time, until 3/4 the frame time is gone (then give up)
 		unsigned int dt = static_cast<unsigned int>(NumFrames*FrameTime/((getTimeScale()>0)?getTimeScale():1.f));
 		unsigned int giveup = t+dt*3/4;
@@ -96,6 +97,7 @@ void SSC32Driver::motionCheck(const float outputs[][NumOutputs]) {
 			dt=t-curt;
 			os << s << 'T' << dt << '\r' << flush; // indicate time until next update
 		}
+		reportWrite(bufferCreated);
 	}
 	
 	MotionHook::motionCheck(outputs); // updates lastOutputs and isFirstCheck, we ignore its motionUpdated() call
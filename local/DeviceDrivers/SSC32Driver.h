@@ -26,6 +26,7 @@ public:
 		TimeET(1.0/(*sensorFramerate)),true,CallbackPollThread::IGNORE_RETURN),
 		motionActive(false), sensorsActive(false), lastSensorTime(), frameNumber(0), timeLastChanged()
 	{
+		poller.setSchedulingRole("Drivers");
 		for(unsigned int i=0; i<NumOutputs && i<NUM_SERVO; ++i) {
 			servos[i]=i;
 			timeLastChanged[i] = 0;
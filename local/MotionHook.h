@@ -5,6 +5,8 @@
 #include <cstring>
 #include "Shared/plist.h"
 #include "Shared/RobotInfo.h"
+#include "Shared/TimeET.h"
+#include "IPC/DeadlineMonitor.h"
 #include <vector>
 
 //! Interface for connections to remote hosts and hardware devices which should be polled with output values
@@ -19,6 +21,12 @@
  *  a breakpoint in the debugger.  See enteringRealtime() and leavingRealtime() if you want updates 
  *  when the user switches simulation modes, although there's still no way to get notification if a
  *  debugger breakpoint is hit.
+ *
+ *  Before each motionCheck(), setBufferTime() records when the buffer's first frame is meant to be
+ *  expressed (#bufferTime).  Hooks which send commands asynchronously, or at some delay after motionCheck(),
+ *  can use interpolateOutputs() to find the outputs for the exact time a command is sent, rather than
+ *  the time the Motion thread happened to run.  Once a buffer has actually been delivered to the hardware,
+ *  pass its #bufferCreated to reportWrite() to record the end-to-end latency.
  */
 class MotionHook {
 public:
@@ -33,11 +41,35 @@ public:
 	};
 	
 	//! constructor
-	MotionHook() : verbose(0), isFirstCheck(true) {}
+	MotionHook() : verbose(0), isFirstCheck(true), bufferTime(0), bufferCreated(), latencyMonitor(NULL) {}
 	
 	//! no-op destructor
 	virtual ~MotionHook() {}
 	
+	//! Called by the motion thread before each motionCheck(), timestamps the buffer which is about to be passed
+	/*! @param time the simulator time (see get_time()) at which the first frame of the buffer should be expressed, each subsequent frame follows by FrameTime
+	 *  @param created the wall-clock time at which the buffer was computed, to be passed to reportWrite()
+	 *  @param latency records the latency reported by reportWrite(), may be NULL */
+	void setBufferTime(unsigned int time, const TimeET& created, DeadlineMonitor* latency) {
+		bufferTime=time;
+		bufferCreated=created;
+		latencyMonitor=latency;
+	}
+	
+	//! stores into @a dst the output values at time @a t, linearly interpolated between the frames of @a outputs, whose first frame is at @a bufTime
+	/*! Times before the first frame or after the last frame are clamped to those frames. */
+	static void interpolateOutputs(const float outputs[][NumOutputs], unsigned int bufTime, unsigned int t, float dst[NumOutputs]) {
+		const unsigned int dt = (t>bufTime) ? t-bufTime : 0;
+		const unsigned int f = dt/FrameTime;
+		if(f>=NumFrames-1) {
+			memcpy(dst,outputs[NumFrames-1],sizeof(float)*NumOutputs);
+			return;
+		}
+		const float w = (dt-f*FrameTime)/static_cast<float>(FrameTime);
+		for(unsigned int i=0; i<NumOutputs; ++i)
+			dst[i] = outputs[f][i] + (outputs[f+1][i]-outputs[f][i])*w;
+	}
+	
 	//! Called when motion process is starting
 	virtual void motionStarting() {}
 	
@@ -125,6 +157,16 @@ protected:
 	bool isFirstCheck;
 	//! stores the last frame of the outputs, updated by motionCheck()
 	float lastOutputs[NumOutputs];
+	
+	//! call once the buffer computed at @a created (a previous #bufferCreated) has been written to the hardware, records the end-to-end latency
+	void reportWrite(const TimeET& created) {
+		if(latencyMonitor!=NULL)
+			latencyMonitor->completed(created);
+	}
+	
+	unsigned int bufferTime; //!< simulator time at which the first frame of the most recent motionCheck() buffer should be expressed, 0 if unknown
+	TimeET bufferCreated; //!< wall-clock time at which the most recent motionCheck() buffer was computed
+	DeadlineMonitor* latencyMonitor; //!< records latencies passed to reportWrite(), may be NULL
 };
 
 /*! @file
@@ -1,6 +1,7 @@
 #include "IPCMotionHook.h"
 #include "IPC/MessageQueue.h"
 #include <sstream>
+#include <new>
 
 using namespace std;
 
@@ -13,7 +14,8 @@ IPCMotionHook::~IPCMotionHook() {
 
 void IPCMotionHook::motionCheck(const float outputs[][NumOutputs]) {
 	RCRegion * r = getRegion();
-	memcpy(r->Base(),outputs,r->Size());
+	memcpy(r->Base(),outputs,sizeof(float)*NumFrames*NumOutputs);
+	new (r->Base()+sizeof(float)*NumFrames*NumOutputs) BufferStamp(bufferTime,bufferCreated);
 	mq.sendMessage(r);
 	regions.push_back(r);
 }
@@ -39,7 +41,7 @@ RCRegion* IPCMotionHook::getRegion() {
 	stringstream ss;
 	ss << "MotionUpdate." << count++;
 	//cout << "Created " << ss.str() << endl;
-	return new RCRegion(ss.str(),sizeof(float)*NumOutputs*NumFrames);
+	return new RCRegion(ss.str(),MESSAGE_SIZE);
 }
 
 /*! @file
@@ -16,6 +16,15 @@ public:
 	
 	virtual bool isConnected() { return true; }
 	
+	//! follows the frames in each message, so the receiving process can pass the timestamps on to its own hooks (see MotionHook::setBufferTime())
+	struct BufferStamp {
+		//! constructor
+		BufferStamp(unsigned int t, const TimeET& c) : time(t), created(c) {}
+		unsigned int time; //!< the MotionHook::bufferTime
+		TimeET created; //!< the MotionHook::bufferCreated
+	};
+	static const unsigned int MESSAGE_SIZE=sizeof(float)*NumFrames*NumOutputs+sizeof(BufferStamp); //!< the size of each output message
+	
 	virtual void motionCheck(const float outputs[][NumOutputs]);
 	virtual void updatePIDs(const std::vector<PIDUpdate>& pids);
 	
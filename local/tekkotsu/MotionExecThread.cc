@@ -37,6 +37,7 @@ bool MotionExecThread::poll() {
 	//ASSERTRETVAL(get_time()>=globals->getNextMotion()-1,"MotionExecThread::poll() early (time="<<get_time()<< " vs. nextMotion=" <<globals->getNextMotion()<<")",true);
 	if(get_time()<globals->getNextMotion())
 		return true;
+	deadlines.activated(period);
 	
 	{
 		MarkScope sensorLock(globals->sensorState);
@@ -80,6 +81,9 @@ bool MotionExecThread::poll() {
 			cnt--;
 		}
 	}
+	const unsigned int prevSkipped=motman->getFrameStats().skippedFrames;
+	// motion commands compute their frames starting from the current time
+	const unsigned int bufferTime=get_time();
 	try {
 		motman->getOutputs(*motionBufferPos);
 	} catch(const std::exception& ex) {
@@ -89,7 +93,11 @@ bool MotionExecThread::poll() {
 		if(!ProjectInterface::uncaughtException(__FILE__,__LINE__,"Occurred during MotionManager processing",NULL))
 			throw;
 	}
-	Simulator::updateMotion(*motionBufferPos);
+	if(globals->motion.verbose>=2 && motman->getFrameStats().skippedFrames!=prevSkipped)
+		cout << "Reused previous outputs for MotionCommand(s) checked out during motion frame at " << get_time() << endl;
+	const TimeET created;
+	writeLatency.setPeriod(period);
+	Simulator::updateMotion(*motionBufferPos,bufferTime,created,&writeLatency);
 	if(++motionBufferPos==motionBuffers.end())
 		motionBufferPos=motionBuffers.begin();
 	{
@@ -130,6 +138,7 @@ bool MotionExecThread::launched() {
 	//reset startTime to last motion time
 	startTime-=(get_time()-(getNextMotion()-FrameTime*NumFrames))/globals->timeScale/1000;
 	interrupted();
+	deadlines.restart();
 	//delay=(getNextMotion()>get_time()) ? (getNextMotion()-get_time())/globals->timeScale/1000 : 0;
 	return PollThread::launched();
 }
@@ -140,6 +149,7 @@ bool MotionExecThread::launched() {
 
 void MotionExecThread::interrupted() {
 	period=FrameTime*NumFrames/globals->timeScale/1000;
+	deadlines.restart(); // time scale may have changed, or we may have been paused
 	delay=(globals->getNextMotion()-get_time())/globals->timeScale/1000+startTime.Age();
 	//cout << "interrupt " << get_time() << ' ' << globals->getNextMotion() << ' ' << startTime.Age() << ' ' << delay << ' ' << period << ' ' << isStarted() << ' ' << globals->timeScale << endl;
 }
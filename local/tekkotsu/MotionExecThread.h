@@ -3,6 +3,7 @@
 #define INCLUDED_MotionExecThread_h_
 
 #include "IPC/PollThread.h"
+#include "IPC/DeadlineMonitor.h"
 #include "Shared/RobotInfo.h"
 #include "IPC/MessageQueue.h"
 #include "Shared/get_time.h"
@@ -23,8 +24,9 @@ public:
 	/*! @arg bl a process lock to ensure mutual exclusion between MotionExecThread::poll() and other threads in the process */
 	MotionExecThread(Resource& bl)
 		: PollThread(0L, FrameTime*NumFrames/globals->timeScale/1000, true), motionLock(bl),
-		motionBuffers(), motionBufferPos(), lastPoll(-1U)
+		motionBuffers(), motionBufferPos(), lastPoll(-1U), deadlines("Motion"), writeLatency("Motion write")
 	{
+		setSchedulingRole("Motion");
 		motionBuffers.push_front(new float[NumFrames][NumOutputs]);
 		for(unsigned int f=0; f<NumFrames; ++f)
 			for(unsigned int o=0; o<NumOutputs; ++o)
@@ -67,6 +69,9 @@ protected:
 	std::list<float(*)[NumOutputs]>::iterator motionBufferPos;
 	
 	unsigned int lastPoll;
+	
+	DeadlineMonitor deadlines; //!< records missed motion frames and timing jitter
+	DeadlineMonitor writeLatency; //!< records the latency from computing each buffer until the hooks have written it to hardware (see MotionHook::reportWrite()), jitter is only recorded by #deadlines
 };
 
 /*! @file
@@ -2,6 +2,7 @@
 #include "SharedGlobals.h"
 #include "Sound/SoundManager.h"
 #include "IPC/SharedObject.h"
+#include "IPC/DeadlineMonitor.h"
 #include "Shared/MarkScope.h"
 #include "Shared/debuget.h"
 #include <unistd.h>
@@ -34,6 +35,14 @@ void Process::statusReport(std::ostream& os) {
 		unsigned int ref=(it->second->NumberOfReference()-1);
 		os << '\t' << setw(16) << left << it->first << setw(8) << right << it->second->Size() << " bytes" << setw(8) << lref<<'/'<<ref << " references" << endl;
 	}
+	RCRegion::PoolStats ps=RCRegion::getPoolStats();
+	os << '\t' << setw(16) << left << "Region pool: " << setw(8) << right << ps.pooledBytes << " bytes in " << ps.pooledRegions << " regions, "
+		<< ps.hits << " hits, " << ps.misses << " misses, " << ps.evictions << " evictions, " << ps.mappedBytes << " bytes mapped" << endl;
+	DeadlineMonitor::dumpStats(os);
+#if TEKKOTSU_SHM_STYLE==NO_SHM
+	if(MutexLockBase::getContentionProfiling())
+		MutexLockBase::dumpContentionProfile(os);
+#endif
 	os << '\t' << setw(16) << left << "Next RCRegion ID: " << setw(8) << right << RCRegion::getNextKey() << endl;
 	os << '\t' << setw(16) << left << "Next ShdObj ID: " << setw(8) << right << SharedObjectBase::getNextKey() << endl;
 	if(sndman!=NULL)
@@ -5,6 +5,7 @@
 #include "Shared/plist.h"
 #include "SharedGlobals.h"
 #include "IPC/RCRegion.h"
+#include "IPC/ThreadScheduling.h"
 
 //! Provides the root dictionary of the simulator configuration, items from SharedGlobals and LoadFileThreads are added as entries in this dictionary
 class SimConfig : public plist::Dictionary {
@@ -14,18 +15,52 @@ public:
 		initSimTime(0),
 		tgtRunlevel(SharedGlobals::RUNNING, SharedGlobals::runlevel_names),
 		multiprocess(false),
+		lockProfiling(false),
+		scheduling(),
 		lastfile()
 	{
 		sim::config.setUnusedWarning(false);
 		addEntry("InitialTime",initSimTime,"The value to initialize the simulator's clock (in milliseconds)");
 		addEntry("InitialRunlevel",tgtRunlevel,"Specifies how far startup should proceed before pausing for user interaction.\nThis value only affects startup, and setting this value from the simulator command prompt will have no effect.  (Use the 'runlevel' command instead.)");
 		addEntry("Multiprocess",multiprocess,"The processing/threading model to use - true to use real process forks a la Aibo/Aperios, or false to just more threads like a sane person would do");
+		addEntry("LockProfiling",lockProfiling,"If true, threads record how long they wait for each contended MutexLock, and the 'status' command displays the totals.\nOnly available when TEKKOTSU_SHM_STYLE is NO_SHM.");
+		addEntry("Scheduling",scheduling,"Scheduling policy, priority, and CPU affinity for the simulator's time-critical threads.\nThese are applied as each thread is launched, so changes take effect the next time the thread starts.");
 	}
 	
+	//! scheduling settings for the simulator's time-critical threads, each registered as a ThreadScheduling role of the same name
+	class SchedulingConfig : public virtual plist::Dictionary {
+	public:
+		//! constructor
+		SchedulingConfig() : plist::Dictionary(), motion(), sound(), timer(), drivers() {
+			addEntry("Motion",motion,"Settings for the thread which calls MotionManager::getOutputs() each motion frame;\nthis is the most sensitive to delays, e.g. FIFO at a higher priority than the others");
+			addEntry("Sound",sound,"Settings for the thread which mixes and sends sound buffers to the sound device");
+			addEntry("Timer",timer,"Settings for the thread which processes timer events");
+			addEntry("Drivers",drivers,"Settings for device driver communication threads (e.g. Dynamixel, Create, SSC32)");
+			setLoadSavePolicy(FIXED,SYNC);
+			ThreadScheduling::registerRole("Motion",motion);
+			ThreadScheduling::registerRole("Sound",sound);
+			ThreadScheduling::registerRole("Timer",timer);
+			ThreadScheduling::registerRole("Drivers",drivers);
+		}
+		//! destructor
+		~SchedulingConfig() {
+			ThreadScheduling::unregisterRole("Motion",motion);
+			ThreadScheduling::unregisterRole("Sound",sound);
+			ThreadScheduling::unregisterRole("Timer",timer);
+			ThreadScheduling::unregisterRole("Drivers",drivers);
+		}
+		ThreadScheduling motion; //!< settings for MotionExecThread
+		ThreadScheduling sound; //!< settings for SoundPlayThread
+		ThreadScheduling timer; //!< settings for TimerExecThread
+		ThreadScheduling drivers; //!< settings for device driver communication threads
+	};
+	
 	std::string cmdPrompt; //!< Not persistently stored -- [re]set by main(...) on each run
 	plist::Primitive<unsigned int> initSimTime; //!< The "boot" time to start the simulator clock at (default 0)
 	plist::NamedEnumeration<SharedGlobals::runlevel_t> tgtRunlevel; //!< The runlevel the simulator should move to (i.e. stop before 'running' to debug startup code)
 	plist::Primitive<bool> multiprocess; //!< The processing/threading model to use -- true to use real process forks a la Aibo/Aperios, or false to just more threads like a sane person would do
+	plist::Primitive<bool> lockProfiling; //!< if true, record contention of MutexLocks (see MutexLockBase::setContentionProfiling())
+	SchedulingConfig scheduling; //!< scheduling settings for the simulator's time-critical threads
 	
 	void setLastFile(const std::string& str) const {
 		lastfile=str;
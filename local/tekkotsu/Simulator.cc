@@ -15,6 +15,7 @@
 #include "local/DataSources/FileSystemImageSource.h"
 #include "local/CommPort.h"
 #include "local/DeviceDriver.h"
+#include "local/MotionHooks/IPCMotionHook.h"
 #include "Events/EventRouter.h"
 #include "Events/TextMsgEvent.h"
 #include "Motion/PostureEngine.h"
@@ -57,7 +58,7 @@ cameraStatus(*cameraQueue), sensorStatus(*sensorQueue), timerStatus(*timerWakeup
 frameTimes(), runSpeed(1), lastTimeScale(0), step(STEP_NONE), waitingSteps(0), curLevel(SharedGlobals::CONSTRUCTING),
 activeSensors(), activeSensorSrcs(), activeCameras(), activeCameraSrcs(),
 fullspeedWallStart(), fullspeedSimStart(), lastFrameWallStart(), avgWallTime(), avgSimTime(),
-simLock()
+simLock(), motionDelivery("Motion IPC")
 {
 	theSim=this;
 	new (&(*cameraQueue)) sim::CameraQueue_t;
@@ -479,12 +480,13 @@ void Simulator::setMotionStopping() {
 	}
 	Simulator::motionHookMonitor->curHook=NULL;
 }
-void Simulator::updateMotion(const float outputs[][NumOutputs]) {
+void Simulator::updateMotion(const float outputs[][NumOutputs], unsigned int bufferTime, const TimeET& created, DeadlineMonitor* latency) {
 	MarkScope l(theSim ? dynamic_cast<Resource&>(theSim->simLock) : ::emptyResource);
 	Simulator::motionHookMonitor->motionCheckTime.Set();
 	Simulator::motionHookMonitor->curFuncName="motionCheck(const float[][])"; 
 	for(std::set<MotionHook*>::iterator it=theSim->motionHooks.begin(); it!=theSim->motionHooks.end(); ++it) {
 		Simulator::motionHookMonitor->curHook=*it;
+		(*it)->setBufferTime(bufferTime,created,latency);
 		(*it)->motionCheck(outputs);
 	}
 	Simulator::motionHookMonitor->curHook=NULL;
@@ -973,7 +975,14 @@ bool Simulator::gotMotion(RCRegion* msg) {
 	Simulator * simp=dynamic_cast<Simulator*>(Process::getCurrent());
 	ASSERTRETVAL(simp!=NULL,"gotMotion, but not within Simulator process!",true);
 #endif
-	updateMotion(reinterpret_cast<float(*)[NumOutputs]>(msg->Base()));
+	const IPCMotionHook::BufferStamp* stamp = reinterpret_cast<const IPCMotionHook::BufferStamp*>(msg->Base()+sizeof(float)*NumFrames*NumOutputs);
+	DeadlineMonitor* latency=NULL;
+	if(theSim!=NULL) {
+		if(globals->timeScale>0)
+			theSim->motionDelivery.activated(FrameTime*NumFrames/globals->timeScale/1000);
+		latency=&theSim->motionDelivery;
+	}
+	updateMotion(reinterpret_cast<float(*)[NumOutputs]>(msg->Base()),stamp->time,stamp->created,latency);
 	return true;
 }
 
@@ -1484,8 +1493,8 @@ void Simulator::cmdStatus(const std::vector<std::string>& args) {
 				region->RemoveReference();
 			}
 			//wait until they're done to put the prompt back up
-			if(sem!=statusRequest->getSemaphoreManager()->invalid()) {
-				statusRequest->getSemaphoreManager()->lower(sem,tgts.size());
+			if(sem!=statusRequest->invalidNotification()) {
+				statusRequest->lowerNotification(sem,tgts.size());
 				statusRequest->removeReadStatusListener(sem);
 			}
 			//check to see if we're included:
@@ -1570,7 +1579,7 @@ void Simulator::cmdAdvance(const std::vector<std::string>& args) {
 		if(!sent && !isAll) // no data in queue and only report empty queue if the queue was explicitly specified
 			cout << "No data in " << lookupDataSourceName(*it) << " queue" << endl;
 		if(sent)
-			cameraQueue->getSemaphoreManager()->lower(sem,true); //block until we know message was read
+			cameraQueue->lowerNotification(sem,1); //block until we know message was read
 		cameraQueue->removeReadStatusListener(sem);
 	}
 	
@@ -1586,7 +1595,7 @@ void Simulator::cmdAdvance(const std::vector<std::string>& args) {
 			sent = sendSensor(true); // have to manually pump it out since sensorThread (shouldn't) be running
 		}
 		if(sent)
-			sensorQueue->getSemaphoreManager()->lower(sem,true); //block until we know message was read
+			sensorQueue->lowerNotification(sem,1); //block until we know message was read
 		sensorQueue->removeReadStatusListener(sem);
 	}
 }
@@ -1790,7 +1799,7 @@ void Simulator::cmdPost(const std::vector<std::string>& args) {
 	//send event!
 	SemaphoreManager::semid_t sem=events->addReadStatusListener(); //register read status listener before sending!
 	erouter->postEvent((EventBase::EventGeneratorID_t)egid,name,(EventBase::EventTypeID_t)etid,dur);
-	events->getSemaphoreManager()->lower(sem,true); //block until we know message was read
+	events->lowerNotification(sem,1); //block until we know message was read
 	events->removeReadStatusListener(sem);
 }
 
@@ -1802,7 +1811,7 @@ void Simulator::cmdMsg(const std::vector<std::string>& args) {
 	for(size_t i=2; i<args.size(); ++i)
 		s.append(" ").append(args[i]);
 	erouter->postEvent(TextMsgEvent(s,0));
-	events->getSemaphoreManager()->lower(sem,true); //block until we know message was read
+	events->lowerNotification(sem,1); //block until we know message was read
 	events->removeReadStatusListener(sem);
 }
 
@@ -70,7 +70,8 @@ public:
 	
 	static void setMotionStarting();
 	static void setMotionStopping();
-	static void updateMotion(const float outputs[][NumOutputs]);
+	//! passes @a outputs to each hook's MotionHook::motionCheck(), after MotionHook::setBufferTime() with the remaining arguments
+	static void updateMotion(const float outputs[][NumOutputs], unsigned int bufferTime, const TimeET& created, DeadlineMonitor* latency);
 	static void updatePIDs(const std::vector<MotionHook::PIDUpdate>& pids);
 	static void setMotionLeavingRealtime(bool isFullSpeed);
 	static void setMotionEnteringRealtime();
@@ -260,6 +261,7 @@ protected:
 	static const float avgSpeedupGamma; //!< gamma parameter for calculating running average in #avgWallTime and #avgSimTime
 	
 	Thread::Lock simLock;
+	DeadlineMonitor motionDelivery; //!< in multi-process mode, records jitter in the arrival of motion buffers from the Motion process, and their latency until written by the hooks
 	
 private:
 	Simulator(const Simulator&); //!< don't call (copy constructor)
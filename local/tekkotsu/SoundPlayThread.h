@@ -19,6 +19,9 @@ public:
 											lock(), pcm_handle(NULL), buffer_size(0), period_size(0), frame_size(0), buf(NULL)
 #endif
 	{
+#ifndef __APPLE__
+		poller.setSchedulingRole("Sound");
+#endif
 		openSystem();
 	}
 	virtual ~SoundPlayThread() {
@@ -8,7 +8,7 @@
 //! executes EventRouter::processTimers() as necessary (allows timers to work without any other vision or sensor processing)
 class TimerExecThread : public PollThread {
 public:
-	explicit TimerExecThread(Resource& bl, bool autoStart=true) : PollThread(), behaviorLock(bl) { if(autoStart) reset(); }
+	explicit TimerExecThread(Resource& bl, bool autoStart=true) : PollThread(), behaviorLock(bl) { setSchedulingRole("Timer"); if(autoStart) reset(); }
 	virtual void reset(); //!< starts and stops thread as needed, or interrupts thread to reset sleep time if already running
 	
 protected:
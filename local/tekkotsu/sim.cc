@@ -344,6 +344,7 @@ bool sim::run() {
 	
 	// point of no return for setting multiprocess mode
 	cfgCheck.holdMultiprocess();
+	cfgCheck.watchLockProfiling();
 	RCRegion::setMultiprocess(config.multiprocess);
 	if(!config.multiprocess) {
 		ProcessID::setIDHooks(getProcessID,setProcessID);
@@ -608,6 +609,8 @@ void sim::handle_exit() {
 	close(fd);
 #endif
 	
+	//regions held for recycling aren't attached, but still need to be unlinked
+	RCRegion::releasePool();
 	if(RCRegion::NumberOfAttach()==0) {
 		/*if(original)
 		 cout << "Clean shutdown complete.  Have a nice day." << endl;*/
@@ -704,6 +707,7 @@ sim::ConfigErrorCheck::ConfigErrorCheck() : PrimitiveListener(), holdMPValue(con
 
 sim::ConfigErrorCheck::~ConfigErrorCheck() {
 	sim::config.multiprocess.removePrimitiveListener(this);
+	sim::config.lockProfiling.removePrimitiveListener(this);
 }
 
 void sim::ConfigErrorCheck::plistValueChanged(const plist::PrimitiveBase& pl) {
@@ -721,6 +725,13 @@ void sim::ConfigErrorCheck::plistValueChanged(const plist::PrimitiveBase& pl) {
 			cerr << "ERROR: Cannot change sim::config.Multiprocess during execution, must set from command line or load from settings file" << endl;
 			sim::config.multiprocess=holdMPValue;
 		}
+#endif
+	} else if(&pl==&sim::config.lockProfiling) {
+#if TEKKOTSU_SHM_STYLE==NO_SHM
+		MutexLockBase::setContentionProfiling(sim::config.lockProfiling);
+#else
+		if(sim::config.lockProfiling)
+			cerr << "WARNING: MutexLock contention profiling is only available when TEKKOTSU_SHM_STYLE is NO_SHM" << endl;
 #endif
 	}
 }
@@ -729,3 +740,8 @@ void sim::ConfigErrorCheck::holdMultiprocess() {
 	holdMPValue=sim::config.multiprocess;
 	sim::config.multiprocess.addPrimitiveListener(this);
 }
+
+void sim::ConfigErrorCheck::watchLockProfiling() {
+	sim::config.lockProfiling.addPrimitiveListener(this);
+	plistValueChanged(sim::config.lockProfiling);
+}
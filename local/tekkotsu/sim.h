@@ -4,6 +4,7 @@
 
 #include "Events/EventTranslator.h"
 #include "IPC/MessageQueue.h"
+#include "IPC/LockFreeMessageQueue.h"
 #include "SharedGlobals.h"
 #include "IPC/SharedObject.h"
 #include "IPC/Thread.h"
@@ -22,6 +23,19 @@ public:
 	bool run();
 	~sim();
 	
+#if TEKKOTSU_SHM_STYLE==NO_SHM
+	// multiprocess is always false, so the queues don't need inter-process locks and semaphores
+	typedef LockFreeMessageQueue<500> EventQueue_t;
+	typedef LockFreeMessageQueue<50> MotionCommandQueue_t;
+	typedef LockFreeMessageQueue<50> SoundPlayQueue_t;
+	typedef LockFreeMessageQueue<1> CameraQueue_t;
+	typedef LockFreeMessageQueue<1> SensorQueue_t;
+	typedef LockFreeMessageQueue<1> TimerWakeup_t;
+	typedef LockFreeMessageQueue<1> MotionWakeup_t;
+	typedef LockFreeMessageQueue<ProcessID::NumProcesses+1> StatusRequest_t;
+	typedef LockFreeMessageQueue<1> MotionOutput_t;
+	typedef LockFreeMessageQueue<50> MotionOutputPIDs_t;
+#else
 	typedef MessageQueue<500> EventQueue_t;
 	typedef MessageQueue<50> MotionCommandQueue_t;
 	typedef MessageQueue<50> SoundPlayQueue_t;
@@ -32,6 +46,7 @@ public:
 	typedef MessageQueue<ProcessID::NumProcesses+1> StatusRequest_t;
 	typedef MessageQueue<1> MotionOutput_t;
 	typedef MessageQueue<50> MotionOutputPIDs_t;
+#endif
 	
 	static SimConfig config;
 	static IPCEventTranslator * etrans;
@@ -56,6 +71,7 @@ protected:
 		~ConfigErrorCheck();
 		virtual void plistValueChanged(const plist::PrimitiveBase& pl);
 		void holdMultiprocess();
+		void watchLockProfiling(); //!< applies SimConfig::lockProfiling, and again whenever it changes
 	protected:
 		bool holdMPValue;
 	};
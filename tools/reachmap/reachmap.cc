@@ -0,0 +1,116 @@
+#include "Motion/KinematicJoint.h"
+#include "Motion/ReachabilityMap.h"
+#include "IPC/TaskPool.h"
+#include "Shared/TimeET.h"
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+int usage(const char name[], int exitval) {
+	cerr
+	<< name << ": kinFile effectorFrame outFile [-v|--voxel size] [-n|--samples n] [-e|--eff x y z] [-a|--axis x y z] [-t|--threads n]\n"
+	"\n"
+	"  Samples random configurations of the chain leading to effectorFrame, and saves\n"
+	"  a ReachabilityMap of the effector positions which were reached to outFile.\n"
+	"\n"
+	"  --voxel   edge length of each voxel (default 10)\n"
+	"\n"
+	"  --samples number of configurations to sample (default 1000000)\n"
+	"\n"
+	"  --eff     sets an effector offset relative to effectorFrame\n"
+	"\n"
+	"  --axis    the axis of effectorFrame recorded as the approach direction (default 0 0 1)\n"
+	"\n"
+	"  --threads number of worker threads (default one per core)\n"
+	"\n"
+	;
+	return exitval;
+}
+
+float readFloat(const char v[]) {
+	char* end;
+	float x = strtof(v,&end);
+	if(*end!='\0')
+		throw invalid_argument(string("could not parse '")+v+"' as a number");
+	return x;
+}
+
+KinematicJoint* findJoint(KinematicJoint& kj, const string& name) {
+	if(kj.outputOffset.get()==name)
+		return &kj;
+	for(KinematicJoint::branch_iterator it=kj.getBranches().begin(); it!=kj.getBranches().end(); ++it)
+		if(KinematicJoint* f = findJoint(**it,name))
+			return f;
+	return NULL;
+}
+
+int main(int argc, const char* argv[]) {
+	try {
+		if(argc<4)
+			return usage(argv[0],2);
+		int argi=1;
+		string kinFile = argv[argi++];
+		string effName = argv[argi++];
+		string outFile = argv[argi++];
+		float voxel=10;
+		unsigned int samples=1000000;
+		fmat::Column<3> pEff, axis=fmat::pack(0,0,1);
+		while(argi!=argc) {
+			string flag=argv[argi++];
+			if(flag=="-v" || flag=="--voxel") {
+				if(argi==argc)
+					throw invalid_argument(flag+" requires a voxel size");
+				voxel = readFloat(argv[argi++]);
+			} else if(flag=="-n" || flag=="--samples") {
+				if(argi==argc)
+					throw invalid_argument(flag+" requires a number of samples");
+				samples = static_cast<unsigned int>(readFloat(argv[argi++]));
+			} else if(flag=="-e" || flag=="--eff" || flag=="-a" || flag=="--axis") {
+				if(argc-argi<3)
+					throw invalid_argument(flag+" requires x y z values");
+				fmat::Column<3>& v = (flag=="-e" || flag=="--eff") ? pEff : axis;
+				for(unsigned int i=0; i<3; ++i)
+					v[i] = readFloat(argv[argi++]);
+			} else if(flag=="-t" || flag=="--threads") {
+				if(argi==argc)
+					throw invalid_argument(flag+" requires a number of threads");
+				TaskPool::setDefaultWorkers(atoi(argv[argi++]));
+			} else {
+				cerr << "Unknown argument " << flag << endl;
+				return usage(argv[0],2);
+			}
+		}
+
+		Thread::initMainThread();
+
+		// (don't check the loadFile() return value, some libxml2 versions don't report the size parsed)
+		KinematicJoint root;
+		root.loadFile(kinFile.c_str());
+		KinematicJoint* eff = findJoint(root,effName);
+		if(eff==NULL) {
+			cerr << "Effector " << effName << " not found in " << kinFile << endl;
+			return 1;
+		}
+
+		ReachabilityMap map;
+		TimeET t;
+		map.generate(*eff, pEff, axis, voxel, samples, TaskPool::getDefault());
+		const double elapsed = t.Age().Value();
+		if(!map.saveFile(outFile))
+			return 1;
+
+		cout << effName << ": " << map.getNumJoints() << " mobile joints, " << samples << " samples in " << elapsed << "s" << endl;
+		cout << "Grid " << map.getDimension(0) << "x" << map.getDimension(1) << "x" << map.getDimension(2)
+			<< " from " << map.getMinBound() << " to " << map.getMaxBound() << endl;
+		cout << map.getNumReachable() << " of " << map.getNumVoxels() << " voxels reachable" << endl;
+
+		TaskPool::releaseDefault();
+	} catch(const exception& ex) {
+		cerr << "Error: " << ex.what() << endl;
+		return 1;
+	}
+	return 0;
+}
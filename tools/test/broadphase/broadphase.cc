@@ -0,0 +1,161 @@
+#include "Planners/RRT/ShapeSpacePlannerBase.h"
+#include "Planners/PlannerObstacles.h"
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Compares collision checking through the grid broad phase of ShapeSpaceCollisionCheckerBase
+// (findCandidates()) against scanning every obstacle.  The candidates must be exactly the
+// obstacles whose bounding boxes overlap or touch the query (plus those without a bounding box),
+// the collisions found must be the same, and the broad phase counters must add up to one entry
+// per obstacle per query.  Covers obstacles lying along the cell edges, queries reaching past the
+// edges of the grid, a coarse grid (made by a distant obstacle) with a wall clamped into its last
+// column, cylinders and ellipsoids (no bounding box), and rebuilding after obstacles are added,
+// removed, or moved.
+
+const unsigned int QUERIES = 5000;
+
+//! gives the test access to the obstacle list and the broad phase
+class TestChecker : public ShapeSpaceCollisionCheckerBase<3> {
+public:
+	TestChecker() : ShapeSpaceCollisionCheckerBase<3>(Shape<PolygonData>(), 0) {}
+
+	using ShapeSpaceCollisionCheckerBase<3>::obstacles;
+	using ShapeSpaceCollisionCheckerBase<3>::findCandidates;
+
+	//! returns true if @a body collides with an obstacle, only checking the broad phase candidates
+	bool collides(const PlannerObstacle3D& body) const {
+		const vector<unsigned int>& candidates = findCandidates(body.getBoundingBox());
+		for(size_t i=0; i<candidates.size(); ++i)
+			if(obstacles[candidates[i]]->collides(body))
+				return true;
+		return false;
+	}
+
+	//! returns true if @a body collides with an obstacle, checking every obstacle
+	bool collidesScan(const PlannerObstacle3D& body) const {
+		for(size_t i=0; i<obstacles.size(); ++i)
+			if(obstacles[i]->collides(body))
+				return true;
+		return false;
+	}
+
+	//! adds a box from @a min to @a max
+	void addBox(const fmat::Column<3>& min, const fmat::Column<3>& max) {
+		obstacles.push_back(new BoxObstacle((min+max)/2, (max-min)/2, fmat::Matrix<3,3>::identity()));
+	}
+};
+
+float randomUnit() { return rand()/(RAND_MAX+1.f); }
+
+//! returns true if @a bb has a finite extent in x and y, the test's own copy of the broad phase's rule
+bool isBounded(const BoundingBox3D& bb) {
+	return std::isfinite(bb.min[0]) && std::isfinite(bb.min[1]) && std::isfinite(bb.max[0]) && std::isfinite(bb.max[1])
+		&& bb.min[0]<=bb.max[0] && bb.min[1]<=bb.max[1];
+}
+
+//! returns the obstacles which should be candidates for @a box: everything if @a box is unbounded, otherwise the unbounded obstacles and those whose boxes overlap or touch @a box
+vector<unsigned int> expectedCandidates(const TestChecker& checker, const BoundingBox3D& box) {
+	vector<unsigned int> expected;
+	for(unsigned int i=0; i<checker.obstacles.size(); ++i) {
+		const BoundingBox3D bb = checker.obstacles[i]->getBoundingBox();
+		bool overlap = true;
+		for(size_t d=0; d<3 && isBounded(box) && isBounded(bb); ++d)
+			if(bb.min[d]>box.max[d] || box.min[d]>bb.max[d])
+				overlap = false;
+		if(overlap)
+			expected.push_back(i);
+	}
+	return expected;
+}
+
+//! returns a random query body within @a area; every fourth is a box on the 100mm lattice (so it touches the faces of lattice obstacles), and every tenth an ellipsoid (no bounding box)
+/*! The other queries are boxes, which the narrow phase checks against the lattice exactly.  (Spheres
+ *  go through GJK, which reports contact with boxes a few millimeters outside their bounding boxes.) */
+PlannerObstacle3D* randomBody(const BoundingBox3D& area, unsigned int n) {
+	const fmat::Column<3> dim = area.getDimensions();
+	fmat::Column<3> c;
+	for(size_t d=0; d<3; ++d)
+		c[d] = area.min[d] + randomUnit()*dim[d];
+	if(n%10==0)
+		return new EllipsoidObstacle(c, fmat::rotationZ(randomUnit()*float(M_PI)), fmat::pack(20+randomUnit()*80, 20+randomUnit()*40, 30));
+	if(n%4==0) {
+		for(size_t d=0; d<2; ++d)
+			c[d] = std::floor(c[d]/100)*100;
+		c[2] = 0;
+		const fmat::Column<3> ext = fmat::pack(50*(1+rand()%2), 50*(1+rand()%2), 50);
+		return new BoxObstacle(c+ext, ext, fmat::Matrix<3,3>::identity());
+	}
+	const fmat::Column<3> ext = fmat::pack(10+randomUnit()*100, 10+randomUnit()*100, 10+randomUnit()*50);
+	return new BoxObstacle(c, ext, n%2==0 ? fmat::Matrix<3,3>::identity() : fmat::rotationZ(randomUnit()*float(M_PI)));
+}
+
+//! runs random queries over @a area, comparing the broad phase against the full scan and checking the counters
+void check(const string& name, TestChecker& checker, const BoundingBox3D& area) {
+	checker.resetBroadPhaseStats();
+	unsigned int wrongCandidates=0, wrongCollisions=0, collisions=0;
+	unsigned long candidates=0;
+	for(unsigned int n=0; n<QUERIES; ++n) {
+		PlannerObstacle3D* body = randomBody(area,n);
+		const vector<unsigned int> found = checker.findCandidates(body->getBoundingBox());
+		candidates += found.size();
+		if(found!=expectedCandidates(checker,body->getBoundingBox()))
+			++wrongCandidates;
+		const bool hit = checker.collidesScan(*body);
+		if(checker.collides(*body)!=hit)
+			++wrongCollisions;
+		if(hit)
+			++collisions;
+		delete body;
+	}
+	candidates *= 2; // each query called findCandidates() twice, directly and through collides()
+	const TestChecker::BroadPhaseStats& stats = checker.getBroadPhaseStats();
+	const bool consistent = stats.queries==2*QUERIES && stats.candidates==candidates
+		&& stats.candidates+stats.rejected==stats.queries*checker.obstacles.size();
+	cout << name << ": " << checker.obstacles.size() << " obstacles, wrong candidates " << wrongCandidates << ", wrong collisions " << wrongCollisions
+		<< ", counters consistent " << consistent << endl;
+	cout << name << ": some collide " << (collisions>0) << ", some clear " << (collisions<QUERIES) << ", some rejected " << (stats.rejected>0) << endl;
+}
+
+int main() {
+	srand(0);
+	TestChecker checker;
+
+	// a checkerboard of 100mm boxes, whose faces lie on the 100mm cell edges of the grid
+	for(unsigned int r=0; r<20; ++r)
+		for(unsigned int c=r%2; c<20; c+=2)
+			checker.addBox(fmat::pack(c*100, r*100, 0), fmat::pack(c*100+100, r*100+100, 100));
+	// queries reach past the obstacles on every side, and above them
+	const BoundingBox3D area(fmat::pack(-300,-300,-50), fmat::pack(2300,2300,250));
+	check("Cell edges", checker, area);
+
+	// cylinders and ellipsoids don't have bounding boxes, so every query must check them
+	checker.obstacles.push_back(new CylindricalObstacle(fmat::pack(550,550,50), fmat::Matrix<3,3>::identity(), 120, 60));
+	checker.obstacles.push_back(new EllipsoidObstacle(fmat::pack(1450,850,50), fmat::rotationZ(0.5f), fmat::pack(150,60,40)));
+	check("Unbounded", checker, area);
+
+	// removing them rebuilds the grid
+	for(unsigned int i=0; i<2; ++i) {
+		delete checker.obstacles.back();
+		checker.obstacles.pop_back();
+	}
+	check("Removed", checker, area);
+
+	// a distant obstacle spreads the grid so far it must coarsen, and a long wall reaches across the last column
+	checker.addBox(fmat::pack(200000,200000,0), fmat::pack(200100,200100,100));
+	checker.addBox(fmat::pack(-50,950,0), fmat::pack(200100,1000,100));
+	check("Coarse grid", checker, area);
+	check("Coarse grid far", checker, BoundingBox3D(fmat::pack(199000,199000,-50), fmat::pack(201000,201000,250)));
+
+	// moving obstacles in place needs rebuildBroadPhase(), the count doesn't change
+	for(unsigned int i=0; i<checker.obstacles.size(); i+=3)
+		checker.obstacles[i]->updatePosition(checker.obstacles[i]->getCenter()+fmat::pack(35,-35,0));
+	checker.rebuildBroadPhase();
+	check("Moved", checker, area);
+
+	return EXIT_SUCCESS;
+}
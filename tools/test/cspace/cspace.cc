@@ -0,0 +1,183 @@
+#include "Planners/Navigation/ConfigurationSpaceMap.h"
+#include "Planners/GridWorld.h"
+#include "Planners/PlannerObstacles.h"
+#include "IPC/TaskPool.h"
+#include "IPC/Thread.h"
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+using namespace std;
+
+// Rasterizes the configuration space of an off-center footprint among posts and walls.  Every
+// configuration the map reports as free must be clear of the obstacles (the map is conservative),
+// incremental updates must give the same map as recomputing from scratch while touching fewer
+// cells, and the exported GridWorld must follow the map through updateGridWorld().
+
+const float INFLATION = 10;
+const unsigned int SAMPLES = 20000;
+
+//! an obstacle of the test world, either a circular post or a rectangular wall
+struct Obstacle {
+	Obstacle(float x_, float y_, float r) : x(x_), y(y_), w(r), h(0), orient(0) {}
+	Obstacle(float x_, float y_, float w_, float h_, float o) : x(x_), y(y_), w(w_), h(h_), orient(o) {}
+	//! returns a new planner obstacle, inflated by @a inflation
+	PlannerObstacle2D* create(float inflation) const {
+		if(h==0)
+			return new CircularObstacle(x,y,w+inflation);
+		return new RectangularObstacle(fmat::pack(x,y),fmat::pack(w+inflation,h+inflation),orient);
+	}
+	float x, y, w, h, orient;
+};
+
+//! returns new planner obstacles for @a world, inflated by @a inflation
+vector<PlannerObstacle2D*> create(const vector<Obstacle>& world, float inflation) {
+	vector<PlannerObstacle2D*> obs;
+	for(size_t i=0; i<world.size(); ++i)
+		obs.push_back(world[i].create(inflation));
+	return obs;
+}
+
+//! deletes the obstacles in @a obs
+void destroy(vector<PlannerObstacle2D*>& obs) {
+	for(size_t i=0; i<obs.size(); ++i)
+		delete obs[i];
+	obs.clear();
+}
+
+float randomUnit() { return rand()/(RAND_MAX+1.f); }
+
+//! returns true if @a a and @a b have the same occupancy in every cell
+bool sameMap(const ConfigurationSpaceMap& a, const ConfigurationSpaceMap& b) {
+	for(unsigned int h=0; h<a.getNumHeadings(); ++h)
+		for(size_t r=0; r<a.getRows(); ++r)
+			for(size_t c=0; c<a.getCols(); ++c)
+				if(a.isOccupied(r,c,h)!=b.isOccupied(r,c,h))
+					return false;
+	return true;
+}
+
+//! samples random configurations, counts those the map reports free which actually collide, and those reported occupied which are clear
+void sample(const ConfigurationSpaceMap& map, const vector<Obstacle>& world, const HierarchicalObstacle& footprint, unsigned int& falseFree, unsigned int& falseOccupied) {
+	vector<PlannerObstacle2D*> obs = create(world,INFLATION);
+	HierarchicalObstacle fp(footprint);
+	falseFree = falseOccupied = 0;
+	for(unsigned int n=0; n<SAMPLES; ++n) {
+		const float x = map.getMinBound()[0] + randomUnit()*map.getCols()*map.getCellSize();
+		const float y = map.getMinBound()[1] + randomUnit()*map.getRows()*map.getCellSize();
+		const AngTwoPi theta = randomUnit()*float(2*M_PI);
+		fp.updatePosition(fmat::pack(x,y));
+		fp.updateRotation(fmat::rotation2D(theta));
+		bool hit = false;
+		for(size_t i=0; i<obs.size() && !hit; ++i)
+			hit = obs[i]->collides(fp);
+		if(map.isFree(x,y,theta) && hit)
+			++falseFree;
+		else if(!map.isFree(x,y,theta) && !hit)
+			++falseOccupied;
+	}
+	destroy(obs);
+}
+
+//! returns the number of free cells in @a gw
+size_t countFree(const GridWorld& gw) {
+	size_t n=0;
+	for(size_t r=0; r<gw.getRows(); ++r)
+		for(size_t c=0; c<gw.getCols(); ++c)
+			if(gw(r,c)==' ')
+				++n;
+	return n;
+}
+
+int main() {
+	Thread::initMainThread();
+	srand(0);
+	TaskPool pool(3);
+
+	// a footprint whose center of rotation is off toward the back, like a robot's wheelbase
+	HierarchicalObstacle footprint;
+	footprint.add(new RectangularObstacle(fmat::pack(40,0),fmat::pack(120,60),0));
+	footprint.add(new CircularObstacle(-60,0,50));
+
+	vector<Obstacle> world;
+	for(unsigned int i=0; i<12; ++i)
+		world.push_back(Obstacle(250+randomUnit()*2500,250+randomUnit()*1500,20+randomUnit()*40));
+	world.push_back(Obstacle(1500,1000,400,30,0.5f));
+	world.push_back(Obstacle(2800,1600,30,300,0));
+
+	const BoundingBox2D area(fmat::pack(0,0),fmat::pack(3000,2000));
+	ConfigurationSpaceMap map(area,50,16);
+	const float margin = map.getMargin(footprint);
+	const size_t cells = map.getRows()*map.getCols();
+	cout << "Map: " << map.getCols() << "x" << map.getRows() << " cells, " << map.getNumHeadings() << " headings, margin " << margin << endl;
+	cout << "Occupied before the first update: " << (map.getNumFree(0)==0) << endl;
+
+	size_t recomputed = map.updateObstacles(create(world,INFLATION+margin),INFLATION,footprint,pool);
+	cout << "First update recomputed " << recomputed << " of " << cells << " cells" << endl;
+	cout << "Free cells facing 0: " << map.getNumFree(0) << ", facing π/2: " << map.getNumFree(4) << endl;
+
+	// occupancy queries
+	cout << "Open corner free: " << map.isFree(2950,50,0.f) << endl;
+	cout << "Post center free: " << map.isFree(world[0].x,world[0].y,0.f) << endl;
+	cout << "Outside the map free: " << map.isFree(-10,50,0.f) << " " << map.isFree(50,2000,0.f) << endl;
+	cout << "NaN free: " << map.isFree(NAN,50,0.f) << endl;
+	// beside the wall at (2800,1600), the short back of the footprint fits toward the wall, but not the long front
+	cout << "Beside the wall, facing away " << map.isFree(2560,1610,float(M_PI)) << ", facing it " << map.isFree(2560,1610,0.f) << endl;
+
+	unsigned int falseFree, falseOccupied;
+	sample(map,world,footprint,falseFree,falseOccupied);
+	cout << "Sampled configurations: " << falseFree << " free but colliding, under 20% occupied but clear: " << (falseOccupied<SAMPLES/5) << endl;
+
+	// nothing changed: nothing recomputed
+	recomputed = map.updateObstacles(create(world,INFLATION+margin),INFLATION,footprint,pool);
+	cout << "Unchanged update recomputed " << recomputed << " cells" << endl;
+
+	// move a post, remove the diagonal wall, add a new post
+	world[3].x += 200;
+	world.erase(world.begin()+12);
+	world.push_back(Obstacle(2700,300,60));
+	GridWorld gw;
+	map.exportGridWorld(0,gw);
+	cout << "Exported GridWorld matches free cells: " << (countFree(gw)==map.getNumFree(0)) << endl;
+	recomputed = map.updateObstacles(create(world,INFLATION+margin),INFLATION,footprint,pool);
+	ConfigurationSpaceMap fresh(area,50,16);
+	fresh.updateObstacles(create(world,INFLATION+margin),INFLATION,footprint,pool);
+	cout << "Incremental update recomputed " << recomputed << " of " << cells << " cells, matches full recompute: " << sameMap(map,fresh) << endl;
+	sample(map,world,footprint,falseFree,falseOccupied);
+	cout << "After the update, free but colliding: " << falseFree << endl;
+
+	// the GridWorld follows the changes
+	GridWorld expected;
+	fresh.exportGridWorld(0,expected);
+	size_t differing=0;
+	for(size_t r=0; r<gw.getRows(); ++r)
+		for(size_t c=0; c<gw.getCols(); ++c)
+			if(gw(r,c)!=expected(r,c))
+				++differing;
+	vector<GridWorld::State> affected;
+	const size_t changed = map.updateGridWorld(0,gw,affected);
+	size_t stillDiffering=0;
+	for(size_t r=0; r<gw.getRows(); ++r)
+		for(size_t c=0; c<gw.getCols(); ++c)
+			if(gw(r,c)!=expected(r,c))
+				++stillDiffering;
+	cout << "updateGridWorld changed " << changed << " cells (" << differing << " differed), now matches: " << (stillDiffering==0) << ", affected states: " << !affected.empty() << endl;
+
+	// a new inflation recomputes everything
+	recomputed = map.updateObstacles(create(world,2*INFLATION+margin),2*INFLATION,footprint,pool);
+	cout << "New inflation recomputed " << recomputed << " of " << cells << " cells, fewer free: " << (map.getNumFree(0)<fresh.getNumFree(0)) << endl;
+
+	// a single heading bin doesn't rotate a round footprint, so it only needs the cell margin
+	HierarchicalObstacle round;
+	round.add(new CircularObstacle(0,0,80));
+	ConfigurationSpaceMap flat(area,50,1);
+	flat.updateObstacles(create(world,INFLATION+flat.getMargin(round)),INFLATION,round,pool);
+	sample(flat,world,round,falseFree,falseOccupied);
+	cout << "Single heading margin " << flat.getMargin(round) << ", free but colliding: " << falseFree << endl;
+
+	map.clear();
+	cout << "Cleared map free cells: " << map.getNumFree(0) << ", open corner free: " << map.isFree(2950,50,0.f) << endl;
+
+	return EXIT_SUCCESS;
+}
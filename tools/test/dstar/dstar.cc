@@ -0,0 +1,143 @@
+#include "Planners/AStar.h"
+#include "Planners/DStarLite.h"
+#include "Planners/GridWorld.h"
+#include "Shared/TimeET.h"
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+
+using namespace std;
+
+// Replans across a cluttered grid as cells are blocked and cleared and the robot moves along its
+// path.  After each change, DStarLite's repaired plan must cost the same as a fresh A★ search,
+// while expanding far fewer states.  Then compares ARA★ against restarting weighted A★ (anytime()).
+
+const size_t SIZE = 80;
+const unsigned int STEPS = 40;
+const unsigned int TOGGLES = 30;
+
+typedef AStar::Results<GridWorld::State> Results;
+
+bool near(float a, float b) { return std::abs(a-b) < 1e-3f*std::max(1.f,std::abs(a)); }
+
+//! returns true if @a path is a sequence of moves from @a gw's expansions costing @a cost
+bool checkPath(const GridWorld& gw, const vector<GridWorld::State>& path, float cost) {
+	float sum = 0;
+	for(size_t i=1; i<path.size(); ++i) {
+		const vector<pair<float,GridWorld::State> >& next = gw.expand(NULL,path[i-1],path.back());
+		size_t j=0;
+		while(j<next.size() && !(next[j].second==path[i]))
+			++j;
+		if(j==next.size())
+			return false;
+		sum += next[j].first;
+	}
+	return near(sum,cost);
+}
+
+//! reports each path found by an anytime search
+bool report(const Results& res, float weight) {
+	cout << "  weight " << weight << " cost " << res.cost << endl;
+	return true;
+}
+
+int main() {
+	srand(0);
+	GridWorld gw(SIZE,SIZE);
+	for(size_t r=0; r<SIZE; ++r)
+		for(size_t c=0; c<SIZE; ++c)
+			if(rand()%100 < 20)
+				gw(r,c) = '#';
+	GridWorld::State start(0,0), goal(SIZE-1,SIZE-1);
+	gw[start] = gw[goal] = ' ';
+
+	DStarLite<GridWorld> dstar(gw,start,goal);
+	const bool timedOut = (dstar.plan(1e-9f)==DStarLite<GridWorld>::TIMEOUT);
+	cout << "Time budget @VAR " << (timedOut ? "timed out" : "finished") << endl; // depends on the machine
+	cout << "Resumed: " << (dstar.plan()==DStarLite<GridWorld>::PATH_FOUND ? "path found" : "no path") << endl;
+
+	Results initial = AStar::astar(gw,start,goal);
+	cout << "Initial plan matches A*: " << near(dstar.getCost(),initial.cost) << endl;
+	const size_t initialExpansions = dstar.getNumExpansions();
+
+	unsigned int matches=0, valid=0, blockedPaths=0;
+	size_t fresh=0;
+	for(unsigned int step=0; step<STEPS; ++step) {
+		// advance a few cells along the current plan
+		vector<GridWorld::State> path;
+		dstar.getPath(path);
+		if(path.size()>3) {
+			start = path[3];
+			dstar.setStart(start);
+		}
+		// toggle cells near the robot, where changes matter most
+		vector<GridWorld::State> changed;
+		for(unsigned int t=0; t<TOGGLES; ++t) {
+			const GridWorld::State x(min(SIZE-1, size_t(max(0, int(start.r)+rand()%21-10))), min(SIZE-1, size_t(max(0, int(start.c)+rand()%21-10))));
+			if(x==start || x==goal)
+				continue;
+			gw[x] = (gw[x]==' ') ? '#' : ' ';
+			gw.affected(x,changed);
+		}
+		dstar.updateStates(changed);
+
+		const bool found = (dstar.plan()==DStarLite<GridWorld>::PATH_FOUND);
+		Results res = AStar::astar(gw,start,goal);
+		fresh += res.closed.size();
+		if(found != !res.path.empty()) {
+			cout << "Step " << step << ": D* Lite " << (found ? "found" : "didn't find") << " a path" << endl;
+			continue;
+		}
+		if(!found) {
+			++blockedPaths;
+			++matches;
+			++valid;
+			continue;
+		}
+		if(near(dstar.getCost(),res.cost))
+			++matches;
+		else
+			cout << "Step " << step << ": D* Lite cost " << dstar.getCost() << " vs A* " << res.cost << endl;
+		if(dstar.getPath(path) && path.front()==start && path.back()==goal && checkPath(gw,path,dstar.getCost()))
+			++valid;
+	}
+	cout << "Replans matching A*: " << matches << " of " << STEPS << " (" << blockedPaths << " without a path)" << endl;
+	cout << "Valid paths: " << valid << " of " << STEPS << endl;
+	cout << "Expansions per replan @VAR D* Lite " << (dstar.getNumExpansions()-initialExpansions)/STEPS << ", A* " << fresh/STEPS << endl;
+
+	// anytime search on a fresh copy of the original map
+	srand(0);
+	GridWorld map2(SIZE,SIZE);
+	for(size_t r=0; r<SIZE; ++r)
+		for(size_t c=0; c<SIZE; ++c)
+			if(rand()%100 < 20)
+				map2(r,c) = '#';
+	start = GridWorld::State(0,0);
+	map2[start] = map2[goal] = ' ';
+	Results optimal = AStar::astar(map2,start,goal);
+
+	cout << "ARA*:" << endl;
+	TimeET timer;
+	Results ara = AStar::ara(map2,start,goal,report,3.f,0.5f);
+	const double araTime = timer.Age().Value();
+	cout << "ARA* final cost matches A*: " << near(ara.cost,optimal.cost) << ", path valid: " << checkPath(map2,ara.path,ara.cost) << endl;
+
+	// without a decrement, the second iteration goes straight to weight 1 and then stops
+	cout << "ARA* without a decrement:" << endl;
+	Results araOnce = AStar::ara(map2,start,goal,report,3.f,0.f);
+	cout << "Final cost matches A*: " << near(araOnce.cost,optimal.cost) << endl;
+
+	cout << "Anytime A*:" << endl;
+	timer.Set();
+	Results any = AStar::anytime(map2,start,goal,report,3.f,0.5f);
+	const double anyTime = timer.Age().Value();
+	cout << "Anytime final cost matches A*: " << near(any.cost,optimal.cost) << endl;
+
+	// without a decrement, the second iteration goes straight to weight 1 and then stops
+	cout << "Anytime A* without a decrement:" << endl;
+	Results once = AStar::anytime(map2,start,goal,report,3.f,0.f);
+	cout << "Final cost matches A*: " << near(once.cost,optimal.cost) << endl;
+	cout << "Anytime time @VAR ARA* " << araTime << ", restarting " << anyTime << endl;
+
+	return EXIT_SUCCESS;
+}
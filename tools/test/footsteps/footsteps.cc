@@ -3,6 +3,7 @@
 #include "local/DeviceDrivers/MirageComm.h"
 #include "Wireless/netstream.h"
 #include "Shared/TimeET.h"
+#include "IPC/TaskPool.h"
 #include <iostream>
 
 const float OBSTACLE_HEIGHT=2;
@@ -25,6 +26,7 @@ int usage(const std::string& name, const std::string& msg) {
 	std::cerr << "Usage: " << name << " [-w|--walk gait-file] [-k|--kin kinematics-file]\n";
 	std::cerr << "       [-e|--env environment-file] [-m|--mirage [host]] [-b|--bound dist]\n";
 	std::cerr << "       [-r|--relax relaxation] [-s|--start x y] [-g|--goal x y] [--no-reorient] [--no-rehab]\n";
+	std::cerr << "       [-a|--anytime weight] [-j|--threads n]\n";
 	std::cerr << "       [-f|--fig file] [--hide-path] [--show-work] [--show-steps] [--show-support] [--show-grid]\n";
 	std::cerr << "       [-o|--ori len] [-v|--view x y w h] [--style css-file] [--embed-style]\n";
 	return msg.size()==0 ? EXIT_SUCCESS : 2;
@@ -32,7 +34,18 @@ int usage(const std::string& name, const std::string& msg) {
 
 static std::string mirage;
 
+//! reports each improvement found by AStar::anytime()
+struct ReportImprovement {
+	explicit ReportImprovement(const TimeET& start) : startTime(start) {}
+	bool operator()(const AStarResults& res, float weight) const {
+		std::cout << "Weight " << weight << ": " << res.path.size() << " steps, cost " << res.cost << " after " << startTime.Age() << std::endl;
+		return true;
+	}
+	const TimeET& startTime;
+};
+
 int main(int argc, const char* argv[]) {
+	Thread::initMainThread();
 	std::string kinematicsFile("robot.kin");
 	XWalkParameters xp;
 	plist::ArrayOf<PlannerObstacle> obs;
@@ -46,6 +59,8 @@ int main(int argc, const char* argv[]) {
 	std::string styleFile="style.css";
 	std::string obsFile;
 	float boundDist=0;
+	float anytimeWeight=0;
+	int threads=0;
 	
 	for(int i=1; i<argc; ++i) {
 		std::string arg = argv[i];
@@ -69,6 +84,14 @@ int main(int argc, const char* argv[]) {
 				if(++i==argc) throw std::invalid_argument("Missing argument for "+arg);
 				std::stringstream ss(argv[i]);
 				if(!(ss >> boundDist)) throw std::invalid_argument("Bad value for "+arg);
+			} else if(arg=="-a" || arg=="--anytime") {
+				if(++i==argc) throw std::invalid_argument("Missing argument for "+arg);
+				std::stringstream ss(argv[i]);
+				if(!(ss >> anytimeWeight)) throw std::invalid_argument("Bad value for "+arg);
+			} else if(arg=="-j" || arg=="--threads") {
+				if(++i==argc) throw std::invalid_argument("Missing argument for "+arg);
+				std::stringstream ss(argv[i]);
+				if(!(ss >> threads)) throw std::invalid_argument("Bad value for "+arg);
 			} else if(arg=="-s" || arg=="--start") {
 				if((i+=2)>=argc) throw std::invalid_argument("Missing argument for "+arg);
 				std::stringstream ss(argv[i-1]);
@@ -150,9 +173,22 @@ int main(int argc, const char* argv[]) {
 	
 	for(size_t i=0; i<obs.size(); ++i)
 		f.addObstacle(obs[i].clone());
+	f.indexObstacles();
+	
+	TaskPool pool(threads>1 ? threads-1 : 0);
+	if(threads>1)
+		f.pool = &pool;
 	
 	TimeET planningTime;
-	AStarResults res = AStar::astar(f,initial,goal,boundDist);
+	AStarResults res;
+	if(anytimeWeight>0) {
+		f.cacheExpansions = true;
+		AStarResults best = AStar::anytime(f,initial,goal,ReportImprovement(planningTime),anytimeWeight,(anytimeWeight-1)/4,boundDist);
+		res.swap(best);
+	} else {
+		AStarResults best = AStar::astar(f,initial,goal,boundDist);
+		res.swap(best);
+	}
 	planningTime = planningTime.Age();
 	
 	ionetstream netcomm;
@@ -0,0 +1,197 @@
+#include "Motion/KinematicJoint.h"
+#include "Motion/IKSolver.h"
+#include "Motion/IKBatch.h"
+#include "Motion/ReachabilityMap.h"
+#include "IPC/TaskPool.h"
+#include "Shared/TimeET.h"
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Checks ReachabilityMap generation and loading, and that IKBatch gives the same
+// solutions as solving serially, then compares solving with and without the map.
+
+using namespace std;
+
+const char* MAP_FILE = "test-reachability.map";
+unsigned int N = 300; // number of reachable targets
+unsigned int UNREACHABLE = 100; // number of targets beyond the workspace
+
+KinematicJoint* findJoint(KinematicJoint& kj, const string& name) {
+	if(kj.outputOffset.get()==name)
+		return &kj;
+	for(KinematicJoint::branch_iterator it=kj.getBranches().begin(); it!=kj.getBranches().end(); ++it)
+		if(KinematicJoint* f = findJoint(**it,name))
+			return f;
+	return NULL;
+}
+
+float randomUnit() { return rand()/(float)RAND_MAX; }
+
+// discards output, IKGradientSolver reports each solve on cout (unbuffered, so it's safe to share between threads)
+struct NullBuf : public streambuf {
+	virtual int overflow(int c) { return c; }
+};
+
+int main(int argc, const char* argv[]) {
+	if(argc<3) {
+		cerr << argv[0] << ": kinFile effectorFrame" << endl;
+		return 2;
+	}
+	Thread::initMainThread();
+	TaskPool pool(3);
+
+	KinematicJoint root;
+	root.loadFile(argv[1]);
+	KinematicJoint* eff = findJoint(root,argv[2]);
+	if(eff==NULL) {
+		cerr << "Effector " << argv[2] << " not found in " << argv[1] << endl;
+		return 1;
+	}
+	vector<KinematicJoint*> chain;
+	for(KinematicJoint* kj=eff; kj!=NULL; kj=kj->getParent())
+		if(kj->isMobile())
+			chain.insert(chain.begin(),kj);
+	for(size_t i=0; i<chain.size(); ++i)
+		chain[i]->setQ((chain[i]->qmin+chain[i]->qmax)/2);
+	vector<float> start(chain.size());
+	for(size_t i=0; i<chain.size(); ++i)
+		start[i]=chain[i]->getQ();
+
+	// *** ReachabilityMap *** //
+	const IKSolver::Point pEff;
+	const float VOXEL=10;
+	ReachabilityMap generated;
+	generated.generate(*eff, pEff, fmat::pack(0,0,1), VOXEL, 100000, pool);
+	ReachabilityMap serial;
+	{
+		TaskPool none(0);
+		serial.generate(*eff, pEff, fmat::pack(0,0,1), VOXEL, 100000, none);
+	}
+	cout << "Map: " << generated.getNumJoints() << " joints, reachable voxels @VAR " << generated.getNumReachable() << " of " << generated.getNumVoxels() << endl;
+	size_t differ=0;
+	for(size_t i=0; i<generated.getNumVoxels(); ++i) {
+		const fmat::Column<3> c = generated.voxelCenter(i);
+		if(generated.getDirections(c)!=serial.getDirections(c))
+			++differ;
+	}
+	cout << "Voxels differing with no workers: " << differ << endl;
+
+	generated.saveFile(MAP_FILE);
+	ReachabilityMap loaded;
+	cout << "Loaded: " << loaded.loadFile(MAP_FILE) << endl;
+	differ=0;
+	size_t badSeeds=0;
+	for(size_t i=0; i<generated.getNumVoxels(); ++i) {
+		const fmat::Column<3> c = generated.voxelCenter(i);
+		const float* a = generated.getSeed(c);
+		const float* b = loaded.getSeed(c);
+		if(generated.getDirections(c)!=loaded.getDirections(c) || (a==NULL)!=(b==NULL)) {
+			++differ;
+			continue;
+		}
+		if(a==NULL)
+			continue;
+		for(size_t j=0; j<chain.size(); ++j) {
+			if(a[j]!=b[j])
+				++differ;
+			chain[j]->setQ(b[j]);
+		}
+		// the seed must actually put the effector in the voxel
+		if(loaded.voxelIndex(eff->getFullT()*pEff)!=i)
+			++badSeeds;
+	}
+	cout << "Voxels differing after reload: " << differ << endl;
+	cout << "Seeds outside their voxel: " << badSeeds << endl;
+	cout << "Outside bounds reachable: " << loaded.isReachable(loaded.getMaxBound()+fmat::pack(1,1,1)) << endl;
+
+	// *** IKBatch *** //
+	for(size_t i=0; i<chain.size(); ++i)
+		chain[i]->setQ(start[i]);
+	srand(1);
+	vector<IKSolver::Point> points;
+	for(unsigned int t=0; t<N; ++t) {
+		for(size_t i=0; i<chain.size(); ++i)
+			chain[i]->setQ(chain[i]->qmin + (chain[i]->qmax-chain[i]->qmin)*randomUnit());
+		points.push_back(eff->getWorldPosition());
+	}
+	for(unsigned int t=0; t<UNREACHABLE; ++t)
+		points.push_back(IKSolver::Point(5000+randomUnit(),randomUnit(),randomUnit()));
+	for(size_t i=0; i<chain.size(); ++i)
+		chain[i]->setQ(start[i]);
+
+	const IKSolver::Rotation oriEff;
+	const IKSolver::Rotation oriTgt;
+	vector<IKBatch::Target> targets;
+	for(size_t t=0; t<points.size(); ++t)
+		targets.push_back(IKBatch::Target(pEff,oriEff,points[t],1,oriTgt,0));
+
+	NullBuf nullBuf;
+	streambuf* orig = cout.rdbuf(&nullBuf);
+
+	// serially, on the original chain
+	const IKSolver& solver = eff->getIK();
+	vector<vector<float> > serialQ(targets.size());
+	TimeET timer;
+	for(size_t t=0; t<targets.size(); ++t) {
+		for(size_t i=0; i<chain.size(); ++i)
+			chain[i]->setQ(start[i]);
+		solver.solve(pEff,oriEff,*eff,points[t],1,oriTgt,0);
+		for(size_t i=0; i<chain.size(); ++i)
+			serialQ[t].push_back(chain[i]->getQ());
+	}
+	const double serialTime=timer.Age().Value();
+	for(size_t i=0; i<chain.size(); ++i)
+		chain[i]->setQ(start[i]);
+
+	IKBatch batch(*eff,pool);
+	vector<IKBatch::Solution> solutions;
+	timer.Set();
+	batch.solve(targets,solutions);
+	const double batchTime=timer.Age().Value();
+	batch.setReachabilityMap(&loaded);
+	timer.Set();
+	vector<IKBatch::Solution> mapSolutions;
+	batch.solve(targets,mapSolutions);
+	const double mapTime=timer.Age().Value();
+	cout.rdbuf(orig);
+
+	differ=0;
+	for(size_t t=0; t<targets.size(); ++t)
+		if(solutions[t].skipped || solutions[t].q!=serialQ[t])
+			++differ;
+	cout << "Batch solutions differing from serial: " << differ << endl;
+
+	// how many reachable targets are actually reached, starting from the starting posture vs. from the map's seeds
+	unsigned int solvedPlain=0;
+	for(size_t t=0; t<N; ++t) {
+		for(size_t i=0; i<chain.size(); ++i)
+			chain[i]->setQ(solutions[t].q[i]);
+		if((eff->getWorldPosition()-points[t]).norm()<1)
+			++solvedPlain;
+	}
+	unsigned int skippedReachable=0, skippedUnreachable=0, solved=0;
+	for(size_t t=0; t<targets.size(); ++t) {
+		if(mapSolutions[t].skipped) {
+			if(t<N)
+				++skippedReachable;
+			else
+				++skippedUnreachable;
+		} else if(t<N) {
+			for(size_t i=0; i<chain.size(); ++i)
+				chain[i]->setQ(mapSolutions[t].q[i]);
+			if((eff->getWorldPosition()-points[t]).norm()<1)
+				++solved;
+		}
+	}
+	cout << "Unreachable targets skipped: " << skippedUnreachable << " of " << UNREACHABLE << endl;
+	cout << "Reachable targets skipped @VAR " << skippedReachable << ", solved " << solved << " of " << N << " (" << solvedPlain << " without the map)" << endl;
+	cout << "Time @VAR serial " << serialTime*1000 << "ms, batch " << batchTime*1000 << "ms, batch with map " << mapTime*1000 << "ms" << endl;
+
+	batch.setReachabilityMap(NULL);
+	loaded.clear();
+	remove(MAP_FILE);
+	return EXIT_SUCCESS;
+}
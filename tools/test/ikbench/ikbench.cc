@@ -0,0 +1,208 @@
+#include "Motion/KinematicJoint.h"
+#include "Motion/IKSolver.h"
+#include "Motion/IKDampedLeastSquares.h"
+#include "Shared/TimeET.h"
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <set>
+#include <string>
+#include <vector>
+
+// Compares the registered IK solvers on a kinematic chain: solve time,
+// iteration count (for the iterative solvers), success rate, and final error.
+//
+// Two scenarios are run:
+//   random:   each target is reached by a random configuration of the chain,
+//             the joints are reset to the initial posture before each solve
+//   tracking: targets follow a path in small steps, again resetting the joints
+//             before each solve (as when the tree is refreshed from the robot's
+//             state), so solvers which warm start from their previous solution benefit
+//
+// IKCalliope is only registered when built for a Calliope target against the full framework.
+
+using namespace std;
+
+unsigned int N = 200; // number of targets per scenario
+bool useOri = false; // also constrain the orientation of the effector
+const float SOLVED_TOLERANCE = 1; // mm, final error to count as solved, regardless of the solver's return value
+
+KinematicJoint* findJoint(KinematicJoint& kj, const string& name) {
+	if(kj.outputOffset.get()==name)
+		return &kj;
+	for(KinematicJoint::branch_iterator it=kj.getBranches().begin(); it!=kj.getBranches().end(); ++it)
+		if(KinematicJoint* f = findJoint(**it,name))
+			return f;
+	return NULL;
+}
+
+float randomQ(const KinematicJoint& kj) {
+	return kj.qmin + (kj.qmax-kj.qmin)*(rand()/(float)RAND_MAX);
+}
+
+struct Target {
+	vector<float> q; // configuration which reaches the target
+	IKSolver::Point p;
+	IKSolver::Rotation ori;
+};
+
+struct Results {
+	Results() : solves(0), solved(0), claimed(0), time(0), maxTime(0), iterations(0), counted(0), err(0) {}
+	unsigned int solves, solved, claimed;
+	double time, maxTime;
+	unsigned long iterations, counted;
+	double err;
+};
+
+// runs solver over targets, each from the initial posture q0
+Results run(const IKSolver& solver, KinematicJoint& eff, const vector<KinematicJoint*>& chain, const vector<float>& q0, const vector<Target>& targets) {
+	Results res;
+	const IKDampedLeastSquares* dls = dynamic_cast<const IKDampedLeastSquares*>(&solver);
+	if(dls!=NULL)
+		dls->clearWarmStart();
+	IKSolver::Point pEff;
+	IKSolver::Rotation oriEff;
+	for(size_t t=0; t<targets.size(); ++t) {
+		for(size_t i=0; i<chain.size(); ++i)
+			chain[i]->setQ(q0[i]);
+		// IKGradientSolver reports its iteration count on cout, capture it
+		stringstream captured;
+		streambuf* orig = cout.rdbuf(captured.rdbuf());
+		TimeET start;
+		bool ok = solver.solve(pEff, oriEff, eff, targets[t].p, 1, targets[t].ori, useOri ? 1 : 0);
+		double elapsed = start.Age().Value()*1e6;
+		cout.rdbuf(orig);
+
+		res.solves++;
+		res.claimed += ok;
+		res.time += elapsed;
+		if(elapsed>res.maxTime)
+			res.maxTime=elapsed;
+		float err = (eff.getWorldPosition()-targets[t].p).norm();
+		res.err += err;
+		if(err<SOLVED_TOLERANCE)
+			res.solved++;
+		if(dls!=NULL) {
+			res.iterations += dls->getLastIterations();
+			res.counted++;
+		} else {
+			string line;
+			while(getline(captured,line)) {
+				if(line.compare(0,12,"Iterations: ")==0) {
+					res.iterations += atoi(line.c_str()+12);
+					res.counted++;
+				}
+			}
+		}
+	}
+	return res;
+}
+
+void report(const string& name, const Results& r) {
+	cout << "  " << setw(22) << left << name << right << fixed << setprecision(1)
+		<< setw(6) << 100.*r.solved/r.solves << "%" << setw(6) << 100.*r.claimed/r.solves << "%"
+		<< setw(10) << r.time/r.solves << setw(10) << r.maxTime;
+	if(r.counted>0)
+		cout << setw(8) << (double)r.iterations/r.counted;
+	else
+		cout << setw(8) << "-";
+	cout << setprecision(3) << setw(10) << r.err/r.solves << endl;
+}
+
+void header(const string& scenario) {
+	cout << scenario << ":\n  " << setw(22) << left << "solver" << right
+		<< setw(7) << "solved" << setw(7) << "claim" << setw(10) << "mean µs" << setw(10) << "max µs"
+		<< setw(8) << "iters" << setw(10) << "err mm" << endl;
+}
+
+int main(int argc, const char* argv[]) {
+	if(argc<3) {
+		cerr << argv[0] << ": kinFile effectorFrame [-n targets] [-o] [solver ...]\n"
+			"  -n  number of targets in each scenario (default " << N << ")\n"
+			"  -o  constrain orientation as well as position\n"
+			"  solvers default to all registered (except the \"\" default alias)" << endl;
+		return 2;
+	}
+	set<string> solvers;
+	for(int argi=3; argi<argc; ++argi) {
+		string arg=argv[argi];
+		if(arg=="-n" && argi+1<argc)
+			N=atoi(argv[++argi]);
+		else if(arg=="-o")
+			useOri=true;
+		else
+			solvers.insert(arg);
+	}
+	if(solvers.size()==0) {
+		IKSolver::getRegistry().getTypeNames(solvers);
+		solvers.erase("");
+	}
+
+	// (don't check the loadFile() return value, some libxml2 versions don't report the size parsed)
+	KinematicJoint root;
+	root.loadFile(argv[1]);
+	KinematicJoint* eff = findJoint(root,argv[2]);
+	if(eff==NULL) {
+		cerr << "Effector " << argv[2] << " not found in " << argv[1] << endl;
+		return 1;
+	}
+	vector<KinematicJoint*> chain;
+	for(KinematicJoint* kj=eff; kj!=NULL; kj=kj->getParent())
+		if(kj->isMobile())
+			chain.insert(chain.begin(),kj);
+	cout << argv[2] << ": " << chain.size() << " mobile joints, " << N << " targets" << (useOri ? " (position and orientation)" : " (position only)") << endl;
+
+	// initial posture: the middle of each joint's range (zero is often a singularity, e.g. a straight knee)
+	vector<float> q0(chain.size());
+	for(size_t i=0; i<chain.size(); ++i)
+		q0[i] = (chain[i]->qmin+chain[i]->qmax)/2;
+
+	srand(1);
+	vector<Target> random(N), tracking(N);
+	for(size_t t=0; t<N; ++t) {
+		random[t].q.resize(chain.size());
+		for(size_t i=0; i<chain.size(); ++i)
+			random[t].q[i] = randomQ(*chain[i]);
+	}
+	// tracking: interpolate between a few random configurations
+	const unsigned int LEG=20;
+	vector<float> from(q0), to(chain.size());
+	for(size_t t=0; t<N; ++t) {
+		if(t%LEG==0) {
+			if(t>0)
+				from=to;
+			for(size_t i=0; i<chain.size(); ++i)
+				to[i] = randomQ(*chain[i]);
+		}
+		const float s = (t%LEG+1)/(float)LEG;
+		tracking[t].q.resize(chain.size());
+		for(size_t i=0; i<chain.size(); ++i)
+			tracking[t].q[i] = from[i] + (to[i]-from[i])*s;
+	}
+	vector<Target>* scenarios[] = { &random, &tracking };
+	for(unsigned int s=0; s<2; ++s) {
+		for(size_t t=0; t<N; ++t) {
+			Target& tgt = (*scenarios[s])[t];
+			for(size_t i=0; i<chain.size(); ++i)
+				chain[i]->setQ(tgt.q[i]);
+			tgt.p = eff->getWorldPosition();
+			tgt.ori = eff->getWorldQuaternion();
+		}
+	}
+
+	const char* names[] = { "random", "tracking" };
+	for(unsigned int s=0; s<2; ++s) {
+		header(names[s]);
+		for(set<string>::const_iterator it=solvers.begin(); it!=solvers.end(); ++it) {
+			IKSolver* solver = IKSolver::getRegistry().create(*it);
+			if(solver==NULL) {
+				cout << "  " << *it << " is not registered" << endl;
+				continue;
+			}
+			report(*it, run(*solver, *eff, chain, q0, *scenarios[s]));
+			delete solver;
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,139 @@
+#include "Motion/KeyframeSequenceMC.h"
+#include "Motion/DynamicMotionSequence.h"
+#include "Shared/WorldState.h"
+#include "IPC/ProcessID.h"
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+using namespace std;
+
+// Plays KeyframeSequenceMC against DynamicMotionSequence: linear playback and seeking must give
+// the same values, a sequence longer than MotionSequenceEngine's 65535 frames must seek correctly,
+// the binary format must round trip, and Hermite interpolation must pass through the keyframes
+// without overshooting them.
+
+bool near(float a, float b) { return std::abs(a-b) < 1e-4f*std::max(1.f,std::abs(a)); }
+
+//! returns true if @a a and @a b have the same keyframes for every output
+bool sameKeys(const KeyframeSequenceMC& a, const KeyframeSequenceMC& b) {
+	for(unsigned int i=0; i<NumOutputs; ++i) {
+		if(a.getNumKeyFrames(i)!=b.getNumKeyFrames(i))
+			return false;
+		for(unsigned int k=0; k<a.getNumKeyFrames(i); ++k) {
+			const KeyframeSequenceMC::KeyFrame &ka=a.getKeyFrame(i,k), &kb=b.getKeyFrame(i,k);
+			if(ka.time!=kb.time || ka.cmd.value!=kb.cmd.value || ka.cmd.weight!=kb.cmd.weight)
+				return false;
+		}
+	}
+	return true;
+}
+
+int main() {
+	srand(0);
+	ProcessID::setID(ProcessID::MainProcess);
+	for(unsigned int i=0; i<NumOutputs; ++i)
+		state->outputs[i]=0.25f;
+
+	// a few outputs with keyframes at different times, including a zero-weight gap
+	KeyframeSequenceMC kf;
+	kf.setTime(400); kf.setOutputCmd(0,OutputCmd(1.0f));
+	kf.setTime(900); kf.setOutputCmd(0,OutputCmd(-0.5f));
+	kf.setTime(1500); kf.setOutputCmd(0,OutputCmd(0.5f));
+	kf.setTime(700); kf.setOutputCmd(1,OutputCmd(2.0f));
+	kf.setTime(1100); kf.setOutputCmd(1,OutputCmd(0.0f,0.0f));
+	kf.setTime(1600); kf.setOutputCmd(1,OutputCmd(-1.0f));
+	kf.setTime(1200); kf.setOutputCmd(2,OutputCmd(0.75f,0.5f));
+	cout << "End time: " << kf.getEndTime() << endl;
+	cout << "Keyframes for output 0: " << kf.getNumKeyFrames(0) << endl;
+
+	DynamicMotionSequence ms;
+	kf.exportSequence(ms);
+	kf.play();
+	ms.play();
+
+	// forward playback, then random seeks in both directions
+	unsigned int matches=0, checks=0;
+	for(unsigned int t=0; t<=1700; t+=10) {
+		kf.setTime(t);
+		ms.setTime(t);
+		for(unsigned int i=0; i<3; ++i, ++checks)
+			if(near(kf.getOutputCmd(i).value,ms.getOutputCmd(i).value) && near(kf.getOutputCmd(i).weight,ms.getOutputCmd(i).weight))
+				++matches;
+	}
+	for(unsigned int n=0; n<200; ++n) {
+		const unsigned int t=rand()%1800;
+		kf.setTime(t);
+		ms.setTime(t);
+		for(unsigned int i=0; i<3; ++i, ++checks)
+			if(near(kf.getOutputCmd(i).value,ms.getOutputCmd(i).value) && near(kf.getOutputCmd(i).weight,ms.getOutputCmd(i).weight))
+				++matches;
+	}
+	cout << "Linear matches DynamicMotionSequence: " << matches << " of " << checks << endl;
+	kf.setTime(600);
+	cout << "Output 0 at 600: " << kf.getOutputCmd(0).value << endl;
+	kf.setTime(1800);
+	cout << "Held past the end: " << kf.getOutputCmd(0).value << ", weight " << kf.getOutputCmd(2).weight << endl;
+	kf.setHold(false);
+	cout << "Unused past the end without hold: " << (kf.getOutputCmd(0).weight==0) << endl;
+	kf.setHold(true);
+
+	// binary round trip
+	vector<char> buf(kf.getBinSize());
+	const unsigned int saved=kf.saveBuffer(&buf[0],buf.size());
+	cout << "Binary size matches getBinSize(): " << (saved==buf.size()) << endl;
+	KeyframeSequenceMC loaded;
+	const unsigned int read=loaded.loadBuffer(&buf[0],buf.size());
+	cout << "Binary round trip: " << (read==saved) << ", same keyframes: " << sameKeys(kf,loaded) << ", end time " << loaded.getEndTime() << endl;
+	KeyframeSequenceMC truncated;
+	cout << "Truncated buffer rejected: " << (truncated.loadBuffer(&buf[0],buf.size()/2)==0) << endl;
+
+	// a long sequence, past the 65535 frame limit of the MotionSequenceEngine classes
+	const unsigned int LONG_FRAMES=100000;
+	KeyframeSequenceMC longSeq;
+	vector<float> values(LONG_FRAMES+1);
+	for(unsigned int k=1; k<=LONG_FRAMES; ++k) {
+		values[k]=rand()/(float)RAND_MAX;
+		longSeq.setTime(k*10);
+		longSeq.setOutputCmd(0,OutputCmd(values[k]));
+	}
+	longSeq.play();
+	cout << "Long sequence keyframes: " << longSeq.getNumKeyFrames(0) << ", end time " << longSeq.getEndTime() << endl;
+	unsigned int seeks=0;
+	for(unsigned int n=0; n<1000; ++n) {
+		const unsigned int k=1+rand()%(LONG_FRAMES-1), offset=rand()%10;
+		longSeq.setTime(k*10+offset);
+		const float expected=values[k]+(values[k+1]-values[k])*offset/10.f;
+		if(near(longSeq.getOutputCmd(0).value,expected))
+			++seeks;
+	}
+	cout << "Long sequence seeks correct: " << seeks << " of 1000" << endl;
+
+	// Hermite interpolation through the keyframes of output 0
+	kf.setInterpolation(KeyframeSequenceMC::HERMITE);
+	kf.play();
+	bool throughKeys=true, noOvershoot=true;
+	for(unsigned int k=1; k<kf.getNumKeyFrames(0); ++k) {
+		const KeyframeSequenceMC::KeyFrame &prev=kf.getKeyFrame(0,k-1), &cur=kf.getKeyFrame(0,k);
+		kf.setTime(cur.time);
+		throughKeys = throughKeys && near(kf.getOutputCmd(0).value,cur.cmd.value);
+		for(unsigned int t=prev.time+1; t<cur.time; ++t) {
+			kf.setTime(t);
+			const float v=kf.getOutputCmd(0).value;
+			if(v<std::min(prev.cmd.value,cur.cmd.value)-1e-5f || v>std::max(prev.cmd.value,cur.cmd.value)+1e-5f)
+				noOvershoot=false;
+		}
+	}
+	cout << "Hermite passes through keyframes: " << throughKeys << ", no overshoot: " << noOvershoot << endl;
+	kf.setTime(600);
+	cout << "Hermite output 0 at 600: " << kf.getOutputCmd(0).value << endl;
+	kf.setTime(1200);
+	cout << "Hermite output 0 at 1200: " << kf.getOutputCmd(0).value << endl;
+	// the zero-weight keyframe of output 1 splits it into linear segments
+	kf.setTime(900);
+	ms.setTime(900);
+	cout << "Hermite falls back to linear next to unweighted frames: " << near(kf.getOutputCmd(1).value,ms.getOutputCmd(1).value) << endl;
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,135 @@
+#include "Motion/KinematicJoint.h"
+#include "Motion/KinematicChain.h"
+#include "Shared/TimeET.h"
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Checks that KinematicChain gives the same forward kinematics, Jacobian, and
+// center of mass as the KinematicJoint tree it was copied from, then compares speed.
+
+using namespace std;
+
+const unsigned int N = 1000; // number of random configurations to compare
+const unsigned int REPS = 200; // number of times to repeat each configuration for timing
+
+KinematicJoint* findJoint(KinematicJoint& kj, const string& name) {
+	if(kj.outputOffset.get()==name)
+		return &kj;
+	for(KinematicJoint::branch_iterator it=kj.getBranches().begin(); it!=kj.getBranches().end(); ++it)
+		if(KinematicJoint* f = findJoint(**it,name))
+			return f;
+	return NULL;
+}
+
+float randomUnit() { return rand()/(float)RAND_MAX; }
+
+template<size_t D>
+float maxDiff(const fmat::Matrix<3,D>& a, const fmat::Matrix<3,D>& b) {
+	float d=0;
+	for(size_t c=0; c<D; ++c)
+		for(size_t r=0; r<3; ++r)
+			d=max(d,std::abs(a(r,c)-b(r,c)));
+	return d;
+}
+
+template<size_t J>
+int compare(KinematicJoint& eff) {
+	KinematicChain<J> chain;
+	if(!chain.init(eff)) {
+		cout << "init failed" << endl;
+		return EXIT_FAILURE;
+	}
+	vector<KinematicJoint*> joints, path;
+	for(KinematicJoint* kj=&eff; kj!=NULL; kj=kj->getParent()) {
+		path.push_back(kj);
+		if(kj->isMobile())
+			joints.insert(joints.begin(),kj);
+	}
+	cout << "Mobile joints: " << joints.size() << endl;
+	
+	const fmat::Column<3> pEff = fmat::pack(10,-5,20);
+	float tDiff=0, jDiff=0, comDiff=0;
+	vector<fmat::fmatReal> qs(N*J);
+	srand(1);
+	for(unsigned int n=0; n<N; ++n) {
+		fmat::fmatReal* q = &qs[n*J];
+		for(size_t i=0; i<J; ++i) {
+			// camera and range sensor frames are prismatic with unbounded range
+			const float range = min(joints[i]->qmax-joints[i]->qmin, 1000.f);
+			q[i] = joints[i]->qmin + range*randomUnit();
+			joints[i]->setQ(q[i]);
+		}
+		tDiff = max(tDiff, maxDiff(chain.getEffectorT(q), eff.getFullT()));
+		
+		fmat::Matrix<6,J> jc;
+		chain.getJacobian(q,pEff,jc);
+		vector<fmat::Column<6> > jt;
+		eff.getMobileJacobian(eff.getFullT()*pEff,jt);
+		for(size_t i=0; i<J; ++i)
+			for(size_t r=0; r<6; ++r)
+				jDiff = max(jDiff, std::abs(jc(r,i)-jt[i][r]));
+		
+		fmat::Column<4> ct;
+		for(size_t i=0; i<path.size(); ++i)
+			ct += path[i]->getFullT()*path[i]->sumLinkCenterOfMass();
+		const fmat::Column<4> cc = chain.sumCenterOfMass(q);
+		for(size_t r=0; r<4; ++r)
+			comDiff = max(comDiff, std::abs(cc[r]-ct[r]) / max(1.f,std::abs(ct[r])));
+	}
+	cout << "Transform within 1e-3: " << (tDiff<1e-3f) << endl;
+	cout << "Jacobian within 1e-2: " << (jDiff<1e-2f) << endl;
+	cout << "Center of mass within 1e-4: " << (comDiff<1e-4f) << endl;
+	
+	float sum=0;
+	TimeET timer;
+	for(unsigned int n=0; n<N; ++n)
+		for(unsigned int r=0; r<REPS; ++r) {
+			for(size_t i=0; i<J; ++i)
+				joints[i]->setQ(qs[n*J+i] + r*1e-6f);
+			sum += eff.getFullT()(0,3);
+		}
+	const double treeTime = timer.Age().Value();
+	timer.Set();
+	for(unsigned int n=0; n<N; ++n)
+		for(unsigned int r=0; r<REPS; ++r) {
+			fmat::fmatReal q[J];
+			for(size_t i=0; i<J; ++i)
+				q[i] = qs[n*J+i] + r*1e-6f;
+			sum -= chain.getEffectorT(q)(0,3);
+		}
+	const double chainTime = timer.Age().Value();
+	cout << "Time @VAR tree " << treeTime*1e9/N/REPS << "ns, chain " << chainTime*1e9/N/REPS << "ns (" << sum << ")" << endl;
+	return EXIT_SUCCESS;
+}
+
+int main(int argc, const char* argv[]) {
+	if(argc<3) {
+		cerr << argv[0] << ": kinFile effectorFrame" << endl;
+		return 2;
+	}
+	KinematicJoint root;
+	root.loadFile(argv[1]);
+	KinematicJoint* eff = findJoint(root,argv[2]);
+	if(eff==NULL) {
+		cerr << "Effector " << argv[2] << " not found in " << argv[1] << endl;
+		return 1;
+	}
+	unsigned int mobile=0;
+	for(KinematicJoint* kj=eff; kj!=NULL; kj=kj->getParent())
+		if(kj->isMobile())
+			++mobile;
+	switch(mobile) {
+		case 1: return compare<1>(*eff);
+		case 2: return compare<2>(*eff);
+		case 3: return compare<3>(*eff);
+		case 4: return compare<4>(*eff);
+		case 5: return compare<5>(*eff);
+		case 6: return compare<6>(*eff);
+		case 7: return compare<7>(*eff);
+	}
+	cerr << "Unsupported number of mobile joints: " << mobile << endl;
+	return 1;
+}
@@ -0,0 +1,152 @@
+#include "IPC/LockFreeMessageQueue.h"
+#include "IPC/MessageReceiver.h"
+#include "IPC/SemaphoreManager.h"
+#include "IPC/Thread.h"
+#include <atomic>
+#include <vector>
+#include <iostream>
+#include <cstdlib>
+
+// Overflows a small LockFreeMessageQueue with the DROP_OLDEST policy: several sender threads
+// push numbered messages while two slow receivers read them, so senders are dropping the
+// oldest message while receivers are marking it read.  Each receiver must see each sender's
+// messages in order, and must never mark a message read which it hasn't processed: when the
+// message it processed is dropped and its slot reused, the newer message in the slot isn't its
+// to mark.
+
+const unsigned int SENDERS = 4;
+const unsigned int RECEIVERS = 2;
+size_t N = 5000; // number of messages per sender
+
+static const unsigned int CAP = 8;
+typedef LockFreeMessageQueue<CAP> Queue_t;
+
+//! the contents of each message
+struct Payload {
+	Payload(unsigned int s, unsigned int i) : sender(s), index(i) {
+		for(unsigned int r=0; r<RECEIVERS; ++r)
+			processed[r]=false;
+	}
+	unsigned int sender; //!< which thread sent it
+	unsigned int index; //!< the sender's count of messages before this one
+	std::atomic<bool> processed[RECEIVERS]; //!< set by each receiver which processes it
+};
+
+//! checks each message a receiver marks read has been processed by that receiver
+class TestQueue : public Queue_t {
+public:
+	TestQueue() : Queue_t(), markedUnprocessed(0) {}
+	virtual void markRead(index_t msg, SemaphoreManager::semid_t rcvr) { check(msg,getMessageSN(msg),rcvr); Queue_t::markRead(msg,rcvr); }
+	virtual void markReadSN(index_t msg, unsigned int sn, SemaphoreManager::semid_t rcvr) { check(msg,sn,rcvr); Queue_t::markReadSN(msg,sn,rcvr); }
+	std::atomic<unsigned int> markedUnprocessed; //!< number of messages marked read by a receiver which hadn't processed them
+protected:
+	//! counts a mark of message @a sn in slot @a msg by receiver @a rcvr (numbered as the receivers are added) if the receiver hasn't processed it
+	void check(index_t msg, unsigned int sn, SemaphoreManager::semid_t rcvr) {
+		RCRegion * r=peekMessage(msg);
+		if(r==NULL)
+			return;
+		// the slot only moves on to newer messages, so if it still holds sn, r is that message
+		if(getMessageSN(msg)==sn && !reinterpret_cast<Payload*>(r->Base())->processed[rcvr])
+			++markedUnprocessed;
+		r->RemoveReference();
+	}
+};
+
+// receiver statistics, each entry only touched by its receiver's thread
+unsigned int nextIndex[RECEIVERS][SENDERS];
+unsigned int outOfOrder[RECEIVERS];
+unsigned int received[RECEIVERS];
+
+template<unsigned int R> bool gotMsg(RCRegion* msg) {
+	Payload& p=*reinterpret_cast<Payload*>(msg->Base());
+	if(p.index<nextIndex[R][p.sender])
+		++outOfOrder[R];
+	nextIndex[R][p.sender]=p.index+1;
+	p.processed[R]=true;
+	if(++received[R]%8==0)
+		sched_yield(); // fall behind so the queue overflows
+	return true;
+}
+
+class SendThread : public Thread {
+public:
+	SendThread(TestQueue& queue, unsigned int sender) : Thread(), regions(), q(queue), id(sender) {}
+	//! the messages sent, the thread keeps a reference to each so they can be checked afterward
+	std::vector<RCRegion*> regions;
+protected:
+	virtual void* run() {
+		ProcessID::setID(ProcessID::MainProcess);
+		for(size_t i=0; i<N; ++i) {
+			RCRegion * r = new RCRegion(sizeof(Payload));
+			new (r->Base()) Payload(id,i);
+			regions.push_back(r);
+			q.sendMessage(r);
+			if(i%2==0)
+				sched_yield(); // give the receivers a chance, so they are reading as messages are dropped
+		}
+		return NULL;
+	}
+	TestQueue& q;
+	unsigned int id;
+private:
+	SendThread(const SendThread&); //!< don't call
+	SendThread& operator=(const SendThread&); //!< don't call
+};
+
+int main(int argc, const char* argv[]) {
+	if(argc>1)
+		N=atoi(argv[1]);
+	Thread::initMainThread();
+	ProcessID::setID(ProcessID::MainProcess);
+	RCRegion::setMultiprocess(false);
+	SemaphoreManager semgr;
+	MessageQueueBase::setSemaphoreManager(&semgr);
+
+	std::vector<SendThread*> threads;
+	unsigned int dropped, sent, read, markedUnprocessed;
+	{
+		TestQueue q;
+		q.setOverflowPolicy(MessageQueueBase::DROP_OLDEST);
+		q.setReportDroppings(false);
+		MessageReceiver rcvr0(q,gotMsg<0>,false), rcvr1(q,gotMsg<1>,false); // subscribe before any senders start, as receivers 0 and 1
+		rcvr0.start();
+		rcvr1.start();
+		for(unsigned int s=0; s<SENDERS; ++s) {
+			threads.push_back(new SendThread(q,s));
+			threads.back()->start();
+		}
+		for(unsigned int s=0; s<SENDERS; ++s)
+			threads[s]->join();
+		rcvr0.finish();
+		rcvr1.finish();
+		dropped=q.getMessagesDropped();
+		sent=q.getMessagesSent();
+		read=q.getMessagesRead();
+		markedUnprocessed=q.markedUnprocessed.load();
+	}
+
+	unsigned int unprocessed[RECEIVERS] = { 0 };
+	for(unsigned int s=0; s<SENDERS; ++s) {
+		for(size_t i=0; i<threads[s]->regions.size(); ++i) {
+			RCRegion * r = threads[s]->regions[i];
+			Payload& p=*reinterpret_cast<Payload*>(r->Base());
+			for(unsigned int rc=0; rc<RECEIVERS; ++rc)
+				if(!p.processed[rc])
+					++unprocessed[rc];
+			r->RemoveReference();
+		}
+		delete threads[s];
+	}
+
+	std::cout << "Sent all messages: " << (sent==SENDERS*N) << std::endl;
+	std::cout << "Released all messages: " << (read==sent) << std::endl;
+	std::cout << "Overflow dropped messages: " << (dropped>0) << std::endl;
+	std::cout << "Messages marked read without being processed: " << markedUnprocessed << std::endl;
+	for(unsigned int rc=0; rc<RECEIVERS; ++rc) {
+		std::cout << "Receiver " << rc << " out of order: " << outOfOrder[rc] << std::endl;
+		std::cout << "Receiver " << rc << " only skipped dropped messages: " << (unprocessed[rc]<=dropped) << std::endl;
+	}
+	std::cout << "Counts @VAR dropped " << dropped << ", unprocessed " << unprocessed[0] << " " << unprocessed[1] << std::endl;
+	RCRegion::releasePool();
+	return EXIT_SUCCESS;
+}
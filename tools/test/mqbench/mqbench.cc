@@ -0,0 +1,114 @@
+#include "IPC/MessageQueue.h"
+#include "IPC/LockFreeMessageQueue.h"
+#include "IPC/MessageReceiver.h"
+#include "IPC/SemaphoreManager.h"
+#include "IPC/Thread.h"
+#include "Shared/TimeET.h"
+#include <vector>
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+
+// Compares MessageQueue against LockFreeMessageQueue: some number of sender
+// threads each push N messages through a queue to a single MessageReceiver.
+// Each message carries its send time, so the receiver can measure latency.
+
+size_t N = 20000; // number of messages per sender
+size_t MAX_SENDERS = 8; // will test 1 through MAX_SENDERS senders
+
+static const unsigned int CAP = 50; // same as sim::MotionCommandQueue_t
+typedef MessageQueue<CAP> LockingQueue_t;
+typedef LockFreeMessageQueue<CAP> LockFreeQueue_t;
+
+// receiver statistics, only touched by the receiver thread
+size_t received=0;
+double totalLatency=0, maxLatency=0;
+
+bool gotMsg(RCRegion* msg) {
+	TimeET sent=*reinterpret_cast<TimeET*>(msg->Base());
+	double lat=sent.Age().Value()*1e6;
+	totalLatency+=lat;
+	if(lat>maxLatency)
+		maxLatency=lat;
+	++received;
+	return true;
+}
+
+class SendThread : public Thread {
+public:
+	explicit SendThread(MessageQueueBase& queue) : Thread(), q(queue) {}
+protected:
+	virtual void* run() {
+		ProcessID::setID(ProcessID::MainProcess);
+		for(size_t i=0; i<N; ++i) {
+			RCRegion * r = new RCRegion(sizeof(TimeET));
+			new (r->Base()) TimeET;
+			q.sendMessage(r,true);
+		}
+		return NULL;
+	}
+	MessageQueueBase& q;
+private:
+	SendThread(const SendThread&); //!< don't call
+	SendThread& operator=(const SendThread&); //!< don't call
+};
+
+void runTest(const char* name, MessageQueueBase& q, size_t senders) {
+	received=0;
+	totalLatency=maxLatency=0;
+	q.setOverflowPolicy(MessageQueueBase::WAIT);
+	MessageReceiver rcvr(q,gotMsg,false); // subscribe before any senders start, so nothing is dropped
+	rcvr.start();
+
+	TimeET start;
+	std::vector<SendThread*> threads;
+	for(size_t i=0; i<senders; ++i) {
+		threads.push_back(new SendThread(q));
+		threads.back()->start();
+	}
+	for(size_t i=0; i<senders; ++i) {
+		threads[i]->join();
+		delete threads[i];
+	}
+	rcvr.finish();
+	double elapsed=start.Age().Value();
+
+	// timings vary from run to run, so they follow the @VAR marker
+	std::cout << std::setw(14) << name << std::setw(4) << senders;
+	if(received!=N*senders)
+		std::cout << "   ERROR: received " << received << " of " << N*senders;
+	std::cout << " @VAR"
+		<< std::setw(14) << static_cast<size_t>(received/elapsed)
+		<< std::setw(14) << std::setprecision(4) << (received>0 ? totalLatency/received : 0)
+		<< std::setw(14) << std::setprecision(6) << maxLatency << std::endl;
+}
+
+int main(int argc, const char* argv[]) {
+	if(argc>1)
+		N=atoi(argv[1]);
+	if(argc>2)
+		MAX_SENDERS=atoi(argv[2]);
+	Thread::initMainThread();
+	ProcessID::setID(ProcessID::MainProcess);
+	RCRegion::setMultiprocess(false);
+	SemaphoreManager semgr;
+	MessageQueueBase::setSemaphoreManager(&semgr);
+
+	std::cout << N << " messages per sender" << std::endl;
+	std::cout << std::setw(14) << "queue" << std::setw(4) << "snd" << "     "
+		<< std::setw(14) << "msgs/sec" << std::setw(14) << "mean lat(us)" << std::setw(14) << "max lat(us)" << std::endl;
+	for(size_t s=1; s<=MAX_SENDERS; ++s) {
+		{
+			LockingQueue_t q;
+			runTest("MessageQueue",q,s);
+		}
+		{
+			LockFreeQueue_t q;
+			runTest("LockFree",q,s);
+		}
+	}
+	RCRegion::PoolStats ps=RCRegion::getPoolStats();
+	std::cout << "region pool: @VAR " << ps.hits << " hits, " << ps.misses << " misses, " << ps.evictions << " evictions" << std::endl;
+	RCRegion::releasePool();
+	return EXIT_SUCCESS;
+}
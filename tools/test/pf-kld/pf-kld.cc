@@ -0,0 +1,98 @@
+#include "Localization/LocalizationParticle.h"
+#include "Shared/zignor.h"
+#include <iostream>
+#include <sstream>
+#include <cmath>
+#include <cstdlib>
+
+using namespace std;
+
+// Adapts the number of particles by KLD-sampling: a filter which has converged on a sharp
+// sensor model should shrink toward the minimum, a reset should jump to the maximum, and a
+// filter which can't tell where it is should stay large.
+
+typedef ParticleFilter<LocalizationParticle> PF;
+typedef PF::LowVarianceResamplingPolicy Resampler;
+
+//! scores particles by their distance from a pose, or not at all if #sigma is 0
+class PoseSensorModel : public PF::SensorModel {
+public:
+	PoseSensorModel() : x(200), y(300), theta(0.5f), sigma(30) {}
+	virtual void evaluate(particle_collection& particles, particle_type& estimate) {
+		if(sigma==0)
+			return;
+		for(size_t i=0; i<particles.size(); ++i) {
+			const float dx=particles[i].x-x, dy=particles[i].y-y;
+			const float dt=AngSignPi(float(particles[i].theta)-theta);
+			particles[i].weight += -(dx*dx+dy*dy)/(2*sigma*sigma) - dt*dt/(2*0.05f*0.05f);
+		}
+	}
+	float x, y, theta; //!< the pose
+	float sigma; //!< standard deviation of position
+};
+
+//! runs @a n updates of @a filter with @a sensor, discarding the resampler's reports
+void update(PF& filter, PoseSensorModel& sensor, unsigned int n) {
+	ostringstream discard;
+	streambuf* prev = cout.rdbuf(discard.rdbuf());
+	for(unsigned int i=0; i<n; ++i)
+		filter.updateSensors(sensor,false,true);
+	cout.rdbuf(prev);
+}
+
+int main(int argc, char** argv) {
+	srand(1);
+	int seed[] = { 1, 2 };
+	RanNormalSetSeedZig32(seed,2);
+
+	PF filter(1000);
+	Resampler& resampler = dynamic_cast<Resampler&>(*filter.getResamplingPolicy());
+	resampler.varianceScale = 0.5f;
+	cout << "Fixed by default: " << !resampler.isAdaptive() << endl;
+
+	filter.setAdaptiveParticles(100, 5000, new LocalizationParticleBinningPolicy<LocalizationParticle>);
+	cout << "Adaptive: " << resampler.isAdaptive() << endl;
+	cout << "One bin needs the minimum: " << resampler.kldParticles(1) << endl;
+	cout << "Bounds grow with bins: " << (resampler.kldParticles(50) < resampler.kldParticles(100)) << endl;
+	cout << "Many bins need the maximum: " << resampler.kldParticles(100000) << endl;
+
+	PoseSensorModel sensor;
+	update(filter, sensor, 15);
+	cout << "Converged below 1000: " << (filter.getNumParticles() < 1000) << endl;
+	cout << "Converged @VAR bins " << resampler.getNumOccupiedBins() << ", particles " << filter.getNumParticles() << endl;
+	float mx=0, my=0;
+	for(size_t i=0; i<filter.getNumParticles(); ++i) {
+		mx+=filter.getParticles()[i].x;
+		my+=filter.getParticles()[i].y;
+	}
+	mx/=filter.getNumParticles();
+	my/=filter.getNumParticles();
+	cout << "Mean near the pose: " << (std::abs(mx-sensor.x)<50 && std::abs(my-sensor.y)<50) << endl;
+
+	filter.resetFilter(0);
+	cout << "Reset to the maximum: " << filter.getNumParticles() << endl;
+
+	// with no information, the particles stay spread over the map
+	sensor.sigma = 0;
+	update(filter, sensor, 3);
+	cout << "Uninformed stays above 4000: " << (filter.getNumParticles() > 4000) << endl;
+
+	// and converging again shrinks them
+	sensor.sigma = 30;
+	update(filter, sensor, 15);
+	cout << "Reconverged below 1000: " << (filter.getNumParticles() < 1000) << endl;
+
+	// bounds are kept to 1 <= minParticles <= maxParticles
+	filter.setAdaptiveParticles(0, 5000, new LocalizationParticleBinningPolicy<LocalizationParticle>);
+	cout << "Zero minimum raised to " << resampler.minParticles << ", one bin needs " << resampler.kldParticles(1) << endl;
+	filter.setAdaptiveParticles(200, 50, new LocalizationParticleBinningPolicy<LocalizationParticle>);
+	cout << "Minimum above maximum lowered to " << resampler.minParticles << ", many bins need " << resampler.kldParticles(100000) << endl;
+	update(filter, sensor, 3);
+	cout << "Particles within the bounds: " << filter.getNumParticles() << endl;
+
+	filter.setAdaptiveParticles(0, 0, NULL);
+	const size_t fixed = filter.getNumParticles();
+	update(filter, sensor, 3);
+	cout << "Fixed again: " << (filter.getNumParticles()==fixed) << endl;
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,247 @@
+#include "Localization/ShapeSensorModel.h"
+#include "Localization/ShapeLandmarks.h"
+#include "Localization/LocalizationParticle.h"
+#include "Localization/LandmarkGrid.h"
+#include "DualCoding/ShapeSpace.h"
+#include "IPC/TaskPool.h"
+#include "IPC/Thread.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+using namespace std;
+using namespace DualCoding;
+
+// Scores particles against a map of lines, ellipses, blobs and crosses with LocalShapeEvaluator.
+// Evaluating all of the particles at once (LocalizationParticleArrays) must give bit-identical
+// weights to evaluating them one at a time, including for local landmarks which can't match
+// anything: points, types the evaluator doesn't handle, and colors missing from the map.
+// Splitting the batch across a TaskPool must not change the weights either.  With a match
+// radius, the ellipses have enough candidates to be looked up in a LandmarkGrid, which must
+// return every landmark in range, and no landmark may score worse than missing altogether.
+
+const unsigned int NUM_PARTICLES = 3000;
+const float TRUE_X = 1000, TRUE_Y = 500, TRUE_THETA = 0.3f;
+
+//! a landmark type LocalShapeEvaluator doesn't match
+class PfOther : public PfRoot {
+public:
+	PfOther(int _id, rgb _color, coordinate_t _x, coordinate_t _y) : PfRoot(sphereDataType, _id, _color, false, _x, _y) {}
+	virtual void print(std::ostream &os) const { os << "PfOther"; }
+};
+
+//! gives access to the landmarks of LocalShapeEvaluator, so they can be set up without DualCoding shapes
+class TestEvaluator : public LocalShapeEvaluator {
+public:
+	TestEvaluator(ShapeSpace& empty, float radius) : LocalShapeEvaluator(empty,empty,radius) {}
+	//! takes ownership of @a local and @a world, and indexes them as the constructor would have
+	void setLandmarks(const vector<PfRoot*>& local, const vector<PfRoot*>& world) {
+		localLms = local;
+		worldLms = world;
+		indexWorld();
+	}
+	//! returns true if local landmark @a i is matched through a LandmarkGrid
+	bool hasGrid(unsigned int i) const { return !grids[i].empty(); }
+	//! returns the weight local landmark @a i adds when nothing is in range
+	float getMissWeight(unsigned int i) const { return missWeights[i]; }
+	virtual ~TestEvaluator() {
+		PfRoot::deleteLms(localLms);
+		PfRoot::deleteLms(worldLms);
+	}
+};
+
+float randomUnit() { return rand()/(RAND_MAX+1.f); }
+
+//! returns the position of world point (@a wx,@a wy) relative to a robot at the true pose
+void toLocal(float wx, float wy, float& lx, float& ly) {
+	const float dx = wx-TRUE_X, dy = wy-TRUE_Y;
+	lx = dx*std::cos(TRUE_THETA) + dy*std::sin(TRUE_THETA);
+	ly = -dx*std::sin(TRUE_THETA) + dy*std::cos(TRUE_THETA);
+}
+
+//! adds a world line as PfRoot::loadLms() does, once in each direction
+void addWorldLine(vector<PfRoot*>& world, int id, rgb color, float x1, float y1, float x2, float y2) {
+	for(int dir=0; dir<2; ++dir) {
+		PfLine* line = (dir==0) ? new PfLine(id,color,false,x1,y1,x2,y2,true,true) : new PfLine(id,color,false,x2,y2,x1,y1,true,true);
+		line->orientation = std::atan2(y2-y1,x2-x1);
+		line->length = std::sqrt((x2-x1)*(x2-x1)+(y2-y1)*(y2-y1));
+		world.push_back(line);
+	}
+}
+
+//! builds the world map, and what the robot sees of it from the true pose
+void buildLandmarks(vector<PfRoot*>& local, vector<PfRoot*>& world) {
+	const rgb blue(0,0,255), pink(255,0,255), orange(255,128,0), green(0,255,0), yellow(255,255,0);
+	int id = 1;
+	// walls of the room
+	addWorldLine(world,id++,blue,0,0,3000,0);
+	addWorldLine(world,id++,blue,3000,0,3000,2000);
+	addWorldLine(world,id++,blue,3000,2000,0,2000);
+	addWorldLine(world,id++,blue,0,2000,0,0);
+	// scattered ellipses, blobs and crosses
+	for(unsigned int i=0; i<40; ++i)
+		world.push_back(new PfEllipse(id++,(i%2) ? pink : orange,false,100+randomUnit()*2800,100+randomUnit()*1800));
+	for(unsigned int i=0; i<6; ++i)
+		world.push_back(new PfBlob(id++,green,false,100+randomUnit()*2800,100+randomUnit()*1800));
+	world.push_back(new PfCross(id++,yellow,false,2500,1500));
+
+	// the robot sees the near wall with an invalid far end, a few ellipses and blobs, and the cross
+	float lx, ly, lx2, ly2;
+	toLocal(0,0,lx,ly);
+	toLocal(3000,0,lx2,ly2);
+	local.push_back(new PfLine(id++,blue,false,lx,ly+15,lx2,ly2-10,true,false));
+	for(unsigned int i=4*2; i<world.size(); i+=5) {
+		toLocal(world[i]->x+randomUnit()*40-20,world[i]->y+randomUnit()*40-20,lx,ly);
+		if(world[i]->type==ellipseDataType)
+			local.push_back(new PfEllipse(id++,world[i]->color,false,lx,ly));
+		else if(world[i]->type==blobDataType)
+			local.push_back(new PfBlob(id++,world[i]->color,false,lx,ly));
+	}
+	toLocal(2510,1490,lx,ly);
+	local.push_back(new PfCross(id++,yellow,false,lx,ly));
+	// things which can't match: a point, an unhandled type, and a mobile ellipse of a color missing from the map
+	local.push_back(new PfPoint(id++,blue,false,300,0));
+	local.push_back(new PfOther(id++,pink,400,100));
+	local.push_back(new PfEllipse(id++,rgb(0,128,128),true,500,-200));
+}
+
+//! the results of compare()
+struct Comparison {
+	Comparison() : differ(0), poolDiffer(0), grids(0), belowMiss(0) {}
+	unsigned int differ; //!< particles whose batch weight differs from their weight evaluated alone
+	unsigned int poolDiffer; //!< particles whose weight differs when the batch is split across a pool
+	unsigned int grids; //!< local landmarks matched through a LandmarkGrid
+	unsigned int belowMiss; //!< particles scoring below the weight of missing every landmark
+};
+
+//! evaluates @a particles one at a time, all at once, and all at once on @a pool, storing the weights in @a weights
+Comparison compare(float radius, const vector<LocalizationParticle>& particles, TaskPool& pool, vector<float>& weights) {
+	ShapeSpace empty(NULL,0,"empty",egocentric);
+	streambuf* out = cout.rdbuf(NULL); // the constructor complains about the empty shape spaces
+	TestEvaluator eval(empty,radius);
+	cout.rdbuf(out);
+	vector<PfRoot*> local, world;
+	srand(1);
+	buildLandmarks(local,world);
+	eval.setLandmarks(local,world);
+
+	vector<LocalizationParticle> scalar(particles);
+	for(size_t i=0; i<scalar.size(); ++i)
+		eval.evaluate(scalar[i]);
+	LocalizationParticleArrays batch, pooled;
+	batch.load(particles);
+	eval.evaluate(batch);
+	pooled.load(particles);
+	eval.evaluate(pooled,&pool);
+
+	Comparison result;
+	float allMiss = 0;
+	for(unsigned int i=0; i<local.size(); ++i) {
+		result.grids += eval.hasGrid(i);
+		allMiss += eval.getMissWeight(i);
+	}
+	weights.resize(scalar.size());
+	for(size_t i=0; i<scalar.size(); ++i) {
+		weights[i] = scalar[i].weight;
+		if(batch.weight[i]!=scalar[i].weight)
+			++result.differ;
+		if(pooled.weight[i]!=batch.weight[i])
+			++result.poolDiffer;
+		if(scalar[i].weight-particles[i].weight < allMiss)
+			++result.belowMiss;
+	}
+	return result;
+}
+
+//! queries a LandmarkGrid of the world map at random points, returns the number of landmarks within @a radius it misses
+unsigned int checkGrid(float radius) {
+	vector<PfRoot*> local, world;
+	srand(1);
+	buildLandmarks(local,world);
+	vector<unsigned int> all;
+	for(unsigned int i=0; i<world.size(); ++i)
+		all.push_back(i);
+	LandmarkGrid grid;
+	grid.build(world,all,radius);
+	unsigned int missed = 0;
+	vector<unsigned int> found;
+	for(unsigned int n=0; n<2000; ++n) {
+		const float x = -500+randomUnit()*4000, y = -500+randomUnit()*3000;
+		found.clear();
+		grid.query(x,y,radius,found);
+		std::sort(found.begin(),found.end());
+		for(unsigned int i=0; i<world.size(); ++i) {
+			// distance from the landmark, or from a line's bounding box
+			float dx = world[i]->x-x, dy = world[i]->y-y;
+			if(world[i]->type==lineDataType) {
+				const PfLine& line = static_cast<const PfLine&>(*world[i]);
+				dx = std::max(0.f,std::max(std::min<float>(line.x,line.x2)-x,x-std::max<float>(line.x,line.x2)));
+				dy = std::max(0.f,std::max(std::min<float>(line.y,line.y2)-y,y-std::max<float>(line.y,line.y2)));
+			}
+			if(dx*dx+dy*dy<=radius*radius && !std::binary_search(found.begin(),found.end(),i))
+				++missed;
+		}
+	}
+	PfRoot::deleteLms(local);
+	PfRoot::deleteLms(world);
+	return missed;
+}
+
+//! returns the weight of a robot at the true pose seeing a pink ellipse at (@a x,@a y), when the only pink ellipse in the map is far off at (2900,1900)
+float farMatch(float radius, float x, float y) {
+	ShapeSpace empty(NULL,0,"empty",egocentric);
+	streambuf* out = cout.rdbuf(NULL);
+	TestEvaluator eval(empty,radius);
+	cout.rdbuf(out);
+	vector<PfRoot*> local, world;
+	local.push_back(new PfEllipse(1,rgb(255,0,255),false,x,y));
+	world.push_back(new PfEllipse(2,rgb(255,0,255),false,2900,1900));
+	eval.setLandmarks(local,world);
+	LocalizationParticle p(TRUE_X,TRUE_Y,TRUE_THETA);
+	eval.evaluate(p);
+	return p.weight;
+}
+
+//! returns the index of the largest of @a weights
+size_t best(const vector<float>& weights) {
+	size_t b = 0;
+	for(size_t i=1; i<weights.size(); ++i)
+		if(weights[i]>weights[b])
+			b = i;
+	return b;
+}
+
+int main() {
+	Thread::initMainThread();
+	TaskPool pool(3);
+	srand(0);
+	vector<LocalizationParticle> particles;
+	particles.push_back(LocalizationParticle(TRUE_X,TRUE_Y,TRUE_THETA));
+	while(particles.size()<NUM_PARTICLES)
+		particles.push_back(LocalizationParticle(randomUnit()*3000,randomUnit()*2000,randomUnit()*float(2*M_PI)));
+
+	vector<float> weights;
+	Comparison c = compare(0,particles,pool,weights);
+	cout << "Without a match radius, batch weights differ for " << c.differ << " of " << NUM_PARTICLES << " particles, on a pool for " << c.poolDiffer << endl;
+	cout << "Best particle is the true pose: " << (best(weights)==0) << endl;
+	cout << "Landmarks matched through a grid: " << c.grids << endl;
+	// ShapeSensorModel's default match radius
+	c = compare(1000,particles,pool,weights);
+	cout << "With a match radius of 1000, batch weights differ for " << c.differ << " of " << NUM_PARTICLES << " particles, on a pool for " << c.poolDiffer << endl;
+	cout << "Best particle is the true pose: " << (best(weights)==0) << endl;
+	cout << "Landmarks matched through a grid: " << c.grids << endl;
+	// the walls' scores include their ends and orientation, which without the cap could exceed the miss weight
+	cout << "Particles scoring below missing everything: " << c.belowMiss << endl;
+
+	cout << "Landmarks in range the grid missed: " << checkGrid(1000) << " and " << checkGrid(150) << endl;
+
+	// the only match is about 2500 away: out of range it scores as a miss, without a radius it scores its distance
+	const float missWeight = -1000*1000/(150*150.f);
+	cout << "Far match with a radius scores as a miss: " << (farMatch(1000,200,0)==missWeight) << endl;
+	cout << "Far match without a radius scores worse: " << (farMatch(0,200,0)<missWeight) << endl;
+
+	return EXIT_SUCCESS;
+}
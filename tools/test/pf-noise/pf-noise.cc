@@ -0,0 +1,93 @@
+#include <iostream>
+#include <cmath>
+#include <vector>
+#include "Localization/HolonomicMotionModel.h"
+#include "Shared/zignor.h"
+
+namespace project_get_time {
+	unsigned int simulation_time=0;
+	unsigned int (*get_time_callback)()=NULL;
+}
+
+using namespace std;
+using namespace project_get_time;
+
+// Checks the batched normal samples used by the particle filter's motion models and jiggle(),
+// and that the batched noise in HolonomicMotionModel::updateMotion() scatters particles around
+// the ideal motion.
+
+typedef vector<LocalizationParticle> Particles;
+
+//! stores the mean and variance of @a x into @a mean and @a var
+void moments(const float* x, size_t n, double& mean, double& var) {
+	mean=var=0;
+	for(size_t i=0; i<n; ++i)
+		mean+=x[i];
+	mean/=n;
+	for(size_t i=0; i<n; ++i)
+		var+=(x[i]-mean)*(x[i]-mean);
+	var/=n-1;
+}
+
+int main(int argc, char** argv) {
+	int seed[] = { 1, 2 };
+	RanNormalSetSeedZig32(seed,2);
+	
+	// samples should be standard normal, including an odd-sized batch
+	const size_t N=200001;
+	vector<float> x(N);
+	RanVecNormalZig32(&x[0],N);
+	double mean, var;
+	moments(&x[0],N,mean,var);
+	size_t tails=0;
+	for(size_t i=0; i<N; ++i)
+		if(std::abs(x[i])>3)
+			++tails;
+	cout << "Sample mean near 0: " << (std::abs(mean)<0.01) << endl;
+	cout << "Sample variance near 1: " << (std::abs(var-1)<0.01) << endl;
+	cout << "Samples beyond 3 sigma near 0.27%: " << (std::abs(tails/double(N)-0.0027)<0.0005) << endl;
+	cout << "Sample stats @VAR mean " << mean << ", variance " << var << endl;
+	
+	// the same seed gives the same samples
+	RanNormalSetSeedZig32(seed,2);
+	vector<float> y(N);
+	RanVecNormalZig32(&y[0],N);
+	cout << "Repeatable: " << (x==y) << endl;
+	
+	// particles spread around the ideal motion of the estimate
+	const float speed=100;
+	HolonomicMotionModel<LocalizationParticle> mm;
+	Particles particles(5000);
+	LocalizationParticle estimate;
+	for(size_t i=0; i<particles.size(); ++i)
+		particles[i].theta=estimate.theta=M_PI/2;
+	mm.setVelocity(speed,0,0.5f,0);
+	simulation_time=1000;
+	mm.updateMotion(particles,estimate);
+	vector<float> px(particles.size()), py(particles.size()), pa(particles.size());
+	for(size_t i=0; i<particles.size(); ++i) {
+		px[i]=particles[i].x;
+		py[i]=particles[i].y;
+		pa[i]=AngSignPi(particles[i].theta-estimate.theta);
+	}
+	double xmean, xvar, ymean, yvar, amean, avar;
+	moments(&px[0],px.size(),xmean,xvar);
+	moments(&py[0],py.size(),ymean,yvar);
+	moments(&pa[0],pa.size(),amean,avar);
+	cout << "Estimate: " << (std::abs(estimate.x+24.48f)<0.1f) << ' ' << (std::abs(estimate.y-95.89f)<0.1f) << endl;
+	cout << "Particle mean near estimate: " << (std::abs(xmean-estimate.x)<2 && std::abs(ymean-estimate.y)<2 && std::abs(amean)<0.01) << endl;
+	cout << "Particles spread: " << (std::sqrt(yvar)>speed*0.2f && std::sqrt(yvar)<speed*0.3f && std::sqrt(xvar)>2 && std::sqrt(avar)>0.1f) << endl;
+	cout << "Particle stats @VAR x " << xmean << " +/- " << std::sqrt(xvar) << ", y " << ymean << " +/- " << std::sqrt(yvar)
+		<< ", theta +/- " << std::sqrt(avar) << endl;
+	
+	// jiggle perturbs every particle
+	LocalizationParticleDistributionPolicy<LocalizationParticle> dist;
+	Particles before(particles);
+	dist.jiggle(1,&particles[0],particles.size());
+	size_t moved=0;
+	for(size_t i=0; i<particles.size(); ++i)
+		if(particles[i].x!=before[i].x && particles[i].y!=before[i].y && particles[i].theta!=before[i].theta)
+			++moved;
+	cout << "Jiggled: " << moved << " of " << particles.size() << endl;
+	return 0;
+}
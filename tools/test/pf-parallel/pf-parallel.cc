@@ -0,0 +1,133 @@
+#include "Shared/ParticleFilter.h"
+#include "IPC/TaskPool.h"
+#include "Shared/TimeET.h"
+#include <iostream>
+#include <cmath>
+#include <cstdlib>
+
+using namespace std;
+
+// Resamples the same particles with and without a TaskPool, which must select exactly the
+// same particles.  With a single block of weights, the selections also match the original
+// single pass resampling loop (with more, the sums round differently, shifting some selections).
+
+class Particle : public ParticleBase<Particle> {
+public:
+	typedef class ParticleDistributionPolicy DistributionPolicy;
+	Particle() : ParticleBase<Particle>(), id(0) {}
+	float sumSqErr(const Particle& p) const { float x=p.id-id; return x*x; }
+	bool operator==(const Particle& p) const { return id==p.id; }
+	unsigned int id; //!< identifies the original particle
+};
+
+typedef ParticleFilter<Particle> PF;
+typedef PF::LowVarianceResamplingPolicy Resampler;
+
+class ParticleDistributionPolicy : public PF::DistributionPolicy {
+	virtual void randomize(particle_type* begin, index_t num) {}
+	virtual void jiggle(float var, particle_type* begin, index_t num) {}
+};
+
+//! the resampling loop as it was before it was split into blocks
+PF::particle_collection serialResample(const PF::particle_collection& particles, unsigned int seed) {
+	srand(seed);
+	float bestWeight = -FLT_MAX;
+	for (size_t i=0; i<particles.size(); i++)
+		bestWeight = std::max(bestWeight, particles[i].weight);
+	std::vector<float> weights(particles.size());
+	weights[0]=std::exp(particles.front().weight-bestWeight);
+	for (unsigned int i=1; i < particles.size(); i++)
+		weights[i] = weights[i-1] + std::exp(particles[i].weight-bestWeight);
+	float r = weights.back() / particles.size();
+	float offset = r*float(rand())/RAND_MAX;
+	unsigned int pos = 0;
+	PF::particle_collection result(particles.size());
+	for (unsigned int i=0; i < particles.size(); i++){
+		float target = offset+r*i;
+		while (target >= weights[pos])
+			pos++;
+		result[i]=particles[pos];
+	}
+	return result;
+}
+
+//! fills @a filter with particles of random log weights, the best is 0 so none are redistributed
+void setup(PF& filter, unsigned int seed) {
+	srand(seed);
+	PF::particle_collection& p = filter.getParticles();
+	for(size_t i=0; i<p.size(); ++i) {
+		p[i].id=i;
+		p[i].weight = -float(rand())/RAND_MAX*5;
+	}
+	p[p.size()/2].weight=0;
+	Resampler& r = dynamic_cast<Resampler&>(*filter.getResamplingPolicy());
+	r.varianceScale=0;
+	r.maxRedistribute=0;
+}
+
+//! resamples @a filter with the rand() seed @a seed, on @a pool if non-NULL
+void resample(PF& filter, unsigned int seed, TaskPool* pool) {
+	filter.setTaskPool(pool);
+	srand(seed);
+	filter.resample();
+}
+
+int main(int argc, char** argv) {
+	Thread::initMainThread();
+	TaskPool pool(3);
+	
+	// small enough to fit in one block: same selections as the original loop
+	PF small(400);
+	setup(small,1);
+	PF::particle_collection expected = serialResample(small.getParticles(),2);
+	resample(small,2,NULL);
+	cout << "Single block matches original: " << (small.getParticles()==expected) << endl;
+	// too few particles to split up: the pool is skipped, same selections
+	PF pooled(400);
+	setup(pooled,1);
+	resample(pooled,2,&pool);
+	cout << "Small filter with a pool matches original: " << (pooled.getParticles()==expected) << endl;
+	
+	// many blocks: the pool doesn't change the selections, and repeats with the seed
+	const size_t N=100000;
+	PF serial(N), parallel(N), again(N);
+	setup(serial,3);
+	setup(parallel,3);
+	setup(again,3);
+	resample(serial,4,NULL);
+	resample(parallel,4,&pool);
+	resample(again,4,&pool);
+	cout << "Parallel matches serial: " << (parallel.getParticles()==serial.getParticles()) << endl;
+	cout << "Repeatable: " << (again.getParticles()==parallel.getParticles()) << endl;
+	
+	// timing depends on the machine (with a single core the pool can only add overhead),
+	// take the best of a few runs so the first touch of the scratch space and the pool's startup don't count
+	double serialTime=1e9, parallelTime=1e9;
+	for(unsigned int rep=0; rep<5; ++rep) {
+		setup(serial,3);
+		setup(parallel,3);
+		TimeET t;
+		resample(serial,4,NULL);
+		serialTime = std::min(serialTime,t.Age().Value());
+		t.Set();
+		resample(parallel,4,&pool);
+		parallelTime = std::min(parallelTime,t.Age().Value());
+	}
+	cout << "Resample time @VAR serial " << serialTime << ", parallel " << parallelTime << endl;
+	
+	// selections are proportional to weight
+	setup(serial,5);
+	std::vector<float> w(N);
+	double total=0;
+	for(size_t i=0; i<N; ++i)
+		total += w[i] = std::exp(serial.getParticles()[i].weight);
+	resample(serial,6,&pool);
+	std::vector<unsigned int> counts(N);
+	for(size_t i=0; i<N; ++i)
+		++counts[serial.getParticles()[i].id];
+	double err=0;
+	for(size_t i=0; i<N; ++i)
+		err = std::max(err, std::abs(counts[i]-w[i]/total*N));
+	cout << "Copies within one of expected: " << (err<1.001) << endl;
+	return 0;
+}
@@ -0,0 +1,268 @@
+#include "Planners/PlannerObstacles.h"
+#include "IPC/TaskPool.h"
+#include "IPC/Thread.h"
+#include "Shared/TimeET.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace DualCoding {
+	class ShapeSpace;
+}
+using namespace std;
+#include "Planners/RRT/GenericRRT.h"
+
+// Compares GenericRRT planning with RRTNearestIndex against scanning the trees for the nearest
+// node.  Both should build exactly the same trees, so the random number sequences stay in step
+// and the plans are identical.  Plans a point robot through a cluttered field of circles, and a
+// three link planar arm (angular coordinates) reaching around circles.  Then plans each again with
+// parallel searches (setParallelPlanners()), checking that every path is clear.
+
+const unsigned int PLANS = 10;
+const unsigned int MAX_ITER = 20000;
+
+typedef std::vector<CircularObstacle> Obstacles;
+
+//! a point in the plane
+class RRTNodePoint : public RRTNodeBase {
+public:
+	typedef std::pair<float,float> NodeValue_t;
+	NodeValue_t q;
+	RRTNodePoint(const NodeValue_t &_q, unsigned int _parent) : RRTNodeBase(_parent), q(_q) {}
+
+	struct CollisionChecker {
+		CollisionChecker(const Obstacles& o) : obs(o) {}
+		bool collides(const NodeValue_t &q, GenericRRTBase::PlannerResult2D* =NULL) const {
+			const fmat::Column<2> p = fmat::pack(q.first,q.second);
+			for(size_t i=0; i<obs.size(); ++i)
+				if(obs[i].collides(p))
+					return true;
+			return false;
+		}
+		const Obstacles& obs;
+	};
+
+	static const unsigned int maxInterpolations = 10;
+	virtual float distance(const NodeValue_t &t) { return (q.first-t.first)*(q.first-t.first) + (q.second-t.second)*(q.second-t.second); }
+	static const size_t KeyDims = 2;
+	static void getKey(const NodeValue_t &q, float key[]) { key[0] = q.first; key[1] = q.second; }
+	static bool isKeyAngular(size_t) { return false; }
+	static void generateSample(const NodeValue_t &lower, const NodeValue_t &upper, NodeValue_t &sample) {
+		sample.first = randRange(lower.first, upper.first);
+		sample.second = randRange(lower.second, upper.second);
+	}
+	static Interp_t interpolate(const NodeValue_t &start, const NodeValue_t &target, const NodeValue_t &interp,
+	                            bool truncate, CollisionChecker *cc, NodeValue_t &reached, bool) {
+		const float dx = target.first-start.first, dy = target.second-start.second;
+		int steps = int(std::max(std::abs(dx)/interp.first, std::abs(dy)/interp.second));
+		const bool truncated = truncate && (unsigned int)steps > maxInterpolations;
+		const int n = truncated ? maxInterpolations : steps;
+		reached = start;
+		for(int t=1; t<=n; ++t) {
+			reached = NodeValue_t(start.first+dx*t/std::max(steps,1), start.second+dy*t/std::max(steps,1));
+			if(cc->collides(reached))
+				return COLLISION;
+		}
+		if(truncated)
+			return APPROACHED;
+		reached = target;
+		return cc->collides(target) ? COLLISION : REACHED;
+	}
+	virtual std::string toString() const { ostringstream os; os << q.first << ' ' << q.second; return os.str(); }
+};
+
+//! joint angles of a planar arm
+class RRTNodeArm : public RRTNodeBase {
+public:
+	static const size_t J = 3;
+	struct NodeValue_t {
+		AngSignPi q[J];
+		NodeValue_t() { for(size_t i=0; i<J; ++i) q[i]=0; }
+	};
+	NodeValue_t q;
+	RRTNodeArm(const NodeValue_t &_q, unsigned int _parent) : RRTNodeBase(_parent), q(_q) {}
+
+	struct CollisionChecker {
+		CollisionChecker(const Obstacles& o) : obs(o) {}
+		bool collides(const NodeValue_t &q, GenericRRTBase::PlannerResult2D* =NULL) const {
+			float x=0, y=0, a=0;
+			for(size_t i=0; i<J; ++i) {
+				a += q.q[i];
+				for(int s=1; s<=4; ++s) {
+					const fmat::Column<2> p = fmat::pack(x+std::cos(a)*LINK*s/4, y+std::sin(a)*LINK*s/4);
+					for(size_t o=0; o<obs.size(); ++o)
+						if(obs[o].collides(p))
+							return true;
+				}
+				x += std::cos(a)*LINK;
+				y += std::sin(a)*LINK;
+			}
+			return false;
+		}
+		const Obstacles& obs;
+	};
+
+	static const float LINK;
+	static const unsigned int maxInterpolations = 10;
+	virtual float distance(const NodeValue_t &t) {
+		float sum = 0;
+		for(size_t i=0; i<J; ++i) {
+			const float d = t.q[i]-q.q[i];
+			sum += d*d;
+		}
+		return sum;
+	}
+	static const size_t KeyDims = J;
+	static void getKey(const NodeValue_t &q, float key[]) { for(size_t i=0; i<J; ++i) key[i] = q.q[i]; }
+	static bool isKeyAngular(size_t) { return true; }
+	static void generateSample(const NodeValue_t &lower, const NodeValue_t &upper, NodeValue_t &sample) {
+		for(size_t i=0; i<J; ++i)
+			sample.q[i] = randRange(lower.q[i], upper.q[i]);
+	}
+	static Interp_t interpolate(const NodeValue_t &start, const NodeValue_t &target, const NodeValue_t &interp,
+	                            bool truncate, CollisionChecker *cc, NodeValue_t &reached, bool) {
+		float delta[J];
+		int steps = 0;
+		for(size_t i=0; i<J; ++i) {
+			delta[i] = target.q[i]-start.q[i]; // short way around
+			steps = std::max(steps, int(std::abs(delta[i])/interp.q[i]));
+		}
+		const bool truncated = truncate && (unsigned int)steps > maxInterpolations;
+		const int n = truncated ? maxInterpolations : steps;
+		for(int t=1; t<=n; ++t) {
+			for(size_t i=0; i<J; ++i)
+				reached.q[i] = float(start.q[i]) + delta[i]*t/std::max(steps,1);
+			if(cc->collides(reached))
+				return COLLISION;
+		}
+		if(truncated)
+			return APPROACHED;
+		reached = target;
+		return cc->collides(target) ? COLLISION : REACHED;
+	}
+	virtual std::string toString() const { ostringstream os; os << q.q[0] << ' ' << q.q[1] << ' ' << q.q[2]; return os.str(); }
+};
+const float RRTNodeArm::LINK = 100;
+
+float randomUnit() { return rand()/(float)RAND_MAX; }
+
+struct Stats {
+	Stats() : solved(0), nodes(0), waypoints(0), time(0) {}
+	unsigned int solved, nodes, waypoints;
+	double time;
+	bool operator==(const Stats& s) const { return solved==s.solved && nodes==s.nodes && waypoints==s.waypoints; }
+};
+
+template<class NODE>
+Stats run(const Obstacles& obs, const typename NODE::NodeValue_t& lower, const typename NODE::NodeValue_t& upper,
+          const typename NODE::NodeValue_t& step, const typename NODE::NodeValue_t& start, const typename NODE::NodeValue_t& end, bool index) {
+	GenericRRT<NODE,2> rrt(new typename NODE::CollisionChecker(obs));
+	rrt.setLimits(lower,upper);
+	rrt.setInterpolation(step);
+	rrt.setUseNearestIndex(index);
+	Stats stats;
+	srand(1);
+	TimeET timer;
+	for(unsigned int p=0; p<PLANS; ++p) {
+		std::vector<typename NODE::NodeValue_t> path;
+		std::vector<NODE> treeStart, treeEnd;
+		if(rrt.planPath(start,end,MAX_ITER,&path,&treeStart,&treeEnd).code==GenericRRTBase::SUCCESS)
+			++stats.solved;
+		stats.nodes += treeStart.size() + treeEnd.size();
+		stats.waypoints += path.size();
+	}
+	stats.time = timer.Age().Value();
+	return stats;
+}
+
+//! a GenericRRT which can copy its collision checker for parallel searches
+template<class NODE>
+class ParallelRRT : public GenericRRT<NODE,2> {
+public:
+	ParallelRRT(typename NODE::CollisionChecker *cc) : GenericRRT<NODE,2>(cc) {}
+	typename NODE::CollisionChecker* getChecker() { return this->cc; }
+protected:
+	virtual typename NODE::CollisionChecker* cloneCollisionChecker() const { return new typename NODE::CollisionChecker(*this->cc); }
+};
+
+template<class NODE>
+void parallel(const string& name, const Obstacles& obs, const typename NODE::NodeValue_t& lower, const typename NODE::NodeValue_t& upper,
+              const typename NODE::NodeValue_t& step, const typename NODE::NodeValue_t& start, const typename NODE::NodeValue_t& end) {
+	TaskPool pool(3);
+	ParallelRRT<NODE> rrt(new typename NODE::CollisionChecker(obs));
+	rrt.setLimits(lower,upper);
+	rrt.setInterpolation(step);
+	rrt.setParallelPlanners(0,&pool);
+	unsigned int solved=0, clear=0;
+	srand(1);
+	TimeET timer;
+	for(unsigned int p=0; p<PLANS; ++p) {
+		std::vector<typename NODE::NodeValue_t> path;
+		if(rrt.planPath(start,end,MAX_ITER,&path).code!=GenericRRTBase::SUCCESS)
+			continue;
+		++solved;
+		bool ok = path.size()>=2 && NODE(path.front(),0).distance(start)==0 && NODE(path.back(),0).distance(end)==0;
+		for(size_t i=1; ok && i<path.size(); ++i) {
+			typename NODE::NodeValue_t reached;
+			ok = NODE::interpolate(path[i-1],path[i],step,false,rrt.getChecker(),reached,false)==RRTNodeBase::REACHED;
+		}
+		if(ok)
+			++clear;
+	}
+	const double time = timer.Age().Value();
+	cout << name << " parallel: solved " << solved << " of " << PLANS << ", paths clear: " << (clear==solved) << endl;
+	cout << name << " parallel plans per second @VAR " << PLANS/time << " on " << pool.getConcurrency() << " threads" << endl;
+}
+
+template<class NODE>
+void compare(const string& name, const Obstacles& obs, const typename NODE::NodeValue_t& lower, const typename NODE::NodeValue_t& upper,
+             const typename NODE::NodeValue_t& step, const typename NODE::NodeValue_t& start, const typename NODE::NodeValue_t& end) {
+	Stats scan = run<NODE>(obs,lower,upper,step,start,end,false);
+	Stats index = run<NODE>(obs,lower,upper,step,start,end,true);
+	cout << name << ": solved " << index.solved << " of " << PLANS << ", identical to scanning: " << (scan==index) << endl;
+	cout << name << " nodes per plan @VAR " << index.nodes/PLANS << endl;
+	cout << name << " plans per second @VAR scanning " << PLANS/scan.time << ", indexed " << PLANS/index.time << endl;
+	parallel<NODE>(name,obs,lower,upper,step,start,end);
+}
+
+int main() {
+	Thread::initMainThread();
+	// walls of posts, each with a narrow gap at alternating ends, plus clutter in between
+	srand(0);
+	Obstacles field;
+	for(unsigned int w=1; w<=4; ++w) {
+		const float gap = (w%2) ? 900 : 100;
+		for(float y=0; y<=1000; y+=30)
+			if(std::abs(y-gap)>40)
+				field.push_back(CircularObstacle(200*w, y, 16));
+	}
+	while(field.size()<300) {
+		const float x = randomUnit()*1000, y = randomUnit()*1000;
+		if(std::abs(x-20)+std::abs(y-20)>80 && std::abs(x-980)+std::abs(y-980)>80)
+			field.push_back(CircularObstacle(x, y, 5+randomUnit()*10));
+	}
+	compare<RRTNodePoint>("Point", field, RRTNodePoint::NodeValue_t(0,0), RRTNodePoint::NodeValue_t(1000,1000),
+	                      RRTNodePoint::NodeValue_t(2,2), RRTNodePoint::NodeValue_t(20,20), RRTNodePoint::NodeValue_t(980,980));
+
+	Obstacles posts;
+	posts.push_back(CircularObstacle(0, 180, 30));
+	posts.push_back(CircularObstacle(-150, -120, 40));
+	posts.push_back(CircularObstacle(170, -60, 25));
+	posts.push_back(CircularObstacle(-60, 230, 20));
+	RRTNodeArm::NodeValue_t lower, upper, step, start, end;
+	for(size_t i=0; i<RRTNodeArm::J; ++i) {
+		lower.q[i] = -3.14f; // AngSignPi would wrap -π to π
+		upper.q[i] = 3.14f;
+		step.q[i] = 0.02f;
+	}
+	start.q[0] = 0.2f;
+	end.q[0] = 2.9f;
+	end.q[1] = -0.5f;
+	end.q[2] = 1.0f;
+	compare<RRTNodeArm>("Arm", posts, lower, upper, step, start, end);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,123 @@
+#include "IPC/TaskPool.h"
+#include "Shared/TimeET.h"
+#include <atomic>
+#include <vector>
+#include <stdexcept>
+#include <iostream>
+#include <cstdlib>
+#include <cmath>
+
+size_t N = 2000000; // size of the parallel_for range
+unsigned int W = 3; // number of workers
+
+// an arbitrary amount of floating point work per index
+struct Work {
+	explicit Work(std::vector<double>& o) : out(o) {}
+	void operator()(size_t i) const {
+		double x=i;
+		for(unsigned int k=0; k<20; ++k)
+			x=std::sqrt(x+k);
+		out[i]=x;
+	}
+	std::vector<double>& out;
+};
+
+// counts calls from each index, to check every index is visited exactly once
+struct Visit {
+	explicit Visit(std::vector<std::atomic<int> >& c) : counts(c) {}
+	void operator()(size_t b, size_t e) const {
+		for(; b!=e; ++b)
+			++counts[b];
+	}
+	std::vector<std::atomic<int> >& counts;
+};
+
+// each task launches its own parallel_for, to check nested waits make progress
+struct Nested {
+	Nested(TaskPool& p, std::atomic<long>& s) : pool(p), sum(s) {}
+	void operator()() const { pool.parallel_for(0,1000,*this,10); }
+	void operator()(size_t i) const { sum+=i; }
+	TaskPool& pool;
+	std::atomic<long>& sum;
+};
+
+struct Answer { int operator()() const { return 42; } };
+struct Thrower { void operator()() const { throw std::runtime_error("task failure"); } };
+struct ThrowAt {
+	void operator()(size_t i) const {
+		if(i==777)
+			throw std::out_of_range("index 777");
+	}
+};
+
+void testPool(TaskPool& pool) {
+	std::cout << "Pool test @VAR " << pool.getNumWorkers() << " workers" << std::endl;
+	
+	std::vector<std::atomic<int> > counts(N);
+	for(size_t i=0; i<N; ++i)
+		counts[i]=0;
+	pool.parallel_for_range(0,N,Visit(counts));
+	pool.parallel_for_range(0,N,Visit(counts),1000);
+	size_t bad=0;
+	for(size_t i=0; i<N; ++i)
+		if(counts[i]!=2)
+			++bad;
+	std::cout << "parallel_for indices visited other than twice: " << bad << std::endl;
+	
+	std::atomic<long> sum(0);
+	{
+		TaskPool::TaskGroup g(pool);
+		for(unsigned int i=0; i<20; ++i)
+			g.run(Nested(pool,sum));
+		g.wait();
+	}
+	std::cout << "Nested sum: " << sum << std::endl;
+	
+	TaskPool::Future<int> f=pool.async(Answer());
+	std::cout << "Future: " << f.get() << std::endl;
+	
+	TaskPool::TaskGroup g(pool);
+	g.run(Thrower());
+	try {
+		g.wait();
+		std::cout << "TaskGroup exception was lost" << std::endl;
+	} catch(const std::runtime_error& ex) {
+		std::cout << "TaskGroup rethrew: " << ex.what() << std::endl;
+	}
+	try {
+		pool.parallel_for(0,10000,ThrowAt(),100);
+		std::cout << "parallel_for exception was lost" << std::endl;
+	} catch(const std::out_of_range& ex) {
+		std::cout << "parallel_for rethrew: " << ex.what() << std::endl;
+	}
+	std::cout << std::endl;
+}
+
+int main(int argc, const char* argv[]) {
+	if(argc>1)
+		N=atoi(argv[1]);
+	if(argc>2)
+		W=atoi(argv[2]);
+	Thread::initMainThread();
+	
+	{
+		TaskPool pool(0);
+		testPool(pool);
+	}
+	TaskPool::setDefaultWorkers(W);
+	testPool(TaskPool::getDefault());
+	
+	std::vector<double> out(N);
+	Work work(out);
+	TimeET t;
+	for(size_t i=0; i<N; ++i)
+		work(i);
+	double serial=t.Age().Value();
+	t.Set();
+	TaskPool::getDefault().parallel_for(0,N,work);
+	double parallel=t.Age().Value();
+	std::cout << "Speedup @VAR " << serial/parallel << " (serial " << serial << "s, parallel " << parallel << "s)" << std::endl;
+	
+	TaskPool::releaseDefault();
+	return EXIT_SUCCESS;
+}